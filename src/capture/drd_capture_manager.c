@@ -11,6 +11,8 @@ struct _DrdCaptureManager
     gboolean running;
     DrdFrameQueue *queue;
     DrdX11Capture *x11_capture;
+    GMutex demand_lock;
+    guint demand_holders; /* 持有按需抓帧模式的 Rdpgfx 流水线数，受 demand_lock 保护 */
 };
 
 G_DEFINE_TYPE(DrdCaptureManager, drd_capture_manager, G_TYPE_OBJECT)
@@ -36,9 +38,23 @@ drd_capture_manager_dispose(GObject *object)
     G_OBJECT_CLASS(drd_capture_manager_parent_class)->dispose(object);
 }
 
+/*
+ * 功能：终结捕获管理器。
+ * 逻辑：清理按需模式计数锁后交由父类 finalize。
+ * 参数：object 基类指针。
+ * 外部接口：GLib g_mutex_clear。
+ */
+static void
+drd_capture_manager_finalize(GObject *object)
+{
+    DrdCaptureManager *self = DRD_CAPTURE_MANAGER(object);
+    g_mutex_clear(&self->demand_lock);
+    G_OBJECT_CLASS(drd_capture_manager_parent_class)->finalize(object);
+}
+
 /*
  * 功能：初始化捕获管理器的类方法表。
- * 逻辑：将自定义 dispose 覆盖到 GObjectClass，以便释放内部对象。
+ * 逻辑：将自定义 dispose/finalize 覆盖到 GObjectClass，以便释放内部对象。
  * 参数：klass 类对象。
  * 外部接口：依赖 GLib 类型系统进行类初始化。
  */
@@ -47,13 +63,14 @@ drd_capture_manager_class_init(DrdCaptureManagerClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
     object_class->dispose = drd_capture_manager_dispose;
+    object_class->finalize = drd_capture_manager_finalize;
 }
 
 /*
  * 功能：初始化捕获管理器实例字段。
- * 逻辑：默认置 running 为 FALSE，创建帧队列并实例化 X11 捕获对象。
+ * 逻辑：默认置 running 为 FALSE，创建帧队列并实例化 X11 捕获对象，初始化按需模式计数。
  * 参数：self 捕获管理器实例。
- * 外部接口：调用 drd_frame_queue_new、drd_x11_capture_new 创建内部组件。
+ * 外部接口：调用 drd_frame_queue_new、drd_x11_capture_new 创建内部组件；GLib g_mutex_init。
  */
 static void
 drd_capture_manager_init(DrdCaptureManager *self)
@@ -61,6 +78,8 @@ drd_capture_manager_init(DrdCaptureManager *self)
     self->running = FALSE;
     self->queue = drd_frame_queue_new();
     self->x11_capture = drd_x11_capture_new(self->queue);
+    g_mutex_init(&self->demand_lock);
+    self->demand_holders = 0;
 }
 
 /*
@@ -108,9 +127,9 @@ drd_capture_manager_start(DrdCaptureManager *self, guint width, guint height, GE
 
 /*
  * 功能：停止捕获线程并清理队列。
- * 逻辑：若未运行直接返回；先停止 X11 捕获与队列，再输出丢帧统计并清除 running 标志。
+ * 逻辑：若未运行直接返回；先停止 X11 捕获与队列，再输出丢帧与消费端阻塞等待统计并清除 running 标志。
  * 参数：self 管理器实例。
- * 外部接口：调用 drd_x11_capture_stop、drd_frame_queue_stop、drd_frame_queue_get_dropped_frames，日志使用 DRD_LOG_WARNING/DRD_LOG_MESSAGE。
+ * 外部接口：调用 drd_x11_capture_stop、drd_frame_queue_stop、drd_frame_queue_get_stats，日志使用 DRD_LOG_WARNING/DRD_LOG_MESSAGE。
  */
 void
 drd_capture_manager_stop(DrdCaptureManager *self)
@@ -125,11 +144,20 @@ drd_capture_manager_stop(DrdCaptureManager *self)
     drd_x11_capture_stop(self->x11_capture);
     drd_frame_queue_stop(self->queue);
 
-    const guint64 dropped = drd_frame_queue_get_dropped_frames(self->queue);
-    if (dropped > 0)
+    DrdFrameQueueStats stats;
+    drd_frame_queue_get_stats(self->queue, &stats);
+    if (stats.dropped_frames > 0)
     {
         DRD_LOG_WARNING("Capture manager dropped %" G_GUINT64_FORMAT " frame(s) due to backpressure",
-                        dropped);
+                        stats.dropped_frames);
+    }
+    if (stats.waits > 0)
+    {
+        DRD_LOG_MESSAGE("Capture queue consumer waited %" G_GUINT64_FORMAT " time(s), avg=%" G_GUINT64_FORMAT
+                        "us max=%" G_GINT64_FORMAT "us",
+                        stats.waits,
+                        stats.wait_us_total / stats.waits,
+                        stats.wait_us_max);
     }
 
     DRD_LOG_MESSAGE("Capture manager leaving running state");
@@ -149,6 +177,71 @@ drd_capture_manager_is_running(DrdCaptureManager *self)
     return self->running;
 }
 
+/*
+ * 功能：调整捕获线程的有效帧率。
+ * 逻辑：委托 X11 捕获模块更新抓帧间隔，0 表示恢复全局 target_fps。
+ * 参数：self 管理器实例；fps 有效帧率。
+ * 外部接口：drd_x11_capture_set_target_fps。
+ */
+void
+drd_capture_manager_set_target_fps(DrdCaptureManager *self, guint fps)
+{
+    g_return_if_fail(DRD_IS_CAPTURE_MANAGER(self));
+    drd_x11_capture_set_target_fps(self->x11_capture, fps);
+}
+
+/*
+ * 功能：登记一条需要按需抓帧的流水线。
+ * 逻辑：持锁计数，由 0 变 1 时委托 X11 捕获模块开启按需模式；此后仅在 drd_capture_manager_grant_credit 授信后抓帧，
+ *       任一持有者授信即抓取一帧并分发给全部订阅者。
+ * 参数：self 管理器实例。
+ * 外部接口：drd_x11_capture_set_demand_mode。
+ */
+void
+drd_capture_manager_hold_demand_mode(DrdCaptureManager *self)
+{
+    g_return_if_fail(DRD_IS_CAPTURE_MANAGER(self));
+
+    g_mutex_lock(&self->demand_lock);
+    if (self->demand_holders++ == 0)
+    {
+        drd_x11_capture_set_demand_mode(self->x11_capture, TRUE);
+    }
+    g_mutex_unlock(&self->demand_lock);
+}
+
+/*
+ * 功能：注销一条按需抓帧的流水线。
+ * 逻辑：持锁计数，最后一个持有者注销时恢复定时抓帧，把捕获帧交还 SurfaceBits 路径。
+ * 参数：self 管理器实例。
+ * 外部接口：drd_x11_capture_set_demand_mode。
+ */
+void
+drd_capture_manager_release_demand_mode(DrdCaptureManager *self)
+{
+    g_return_if_fail(DRD_IS_CAPTURE_MANAGER(self));
+
+    g_mutex_lock(&self->demand_lock);
+    if (self->demand_holders > 0 && --self->demand_holders == 0)
+    {
+        drd_x11_capture_set_demand_mode(self->x11_capture, FALSE);
+    }
+    g_mutex_unlock(&self->demand_lock);
+}
+
+/*
+ * 功能：发送端有容量时授予一次抓帧额度。
+ * 逻辑：委托 X11 捕获模块，额度不累积。
+ * 参数：self 管理器实例。
+ * 外部接口：drd_x11_capture_grant_credit。
+ */
+void
+drd_capture_manager_grant_credit(DrdCaptureManager *self)
+{
+    g_return_if_fail(DRD_IS_CAPTURE_MANAGER(self));
+    drd_x11_capture_grant_credit(self->x11_capture);
+}
+
 /*
  * 功能：获取当前显示的实际分辨率。
  * 逻辑：委托 X11 捕获模块读取 Display 宽高。
@@ -181,6 +274,78 @@ drd_capture_manager_get_queue(DrdCaptureManager *self)
     return self->queue;
 }
 
+/*
+ * 功能：订阅捕获帧，供多个 Rdpgfx 编码组共享同一路捕获。
+ * 逻辑：创建独立的“最新帧胜出”邮箱并登记到 X11 捕获线程，每帧与主队列收到同一帧引用；
+ *       各订阅者按自己的节奏消费，慢者只会丢掉自己邮箱里的旧帧，不影响其他订阅者。
+ * 参数：self 管理器实例。
+ * 外部接口：drd_frame_queue_new；drd_x11_capture_add_tap。
+ * 返回：订阅邮箱（调用方持有引用），用 drd_capture_manager_unsubscribe 注销。
+ */
+DrdFrameQueue *
+drd_capture_manager_subscribe(DrdCaptureManager *self)
+{
+    g_return_val_if_fail(DRD_IS_CAPTURE_MANAGER(self), NULL);
+
+    DrdFrameQueue *queue = drd_frame_queue_new();
+    drd_x11_capture_add_tap(self->x11_capture, queue);
+    return queue;
+}
+
+/*
+ * 功能：注销捕获帧订阅。
+ * 逻辑：从 X11 捕获线程移除后停止邮箱，唤醒可能阻塞在其上的消费者；调用方仍需释放自己的引用。
+ * 参数：self 管理器实例；queue 订阅邮箱。
+ * 外部接口：drd_x11_capture_remove_tap；drd_frame_queue_stop。
+ */
+void
+drd_capture_manager_unsubscribe(DrdCaptureManager *self, DrdFrameQueue *queue)
+{
+    g_return_if_fail(DRD_IS_CAPTURE_MANAGER(self));
+    g_return_if_fail(DRD_IS_FRAME_QUEUE(queue));
+
+    drd_x11_capture_remove_tap(self->x11_capture, queue);
+    drd_frame_queue_stop(queue);
+}
+
+/*
+ * 功能：在运行状态下等待订阅邮箱中的捕获帧。
+ * 逻辑：与 drd_capture_manager_wait_frame 相同，只是从订阅邮箱取帧。
+ * 参数：self 管理器；queue 订阅邮箱；timeout_us 超时时间（微秒）；out_frame 输出帧；error 错误输出。
+ * 外部接口：drd_frame_queue_wait；GLib g_set_error_literal。
+ */
+gboolean
+drd_capture_manager_wait_subscribed(DrdCaptureManager *self,
+                                    DrdFrameQueue *queue,
+                                    gint64 timeout_us,
+                                    DrdFrame **out_frame,
+                                    GError **error)
+{
+    g_return_val_if_fail(DRD_IS_CAPTURE_MANAGER(self), FALSE);
+    g_return_val_if_fail(DRD_IS_FRAME_QUEUE(queue), FALSE);
+    g_return_val_if_fail(out_frame != NULL, FALSE);
+
+    if (!self->running)
+    {
+        g_set_error_literal(error,
+                            G_IO_ERROR,
+                            G_IO_ERROR_FAILED,
+                            "Capture manager is not running");
+        return FALSE;
+    }
+
+    if (!drd_frame_queue_wait(queue, timeout_us, out_frame))
+    {
+        g_set_error_literal(error,
+                            G_IO_ERROR,
+                            G_IO_ERROR_TIMED_OUT,
+                            "Timed out waiting for capture frame");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /*
  * 功能：在运行状态下等待捕获帧输出。
  * 逻辑：若未运行则报错；调用帧队列等待接口获取帧，超时或失败返回错误；成功时返回帧对象。
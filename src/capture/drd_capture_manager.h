@@ -15,6 +15,10 @@ gboolean drd_capture_manager_start(DrdCaptureManager *self, guint width,
                                    guint height, GError **error);
 void drd_capture_manager_stop(DrdCaptureManager *self);
 gboolean drd_capture_manager_is_running(DrdCaptureManager *self);
+void drd_capture_manager_set_target_fps(DrdCaptureManager *self, guint fps);
+void drd_capture_manager_hold_demand_mode(DrdCaptureManager *self);
+void drd_capture_manager_release_demand_mode(DrdCaptureManager *self);
+void drd_capture_manager_grant_credit(DrdCaptureManager *self);
 gboolean drd_capture_manager_get_display_size(DrdCaptureManager *self,
                                               guint *out_width,
                                               guint *out_height,
@@ -23,5 +27,12 @@ DrdFrameQueue *drd_capture_manager_get_queue(DrdCaptureManager *self);
 gboolean drd_capture_manager_wait_frame(DrdCaptureManager *self,
                                         gint64 timeout_us, DrdFrame **out_frame,
                                         GError **error);
+DrdFrameQueue *drd_capture_manager_subscribe(DrdCaptureManager *self);
+void drd_capture_manager_unsubscribe(DrdCaptureManager *self, DrdFrameQueue *queue);
+gboolean drd_capture_manager_wait_subscribed(DrdCaptureManager *self,
+                                             DrdFrameQueue *queue,
+                                             gint64 timeout_us,
+                                             DrdFrame **out_frame,
+                                             GError **error);
 
 G_END_DECLS
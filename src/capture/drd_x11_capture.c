@@ -31,6 +31,8 @@ struct _DrdX11Capture
 
     GMutex state_mutex;
     DrdFrameQueue *queue;
+    GMutex tap_mutex;
+    GPtrArray *taps; /* 额外订阅的帧队列（各 Rdpgfx 编码组），与 queue 收到同一帧的引用，受 tap_mutex 保护 */
     GThread *thread;
 
     gboolean running;
@@ -48,6 +50,9 @@ struct _DrdX11Capture
     guint width;
     guint height;
     int wakeup_pipe[2];
+    gint target_fps; /* 会话帧率调节器下发的有效帧率，0 表示沿用全局配置 */
+    gint demand_mode; /* 按需抓帧：仅在发送端授信后抓取 */
+    gint credit;      /* 发送端授予的抓帧额度（0/1），抓帧后清零 */
 };
 
 G_DEFINE_TYPE(DrdX11Capture, drd_x11_capture, G_TYPE_OBJECT)
@@ -62,9 +67,11 @@ static void drd_x11_capture_close_wakeup_pipe(DrdX11Capture *self);
 
 static void drd_x11_capture_drain_wakeup_pipe(int fd);
 
+static void drd_x11_capture_wakeup(DrdX11Capture *self);
+
 /*
  * 功能：释放 X11 捕获实例持有的资源。
- * 逻辑：调用 stop 确保线程退出；清理 display 名称与帧队列引用，最后交由父类 dispose。
+ * 逻辑：调用 stop 确保线程退出；清理 display 名称、帧队列与订阅队列引用，最后交由父类 dispose。
  * 参数：object 基类指针，期望为 DrdX11Capture。
  * 外部接口：GLib g_clear_pointer/g_clear_object 释放资源，最终调用 GObjectClass::dispose。
  */
@@ -77,13 +84,16 @@ drd_x11_capture_dispose(GObject *object)
 
     g_clear_pointer(&self->display_name, g_free);
     g_clear_object(&self->queue);
+    g_mutex_lock(&self->tap_mutex);
+    g_clear_pointer(&self->taps, g_ptr_array_unref);
+    g_mutex_unlock(&self->tap_mutex);
 
     G_OBJECT_CLASS(drd_x11_capture_parent_class)->dispose(object);
 }
 
 /*
  * 功能：清理互斥锁等基础资源。
- * 逻辑：销毁 state_mutex，然后调用父类 finalize 完成剩余释放。
+ * 逻辑：销毁 state_mutex 与 tap_mutex，然后调用父类 finalize 完成剩余释放。
  * 参数：object 基类指针。
  * 外部接口：GLib g_mutex_clear。
  */
@@ -92,6 +102,7 @@ drd_x11_capture_finalize(GObject *object)
 {
     DrdX11Capture *self = DRD_X11_CAPTURE(object);
     g_mutex_clear(&self->state_mutex);
+    g_mutex_clear(&self->tap_mutex);
     G_OBJECT_CLASS(drd_x11_capture_parent_class)->finalize(object);
 }
 
@@ -111,19 +122,24 @@ drd_x11_capture_class_init(DrdX11CaptureClass *klass)
 
 /*
  * 功能：初始化实例字段。
- * 逻辑：初始化互斥锁与共享内存标记，置运行状态与唤醒管道为未激活。
+ * 逻辑：初始化互斥锁、订阅队列列表与共享内存标记，置运行状态与唤醒管道为未激活。
  * 参数：self 捕获实例。
- * 外部接口：GLib g_mutex_init、C 库 memset。
+ * 外部接口：GLib g_mutex_init/g_ptr_array_new_with_free_func、C 库 memset。
  */
 static void
 drd_x11_capture_init(DrdX11Capture *self)
 {
     g_mutex_init(&self->state_mutex);
+    g_mutex_init(&self->tap_mutex);
+    self->taps = g_ptr_array_new_with_free_func(g_object_unref);
     memset(&self->shm.info, 0, sizeof(self->shm.info));
     self->shm.info.shmid = -1;
     self->running = FALSE;
     self->wakeup_pipe[0] = -1;
     self->wakeup_pipe[1] = -1;
+    self->target_fps = 0;
+    self->demand_mode = 0;
+    self->credit = 0;
 }
 
 /*
@@ -434,14 +450,7 @@ drd_x11_capture_stop(DrdX11Capture *self)
         XSync(display, False);
     }
 
-    if (self->wakeup_pipe[1] >= 0)
-    {
-        const gchar signal_byte = 'x';
-        if (write(self->wakeup_pipe[1], &signal_byte, 1) < 0)
-        {
-            (void) signal_byte;
-        }
-    }
+    drd_x11_capture_wakeup(self);
 
     if (self->thread != NULL)
     {
@@ -475,8 +484,10 @@ drd_x11_capture_is_running(DrdX11Capture *self)
 }
 
 /*
- * 功能：捕获线程主循环，从 X11 拉帧并写入队列。
- * 逻辑：循环读取运行状态与资源；按 target_interval 驱动一次事件消费与抓帧，期间用 g_poll 监听 X 连接和唤醒管道；每个间隔都会触发一次抓帧，XDamage 事件仅用于清理队列与统计，避免被合成器合并后的事件频率限制帧率。
+ * 功能：捕获线程主循环，从 X11 拉帧并写入主队列与各订阅队列。
+ * 逻辑：循环读取运行状态与资源；按 target_interval 驱动一次事件消费与抓帧，期间用 g_poll 监听 X 连接和唤醒管道；
+ *       XDamage 事件跨轮次累积，直到真正抓帧才清除，避免在帧间隔内到达的损坏被遗漏；按需模式下还须持有发送端
+ *       授予的额度才抓帧，拥塞时不再抓取注定被队列丢弃的帧，恢复时一次抓到包含全部累积损坏的最新画面。
  * 参数：user_data 线程参数，DrdX11Capture 实例。
  * 外部接口：XPending/XNextEvent/XDamageSubtract 处理 Damage 事件；g_poll 监听文件描述符；XShmGetImage 抓帧；glib 时间函数 g_get_monotonic_time；DrdFrame API drd_frame_new/configure/ensure_capacity 与 drd_frame_queue_push；日志 DRD_LOG_MESSAGE/DRD_LOG_WARNING。
  */
@@ -485,13 +496,15 @@ drd_x11_capture_thread(gpointer user_data)
 {
     DrdX11Capture *self = DRD_X11_CAPTURE(user_data);
 
-    const guint target_fps = drd_capture_metrics_get_target_fps();
-    const gint64 target_interval = drd_capture_metrics_get_target_interval_us();
+    guint target_fps = drd_capture_metrics_get_target_fps();
+    gint64 target_interval = drd_capture_metrics_get_target_interval_us();
     const gint64 stats_interval = drd_capture_metrics_get_stats_interval_us();
     gint64 stats_window_start = 0;
     guint stats_frames = 0;
     gint64 next_capture_deadline = 0;
     gint64 now = 0;
+    gboolean damage_pending = FALSE;
+    guint coalesced_damage = 0;
 
     while (TRUE)
     {
@@ -503,7 +516,6 @@ drd_x11_capture_thread(gpointer user_data)
         guint height = 0;
         gboolean running;
         int wake_fd = -1;
-        gboolean damage = FALSE;
 
         g_mutex_lock(&self->state_mutex);
         running = self->running;
@@ -516,6 +528,15 @@ drd_x11_capture_thread(gpointer user_data)
         wake_fd = self->wakeup_pipe[0];
         g_mutex_unlock(&self->state_mutex);
 
+        const guint override_fps = (guint) g_atomic_int_get(&self->target_fps);
+        const guint effective_fps = override_fps > 0 ? override_fps : drd_capture_metrics_get_target_fps();
+        if (effective_fps != target_fps)
+        {
+            target_fps = effective_fps;
+            target_interval = override_fps > 0 ? (gint64) (G_USEC_PER_SEC / target_fps)
+                                               : drd_capture_metrics_get_target_interval_us();
+        }
+
         if (!running || display == NULL || image == NULL)
         {
             DRD_LOG_MESSAGE("break x11 capture thread");
@@ -560,11 +581,20 @@ drd_x11_capture_thread(gpointer user_data)
             if (event.type == damage_event_base + XDamageNotify)
             {
                 XDamageSubtract(display, self->damage, None, None);
-                damage = TRUE;
+                if (damage_pending)
+                {
+                    coalesced_damage++;
+                }
+                damage_pending = TRUE;
             }
         }
-        if (!damage)
+        if (!damage_pending)
+            continue;
+        if (g_atomic_int_get(&self->demand_mode) && !g_atomic_int_get(&self->credit))
+        {
+            /* 发送端暂无容量：保留累积的损坏，等待授信唤醒 */
             continue;
+        }
         now = g_get_monotonic_time();
         if (now < next_capture_deadline)
         {
@@ -577,6 +607,8 @@ drd_x11_capture_thread(gpointer user_data)
             next_capture_deadline = now + target_interval;
             continue;
         }
+        damage_pending = FALSE;
+        g_atomic_int_set(&self->credit, 0);
         stats_frames++;
         g_autoptr(DrdFrame) frame = drd_frame_new();
         now = g_get_monotonic_time();
@@ -592,6 +624,13 @@ drd_x11_capture_thread(gpointer user_data)
         {
             memcpy(buffer, image->data, frame_size);
             drd_frame_queue_push(self->queue, frame);
+            /* 帧抓取后只读，各订阅者共享同一份像素 */
+            g_mutex_lock(&self->tap_mutex);
+            for (guint i = 0; self->taps != NULL && i < self->taps->len; ++i)
+            {
+                drd_frame_queue_push(g_ptr_array_index(self->taps, i), frame);
+            }
+            g_mutex_unlock(&self->tap_mutex);
         }
 
         if (stats_window_start == 0)
@@ -606,11 +645,14 @@ drd_x11_capture_thread(gpointer user_data)
                 const gdouble actual_fps =
                     (gdouble) stats_frames * (gdouble) G_USEC_PER_SEC / (gdouble) stats_elapsed;
                 const gboolean reached_target = actual_fps >= (gdouble) target_fps;
-                DRD_LOG_MESSAGE("X11 capture fps=%.2f (target=%u): %s",
+                DRD_LOG_MESSAGE("X11 capture fps=%.2f (target=%u demand=%s coalesced_damage=%u): %s",
                                 actual_fps,
                                 target_fps,
+                                g_atomic_int_get(&self->demand_mode) ? "on" : "off",
+                                coalesced_damage,
                                 reached_target ? "reached target" : "below target");
                 stats_frames = 0;
+                coalesced_damage = 0;
                 stats_window_start = now;
             }
         }
@@ -626,6 +668,114 @@ drd_x11_capture_thread(gpointer user_data)
     return NULL;
 }
 
+/*
+ * 功能：调整捕获线程的有效帧率。
+ * 逻辑：原子写入 target_fps，捕获线程在下一轮循环读取并换算抓帧间隔；0 表示恢复全局配置。
+ * 参数：self 捕获实例；fps 有效帧率。
+ * 外部接口：GLib g_atomic_int_set。
+ */
+void
+drd_x11_capture_set_target_fps(DrdX11Capture *self, guint fps)
+{
+    g_return_if_fail(DRD_IS_X11_CAPTURE(self));
+
+    g_atomic_int_set(&self->target_fps, (gint) MIN(fps, (guint) G_MAXINT));
+}
+
+/*
+ * 功能：切换按需抓帧模式。
+ * 逻辑：原子写入 demand_mode；开启时预置一次额度让首帧无需等待，关闭时唤醒线程按定时模式继续抓帧。
+ * 参数：self 捕获实例；enabled 是否仅在授信后抓帧。
+ * 外部接口：GLib g_atomic_int_set。
+ */
+void
+drd_x11_capture_set_demand_mode(DrdX11Capture *self, gboolean enabled)
+{
+    g_return_if_fail(DRD_IS_X11_CAPTURE(self));
+
+    g_atomic_int_set(&self->credit, 1);
+    g_atomic_int_set(&self->demand_mode, enabled ? 1 : 0);
+    drd_x11_capture_wakeup(self);
+}
+
+/*
+ * 功能：增加一个帧订阅队列。
+ * 逻辑：持锁加入订阅列表并持有引用，此后每帧与主队列一同推入。
+ * 参数：self 捕获实例；queue 订阅队列。
+ * 外部接口：GLib g_ptr_array_add/g_object_ref。
+ */
+void
+drd_x11_capture_add_tap(DrdX11Capture *self, DrdFrameQueue *queue)
+{
+    g_return_if_fail(DRD_IS_X11_CAPTURE(self));
+    g_return_if_fail(DRD_IS_FRAME_QUEUE(queue));
+
+    g_mutex_lock(&self->tap_mutex);
+    if (self->taps != NULL)
+    {
+        g_ptr_array_add(self->taps, g_object_ref(queue));
+    }
+    g_mutex_unlock(&self->tap_mutex);
+}
+
+/*
+ * 功能：移除一个帧订阅队列。
+ * 逻辑：持锁从订阅列表删除并释放引用；返回后捕获线程不再向其推帧。
+ * 参数：self 捕获实例；queue 订阅队列。
+ * 外部接口：GLib g_ptr_array_remove。
+ */
+void
+drd_x11_capture_remove_tap(DrdX11Capture *self, DrdFrameQueue *queue)
+{
+    g_return_if_fail(DRD_IS_X11_CAPTURE(self));
+
+    g_mutex_lock(&self->tap_mutex);
+    if (self->taps != NULL)
+    {
+        g_ptr_array_remove(self->taps, queue);
+    }
+    g_mutex_unlock(&self->tap_mutex);
+}
+
+/*
+ * 功能：授予捕获线程一次抓帧额度。
+ * 逻辑：额度最多为 1，不累积；仅在 0→1 时写唤醒管道，使已有累积损坏时立即抓帧而不必等到下一个 poll 超时。
+ * 参数：self 捕获实例。
+ * 外部接口：GLib g_atomic_int_compare_and_exchange。
+ */
+void
+drd_x11_capture_grant_credit(DrdX11Capture *self)
+{
+    g_return_if_fail(DRD_IS_X11_CAPTURE(self));
+
+    if (g_atomic_int_compare_and_exchange(&self->credit, 0, 1))
+    {
+        drd_x11_capture_wakeup(self);
+    }
+}
+
+/*
+ * 功能：唤醒阻塞在 g_poll 上的捕获线程。
+ * 逻辑：向非阻塞唤醒管道写入 1 字节；管道已满说明线程尚未消费前一次唤醒，忽略即可。
+ * 参数：self 捕获实例。
+ * 外部接口：POSIX write。
+ */
+static void
+drd_x11_capture_wakeup(DrdX11Capture *self)
+{
+    const int fd = self->wakeup_pipe[1];
+    if (fd < 0)
+    {
+        return;
+    }
+
+    const gchar signal_byte = 'x';
+    if (write(fd, &signal_byte, 1) < 0)
+    {
+        (void) signal_byte;
+    }
+}
+
 /*
  * 功能：创建唤醒管道供线程退出时使用。
  * 逻辑：若已有管道直接返回；否则通过 g_unix_open_pipe 创建带 CLOEXEC 标志的管道并缓存 fd。
@@ -645,6 +795,13 @@ drd_x11_capture_setup_wakeup_pipe(DrdX11Capture *self, GError **error)
     {
         return FALSE;
     }
+    /* 读端排空循环与授信写入都不能阻塞 */
+    if (!g_unix_set_fd_nonblocking(fds[0], TRUE, error) || !g_unix_set_fd_nonblocking(fds[1], TRUE, error))
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return FALSE;
+    }
 
     self->wakeup_pipe[0] = fds[0];
     self->wakeup_pipe[1] = fds[1];
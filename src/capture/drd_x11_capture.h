@@ -17,6 +17,11 @@ gboolean drd_x11_capture_start(DrdX11Capture *self, const gchar *display_name,
 
 void drd_x11_capture_stop(DrdX11Capture *self);
 gboolean drd_x11_capture_is_running(DrdX11Capture *self);
+void drd_x11_capture_set_target_fps(DrdX11Capture *self, guint fps);
+void drd_x11_capture_set_demand_mode(DrdX11Capture *self, gboolean enabled);
+void drd_x11_capture_grant_credit(DrdX11Capture *self);
+void drd_x11_capture_add_tap(DrdX11Capture *self, DrdFrameQueue *queue);
+void drd_x11_capture_remove_tap(DrdX11Capture *self, DrdFrameQueue *queue);
 gboolean drd_x11_capture_get_display_size(DrdX11Capture *self,
                                           const gchar *display_name,
                                           guint *out_width, guint *out_height,
@@ -365,6 +365,12 @@ drd_application_start_listener(DrdApplication *self, GError **error)
         return FALSE;
     }
 
+    drd_rdp_listener_set_accept_limits(self->listener,
+                                       drd_config_get_accept_workers(self->config),
+                                       drd_config_get_accept_queue_max(self->config),
+                                       drd_config_get_accept_queue_timeout_ms(self->config),
+                                       drd_config_get_routing_peek_timeout_ms(self->config));
+
     if (!drd_rdp_listener_start(self->listener, error))
     {
         g_clear_object(&self->listener);
@@ -681,6 +687,8 @@ drd_application_parse_options(DrdApplication *self, gint *argc, gchar ***argv, G
 
     drd_capture_metrics_apply_config(drd_config_get_capture_target_fps(self->config),
                                      drd_config_get_capture_stats_interval_sec(self->config));
+    drd_capture_metrics_apply_adaptive_config(drd_config_get_capture_adaptive_fps(self->config),
+                                              drd_config_get_capture_min_fps(self->config));
 
     g_clear_pointer(&bind_address, g_free);
     g_clear_pointer(&cert_path, g_free);
@@ -23,6 +23,12 @@ struct _DrdConfig
     DrdEncodingOptions encoding;
     guint capture_target_fps;
     guint capture_stats_interval_sec;
+    gboolean capture_adaptive_fps;
+    guint capture_min_fps;
+    guint accept_workers;           /* 接入工作线程数 */
+    guint accept_queue_max;         /* 已受理未结束的连接上限 */
+    guint accept_queue_timeout_ms;  /* 单个工作阶段排队等待线程的上限 */
+    guint routing_peek_timeout_ms;  /* system 模式窥探路由令牌的上限 */
 };
 
 G_DEFINE_TYPE(DrdConfig, drd_config, G_TYPE_OBJECT)
@@ -39,6 +45,13 @@ static void drd_config_set_runtime_mode_internal(DrdConfig *self, DrdRuntimeMode
 
 static void drd_config_refresh_pam_service(DrdConfig * self);
 
+static gboolean drd_config_parse_service_uint(GKeyFile *keyfile,
+                                              const gchar *key,
+                                              guint min_value,
+                                              guint max_value,
+                                              guint *out_value,
+                                              GError **error);
+
 /*
  * 功能：释放配置实例中持有的动态字符串资源。
  * 逻辑：依次清理绑定地址、证书路径、NLA 凭据、基目录与 PAM 服务名，最后交由父类 dispose。
@@ -95,6 +108,18 @@ drd_config_init(DrdConfig *self)
     self->encoding.gfx_large_change_threshold = DRD_GFX_DEFAULT_LARGE_CHANGE_THRESHOLD;
     self->encoding.gfx_progressive_refresh_interval = DRD_GFX_DEFAULT_PROGRESSIVE_REFRESH_INTERVAL;
     self->encoding.gfx_progressive_refresh_timeout_ms = DRD_GFX_DEFAULT_PROGRESSIVE_REFRESH_TIMEOUT_MS;
+    self->encoding.gfx_stale_frame_ms = DRD_GFX_DEFAULT_STALE_FRAME_MS;
+    self->encoding.gfx_tile_size = DRD_GFX_DEFAULT_TILE_SIZE;
+    self->encoding.gfx_super_tile_factor = DRD_GFX_DEFAULT_SUPER_TILE_FACTOR;
+    self->encoding.gfx_max_viewers = DRD_GFX_DEFAULT_MAX_VIEWERS;
+    self->encoding.encode_core_budget = DRD_ENCODE_DEFAULT_CORE_BUDGET;
+    self->encoding.abr_enable = DRD_ABR_DEFAULT_ENABLE;
+    self->encoding.abr_min_bitrate = DRD_ABR_DEFAULT_MIN_BITRATE;
+    self->encoding.abr_max_bitrate = DRD_ABR_DEFAULT_MAX_BITRATE;
+    self->encoding.abr_min_qp = DRD_ABR_DEFAULT_MIN_QP;
+    self->encoding.abr_max_qp = DRD_ABR_DEFAULT_MAX_QP;
+    self->encoding.abr_interval_ms = DRD_ABR_DEFAULT_INTERVAL_MS;
+    self->encoding.abr_target_latency_ms = DRD_ABR_DEFAULT_TARGET_LATENCY_MS;
     self->base_dir = g_get_current_dir();
     self->nla_username = NULL;
     self->nla_password = NULL;
@@ -104,6 +129,12 @@ drd_config_init(DrdConfig *self)
     self->pam_service = NULL;
     self->capture_target_fps = 60;
     self->capture_stats_interval_sec = 5;
+    self->capture_adaptive_fps = TRUE;
+    self->capture_min_fps = 5;
+    self->accept_workers = DRD_ACCEPT_DEFAULT_WORKERS;
+    self->accept_queue_max = DRD_ACCEPT_DEFAULT_QUEUE_MAX;
+    self->accept_queue_timeout_ms = DRD_ACCEPT_DEFAULT_QUEUE_TIMEOUT_MS;
+    self->routing_peek_timeout_ms = DRD_ACCEPT_DEFAULT_PEEK_TIMEOUT_MS;
     drd_config_refresh_pam_service(self);
 }
 
@@ -413,6 +444,26 @@ drd_config_load_from_key_file(DrdConfig *self, GKeyFile *keyfile, GError **error
         }
     }
 
+    if (g_key_file_has_key(keyfile, "capture", "adaptive_fps", NULL))
+    {
+        g_autofree gchar *adaptive = g_key_file_get_string(keyfile, "capture", "adaptive_fps", NULL);
+        gboolean value = TRUE;
+        if (!drd_config_parse_bool(adaptive, &value, error))
+        {
+            return FALSE;
+        }
+        self->capture_adaptive_fps = value;
+    }
+
+    if (g_key_file_has_key(keyfile, "capture", "min_fps", NULL))
+    {
+        gint64 min_fps = g_key_file_get_integer(keyfile, "capture", "min_fps", NULL);
+        if (min_fps > 0)
+        {
+            self->capture_min_fps = (guint) min_fps;
+        }
+    }
+
     if (g_key_file_has_key(keyfile, "encoding", "mode", NULL))
     {
         g_autofree gchar *mode = g_key_file_get_string(keyfile, "encoding", "mode", NULL);
@@ -545,6 +596,201 @@ drd_config_load_from_key_file(DrdConfig *self, GKeyFile *keyfile, GError **error
         }
         self->encoding.gfx_progressive_refresh_timeout_ms = (guint) timeout_ms;
     }
+
+    if (g_key_file_has_key(keyfile, "encoding", "gfx_stale_frame_ms", NULL))
+    {
+        gint64 stale_ms = g_key_file_get_integer(keyfile, "encoding", "gfx_stale_frame_ms", NULL);
+        if (stale_ms < 0)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid gfx_stale_frame_ms %" G_GINT64_FORMAT " (must be >=0)",
+                        stale_ms);
+            return FALSE;
+        }
+        self->encoding.gfx_stale_frame_ms = (guint) stale_ms;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "gfx_tile_size", NULL))
+    {
+        gint64 tile_size = g_key_file_get_integer(keyfile, "encoding", "gfx_tile_size", NULL);
+        if (tile_size < DRD_GFX_MIN_TILE_SIZE || tile_size > DRD_GFX_MAX_TILE_SIZE || (tile_size & (tile_size - 1)) != 0)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid gfx_tile_size %" G_GINT64_FORMAT " (must be a power of two in [%d,%d])",
+                        tile_size,
+                        DRD_GFX_MIN_TILE_SIZE,
+                        DRD_GFX_MAX_TILE_SIZE);
+            return FALSE;
+        }
+        self->encoding.gfx_tile_size = (guint) tile_size;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "gfx_super_tile_factor", NULL))
+    {
+        gint64 factor = g_key_file_get_integer(keyfile, "encoding", "gfx_super_tile_factor", NULL);
+        if (factor < 1 || factor > DRD_GFX_MAX_SUPER_TILE_FACTOR)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid gfx_super_tile_factor %" G_GINT64_FORMAT " (must be in [1,%d])",
+                        factor,
+                        DRD_GFX_MAX_SUPER_TILE_FACTOR);
+            return FALSE;
+        }
+        self->encoding.gfx_super_tile_factor = (guint) factor;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "gfx_max_viewers", NULL))
+    {
+        gint64 viewers = g_key_file_get_integer(keyfile, "encoding", "gfx_max_viewers", NULL);
+        if (viewers < 1 || viewers > DRD_GFX_MAX_VIEWERS)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid gfx_max_viewers %" G_GINT64_FORMAT " (must be in [1,%d])",
+                        viewers,
+                        DRD_GFX_MAX_VIEWERS);
+            return FALSE;
+        }
+        self->encoding.gfx_max_viewers = (guint) viewers;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "encode_core_budget", NULL))
+    {
+        gint64 budget = g_key_file_get_integer(keyfile, "encoding", "encode_core_budget", NULL);
+        if (budget < 0 || budget > DRD_ENCODE_MAX_CORE_BUDGET)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid encode_core_budget %" G_GINT64_FORMAT " (must be in [0,%d])",
+                        budget,
+                        DRD_ENCODE_MAX_CORE_BUDGET);
+            return FALSE;
+        }
+        self->encoding.encode_core_budget = (guint) budget;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "abr_enable", NULL))
+    {
+        g_autofree gchar *abr = g_key_file_get_string(keyfile, "encoding", "abr_enable", NULL);
+        gboolean value = DRD_ABR_DEFAULT_ENABLE;
+        if (!drd_config_parse_bool(abr, &value, error))
+        {
+            return FALSE;
+        }
+        self->encoding.abr_enable = value;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "abr_min_bitrate", NULL))
+    {
+        gint64 value = g_key_file_get_integer(keyfile, "encoding", "abr_min_bitrate", NULL);
+        if (value <= 0)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid abr_min_bitrate %" G_GINT64_FORMAT " (must be >0)",
+                        value);
+            return FALSE;
+        }
+        self->encoding.abr_min_bitrate = (guint) value;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "abr_max_bitrate", NULL))
+    {
+        gint64 value = g_key_file_get_integer(keyfile, "encoding", "abr_max_bitrate", NULL);
+        if (value <= 0)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid abr_max_bitrate %" G_GINT64_FORMAT " (must be >0)",
+                        value);
+            return FALSE;
+        }
+        self->encoding.abr_max_bitrate = (guint) value;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "abr_min_qp", NULL))
+    {
+        gint64 value = g_key_file_get_integer(keyfile, "encoding", "abr_min_qp", NULL);
+        if (value <= 0)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid abr_min_qp %" G_GINT64_FORMAT " (must be >0)",
+                        value);
+            return FALSE;
+        }
+        self->encoding.abr_min_qp = (guint) value;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "abr_max_qp", NULL))
+    {
+        gint64 value = g_key_file_get_integer(keyfile, "encoding", "abr_max_qp", NULL);
+        if (value <= 0)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid abr_max_qp %" G_GINT64_FORMAT " (must be >0)",
+                        value);
+            return FALSE;
+        }
+        self->encoding.abr_max_qp = (guint) value;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "abr_interval_ms", NULL))
+    {
+        gint64 value = g_key_file_get_integer(keyfile, "encoding", "abr_interval_ms", NULL);
+        if (value <= 0)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid abr_interval_ms %" G_GINT64_FORMAT " (must be >0)",
+                        value);
+            return FALSE;
+        }
+        self->encoding.abr_interval_ms = (guint) value;
+    }
+
+    if (g_key_file_has_key(keyfile, "encoding", "abr_target_latency_ms", NULL))
+    {
+        gint64 value = g_key_file_get_integer(keyfile, "encoding", "abr_target_latency_ms", NULL);
+        if (value <= 0)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid abr_target_latency_ms %" G_GINT64_FORMAT " (must be >0)",
+                        value);
+            return FALSE;
+        }
+        self->encoding.abr_target_latency_ms = (guint) value;
+    }
+
+    if (self->encoding.abr_min_bitrate > self->encoding.abr_max_bitrate ||
+        self->encoding.abr_min_qp > self->encoding.abr_max_qp)
+    {
+        g_set_error(error,
+                    G_IO_ERROR,
+                    G_IO_ERROR_INVALID_ARGUMENT,
+                    "Invalid adaptive rate bounds (bitrate %u-%u, qp %u-%u)",
+                    self->encoding.abr_min_bitrate,
+                    self->encoding.abr_max_bitrate,
+                    self->encoding.abr_min_qp,
+                    self->encoding.abr_max_qp);
+        return FALSE;
+    }
 if (g_key_file_has_key(keyfile, "auth", "username", NULL))
 {
     g_clear_pointer(&self->nla_username, g_free);
@@ -642,6 +888,54 @@ if (g_key_file_has_key(keyfile, "auth", "password", NULL))
         self->nla_enabled = !rdp_sso;
     }
 
+    if (!drd_config_parse_service_uint(keyfile, "accept_workers", 1, DRD_ACCEPT_MAX_WORKERS,
+                                       &self->accept_workers, error) ||
+        !drd_config_parse_service_uint(keyfile, "accept_queue_max", 1, DRD_ACCEPT_MAX_QUEUE_MAX,
+                                       &self->accept_queue_max, error) ||
+        !drd_config_parse_service_uint(keyfile, "accept_queue_timeout_ms", 100, DRD_ACCEPT_MAX_TIMEOUT_MS,
+                                       &self->accept_queue_timeout_ms, error) ||
+        !drd_config_parse_service_uint(keyfile, "routing_peek_timeout_ms", 100, DRD_ACCEPT_MAX_TIMEOUT_MS,
+                                       &self->routing_peek_timeout_ms, error))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * 功能：解析 [service] 段中带取值范围的整数键。
+ * 逻辑：键不存在时保留 out_value 原值；存在时读取整数，越界则报错，否则写回。
+ * 参数：keyfile 配置；key 键名；min_value/max_value 闭区间；out_value 输出；error 错误输出。
+ * 外部接口：GLib g_key_file_has_key/g_key_file_get_integer。
+ */
+static gboolean
+drd_config_parse_service_uint(GKeyFile *keyfile,
+                              const gchar *key,
+                              guint min_value,
+                              guint max_value,
+                              guint *out_value,
+                              GError **error)
+{
+    if (!g_key_file_has_key(keyfile, "service", key, NULL))
+    {
+        return TRUE;
+    }
+
+    gint64 value = g_key_file_get_integer(keyfile, "service", key, NULL);
+    if (value < (gint64) min_value || value > (gint64) max_value)
+    {
+        g_set_error(error,
+                    G_IO_ERROR,
+                    G_IO_ERROR_INVALID_ARGUMENT,
+                    "Invalid %s %" G_GINT64_FORMAT " (must be in [%u,%u])",
+                    key,
+                    value,
+                    min_value,
+                    max_value);
+        return FALSE;
+    }
+    *out_value = (guint) value;
     return TRUE;
 }
 
@@ -1062,6 +1356,32 @@ drd_config_get_capture_stats_interval_sec(DrdConfig *self)
     return self->capture_stats_interval_sec;
 }
 
+/*
+ * 功能：查询是否启用会话自适应帧率。
+ * 逻辑：类型检查后返回 adaptive_fps。
+ * 参数：self 配置实例。
+ * 外部接口：无额外外部库。
+ */
+gboolean
+drd_config_get_capture_adaptive_fps(DrdConfig *self)
+{
+    g_return_val_if_fail(DRD_IS_CONFIG(self), TRUE);
+    return self->capture_adaptive_fps;
+}
+
+/*
+ * 功能：获取自适应帧率下限。
+ * 逻辑：类型检查后返回 min_fps。
+ * 参数：self 配置实例。
+ * 外部接口：无额外外部库。
+ */
+guint
+drd_config_get_capture_min_fps(DrdConfig *self)
+{
+    g_return_val_if_fail(DRD_IS_CONFIG(self), 5);
+    return self->capture_min_fps;
+}
+
 /*
  * 功能：获取编码选项结构体。
  * 逻辑：类型检查后返回内部 encoding 指针。
@@ -1074,3 +1394,55 @@ drd_config_get_encoding_options(DrdConfig *self)
     g_return_val_if_fail(DRD_IS_CONFIG(self), NULL);
     return &self->encoding;
 }
+
+/*
+ * 功能：获取接入工作线程数。
+ * 逻辑：类型检查后返回 accept_workers。
+ * 参数：self 配置实例。
+ * 外部接口：无额外外部库。
+ */
+guint
+drd_config_get_accept_workers(DrdConfig *self)
+{
+    g_return_val_if_fail(DRD_IS_CONFIG(self), DRD_ACCEPT_DEFAULT_WORKERS);
+    return self->accept_workers;
+}
+
+/*
+ * 功能：获取已受理未结束的连接上限。
+ * 逻辑：类型检查后返回 accept_queue_max。
+ * 参数：self 配置实例。
+ * 外部接口：无额外外部库。
+ */
+guint
+drd_config_get_accept_queue_max(DrdConfig *self)
+{
+    g_return_val_if_fail(DRD_IS_CONFIG(self), DRD_ACCEPT_DEFAULT_QUEUE_MAX);
+    return self->accept_queue_max;
+}
+
+/*
+ * 功能：获取接入阶段排队等待工作线程的上限（毫秒）。
+ * 逻辑：类型检查后返回 accept_queue_timeout_ms。
+ * 参数：self 配置实例。
+ * 外部接口：无额外外部库。
+ */
+guint
+drd_config_get_accept_queue_timeout_ms(DrdConfig *self)
+{
+    g_return_val_if_fail(DRD_IS_CONFIG(self), DRD_ACCEPT_DEFAULT_QUEUE_TIMEOUT_MS);
+    return self->accept_queue_timeout_ms;
+}
+
+/*
+ * 功能：获取 system 模式窥探路由令牌的上限（毫秒）。
+ * 逻辑：类型检查后返回 routing_peek_timeout_ms。
+ * 参数：self 配置实例。
+ * 外部接口：无额外外部库。
+ */
+guint
+drd_config_get_routing_peek_timeout_ms(DrdConfig *self)
+{
+    g_return_val_if_fail(DRD_IS_CONFIG(self), DRD_ACCEPT_DEFAULT_PEEK_TIMEOUT_MS);
+    return self->routing_peek_timeout_ms;
+}
@@ -16,6 +16,15 @@ typedef enum
     DRD_RUNTIME_MODE_HANDOVER,
 } DrdRuntimeMode;
 
+/* [service] 接入流水线参数的默认值与上限 */
+#define DRD_ACCEPT_DEFAULT_WORKERS 4
+#define DRD_ACCEPT_MAX_WORKERS 64
+#define DRD_ACCEPT_DEFAULT_QUEUE_MAX 32
+#define DRD_ACCEPT_MAX_QUEUE_MAX 1024
+#define DRD_ACCEPT_DEFAULT_QUEUE_TIMEOUT_MS (10 * 1000)
+#define DRD_ACCEPT_DEFAULT_PEEK_TIMEOUT_MS (5 * 1000)
+#define DRD_ACCEPT_MAX_TIMEOUT_MS (10 * 60 * 1000)
+
 DrdConfig *drd_config_new(void);
 DrdConfig *drd_config_new_from_file(const gchar *path, GError **error);
 
@@ -50,6 +59,12 @@ guint drd_config_get_capture_width(DrdConfig *self);
 guint drd_config_get_capture_height(DrdConfig *self);
 guint drd_config_get_capture_target_fps(DrdConfig *self);
 guint drd_config_get_capture_stats_interval_sec(DrdConfig *self);
+gboolean drd_config_get_capture_adaptive_fps(DrdConfig *self);
+guint drd_config_get_capture_min_fps(DrdConfig *self);
 const DrdEncodingOptions *drd_config_get_encoding_options(DrdConfig *self);
+guint drd_config_get_accept_workers(DrdConfig *self);
+guint drd_config_get_accept_queue_max(DrdConfig *self);
+guint drd_config_get_accept_queue_timeout_ms(DrdConfig *self);
+guint drd_config_get_routing_peek_timeout_ms(DrdConfig *self);
 
 G_END_DECLS
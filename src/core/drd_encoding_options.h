@@ -21,6 +21,24 @@ typedef enum
 #define DRD_GFX_DEFAULT_LARGE_CHANGE_THRESHOLD 0.05
 #define DRD_GFX_DEFAULT_PROGRESSIVE_REFRESH_INTERVAL 6
 #define DRD_GFX_DEFAULT_PROGRESSIVE_REFRESH_TIMEOUT_MS 100
+#define DRD_GFX_DEFAULT_STALE_FRAME_MS 100
+#define DRD_GFX_DEFAULT_TILE_SIZE 64
+#define DRD_GFX_DEFAULT_SUPER_TILE_FACTOR 4
+#define DRD_GFX_MIN_TILE_SIZE 16
+#define DRD_GFX_MAX_TILE_SIZE 256
+#define DRD_GFX_MAX_SUPER_TILE_FACTOR 16
+#define DRD_GFX_DEFAULT_MAX_VIEWERS 1
+#define DRD_GFX_MAX_VIEWERS 4
+#define DRD_ENCODE_DEFAULT_CORE_BUDGET 0
+#define DRD_ENCODE_MAX_CORE_BUDGET 256
+
+#define DRD_ABR_DEFAULT_ENABLE TRUE
+#define DRD_ABR_DEFAULT_MIN_BITRATE 500000
+#define DRD_ABR_DEFAULT_MAX_BITRATE 10000000
+#define DRD_ABR_DEFAULT_MIN_QP 10
+#define DRD_ABR_DEFAULT_MAX_QP 40
+#define DRD_ABR_DEFAULT_INTERVAL_MS 300
+#define DRD_ABR_DEFAULT_TARGET_LATENCY_MS 120
 
 static inline const gchar *
 drd_encoding_mode_to_string(DrdEncodingMode mode)
@@ -54,6 +72,18 @@ typedef struct
     gdouble gfx_large_change_threshold;
     guint gfx_progressive_refresh_interval;
     guint gfx_progressive_refresh_timeout_ms;
+    guint gfx_stale_frame_ms; /* 捕获后超过该时长未编码的帧让位于更新的捕获，0 表示不限 */
+    guint gfx_tile_size;          /* 差分细粒度 tile 边长（像素，2 的幂） */
+    guint gfx_super_tile_factor;  /* 粗粒度 super tile 边长 = tile 边长 × 该系数，1 表示不分层 */
+    guint gfx_max_viewers;        /* 同时观看同一桌面的会话上限，共享一次捕获与编码 */
+    guint encode_core_budget;     /* 全部编码组在分析、编码阶段各自同时执行任务的上限，0 表示两阶段平分 CPU 数的一半 */
+    gboolean abr_enable;
+    guint abr_min_bitrate;
+    guint abr_max_bitrate;
+    guint abr_min_qp;
+    guint abr_max_qp;
+    guint abr_interval_ms;
+    guint abr_target_latency_ms;
 } DrdEncodingOptions;
 
 G_END_DECLS
@@ -3,6 +3,10 @@
 #include <freerdp/settings.h>
 #include <gio/gio.h>
 
+#include "security/drd_auth_pool.h"
+#include "session/drd_encode_scheduler.h"
+#include "session/drd_gfx_broadcast.h"
+#include "session/drd_session_reactor.h"
 #include "utils/drd_log.h"
 
 struct _DrdServerRuntime
@@ -13,6 +17,13 @@ struct _DrdServerRuntime
     DrdEncodingManager *encoder;
     DrdInputDispatcher *input;
     DrdTlsCredentials *tls;
+    DrdGfxBroadcast *gfx_broadcast; /* Rdpgfx 会话共享的捕获→编码流水线与分发 */
+    DrdSessionReactor *session_reactor; /* 全部会话共用的 peer/VCM 事件反应器 */
+    DrdEncodeScheduler *encode_scheduler; /* 各编码组分析/编码任务共享的核心配额与公平调度 */
+    DrdAuthPool *auth_pool; /* TLS-only 登录的 PAM 认证线程池 */
+    GMutex capture_fps_lock;
+    GHashTable *capture_fps_votes; /* 会话 → 其帧率调节器建议的采集帧率（0 表示不限速） */
+    guint capture_fps_applied;     /* 最近一次写入捕获管理器的采集帧率 */
     DrdEncodingOptions encoding_options;
     gboolean has_encoding_options;
     gboolean stream_running;
@@ -23,7 +34,8 @@ G_DEFINE_TYPE(DrdServerRuntime, drd_server_runtime, G_TYPE_OBJECT)
 
 /*
  * 功能：释放运行时持有的模块资源。
- * 逻辑：调用 stop 停止流后，依次释放 capture/encoder/input/TLS 对象，再交给父类 dispose。
+ * 逻辑：调用 stop 停止流后，先释放 Rdpgfx 广播（编码组随之注销调度客户端）、会话事件反应器、编码调度器与认证线程池
+ *       （等待执行中的 PAM 调用返回），再依次释放 capture/encoder/input/TLS 对象，最后交给父类 dispose。
  * 参数：object 基类指针，期望为 DrdServerRuntime。
  * 外部接口：drd_server_runtime_stop 关闭模块；GLib g_clear_object；GObjectClass::dispose。
  */
@@ -32,6 +44,10 @@ drd_server_runtime_dispose(GObject *object)
 {
     DrdServerRuntime *self = DRD_SERVER_RUNTIME(object);
     drd_server_runtime_stop(self);
+    g_clear_pointer(&self->gfx_broadcast, drd_gfx_broadcast_free);
+    g_clear_pointer(&self->session_reactor, drd_session_reactor_free);
+    g_clear_pointer(&self->encode_scheduler, drd_encode_scheduler_free);
+    g_clear_pointer(&self->auth_pool, drd_auth_pool_free);
     g_clear_object(&self->capture);
     g_clear_object(&self->encoder);
     g_clear_object(&self->input);
@@ -40,9 +56,25 @@ drd_server_runtime_dispose(GObject *object)
     G_OBJECT_CLASS(drd_server_runtime_parent_class)->dispose(object);
 }
 
+/*
+ * 功能：释放运行时的采集帧率投票表。
+ * 逻辑：销毁投票表与互斥锁后交给父类 finalize。
+ * 参数：object 基类指针，期望为 DrdServerRuntime。
+ * 外部接口：GLib g_hash_table_unref/g_mutex_clear；GObjectClass::finalize。
+ */
+static void
+drd_server_runtime_finalize(GObject *object)
+{
+    DrdServerRuntime *self = DRD_SERVER_RUNTIME(object);
+    g_clear_pointer(&self->capture_fps_votes, g_hash_table_unref);
+    g_mutex_clear(&self->capture_fps_lock);
+
+    G_OBJECT_CLASS(drd_server_runtime_parent_class)->finalize(object);
+}
+
 /*
  * 功能：绑定类级别的析构回调。
- * 逻辑：将自定义 dispose 挂载到 GObjectClass。
+ * 逻辑：将自定义 dispose/finalize 挂载到 GObjectClass。
  * 参数：klass 类结构。
  * 外部接口：GLib 类型系统。
  */
@@ -51,13 +83,18 @@ drd_server_runtime_class_init(DrdServerRuntimeClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
     object_class->dispose = drd_server_runtime_dispose;
+    object_class->finalize = drd_server_runtime_finalize;
 }
 
 /*
  * 功能：初始化运行时对象的成员。
- * 逻辑：创建捕获/编码/输入子模块，初始化标志位与默认传输模式。
+ * 逻辑：创建捕获/编码/输入子模块、Rdpgfx 广播、会话事件反应器（线程在首个会话登记时才启动）、编码调度器
+ *       （核心配额先按 CPU 数推导，写入编码配置时更新）与 PAM 认证线程池（线程按需创建），初始化采集帧率投票表、
+ *       标志位与默认传输模式。
  * 参数：self 运行时实例。
- * 外部接口：drd_capture_manager_new、drd_encoding_manager_new、drd_input_dispatcher_new 创建子组件；GLib g_atomic_int_set 设置原子值。
+ * 外部接口：drd_capture_manager_new、drd_encoding_manager_new、drd_input_dispatcher_new、drd_gfx_broadcast_new、
+ *           drd_session_reactor_new、drd_encode_scheduler_new、drd_auth_pool_new 创建子组件；
+ *           GLib g_atomic_int_set 设置原子值。
  */
 static void
 drd_server_runtime_init(DrdServerRuntime *self)
@@ -65,6 +102,15 @@ drd_server_runtime_init(DrdServerRuntime *self)
     self->capture = drd_capture_manager_new();
     self->encoder = drd_encoding_manager_new();
     self->input = drd_input_dispatcher_new();
+    self->gfx_broadcast = drd_gfx_broadcast_new(self);
+    self->session_reactor = drd_session_reactor_new(0);
+    self->encode_scheduler = drd_encode_scheduler_new(DRD_ENCODE_DEFAULT_CORE_BUDGET);
+    self->auth_pool = drd_auth_pool_new(DRD_AUTH_POOL_DEFAULT_WORKERS,
+                                        DRD_AUTH_POOL_DEFAULT_MAX_QUEUED,
+                                        DRD_AUTH_POOL_DEFAULT_TIMEOUT_MS);
+    g_mutex_init(&self->capture_fps_lock);
+    self->capture_fps_votes = g_hash_table_new(g_direct_hash, g_direct_equal);
+    self->capture_fps_applied = 0;
     self->tls = NULL;
     self->has_encoding_options = FALSE;
     self->stream_running = FALSE;
@@ -122,6 +168,58 @@ drd_server_runtime_get_input(DrdServerRuntime *self)
     return self->input;
 }
 
+/*
+ * 功能：获取 Rdpgfx 多观看者广播。
+ * 逻辑：类型检查后返回广播指针，各会话经它共享同一路捕获与编码。
+ * 参数：self 运行时实例。
+ * 外部接口：无额外外部库。
+ */
+DrdGfxBroadcast *
+drd_server_runtime_get_gfx_broadcast(DrdServerRuntime *self)
+{
+    g_return_val_if_fail(DRD_IS_SERVER_RUNTIME(self), NULL);
+    return self->gfx_broadcast;
+}
+
+/*
+ * 功能：获取会话事件反应器。
+ * 逻辑：类型检查后返回反应器指针，各会话把 peer/VCM 事件句柄登记到其中，不再各占一条 VCM 线程。
+ * 参数：self 运行时实例。
+ * 外部接口：无额外外部库。
+ */
+DrdSessionReactor *
+drd_server_runtime_get_session_reactor(DrdServerRuntime *self)
+{
+    g_return_val_if_fail(DRD_IS_SERVER_RUNTIME(self), NULL);
+    return self->session_reactor;
+}
+
+/*
+ * 功能：获取编码 CPU 调度器。
+ * 逻辑：类型检查后返回调度器指针，各编码组登记为其客户端，分析/编码任务按加权公平份额共享核心配额。
+ * 参数：self 运行时实例。
+ * 外部接口：无额外外部库。
+ */
+DrdEncodeScheduler *
+drd_server_runtime_get_encode_scheduler(DrdServerRuntime *self)
+{
+    g_return_val_if_fail(DRD_IS_SERVER_RUNTIME(self), NULL);
+    return self->encode_scheduler;
+}
+
+/*
+ * 功能：获取 PAM 认证线程池。
+ * 逻辑：类型检查后返回线程池指针，TLS-only 登录的 PAM 会话经其在认证线程上执行。
+ * 参数：self 运行时实例。
+ * 外部接口：无额外外部库。
+ */
+DrdAuthPool *
+drd_server_runtime_get_auth_pool(DrdServerRuntime *self)
+{
+    g_return_val_if_fail(DRD_IS_SERVER_RUNTIME(self), NULL);
+    return self->auth_pool;
+}
+
 /*
  * 功能：准备捕获/编码/输入流水线并启动捕获线程。
  * 逻辑：若已运行则直接返回；缓存编码配置并设置默认传输模式；依次准备编码器、输入分发器与捕获管理器，任一失败则回滚已启动的模块；成功后标记 stream_running。
@@ -200,87 +298,6 @@ drd_server_runtime_stop(DrdServerRuntime *self)
     DRD_LOG_MESSAGE("Server runtime stopped and released capture/encoding resources");
 }
 
-gboolean drd_server_runtime_pull_encoded_frame_surface_gfx(DrdServerRuntime *self,
-                                                           rdpSettings *settings,
-                                                           RdpgfxServerContext *context,
-                                                           guint16 surface_id,
-                                                           gint64 timeout_us,
-                                                           guint32 frame_id,
-                                                           gboolean *h264,
-                                                           GError **error)
-{
-    g_return_val_if_fail(DRD_IS_SERVER_RUNTIME(self), FALSE);
-    g_return_val_if_fail(self->capture != NULL, FALSE);
-    g_return_val_if_fail(settings != NULL, FALSE);
-
-    const gboolean auto_switch = self->has_encoding_options &&
-                                 self->encoding_options.mode == DRD_ENCODING_MODE_AUTO;
-
-    g_autoptr(DrdFrame) frame = NULL;
-    g_autoptr(GError) capture_error = NULL;
-    if (!drd_capture_manager_wait_frame(self->capture, timeout_us, &frame, &capture_error))
-    {
-        const gboolean refresh_due = drd_encoding_manager_refresh_interval_reached(self->encoder);
-
-        if (capture_error != NULL && capture_error->domain == G_IO_ERROR &&
-            capture_error->code == G_IO_ERROR_TIMED_OUT && refresh_due)
-        {
-            g_clear_error(&capture_error);
-            return drd_encoding_manager_encode_cached_frame_gfx(self->encoder,
-                                                                settings,
-                                                                context,
-                                                                surface_id,
-                                                                frame_id,
-                                                                h264,
-                                                                auto_switch,
-                                                                error);
-        }
-
-        if (error != NULL)
-        {
-            *error = capture_error;
-            capture_error = NULL;
-        }
-        return FALSE;
-    }
-
-    return drd_encoding_manager_encode_surface_gfx(self->encoder,
-                                                   settings,
-                                                   context,
-                                                   surface_id,
-                                                   frame,
-                                                   frame_id,
-                                                   h264,
-                                                   auto_switch,
-                                                   error);
-}
-
-gboolean drd_server_runtime_send_cached_frame_surface_gfx(DrdServerRuntime *self,
-                                                          rdpSettings *settings,
-                                                          RdpgfxServerContext *context,
-                                                          guint16 surface_id,
-                                                          guint32 frame_id,
-                                                          gboolean *h264,
-                                                          GError **error)
-{
-    g_return_val_if_fail(DRD_IS_SERVER_RUNTIME(self), FALSE);
-    g_return_val_if_fail(self->encoder != NULL, FALSE);
-    g_return_val_if_fail(settings != NULL, FALSE);
-    g_return_val_if_fail(context != NULL, FALSE);
-
-    const gboolean auto_switch = self->has_encoding_options &&
-                                 self->encoding_options.mode == DRD_ENCODING_MODE_AUTO;
-
-    return drd_encoding_manager_encode_cached_frame_gfx(self->encoder,
-                                                        settings,
-                                                        context,
-                                                        surface_id,
-                                                        frame_id,
-                                                        h264,
-                                                        auto_switch,
-                                                        error);
-}
-
 gboolean drd_server_runtime_pull_encoded_frame_surface_bit(DrdServerRuntime *self,
                                                            rdpContext *context,
                                                            guint32 frame_id,
@@ -374,9 +391,9 @@ drd_server_runtime_get_encoding_options(DrdServerRuntime *self,
 
 /*
  * 功能：写入编码参数并检测几何变化。
- * 逻辑：缓存新配置并标记已设置；若几何或模式变化且流已运行则提示需要重启。
+ * 逻辑：缓存新配置并标记已设置；编码核心配额立即生效；若几何或模式变化且流已运行则提示需要重启。
  * 参数：self 运行时实例；encoding_options 新编码配置。
- * 外部接口：日志 DRD_LOG_WARNING。
+ * 外部接口：drd_encode_scheduler_set_core_budget；日志 DRD_LOG_WARNING。
  */
 void
 drd_server_runtime_set_encoding_options(DrdServerRuntime *self,
@@ -401,10 +418,24 @@ drd_server_runtime_set_encoding_options(DrdServerRuntime *self,
                                       self->encoding_options.gfx_progressive_refresh_interval !=
                                               encoding_options->gfx_progressive_refresh_interval ||
                                       self->encoding_options.gfx_progressive_refresh_timeout_ms !=
-                                              encoding_options->gfx_progressive_refresh_timeout_ms);
+                                              encoding_options->gfx_progressive_refresh_timeout_ms ||
+                                      self->encoding_options.gfx_stale_frame_ms != encoding_options->gfx_stale_frame_ms ||
+                                      self->encoding_options.gfx_tile_size != encoding_options->gfx_tile_size ||
+                                      self->encoding_options.gfx_super_tile_factor !=
+                                              encoding_options->gfx_super_tile_factor ||
+                                      self->encoding_options.gfx_max_viewers != encoding_options->gfx_max_viewers ||
+                                      self->encoding_options.abr_enable != encoding_options->abr_enable ||
+                                      self->encoding_options.abr_min_bitrate != encoding_options->abr_min_bitrate ||
+                                      self->encoding_options.abr_max_bitrate != encoding_options->abr_max_bitrate ||
+                                      self->encoding_options.abr_min_qp != encoding_options->abr_min_qp ||
+                                      self->encoding_options.abr_max_qp != encoding_options->abr_max_qp ||
+                                      self->encoding_options.abr_interval_ms != encoding_options->abr_interval_ms ||
+                                      self->encoding_options.abr_target_latency_ms !=
+                                              encoding_options->abr_target_latency_ms);
 
     self->encoding_options = *encoding_options;
     self->has_encoding_options = TRUE;
+    drd_encode_scheduler_set_core_budget(self->encode_scheduler, encoding_options->encode_core_budget);
 
     if (options_changed && self->stream_running)
     {
@@ -468,6 +499,81 @@ drd_server_runtime_request_keyframe(DrdServerRuntime *self)
     g_return_if_fail(DRD_IS_SERVER_RUNTIME(self));
     drd_encoding_manager_force_keyframe(self->encoder);
 }
+
+/*
+ * 功能：按投票表重新计算共享采集帧率并在变化时下发。
+ * 逻辑：任一会话投 0（不限速）则取 0，否则取各会话建议值的最大值，保证最快的会话不被其他会话的降速拖慢；
+ *       投票表为空时恢复为 0；结果与上次下发值相同则不重复调用捕获管理器。调用方需持有 capture_fps_lock。
+ * 参数：self 运行时实例。
+ * 外部接口：drd_capture_manager_set_target_fps。
+ */
+static void
+drd_server_runtime_apply_capture_fps_locked(DrdServerRuntime *self)
+{
+    guint fps = 0;
+    GHashTableIter iter;
+    gpointer value = NULL;
+
+    g_hash_table_iter_init(&iter, self->capture_fps_votes);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+    {
+        const guint vote = GPOINTER_TO_UINT(value) - 1;
+        if (vote == 0)
+        {
+            fps = 0;
+            break;
+        }
+        fps = MAX(fps, vote);
+    }
+
+    if (fps == self->capture_fps_applied)
+    {
+        return;
+    }
+    self->capture_fps_applied = fps;
+    DRD_LOG_MESSAGE("Shared capture fps set to %u across %u session(s)", fps,
+                    g_hash_table_size(self->capture_fps_votes));
+    drd_capture_manager_set_target_fps(self->capture, fps);
+}
+
+/*
+ * 功能：登记或更新某会话对共享采集帧率的建议值。
+ * 逻辑：各会话（不论 Rdpgfx 还是 SurfaceBits）以自身指针为键写入帧率调节器的输出，随后按全部在线会话的最大值
+ *       重新计算采集帧率；0 表示该会话需要满帧率。
+ * 参数：self 运行时实例；voter 会话标识；fps 建议帧率，0 表示不限速。
+ * 外部接口：GLib g_hash_table_replace；drd_capture_manager_set_target_fps。
+ */
+void
+drd_server_runtime_vote_capture_fps(DrdServerRuntime *self, gconstpointer voter, guint fps)
+{
+    g_return_if_fail(DRD_IS_SERVER_RUNTIME(self));
+    g_return_if_fail(voter != NULL);
+
+    g_mutex_lock(&self->capture_fps_lock);
+    /* 值存为 fps+1，避免 0 与“键不存在”混淆 */
+    g_hash_table_replace(self->capture_fps_votes, (gpointer) voter, GUINT_TO_POINTER(fps + 1));
+    drd_server_runtime_apply_capture_fps_locked(self);
+    g_mutex_unlock(&self->capture_fps_lock);
+}
+
+/*
+ * 功能：撤销某会话的采集帧率投票。
+ * 逻辑：从投票表删除该会话后重新计算；最后一个会话（任意传输方式）离开时投票表为空，采集帧率恢复为 0。
+ * 参数：self 运行时实例；voter 会话标识。
+ * 外部接口：GLib g_hash_table_remove；drd_capture_manager_set_target_fps。
+ */
+void
+drd_server_runtime_withdraw_capture_fps(DrdServerRuntime *self, gconstpointer voter)
+{
+    g_return_if_fail(DRD_IS_SERVER_RUNTIME(self));
+
+    g_mutex_lock(&self->capture_fps_lock);
+    if (g_hash_table_remove(self->capture_fps_votes, voter))
+    {
+        drd_server_runtime_apply_capture_fps_locked(self);
+    }
+    g_mutex_unlock(&self->capture_fps_lock);
+}
 gboolean drd_runtime_encoder_prepare(DrdServerRuntime *self, guint32 codecs, rdpSettings *settings)
 {
     return drd_encoder_prepare(self->encoder, codecs, settings);
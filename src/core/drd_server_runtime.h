@@ -13,6 +13,15 @@ G_BEGIN_DECLS
 #define DRD_TYPE_SERVER_RUNTIME (drd_server_runtime_get_type())
 G_DECLARE_FINAL_TYPE(DrdServerRuntime, drd_server_runtime, DRD, SERVER_RUNTIME, GObject)
 
+/* Rdpgfx 多观看者广播，定义见 session/drd_gfx_broadcast.h */
+typedef struct _DrdGfxBroadcast DrdGfxBroadcast;
+/* 会话事件反应器，定义见 session/drd_session_reactor.h */
+typedef struct _DrdSessionReactor DrdSessionReactor;
+/* 编码 CPU 调度器，定义见 session/drd_encode_scheduler.h */
+typedef struct _DrdEncodeScheduler DrdEncodeScheduler;
+/* PAM 认证线程池，定义见 security/drd_auth_pool.h */
+typedef struct _DrdAuthPool DrdAuthPool;
+
 typedef enum
 {
     DRD_FRAME_TRANSPORT_SURFACE_BITS = 0,
@@ -24,26 +33,15 @@ DrdServerRuntime *drd_server_runtime_new(void);
 DrdCaptureManager *drd_server_runtime_get_capture(DrdServerRuntime *self);
 DrdEncodingManager *drd_server_runtime_get_encoder(DrdServerRuntime *self);
 DrdInputDispatcher *drd_server_runtime_get_input(DrdServerRuntime *self);
+DrdGfxBroadcast *drd_server_runtime_get_gfx_broadcast(DrdServerRuntime *self);
+DrdSessionReactor *drd_server_runtime_get_session_reactor(DrdServerRuntime *self);
+DrdEncodeScheduler *drd_server_runtime_get_encode_scheduler(DrdServerRuntime *self);
+DrdAuthPool *drd_server_runtime_get_auth_pool(DrdServerRuntime *self);
 
 gboolean drd_server_runtime_prepare_stream(DrdServerRuntime *self, const DrdEncodingOptions *encoding_options,
                                            GError **error);
 void drd_server_runtime_stop(DrdServerRuntime *self);
 
-gboolean drd_server_runtime_pull_encoded_frame_surface_gfx(DrdServerRuntime *self,
-                                                           rdpSettings *settings,
-                                                           RdpgfxServerContext *context,
-                                                           guint16 surface_id,
-                                                           gint64 timeout_us,
-                                                           guint32 frame_id,
-                                                           gboolean *h264,
-                                                           GError **error);
-gboolean drd_server_runtime_send_cached_frame_surface_gfx(DrdServerRuntime *self,
-                                                          rdpSettings *settings,
-                                                          RdpgfxServerContext *context,
-                                                          guint16 surface_id,
-                                                          guint32 frame_id,
-                                                          gboolean *h264,
-                                                          GError **error);
 gboolean drd_server_runtime_pull_encoded_frame_surface_bit(DrdServerRuntime *self,
                                                            rdpContext *context,
                                                            guint32 frame_id,
@@ -59,6 +57,8 @@ gboolean drd_server_runtime_is_stream_running(DrdServerRuntime *self);
 void drd_server_runtime_set_tls_credentials(DrdServerRuntime *self, DrdTlsCredentials *credentials);
 DrdTlsCredentials *drd_server_runtime_get_tls_credentials(DrdServerRuntime *self);
 void drd_server_runtime_request_keyframe(DrdServerRuntime *self);
+void drd_server_runtime_vote_capture_fps(DrdServerRuntime *self, gconstpointer voter, guint fps);
+void drd_server_runtime_withdraw_capture_fps(DrdServerRuntime *self, gconstpointer voter);
 
 gboolean drd_runtime_encoder_prepare(DrdServerRuntime *self, guint32 codecs, rdpSettings *settings);
 
@@ -16,18 +16,82 @@
 #include <freerdp/codec/rfx.h>
 #include <winpr/stream.h>
 
+#include "encoding/drd_rate_controller.h"
 #include "utils/drd_log.h"
+#include "utils/drd_recycle_pool.h"
+#include "utils/drd_timestamp.h"
 
 /* SurfaceBits 未实现标志，拒绝切换 */
 #define SURFACE_BITS_NOT_IMPLEMENTED
 
+/* 网络探测带宽低于该值时 RemoteFX/Progressive 难以维持帧率，自动模式更早切到 AVC */
+#define DRD_ENCODING_LOW_BANDWIDTH_BPS (20 * 1000 * 1000)
+#define DRD_ENCODING_VERY_LOW_BANDWIDTH_BPS (5 * 1000 * 1000)
+/* 客户端解码 p95 超过该值（约 40fps 的帧预算）时视为解码吃力；低于一半时恢复 */
+#define DRD_ENCODING_SLOW_DECODE_US (25 * G_TIME_SPAN_MILLISECOND)
+/* 分析结果/编码帧回收池容量：生产中、交接槽内、下游持有各一份，再留一份余量 */
+#define DRD_GFX_SCRATCH_POOL_SIZE 4
+/* 多观看者共享编码帧时，每多一名观看者最多多出邮箱内与发送中各一帧；关键帧缓存另占一帧 */
+#define DRD_GFX_ENCODED_POOL_SIZE (DRD_GFX_SCRATCH_POOL_SIZE + 2 * (DRD_GFX_MAX_VIEWERS - 1) + 1)
+/* 几何或编码器切换后经过这么多帧视为进入稳态，此后的暂存区分配计入稳态分配 */
+#define DRD_GFX_SCRATCH_WARMUP_FRAMES 120
+#define DRD_GFX_SCRATCH_MIN_CAPACITY (64 * 1024)
+
+/* 由编码管理器控制增长的码流暂存区，复用时只重置 len */
+typedef struct
+{
+    guint8 *data;
+    gsize len;
+    gsize capacity;
+} DrdGfxScratchBuffer;
+
+/*
+ * 功能：编码阶段产物，自包含一帧 Surface 命令所需的全部码流。
+ * 说明：FreeRDP 编码器输出指向其内部缓冲，下一次编码即被覆盖，因此这里持有码流副本与 H264 元数据，
+ *       发送阶段可在任意线程、任意时刻提交。编码完成后内容只读，可由多名观看者共享引用；
+ *       最后一个引用释放时连同暂存区一起归还编码管理器的回收池。
+ */
+struct _DrdEncodedGfxFrame
+{
+    gint ref_count;
+    DrdRecyclePool *pool;            /* 池外流转期间持有的回收池引用 */
+    RDPGFX_SURFACE_COMMAND cmd;
+    DrdGfxScratchBuffer payload;     /* RFX/Progressive/AVC420 码流，或 AVC444 第一路 */
+    DrdGfxScratchBuffer payload_aux; /* AVC444 第二路（色度） */
+    RDPGFX_AVC420_BITMAP_STREAM avc420;
+    RDPGFX_AVC444_BITMAP_STREAM avc444;
+    RECTANGLE_16 meta_rect;                 /* VAAPI 全帧元数据的内联存储 */
+    RDPGFX_H264_QUANT_QUALITY meta_quality;
+    gboolean meta_inline;                   /* avc420.meta 指向内联存储，不交给 free_h264_metablock */
+    gboolean h264;
+    gboolean keyframe;      /* 不依赖此前任何帧即可解码，参考链断开的观看者可从此帧恢复 */
+    gsize encoded_bytes;
+    gint64 capture_time_us; /* 源帧捕获时刻（单调时钟），缓存帧刷新为 0 */
+    guint64 sequence;       /* 编码序号，单调递增；重复发送的缓存关键帧据此识别 */
+};
+
+/* 关键帧缓存按 Rdpgfx codecId 分槽 */
+typedef enum
+{
+    DRD_GFX_KEYFRAME_SLOT_AVC420 = 0,
+    DRD_GFX_KEYFRAME_SLOT_AVC444,
+    DRD_GFX_KEYFRAME_SLOT_AVC444V2,
+    DRD_GFX_KEYFRAME_SLOT_PROGRESSIVE,
+    DRD_GFX_KEYFRAME_SLOT_REMOTEFX,
+    DRD_GFX_KEYFRAME_SLOT_COUNT
+} DrdGfxKeyframeSlot;
+
 static void drd_vaapi_encoder_release(DrdEncodingManager *self);
 static gboolean drd_vaapi_encoder_prepare(DrdEncodingManager *self, GError **error);
-static gboolean drd_h264_build_fullframe_metablock(const RECTANGLE_16 *regionRect, RDPGFX_H264_METABLOCK *meta,
-                                                   GError **error);
+static void drd_h264_build_fullframe_metablock(const RECTANGLE_16 *regionRect, DrdEncodedGfxFrame *encoded);
 static gboolean drd_vaapi_encode_avc420(DrdEncodingManager *self, const guint8 *data, guint stride,
-                                        const RECTANGLE_16 *regionRect, RDPGFX_AVC420_BITMAP_STREAM *avc420,
-                                        GByteArray **bitstream_out, GError **error);
+                                        const RECTANGLE_16 *regionRect, gboolean force_idr,
+                                        DrdEncodedGfxFrame *encoded, GError **error);
+static void drd_encoding_manager_append_payload(DrdEncodingManager *self, DrdGfxScratchBuffer *buffer,
+                                                const BYTE *data, gsize length);
+static void drd_encoding_manager_note_scratch_alloc(DrdEncodingManager *self, const gchar *what, guint warm_frames);
+static void drd_gfx_analysis_destroy(gpointer data);
+static void drd_encoded_gfx_frame_destroy(gpointer data);
 
 struct _DrdEncodingManager
 {
@@ -46,19 +110,37 @@ struct _DrdEncodingManager
     AVBufferRef *vaapi_device;
     AVBufferRef *vaapi_frames;
     AVFrame *vaapi_sw_frame;
+    AVFrame *vaapi_hw_frame; /* 每帧从 frames 池取 surface，结构体本身复用 */
+    AVPacket *vaapi_packet;
     struct SwsContext *vaapi_sws;
     guint vaapi_width;
     guint vaapi_height;
+    guint vaapi_bitrate;
 
     guint32 codecs;
     H264_CONTEXT *h264;
     RFX_CONTEXT *rfx;
     PROGRESSIVE_CONTEXT *progressive;
     GByteArray *gfx_previous_frame;
-    GArray *gfx_tile_hashes;
+    GArray *gfx_super_tile_hashes; /* 每个 super tile 一个 hash，分析时即写入当前帧的值 */
     GArray *gfx_dirty_rects;
+    GArray *gfx_dirty_tile_rects; /* 脏块位图合并出的 tile 矩形，编码线程复用 */
+    wStream *gfx_rfx_stream; /* RemoteFX 输出流，逐帧复用 */
+    DrdRecyclePool *gfx_analysis_pool;
+    DrdRecyclePool *gfx_encoded_pool;
+    gint gfx_scratch_allocs;        /* 暂存区累计分配次数 */
+    gint gfx_steady_scratch_allocs; /* 进入稳态后的分配次数，正常画面下应保持为 0 */
+    guint gfx_warm_frames;          /* 编码线程独占：自上次几何/编码器切换以来成功编码的帧数 */
+    guint gfx_analysis_warm_frames; /* 分析线程独占：自上次几何切换以来分析的帧数 */
+    gsize gfx_payload_reserve;      /* 编码线程独占：当前几何下码流暂存区的预留上限（整帧像素字节数加余量） */
+    guint16 gfx_scratch_codec_id;
+    guint gfx_tile_size;
+    guint gfx_super_tile_factor;
     guint gfx_tiles_x;
     guint gfx_tiles_y;
+    guint gfx_supers_x;
+    guint gfx_supers_y;
+    guint gfx_diff_tile_size; /* 差分状态建立时的 tile 边长，配置变化时据此重建 */
     guint gfx_diff_width;
     guint gfx_diff_height;
     guint gfx_diff_stride;
@@ -70,6 +152,17 @@ struct _DrdEncodingManager
     DrdEncodingCodecClass gfx_last_codec;
     gboolean gfx_avc_to_non_avc_transition;
     gint64 gfx_non_avc_switch_timestamp_us;
+
+    DrdRateController *rate_controller;
+    guint gfx_quality_level;
+    gint gfx_change_ratio_ppm; /* 脏 tile 占比（百万分之一定点），分析线程写、渲染线程读 */
+    gsize gfx_last_encoded_bytes;
+    gint gfx_link_quality_bias; /* 网络探测给出的画质档位偏置，VCM 线程写、编码线程读 */
+    gint gfx_client_decode_slow; /* 客户端解码 p95 超出预算，避免使用 AVC444 */
+
+    GMutex gfx_keyframe_lock; /* 保护关键帧缓存：编码线程写，会话/分发线程读 */
+    DrdEncodedGfxFrame *gfx_keyframe_cache[DRD_GFX_KEYFRAME_SLOT_COUNT]; /* 各编码最近一帧仍有效的全帧关键帧 */
+    guint64 gfx_encode_sequence; /* 仅编码线程递增 */
 };
 
 G_DEFINE_TYPE(DrdEncodingManager, drd_encoding_manager, G_TYPE_OBJECT)
@@ -85,18 +178,41 @@ static void drd_encoding_manager_dispose(GObject *object)
 {
     DrdEncodingManager *self = DRD_ENCODING_MANAGER(object);
     drd_encoding_manager_reset(self);
+    drd_encoding_manager_drop_cached_keyframes(self);
     g_clear_pointer(&self->h264, h264_context_free);
     g_clear_pointer(&self->rfx, rfx_context_free);
     g_clear_pointer(&self->progressive, progressive_context_free);
     g_clear_pointer(&self->gfx_previous_frame, g_byte_array_unref);
-    g_clear_pointer(&self->gfx_tile_hashes, g_array_unref);
+    g_clear_pointer(&self->gfx_super_tile_hashes, g_array_unref);
     g_clear_pointer(&self->gfx_dirty_rects, g_array_unref);
+    g_clear_pointer(&self->gfx_dirty_tile_rects, g_array_unref);
+    if (self->gfx_rfx_stream != NULL)
+    {
+        Stream_Free(self->gfx_rfx_stream, TRUE);
+        self->gfx_rfx_stream = NULL;
+    }
+    g_clear_pointer(&self->gfx_analysis_pool, drd_recycle_pool_unref);
+    g_clear_pointer(&self->gfx_encoded_pool, drd_recycle_pool_unref);
+    g_clear_pointer(&self->rate_controller, drd_rate_controller_free);
     G_OBJECT_CLASS(drd_encoding_manager_parent_class)->dispose(object);
 }
 
+/*
+ * 功能：终结编码管理器。
+ * 逻辑：dispose 已释放缓存的关键帧，这里只清理关键帧缓存锁。
+ * 参数：object GObject 指针。
+ * 外部接口：GLib g_mutex_clear，随后调用父类 finalize。
+ */
+static void drd_encoding_manager_finalize(GObject *object)
+{
+    DrdEncodingManager *self = DRD_ENCODING_MANAGER(object);
+    g_mutex_clear(&self->gfx_keyframe_lock);
+    G_OBJECT_CLASS(drd_encoding_manager_parent_class)->finalize(object);
+}
+
 /*
  * 功能：初始化编码管理器的类回调。
- * 逻辑：注册自定义 dispose 以释放内部 encoder；其他生命周期保持默认。
+ * 逻辑：注册自定义 dispose 以释放内部 encoder，finalize 清理关键帧缓存锁。
  * 参数：klass 类结构指针。
  * 外部接口：使用 GLib 类型系统，将 dispose 挂载到 GObjectClass。
  */
@@ -104,11 +220,12 @@ static void drd_encoding_manager_class_init(DrdEncodingManagerClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
     object_class->dispose = drd_encoding_manager_dispose;
+    object_class->finalize = drd_encoding_manager_finalize;
 }
 
 /*
  * 功能：初始化编码管理器的实例字段。
- * 逻辑：设置默认分辨率/编码模式/差分开关，创建暂存帧与编码上下文缓冲。
+ * 逻辑：设置默认分辨率/编码模式/差分开关，创建差分缓冲、RemoteFX 输出流与分析结果/编码帧回收池。
  * 参数：self 编码管理器实例。
  * 外部接口：调用 drd_encoded_frame_new 生成暂存帧。
  */
@@ -126,6 +243,8 @@ static void drd_encoding_manager_init(DrdEncodingManager *self)
     self->vaapi_device = NULL;
     self->vaapi_frames = NULL;
     self->vaapi_sw_frame = NULL;
+    self->vaapi_hw_frame = NULL;
+    self->vaapi_packet = NULL;
     self->vaapi_sws = NULL;
     self->vaapi_width = 0;
     self->vaapi_height = 0;
@@ -133,10 +252,25 @@ static void drd_encoding_manager_init(DrdEncodingManager *self)
     self->rfx = NULL;
     self->progressive = NULL;
     self->gfx_previous_frame = g_byte_array_new();
-    self->gfx_tile_hashes = g_array_new(FALSE, TRUE, sizeof(guint64));
+    self->gfx_super_tile_hashes = g_array_new(FALSE, TRUE, sizeof(guint64));
     self->gfx_dirty_rects = g_array_new(FALSE, FALSE, sizeof(RFX_RECT));
+    self->gfx_dirty_tile_rects = g_array_new(FALSE, FALSE, sizeof(DrdDirtyRect));
+    self->gfx_rfx_stream = Stream_New(NULL, DRD_GFX_SCRATCH_MIN_CAPACITY);
+    self->gfx_analysis_pool = drd_recycle_pool_new(DRD_GFX_SCRATCH_POOL_SIZE, drd_gfx_analysis_destroy);
+    self->gfx_encoded_pool = drd_recycle_pool_new(DRD_GFX_ENCODED_POOL_SIZE, drd_encoded_gfx_frame_destroy);
+    self->gfx_scratch_allocs = 0;
+    self->gfx_steady_scratch_allocs = 0;
+    self->gfx_warm_frames = 0;
+    self->gfx_analysis_warm_frames = 0;
+    self->gfx_payload_reserve = 0;
+    self->gfx_scratch_codec_id = 0;
+    self->gfx_tile_size = DRD_GFX_DEFAULT_TILE_SIZE;
+    self->gfx_super_tile_factor = DRD_GFX_DEFAULT_SUPER_TILE_FACTOR;
     self->gfx_tiles_x = 0;
     self->gfx_tiles_y = 0;
+    self->gfx_supers_x = 0;
+    self->gfx_supers_y = 0;
+    self->gfx_diff_tile_size = 0;
     self->gfx_diff_width = 0;
     self->gfx_diff_height = 0;
     self->gfx_diff_stride = 0;
@@ -148,15 +282,20 @@ static void drd_encoding_manager_init(DrdEncodingManager *self)
     self->gfx_last_codec = DRD_ENCODING_CODEC_CLASS_UNKNOWN;
     self->gfx_avc_to_non_avc_transition = FALSE;
     self->gfx_non_avc_switch_timestamp_us = 0;
+    self->rate_controller = drd_rate_controller_new();
+    self->gfx_quality_level = 0;
+    self->gfx_change_ratio_ppm = 0;
+    g_mutex_init(&self->gfx_keyframe_lock);
+    self->gfx_encode_sequence = 0;
     drd_vaapi_encoder_release(self);
 }
 
 /*
  * 功能：释放 VAAPI 编码器相关资源，避免重建或重置时泄漏。
- * 逻辑：依次释放 sws 转换器、软帧、硬件帧池与编码器上下文，同时清零尺寸缓存。
+ * 逻辑：依次释放 sws 转换器、软帧、复用的硬件帧与 packet、硬件帧池与编码器上下文，同时清零尺寸缓存。
  * 参数：self 编码管理器实例。
  * 外部接口：libswscale 的 sws_freeContext，libavutil 的 av_buffer_unref/av_frame_free，
- *           libavcodec 的 avcodec_free_context。
+ *           libavcodec 的 av_packet_free/avcodec_free_context。
  */
 static void drd_vaapi_encoder_release(DrdEncodingManager *self)
 {
@@ -169,6 +308,14 @@ static void drd_vaapi_encoder_release(DrdEncodingManager *self)
     {
         av_frame_free(&self->vaapi_sw_frame);
     }
+    if (self->vaapi_hw_frame != NULL)
+    {
+        av_frame_free(&self->vaapi_hw_frame);
+    }
+    if (self->vaapi_packet != NULL)
+    {
+        av_packet_free(&self->vaapi_packet);
+    }
     if (self->vaapi_frames != NULL)
     {
         av_buffer_unref(&self->vaapi_frames);
@@ -183,12 +330,14 @@ static void drd_vaapi_encoder_release(DrdEncodingManager *self)
     }
     self->vaapi_width = 0;
     self->vaapi_height = 0;
+    self->vaapi_bitrate = 0;
 }
 
 /*
  * 功能：准备 VAAPI 编码器上下文与 BGRA→NV12 的 swscale 转换器。
  * 逻辑：按当前分辨率初始化 VAAPI 设备、frames 池、编码器上下文和 sws 颜色空间转换，
- *       已准备且尺寸一致时直接复用；失败时释放中间资源并返回错误。
+ *       已准备且尺寸一致、码率偏差小于 25% 时直接复用；码率控制参数随目标码率推导；逐帧复用的硬件帧与 packet 一并分配；
+ *       失败时释放中间资源并返回错误。
  * 参数：self 编码管理器实例；error GLib 错误返回。
  * 外部接口：libavcodec 的 avcodec_find_encoder_by_name/avcodec_alloc_context3/avcodec_open2，
  *           libavutil 的 av_hwdevice_ctx_create/av_hwframe_ctx_alloc/av_hwframe_ctx_init，
@@ -203,7 +352,14 @@ static gboolean drd_vaapi_encoder_prepare(DrdEncodingManager *self, GError **err
     if (self->vaapi_encoder != NULL && self->vaapi_width == self->frame_width &&
         self->vaapi_height == self->frame_height)
     {
-        return TRUE;
+        /* h264_vaapi 打开后无法修改码率，偏差较大时才重建，避免频繁产生 IDR */
+        const guint delta = self->vaapi_bitrate > self->h264_bitrate ? self->vaapi_bitrate - self->h264_bitrate
+                                                                     : self->h264_bitrate - self->vaapi_bitrate;
+        if ((guint64) delta * 4 < (guint64) self->vaapi_bitrate)
+        {
+            return TRUE;
+        }
+        DRD_LOG_MESSAGE("Rebuilding VAAPI encoder for bitrate %u -> %u", self->vaapi_bitrate, self->h264_bitrate);
     }
 
     drd_vaapi_encoder_release(self);
@@ -268,9 +424,9 @@ static gboolean drd_vaapi_encoder_prepare(DrdEncodingManager *self, GError **err
     self->vaapi_encoder->qmin = 1;
     self->vaapi_encoder->qmax = 60;
     self->vaapi_encoder->max_qdiff = 5;
-    self->vaapi_encoder->rc_max_rate = 5000000;
-    self->vaapi_encoder->rc_min_rate = 1000000;
-    self->vaapi_encoder->rc_buffer_size = 4000000;
+    self->vaapi_encoder->rc_max_rate = (int64_t) self->h264_bitrate;
+    self->vaapi_encoder->rc_min_rate = (int64_t) MIN(1000000u, self->h264_bitrate);
+    self->vaapi_encoder->rc_buffer_size = (int) ((guint64) self->h264_bitrate * 4 / 5);
     self->vaapi_encoder->me_cmp = FF_CMP_VSAD;
     self->vaapi_encoder->profile = FF_PROFILE_H264_CONSTRAINED_BASELINE;
     self->vaapi_encoder->level = 41;
@@ -320,56 +476,60 @@ static gboolean drd_vaapi_encoder_prepare(DrdEncodingManager *self, GError **err
         return FALSE;
     }
 
+    self->vaapi_hw_frame = av_frame_alloc();
+    self->vaapi_packet = av_packet_alloc();
+    if (self->vaapi_hw_frame == NULL || self->vaapi_packet == NULL)
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to allocate VAAPI frame/packet");
+        drd_vaapi_encoder_release(self);
+        return FALSE;
+    }
+
     self->vaapi_width = self->frame_width;
     self->vaapi_height = self->frame_height;
+    self->vaapi_bitrate = self->h264_bitrate;
     return TRUE;
 }
 
 /*
  * 功能：构造 AVC420 全帧元数据，供 Rdpgfx H264 元数据发送。
- * 逻辑：填充单区域矩形与量化/质量默认值；分配失败时释放并返回错误。
- * 参数：regionRect 全帧矩形；meta 输出元数据；error GLib 错误。
- * 外部接口：FreeRDP h264 的 free_h264_metablock。
+ * 逻辑：单区域矩形与默认量化/质量值存放在编码帧的内联存储中，避免逐帧分配；标记 meta_inline 防止被 free_h264_metablock 释放。
+ * 参数：regionRect 全帧矩形；encoded 输出编码帧。
+ * 外部接口：无。
  */
-static gboolean drd_h264_build_fullframe_metablock(const RECTANGLE_16 *regionRect, RDPGFX_H264_METABLOCK *meta, GError **error)
+static void drd_h264_build_fullframe_metablock(const RECTANGLE_16 *regionRect, DrdEncodedGfxFrame *encoded)
 {
     WINPR_ASSERT(regionRect != NULL);
-    WINPR_ASSERT(meta != NULL);
+    WINPR_ASSERT(encoded != NULL);
 
+    RDPGFX_H264_METABLOCK *meta = &encoded->avc420.meta;
     memset(meta, 0, sizeof(*meta));
+    encoded->meta_rect = *regionRect;
+    memset(&encoded->meta_quality, 0, sizeof(encoded->meta_quality));
     meta->numRegionRects = 1;
-    meta->regionRects = g_malloc0(sizeof(*meta->regionRects));
-    meta->quantQualityVals = g_malloc0(sizeof(*meta->quantQualityVals));
-    if (meta->regionRects == NULL || meta->quantQualityVals == NULL)
-    {
-        free_h264_metablock(meta);
-        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to allocate h264 metablock");
-        return FALSE;
-    }
-
-    meta->regionRects[0] = *regionRect;
-    memset(meta->quantQualityVals, 0, sizeof(*meta->quantQualityVals));
-    return TRUE;
+    meta->regionRects = &encoded->meta_rect;
+    meta->quantQualityVals = &encoded->meta_quality;
+    encoded->meta_inline = TRUE;
 }
 
 /*
  * 功能：使用 VAAPI 硬件加速编码 BGRA 帧为 AVC420，并填充 Rdpgfx 需要的元数据。
- * 逻辑：通过 swscale 将 BGRA 转 NV12，上传到 VAAPI 硬件帧后编码，收集 H264 packet，
- *       拼接输出到 avc420->data/length，并构造全帧元数据。
- * 参数：self 编码管理器；data 原始 BGRA 像素；stride 行跨度；regionRect 全帧矩形；
- *       avc420 输出结构；bitstream_out 返回缓存；error GLib 错误。
+ * 逻辑：通过 swscale 将 BGRA 转 NV12，上传到复用的 VAAPI 硬件帧后编码，把 H264 packet 依次追加到编码帧的码流暂存区，
+ *       并用内联存储构造全帧元数据；硬件帧与 packet 结构体逐帧复用，仅 unref 其引用的缓冲。
+ *       force_idr 时把输入标为 I 帧请求编码器输出 IDR，packet 带关键帧标记时编码帧记为关键帧。
+ * 参数：self 编码管理器；data 原始 BGRA 像素；stride 行跨度；regionRect 全帧矩形；force_idr 是否强制 IDR；
+ *       encoded 输出编码帧；error GLib 错误。
  * 外部接口：libswscale 的 sws_scale，libavcodec 的 avcodec_send_frame/avcodec_receive_packet，
- *           libavutil 的 av_hwframe_get_buffer/av_hwframe_transfer_data。
+ *           libavutil 的 av_hwframe_get_buffer/av_hwframe_transfer_data/av_frame_unref。
  */
 static gboolean drd_vaapi_encode_avc420(DrdEncodingManager *self, const guint8 *data, guint stride,
-                                        const RECTANGLE_16 *regionRect, RDPGFX_AVC420_BITMAP_STREAM *avc420,
-                                        GByteArray **bitstream_out, GError **error)
+                                        const RECTANGLE_16 *regionRect, gboolean force_idr,
+                                        DrdEncodedGfxFrame *encoded, GError **error)
 {
     const uint8_t *src_slices[4] = {data, NULL, NULL, NULL};
     int src_strides[4] = {(int) stride, 0, 0, 0};
-    GByteArray *bitstream = NULL;
-    AVPacket *packet = NULL;
     AVFrame *hw_frame = NULL;
+    AVPacket *packet = NULL;
     int ret = 0;
 
     if (!drd_vaapi_encoder_prepare(self, error))
@@ -392,13 +552,8 @@ static gboolean drd_vaapi_encode_avc420(DrdEncodingManager *self, const guint8 *
         return FALSE;
     }
 
-    hw_frame = av_frame_alloc();
-    if (hw_frame == NULL)
-    {
-        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to allocate VAAPI frame");
-        return FALSE;
-    }
-
+    hw_frame = self->vaapi_hw_frame;
+    av_frame_unref(hw_frame);
     hw_frame->format = AV_PIX_FMT_VAAPI;
     hw_frame->width = (int) self->frame_width;
     hw_frame->height = (int) self->frame_height;
@@ -407,66 +562,51 @@ static gboolean drd_vaapi_encode_avc420(DrdEncodingManager *self, const guint8 *
     if (ret < 0)
     {
         g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to get VAAPI frame buffer");
-        av_frame_free(&hw_frame);
         return FALSE;
     }
+    hw_frame->pict_type = force_idr ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
 
     ret = av_hwframe_transfer_data(hw_frame, self->vaapi_sw_frame, 0);
     if (ret < 0)
     {
         g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to upload data to VAAPI frame");
-        av_frame_free(&hw_frame);
+        av_frame_unref(hw_frame);
         return FALSE;
     }
 
     ret = avcodec_send_frame(self->vaapi_encoder, hw_frame);
-    av_frame_free(&hw_frame);
+    av_frame_unref(hw_frame);
     if (ret < 0)
     {
         g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to send VAAPI frame to encoder");
         return FALSE;
     }
 
-    bitstream = g_byte_array_new();
-    packet = av_packet_alloc();
-    if (packet == NULL)
-    {
-        g_byte_array_unref(bitstream);
-        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to allocate AVPacket");
-        return FALSE;
-    }
-
+    packet = self->vaapi_packet;
+    encoded->payload.len = 0;
+    encoded->keyframe = FALSE;
     while ((ret = avcodec_receive_packet(self->vaapi_encoder, packet)) == 0)
     {
-        g_byte_array_append(bitstream, packet->data, packet->size);
+        drd_encoding_manager_append_payload(self, &encoded->payload, packet->data, (gsize) packet->size);
+        encoded->keyframe = encoded->keyframe || (packet->flags & AV_PKT_FLAG_KEY) != 0;
         av_packet_unref(packet);
     }
 
-    av_packet_free(&packet);
-
     if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
     {
-        g_byte_array_unref(bitstream);
+        encoded->payload.len = 0;
         g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to receive VAAPI packet");
         return FALSE;
     }
 
-    if (bitstream->len == 0)
+    if (encoded->payload.len == 0)
     {
-        g_byte_array_unref(bitstream);
         g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PENDING, "no avc420 frame produced by VAAPI");
         return FALSE;
     }
 
-    if (!drd_h264_build_fullframe_metablock(regionRect, &avc420->meta, error))
-    {
-        g_byte_array_unref(bitstream);
-        return FALSE;
-    }
-
-    avc420->data = bitstream->data;
-    avc420->length = bitstream->len;
-    *bitstream_out = bitstream;
+    drd_h264_build_fullframe_metablock(regionRect, encoded);
+    encoded->avc420.length = (UINT32) encoded->payload.len;
     return TRUE;
 }
 
@@ -518,12 +658,25 @@ gboolean drd_encoding_manager_prepare(DrdEncodingManager *self, const DrdEncodin
     self->gfx_large_change_threshold = options->gfx_large_change_threshold;
     self->gfx_progressive_refresh_interval = options->gfx_progressive_refresh_interval;
     self->gfx_progressive_refresh_timeout_ms = options->gfx_progressive_refresh_timeout_ms;
+    /* tile 几何只由分析线程读取；边长变化时下一帧分析据 gfx_diff_tile_size 重建差分状态 */
+    self->gfx_tile_size = options->gfx_tile_size != 0 ? options->gfx_tile_size : DRD_GFX_DEFAULT_TILE_SIZE;
+    self->gfx_super_tile_factor = MAX(options->gfx_super_tile_factor, 1u);
     self->gfx_last_codec = DRD_ENCODING_CODEC_CLASS_UNKNOWN;
     self->gfx_avc_to_non_avc_transition = FALSE;
     self->frame_width = options->width;
     self->frame_height = options->height;
     self->ready = TRUE;
 
+    drd_rate_controller_configure(self->rate_controller, options);
+    if (drd_rate_controller_is_enabled(self->rate_controller))
+    {
+        DrdRateTarget target;
+        drd_rate_controller_get_target(self->rate_controller, &target);
+        self->h264_bitrate = target.bitrate;
+        self->h264_qp = target.qp;
+    }
+    self->gfx_quality_level = 0;
+
     DRD_LOG_MESSAGE("Encoding manager configured for %ux%u stream (mode=%s diff=%s)", options->width, options->height,
                     drd_encoding_mode_to_string(options->mode), options->enable_frame_diff ? "on" : "off");
     return TRUE;
@@ -557,20 +710,32 @@ void drd_encoding_manager_reset(DrdEncodingManager *self)
     {
         g_byte_array_set_size(self->gfx_previous_frame, 0);
     }
-    if (self->gfx_tile_hashes != NULL)
+    if (self->gfx_super_tile_hashes != NULL)
     {
-        g_array_set_size(self->gfx_tile_hashes, 0);
+        g_array_set_size(self->gfx_super_tile_hashes, 0);
     }
     if (self->gfx_dirty_rects != NULL)
     {
         g_array_set_size(self->gfx_dirty_rects, 0);
     }
+    if (self->gfx_dirty_tile_rects != NULL)
+    {
+        g_array_set_size(self->gfx_dirty_tile_rects, 0);
+    }
     self->gfx_tiles_x = 0;
     self->gfx_tiles_y = 0;
+    self->gfx_supers_x = 0;
+    self->gfx_supers_y = 0;
+    self->gfx_diff_tile_size = 0;
     self->gfx_diff_width = 0;
     self->gfx_diff_height = 0;
     self->gfx_diff_stride = 0;
     self->gfx_force_keyframe = TRUE;
+    self->gfx_scratch_codec_id = 0;
+    /* 只在分析/编码线程都已停止时调用，预热计数可直接清零 */
+    self->gfx_warm_frames = 0;
+    self->gfx_analysis_warm_frames = 0;
+    self->gfx_payload_reserve = 0;
     self->gfx_progressive_rfx_frames = 0;
     self->gfx_large_change_threshold = DRD_GFX_DEFAULT_LARGE_CHANGE_THRESHOLD;
     self->gfx_progressive_refresh_interval = DRD_GFX_DEFAULT_PROGRESSIVE_REFRESH_INTERVAL;
@@ -578,6 +743,14 @@ void drd_encoding_manager_reset(DrdEncodingManager *self)
     self->gfx_last_codec = DRD_ENCODING_CODEC_CLASS_UNKNOWN;
     self->gfx_avc_to_non_avc_transition = FALSE;
     self->gfx_non_avc_switch_timestamp_us = 0;
+    self->gfx_quality_level = 0;
+    g_atomic_int_set(&self->gfx_change_ratio_ppm, 0);
+    self->gfx_last_encoded_bytes = 0;
+    drd_encoding_manager_drop_cached_keyframes(self);
+    if (self->rate_controller != NULL)
+    {
+        drd_rate_controller_reset(self->rate_controller);
+    }
 }
 
 gboolean drd_encoding_manager_has_avc_to_non_avc_transition( DrdEncodingManager *self)
@@ -621,60 +794,156 @@ gboolean drd_encoding_manager_refresh_interval_reached( DrdEncodingManager *self
 }
 
 /*
- * 功能：在无新捕获帧时复用上一帧并强制输出 Surface GFX 关键帧。
- * 逻辑：校验缓存帧与差分状态可用，构造临时 DrdFrame 承载上一帧像素，置位关键帧标志后复用 Surface GFX
- *       编码路径发送全量帧。
- * 参数：self 管理器；settings 客户端编码设置；context Rdpgfx 上下文；surface_id 目标 surface；frame_id 帧序号；h264 输出是否
- *       使用 H264；auto_switch 自动切换编码策略；error 错误输出。
- * 外部接口：GLib g_get_monotonic_time/g_set_error；调用 drd_frame_new/drd_frame_configure/drd_frame_ensure_capacity 以及
- *           drd_encoding_manager_encode_surface_gfx 复用现有编码逻辑。
+ * 功能：把客户端 FrameAcknowledge 转交码率控制器。
+ * 逻辑：以当前单调时钟记录 ACK，用于计算提交→ACK 往返时延与 queueDepth 峰值；可在 VCM 线程调用。
+ * 参数：self 管理器；frame_id ACK 帧序号；queue_depth 客户端未解码帧数。
+ * 外部接口：GLib g_get_monotonic_time；drd_rate_controller_on_frame_ack。
  */
-gboolean
-drd_encoding_manager_encode_cached_frame_gfx(DrdEncodingManager *self,
-                                             rdpSettings *settings,
-                                             RdpgfxServerContext *context,
-                                             guint16 surface_id,
-                                             guint32 frame_id,
-                                             gboolean *h264,
-                                             gboolean auto_switch,
-                                             GError **error)
+void drd_encoding_manager_notify_frame_ack(DrdEncodingManager *self, guint32 frame_id, guint32 queue_depth)
 {
-    g_return_val_if_fail(DRD_IS_ENCODING_MANAGER(self), FALSE);
-    g_return_val_if_fail(settings != NULL, FALSE);
-    g_return_val_if_fail(context != NULL, FALSE);
+    g_return_if_fail(DRD_IS_ENCODING_MANAGER(self));
 
-    if (!self->ready)
+    if (self->rate_controller == NULL)
     {
-        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Encoding manager not prepared");
-        return FALSE;
+        return;
     }
+    drd_rate_controller_on_frame_ack(self->rate_controller, frame_id, queue_depth, g_get_monotonic_time());
+}
+
+/*
+ * 功能：发布网络自动探测得到的链路估计。
+ * 逻辑：把带宽与丢包率交给码率控制器作为拥塞时的码率上限；实测带宽低于 20Mbps/5Mbps 时画质档位偏置 1/2 级，
+ *       让自动模式在低带宽链路上更早选择 AVC；可在 VCM 线程调用。
+ * 参数：self 管理器；bandwidth_bps 平滑带宽（0 表示未知）；rtt_us 平滑往返时延；loss_ratio 探测丢包率。
+ * 外部接口：drd_rate_controller_set_link_estimate；GLib g_atomic_int_set。
+ */
+void drd_encoding_manager_update_network_estimate(DrdEncodingManager *self,
+                                                  guint64 bandwidth_bps,
+                                                  gint64 rtt_us,
+                                                  gdouble loss_ratio)
+{
+    g_return_if_fail(DRD_IS_ENCODING_MANAGER(self));
 
-    if (self->gfx_previous_frame->len == 0 || self->gfx_diff_width == 0 || self->gfx_diff_height == 0 ||
-        self->gfx_diff_stride == 0)
+    if (self->rate_controller != NULL)
     {
-        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "No cached frame available for refresh");
-        return FALSE;
+        drd_rate_controller_set_link_estimate(self->rate_controller, bandwidth_bps, loss_ratio);
     }
 
-    g_autoptr(DrdFrame) cached_frame = drd_frame_new();
-    drd_frame_configure(cached_frame,
-                        self->gfx_diff_width,
-                        self->gfx_diff_height,
-                        self->gfx_diff_stride,
-                        (guint64) g_get_monotonic_time());
+    gint bias = 0;
+    if (bandwidth_bps > 0 && bandwidth_bps < DRD_ENCODING_LOW_BANDWIDTH_BPS)
+    {
+        bias = bandwidth_bps < DRD_ENCODING_VERY_LOW_BANDWIDTH_BPS ? 2 : 1;
+    }
+    if (g_atomic_int_get(&self->gfx_link_quality_bias) != bias)
+    {
+        DRD_LOG_DEBUG("Network estimate bandwidth=%" G_GUINT64_FORMAT " rtt=%" G_GINT64_FORMAT
+                      "us loss=%.3f, codec quality bias %d",
+                      bandwidth_bps, rtt_us, loss_ratio, bias);
+        g_atomic_int_set(&self->gfx_link_quality_bias, bias);
+    }
+}
 
-    guint8 *buffer = drd_frame_ensure_capacity(cached_frame, self->gfx_previous_frame->len);
-    if (buffer == NULL)
+/*
+ * 功能：发布客户端解码耗时 p95。
+ * 逻辑：超过 25ms 时标记客户端解码吃力，编码时以 AVC420 代替需要双路解码的 AVC444；回落到 12.5ms 以下才解除，
+ *       避免在阈值附近来回切换；可在 VCM 线程调用。
+ * 参数：self 管理器；decode_p95_us QoE 统计的解码耗时 p95。
+ * 外部接口：GLib g_atomic_int_get/set；日志 DRD_LOG_MESSAGE。
+ */
+void drd_encoding_manager_set_client_decode_time(DrdEncodingManager *self, gint64 decode_p95_us)
+{
+    g_return_if_fail(DRD_IS_ENCODING_MANAGER(self));
+
+    const gboolean slow = g_atomic_int_get(&self->gfx_client_decode_slow) != 0;
+    if (!slow && decode_p95_us > DRD_ENCODING_SLOW_DECODE_US)
     {
-        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to allocate cached frame buffer");
-        return FALSE;
+        DRD_LOG_MESSAGE("Client decode p95 %" G_GINT64_FORMAT "us exceeds budget, avoiding AVC444", decode_p95_us);
+        g_atomic_int_set(&self->gfx_client_decode_slow, 1);
+    }
+    else if (slow && decode_p95_us < DRD_ENCODING_SLOW_DECODE_US / 2)
+    {
+        DRD_LOG_MESSAGE("Client decode p95 %" G_GINT64_FORMAT "us recovered, AVC444 allowed", decode_p95_us);
+        g_atomic_int_set(&self->gfx_client_decode_slow, 0);
     }
-    memcpy(buffer, self->gfx_previous_frame->data, self->gfx_previous_frame->len);
+}
 
-    self->gfx_force_keyframe = TRUE;
-    DRD_LOG_MESSAGE("encode cached frame");
-    return drd_encoding_manager_encode_surface_gfx(
-            self, settings, context, surface_id, cached_frame, frame_id, h264, auto_switch, error);
+/*
+ * 功能：获取最近一次 Surface GFX 编码的脏 tile 占比。
+ * 逻辑：返回 analyze_tiles 统计的变化 tile 数与总 tile 数之比，供会话帧率调节使用；该值由分析线程以百万分之一
+ *       定点原子写入，渲染线程原子读取后换算为比例。
+ * 参数：self 管理器。
+ * 外部接口：GLib g_atomic_int_get。
+ */
+gdouble drd_encoding_manager_get_change_ratio(DrdEncodingManager *self)
+{
+    g_return_val_if_fail(DRD_IS_ENCODING_MANAGER(self), 0.0);
+
+    return (gdouble) g_atomic_int_get(&self->gfx_change_ratio_ppm) / 1000000.0;
+}
+
+/*
+ * 功能：获取最近一次成功提交的 Surface GFX 帧编码字节数。
+ * 逻辑：返回 note_frame_sent 在发送成功时记录的负载大小，供 Rdpgfx 拥塞窗口统计在途字节；与发送阶段同线程读取。
+ * 参数：self 管理器。
+ * 外部接口：无。
+ */
+gsize drd_encoding_manager_get_last_encoded_bytes(DrdEncodingManager *self)
+{
+    g_return_val_if_fail(DRD_IS_ENCODING_MANAGER(self), 0);
+
+    return self->gfx_last_encoded_bytes;
+}
+
+/*
+ * 功能：获取编码暂存区分配统计。
+ * 逻辑：返回累计分配次数与进入稳态后的分配次数；后者在正常运行中应保持为 0。
+ * 参数：self 管理器；out_total/out_steady 输出，可为 NULL。
+ * 外部接口：GLib g_atomic_int_get。
+ */
+void drd_encoding_manager_get_scratch_alloc_stats(DrdEncodingManager *self, guint *out_total, guint *out_steady)
+{
+    g_return_if_fail(DRD_IS_ENCODING_MANAGER(self));
+
+    if (out_total != NULL)
+    {
+        *out_total = (guint) g_atomic_int_get(&self->gfx_scratch_allocs);
+    }
+    if (out_steady != NULL)
+    {
+        *out_steady = (guint) g_atomic_int_get(&self->gfx_steady_scratch_allocs);
+    }
+}
+
+/*
+ * 功能：在编码前应用码率控制器给出的最新目标。
+ * 逻辑：控制器目标变化时更新 h264_bitrate/h264_qp 与画质档位；软件 H264 通过 h264_context_set_option 即时生效，
+ *       VAAPI 在下次 drd_vaapi_encoder_prepare 时按码率偏差决定是否重建。
+ * 参数：self 管理器。
+ * 外部接口：FreeRDP h264_context_set_option；日志使用 DRD_LOG_MESSAGE/DRD_LOG_WARNING。
+ */
+static void drd_encoding_manager_apply_rate_target(DrdEncodingManager *self)
+{
+    DrdRateTarget target;
+
+    if (!drd_rate_controller_update(self->rate_controller, g_get_monotonic_time(), &target))
+    {
+        return;
+    }
+
+    DRD_LOG_MESSAGE("Adaptive rate target bitrate=%u qp=%u quality_level=%u (was bitrate=%u qp=%u)", target.bitrate,
+                    target.qp, target.quality_level, self->h264_bitrate, self->h264_qp);
+    self->h264_bitrate = target.bitrate;
+    self->h264_qp = target.qp;
+    self->gfx_quality_level = target.quality_level;
+
+    if (self->h264 != NULL)
+    {
+        if (!h264_context_set_option(self->h264, H264_CONTEXT_OPTION_BITRATE, self->h264_bitrate) ||
+            !h264_context_set_option(self->h264, H264_CONTEXT_OPTION_QP, self->h264_qp))
+        {
+            DRD_LOG_WARNING("Failed to apply adaptive rate target to H264 encoder");
+        }
+    }
 }
 
 void drd_encoding_manager_register_codec_result(DrdEncodingManager *self,
@@ -932,36 +1201,44 @@ static guint64 drd_gfx_hash_tile(const guint8 *data, guint stride, guint32 x, gu
 }
 
 /*
- * 功能：根据帧尺寸与 stride 初始化 surface gfx 差分状态。
- * 逻辑：尺寸变化时重建 tile 哈希与 previous buffer，并强制关键帧。
+ * 功能：根据帧尺寸、stride 与 tile 配置初始化 surface gfx 差分状态。
+ * 逻辑：尺寸或 tile 边长变化时重建 super tile 哈希与 previous buffer，并返回 TRUE 让编码阶段输出关键帧。
  * 参数：self 管理器；width/height/stride 当前帧几何。
  * 外部接口：GLib g_byte_array_set_size/g_array_set_size。
  */
-static void drd_encoding_manager_prepare_gfx_diff_state(DrdEncodingManager *self, guint width, guint height,
+static gboolean drd_encoding_manager_prepare_gfx_diff_state(DrdEncodingManager *self, guint width, guint height,
                                                         guint stride)
 {
+    const guint tile_size = self->gfx_tile_size;
+    const guint super_size = tile_size * self->gfx_super_tile_factor;
     const gboolean size_changed =
             self->gfx_diff_width != width || self->gfx_diff_height != height || self->gfx_diff_stride != stride;
-    const guint tiles_x = (width + 63) / 64;
-    const guint tiles_y = (height + 63) / 64;
-    const gboolean tiles_changed = self->gfx_tiles_x != tiles_x || self->gfx_tiles_y != tiles_y;
+    const guint tiles_x = (width + tile_size - 1) / tile_size;
+    const guint tiles_y = (height + tile_size - 1) / tile_size;
+    const guint supers_x = (width + super_size - 1) / super_size;
+    const guint supers_y = (height + super_size - 1) / super_size;
+    const gboolean tiles_changed = self->gfx_diff_tile_size != tile_size || self->gfx_tiles_x != tiles_x ||
+                                   self->gfx_tiles_y != tiles_y || self->gfx_supers_x != supers_x ||
+                                   self->gfx_supers_y != supers_y;
 
     if (!size_changed && !tiles_changed && self->gfx_previous_frame->len == (gsize) stride * height)
     {
-        return;
+        return FALSE;
     }
 
     self->gfx_diff_width = width;
     self->gfx_diff_height = height;
     self->gfx_diff_stride = stride;
+    self->gfx_diff_tile_size = tile_size;
     self->gfx_tiles_x = tiles_x;
     self->gfx_tiles_y = tiles_y;
+    self->gfx_supers_x = supers_x;
+    self->gfx_supers_y = supers_y;
     g_byte_array_set_size(self->gfx_previous_frame, (gsize) stride * height);
     memset(self->gfx_previous_frame->data, 0, self->gfx_previous_frame->len);
-    g_array_set_size(self->gfx_tile_hashes, self->gfx_tiles_x * self->gfx_tiles_y);
-    memset(self->gfx_tile_hashes->data, 0, self->gfx_tile_hashes->len * sizeof(guint64));
-    self->gfx_force_keyframe = TRUE;
-    self->gfx_progressive_rfx_frames = 0;
+    g_array_set_size(self->gfx_super_tile_hashes, supers_x * supers_y);
+    memset(self->gfx_super_tile_hashes->data, 0, self->gfx_super_tile_hashes->len * sizeof(guint64));
+    return TRUE;
 }
 
 static void drd_encoding_manager_store_previous_frame(DrdEncodingManager *self, const guint8 *data, guint stride,
@@ -975,217 +1252,680 @@ static void drd_encoding_manager_store_previous_frame(DrdEncodingManager *self,
 }
 
 /*
- * 功能：按当前帧预计算 tile hash，便于后续差分复用。
- * 逻辑：遍历 64x64 tile 计算 hash 并写回缓存。
- * 参数：self 管理器；data 当前帧；stride 行步长。
- * 外部接口：无。
+ * 功能：基于分析阶段给出的脏块位图生成 REGION16 或 RFX_RECT，供 Progressive/RemoteFX 共用。
+ * 逻辑：先把位图合并为最大的水平/纵向堆叠矩形（tile 单位），再按分析时的 tile 边长换算为像素并裁剪到帧边界，
+ *       写入矩形或合并 REGION16；大面积变化时矩形数与 region16_union_rect 调用次数随之大幅减少。
+ *       不访问分析线程持有的差分状态。
+ * 参数：self 管理器（提供编码线程复用的 tile 矩形缓存）；analysis 分析结果；region/rects 输出容器。
+ * 外部接口：drd_dirty_map_coalesce；WinPR region16_union_rect；GLib g_array_append_val。
  */
-static void drd_encoding_manager_update_tile_hashes(DrdEncodingManager *self, const guint8 *data, guint stride)
+static gboolean drd_encoding_manager_collect_dirty_tiles(DrdEncodingManager *self, const DrdGfxAnalysis *analysis,
+                                                         REGION16 *region, GArray *rects)
 {
-    if (self->gfx_tiles_x == 0 || self->gfx_tiles_y == 0)
+    if (analysis->tiles_x == 0 || analysis->tiles_y == 0)
     {
-        return;
+        return FALSE;
+    }
+
+    WINPR_ASSERT(analysis->dirty_map != NULL);
+    WINPR_ASSERT(drd_dirty_map_get_tiles_x(analysis->dirty_map) == analysis->tiles_x);
+    WINPR_ASSERT(drd_dirty_map_get_tiles_y(analysis->dirty_map) == analysis->tiles_y);
+
+    GArray *tile_rects = self->gfx_dirty_tile_rects;
+    g_array_set_size(tile_rects, 0);
+    if (drd_dirty_map_coalesce(analysis->dirty_map, tile_rects) == 0)
+    {
+        return FALSE;
     }
 
-    for (guint y = 0; y < self->gfx_diff_height; y += 64)
+    const guint tile_size = analysis->tile_size;
+    for (guint i = 0; i < tile_rects->len; ++i)
     {
-        const guint tile_h = MIN(64u, self->gfx_diff_height - y);
-        for (guint x = 0; x < self->gfx_diff_width; x += 64)
+        const DrdDirtyRect *tile_rect = &g_array_index(tile_rects, DrdDirtyRect, i);
+        const guint x = (guint) tile_rect->x * tile_size;
+        const guint y = (guint) tile_rect->y * tile_size;
+        const guint32 right = MIN(x + (guint) tile_rect->width * tile_size, analysis->width);
+        const guint32 bottom = MIN(y + (guint) tile_rect->height * tile_size, analysis->height);
+        WINPR_ASSERT(right <= UINT16_MAX);
+        WINPR_ASSERT(bottom <= UINT16_MAX);
+
+        if (rects != NULL)
         {
-            const guint tile_w = MIN(64u, self->gfx_diff_width - x);
-            const guint index = (y / 64) * self->gfx_tiles_x + (x / 64);
-            guint64 hash = drd_gfx_hash_tile(data, stride, x, y, tile_w, tile_h);
-            guint64 *stored = &g_array_index(self->gfx_tile_hashes, guint64, index);
-            *stored = hash;
+            RFX_RECT rect = {(UINT16) x, (UINT16) y, (UINT16) (right - x), (UINT16) (bottom - y)};
+            g_array_append_val(rects, rect);
+        }
+        if (region != NULL)
+        {
+            RECTANGLE_16 region_rect;
+            region_rect.left = (UINT16) x;
+            region_rect.top = (UINT16) y;
+            region_rect.right = (UINT16) right;
+            region_rect.bottom = (UINT16) bottom;
+            region16_union_rect(region, region, &region_rect);
         }
     }
+
+    return TRUE;
+}
+
+static gboolean drd_encoding_manager_collect_dirty_rects(DrdEncodingManager *self, const DrdGfxAnalysis *analysis,
+                                                         GArray *rects)
+{
+    return drd_encoding_manager_collect_dirty_tiles(self, analysis, NULL, rects);
+}
+
+static gboolean drd_encoding_manager_collect_dirty_region(DrdEncodingManager *self, const DrdGfxAnalysis *analysis,
+                                                          REGION16 *region)
+{
+    return drd_encoding_manager_collect_dirty_tiles(self, analysis, region, NULL);
 }
 
 /*
- * 功能：基于预计算的脏块标记生成 REGION16 或 RFX_RECT，供 Progressive/RemoteFX 共用。
- * 逻辑：按 64x64 tile 读取 dirty_flags，命中时写入矩形或合并 REGION16，避免重复像素比对。
- * 参数：self 管理器；dirty_flags 脏块标记；region/rects 输出容器。
- * 外部接口：WinPR region16_union_rect；GLib g_array_append_val。
+ * 功能：在一个已变化的 super tile 内逐 tile 比对。
+ * 逻辑：无上一帧时所有 tile 视为脏；否则逐行 memcmp，首个差异行即判定为脏并写入位图。
+ * 参数：self 管理器；data 当前帧；previous 上一帧，可为 NULL；stride 行步长；
+ *       super_x/super_y/super_w/super_h super tile 的像素范围；dirty_map 脏块位图。
+ * 外部接口：C 标准库 memcmp；drd_dirty_map_set。
+ * 返回：该 super tile 内的脏 tile 数。
  */
-static gboolean drd_encoding_manager_collect_dirty_tiles(DrdEncodingManager *self, const GArray *dirty_flags,
-                                                         REGION16 *region, GArray *rects)
+static guint drd_encoding_manager_analyze_sub_tiles(DrdEncodingManager *self, const guint8 *data,
+                                                    const guint8 *previous, guint stride, guint super_x,
+                                                    guint super_y, guint super_w, guint super_h,
+                                                    DrdDirtyMap *dirty_map)
 {
-    if (self->gfx_tiles_x == 0 || self->gfx_tiles_y == 0)
+    const guint tile_size = self->gfx_diff_tile_size;
+    guint changed_tiles = 0;
+
+    for (guint y = super_y; y < super_y + super_h; y += tile_size)
     {
-        return FALSE;
+        const guint tile_h = MIN(tile_size, super_y + super_h - y);
+        for (guint x = super_x; x < super_x + super_w; x += tile_size)
+        {
+            const guint tile_w = MIN(tile_size, super_x + super_w - x);
+            gboolean different = previous == NULL;
+
+            for (guint row = 0; row < tile_h && !different; ++row)
+            {
+                const gsize offset = ((gsize) (y + row) * stride) + (gsize) x * 4;
+                different = memcmp(previous + offset, data + offset, tile_w * 4) != 0;
+            }
+
+            if (different)
+            {
+                drd_dirty_map_set(dirty_map, x / tile_size, y / tile_size);
+                changed_tiles++;
+            }
+        }
     }
 
-    const guint total_tiles = self->gfx_tiles_x * self->gfx_tiles_y;
-    WINPR_ASSERT(dirty_flags != NULL);
-    WINPR_ASSERT(dirty_flags->len == total_tiles);
+    return changed_tiles;
+}
 
-    gboolean has_dirty = FALSE;
+/*
+ * 功能：两级遍历获取脏块分布。
+ * 逻辑：先对每个 super tile 计算 hash 并与上一帧的 hash 比较，相同则整块跳过；不同时才在其内部逐 tile memcmp。
+ *       比较后立即写回当前帧的 hash，分析结束后无需再次遍历整帧刷新哈希。
+ *       大变化判定交给编码阶段按当时的画质档位计算。
+ * 参数：self 管理器；data 当前帧；previous 上一帧；stride 行步长；dirty_map 脏块位图。
+ * 外部接口：drd_dirty_map_reset；内部 hash/比对工具。
+ */
+static guint drd_encoding_manager_analyze_tiles(DrdEncodingManager *self, const guint8 *data, const guint8 *previous,
+                                                guint stride, DrdDirtyMap *dirty_map)
+{
+    if (drd_dirty_map_reset(dirty_map, self->gfx_tiles_x, self->gfx_tiles_y))
+    {
+        drd_encoding_manager_note_scratch_alloc(self, "dirty map", self->gfx_analysis_warm_frames);
+    }
 
-    for (guint y = 0; y < self->gfx_diff_height; y += 64)
+    if (self->gfx_tiles_x == 0 || self->gfx_tiles_y == 0 || self->gfx_diff_width == 0 || self->gfx_diff_height == 0)
+    {
+        return 0;
+    }
+
+    const guint super_size = self->gfx_diff_tile_size * self->gfx_super_tile_factor;
+    guint changed_tiles = 0;
+    const gboolean force_dirty = previous == NULL;
+
+    for (guint y = 0; y < self->gfx_diff_height; y += super_size)
     {
-        const guint tile_h = MIN(64u, self->gfx_diff_height - y);
-        for (guint x = 0; x < self->gfx_diff_width; x += 64)
+        const guint super_h = MIN(super_size, self->gfx_diff_height - y);
+        for (guint x = 0; x < self->gfx_diff_width; x += super_size)
         {
-            const guint tile_w = MIN(64u, self->gfx_diff_width - x);
-            const guint index = (y / 64) * self->gfx_tiles_x + (x / 64);
-            const gboolean different = g_array_index(dirty_flags, gboolean, index);
+            const guint super_w = MIN(super_size, self->gfx_diff_width - x);
+            const guint index = (y / super_size) * self->gfx_supers_x + (x / super_size);
+            const guint64 hash = drd_gfx_hash_tile(data, stride, x, y, super_w, super_h);
+            guint64 *stored = &g_array_index(self->gfx_super_tile_hashes, guint64, index);
+            const gboolean different = force_dirty || *stored != hash;
 
+            *stored = hash;
             if (different)
             {
-                if (rects != NULL)
-                {
-                    RFX_RECT rect = {(UINT16) x, (UINT16) y, (UINT16) tile_w, (UINT16) tile_h};
-                    g_array_append_val(rects, rect);
-                }
-                if (region != NULL)
-                {
-                    const guint32 right = x + tile_w;
-                    const guint32 bottom = y + tile_h;
-                    RECTANGLE_16 region_rect;
-                    WINPR_ASSERT(right <= UINT16_MAX);
-                    WINPR_ASSERT(bottom <= UINT16_MAX);
-                    region_rect.left = (UINT16) x;
-                    region_rect.top = (UINT16) y;
-                    region_rect.right = (UINT16) right;
-                    region_rect.bottom = (UINT16) bottom;
-                    region16_union_rect(region, region, &region_rect);
-                }
-                has_dirty = TRUE;
+                changed_tiles += drd_encoding_manager_analyze_sub_tiles(self, data, previous, stride, x, y, super_w,
+                                                                        super_h, dirty_map);
             }
         }
     }
 
-    return has_dirty;
+    return changed_tiles;
 }
 
-static gboolean drd_encoding_manager_collect_dirty_rects(DrdEncodingManager *self, const GArray *dirty_flags,
-                                                         GArray *rects)
+/*
+ * 功能：记录一次编码暂存区分配。
+ * 逻辑：累计分配次数；调用线程自己的预热计数已达 DRD_GFX_SCRATCH_WARMUP_FRAMES（进入稳态）时另行计数并输出警告。
+ *       稳态分配可能由画面内容（码流超出预留）或观看者增加（编码帧池耗尽）正常引起，默认只计数告警；
+ *       meson 选项 encode_alloc_assert 打开时（定义 DRD_ENCODE_ALLOC_CHECK）改为断言失败，供排查分配回归。
+ * 参数：self 管理器；what 分配对象描述；warm_frames 调用线程（分析或编码）的预热计数。
+ * 外部接口：GLib g_atomic_int_inc/g_atomic_int_add；DRD_LOG_WARNING。
+ */
+static void drd_encoding_manager_note_scratch_alloc(DrdEncodingManager *self, const gchar *what, guint warm_frames)
 {
-    return drd_encoding_manager_collect_dirty_tiles(self, dirty_flags, NULL, rects);
+    g_atomic_int_inc(&self->gfx_scratch_allocs);
+    if (warm_frames < DRD_GFX_SCRATCH_WARMUP_FRAMES)
+    {
+        return;
+    }
+
+    const gint steady_allocs = g_atomic_int_add(&self->gfx_steady_scratch_allocs, 1) + 1;
+    DRD_LOG_WARNING("Steady-state encode allocated scratch memory: %s (%d so far)", what, steady_allocs);
+#ifdef DRD_ENCODE_ALLOC_CHECK
+    g_assert_not_reached();
+#endif
 }
 
-static gboolean drd_encoding_manager_collect_dirty_region(DrdEncodingManager *self, const GArray *dirty_flags,
-                                                          REGION16 *region)
+/*
+ * 功能：确保码流暂存区容量足够。
+ * 逻辑：容量不足时按 2 倍增长（至少 64KiB），但不超过当前几何的预留上限（除非需要的更多），并计入暂存区分配；
+ *       足够时不做任何事。只在编码线程调用。
+ * 参数：self 管理器；buffer 暂存区；size 需要的字节数。
+ * 外部接口：GLib g_realloc。
+ */
+static void drd_encoding_manager_reserve_payload(DrdEncodingManager *self, DrdGfxScratchBuffer *buffer, gsize size)
 {
-    return drd_encoding_manager_collect_dirty_tiles(self, dirty_flags, region, NULL);
+    if (size <= buffer->capacity)
+    {
+        return;
+    }
+
+    gsize capacity = MAX(buffer->capacity, (gsize) DRD_GFX_SCRATCH_MIN_CAPACITY);
+    while (capacity < size)
+    {
+        capacity *= 2;
+    }
+    if (self->gfx_payload_reserve > 0)
+    {
+        capacity = MAX(size, MIN(capacity, self->gfx_payload_reserve));
+    }
+    buffer->data = g_realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+    drd_encoding_manager_note_scratch_alloc(self, "payload", self->gfx_warm_frames);
 }
 
 /*
- * 功能：单次遍历 tile 获取脏块分布并判定是否为大变化。
- * 逻辑：按 64x64 tile 计算 hash，对比历史 hash 后在差异 tile 上执行 memcmp，累计变化比例并写入脏块标记。
- * 参数：self 管理器；data 当前帧；previous 上一帧；stride 行步长；threshold 判定阈值；dirty_flags 脏块标记数组；changed_tiles 输出变化 tile 数。
- * 外部接口：C 标准库 memcmp。
+ * 功能：把一段编码器输出追加到码流暂存区。
+ * 逻辑：按需扩容后拷贝；长度为 0 时不做任何事。
+ * 参数：self 管理器；buffer 暂存区；data 码流；length 字节数。
+ * 外部接口：C 标准库 memcpy。
  */
-static gboolean drd_encoding_manager_analyze_tiles(DrdEncodingManager *self, const guint8 *data, const guint8 *previous,
-                                                   guint stride, gdouble threshold, GArray *dirty_flags,
-                                                   guint *changed_tiles)
+static void drd_encoding_manager_append_payload(DrdEncodingManager *self, DrdGfxScratchBuffer *buffer,
+                                                const BYTE *data, gsize length)
 {
-    if (self->gfx_tiles_x == 0 || self->gfx_tiles_y == 0 || self->gfx_diff_width == 0 || self->gfx_diff_height == 0)
+    if (data == NULL || length == 0)
     {
-        if (changed_tiles != NULL)
-        {
-            *changed_tiles = 0;
-        }
-        return TRUE;
+        return;
     }
 
-    const guint total_tiles = self->gfx_tiles_x * self->gfx_tiles_y;
-    if (total_tiles == 0)
+    drd_encoding_manager_reserve_payload(self, buffer, buffer->len + length);
+    memcpy(buffer->data + buffer->len, data, length);
+    buffer->len += length;
+}
+
+/*
+ * 功能：用一段编码器输出覆盖码流暂存区。
+ * 逻辑：清空长度后追加。
+ * 参数：self 管理器；buffer 暂存区；data 码流；length 字节数。
+ * 外部接口：drd_encoding_manager_append_payload。
+ */
+static void drd_encoding_manager_assign_payload(DrdEncodingManager *self, DrdGfxScratchBuffer *buffer,
+                                                const BYTE *data, gsize length)
+{
+    buffer->len = 0;
+    drd_encoding_manager_append_payload(self, buffer, data, length);
+}
+
+/*
+ * 功能：从回收池取一个编码帧。
+ * 逻辑：池空时新建并计入暂存区分配；取到的帧持有池引用，释放时自动归还。
+ * 参数：self 管理器。
+ * 外部接口：drd_recycle_pool_acquire/drd_recycle_pool_ref。
+ */
+static DrdEncodedGfxFrame *drd_encoding_manager_acquire_encoded_frame(DrdEncodingManager *self)
+{
+    DrdEncodedGfxFrame *frame = drd_recycle_pool_acquire(self->gfx_encoded_pool);
+    if (frame == NULL)
     {
-        if (changed_tiles != NULL)
-        {
-            *changed_tiles = 0;
-        }
-        return TRUE;
+        frame = g_new0(DrdEncodedGfxFrame, 1);
+        drd_encoding_manager_note_scratch_alloc(self, "encoded frame", self->gfx_warm_frames);
     }
+    frame->pool = drd_recycle_pool_ref(self->gfx_encoded_pool);
+    g_atomic_int_set(&frame->ref_count, 1);
+    return frame;
+}
 
-    if (dirty_flags != NULL)
+/*
+ * 功能：从回收池取一个分析结果。
+ * 逻辑：池空时新建（含空的脏块位图，首次分析时按 tile 数分配）并计入暂存区分配；取到的结果持有池引用。
+ * 参数：self 管理器。
+ * 外部接口：drd_recycle_pool_acquire/drd_recycle_pool_ref；drd_dirty_map_new。
+ */
+static DrdGfxAnalysis *drd_encoding_manager_acquire_analysis(DrdEncodingManager *self)
+{
+    DrdGfxAnalysis *analysis = drd_recycle_pool_acquire(self->gfx_analysis_pool);
+    if (analysis == NULL)
     {
-        g_array_set_size(dirty_flags, total_tiles);
-        memset(dirty_flags->data, 0, dirty_flags->len * sizeof(gboolean));
+        analysis = g_new0(DrdGfxAnalysis, 1);
+        analysis->dirty_map = drd_dirty_map_new();
+        drd_encoding_manager_note_scratch_alloc(self, "analysis", self->gfx_analysis_warm_frames);
     }
+    analysis->pool = drd_recycle_pool_ref(self->gfx_analysis_pool);
+    return analysis;
+}
 
-    guint local_changed_tiles = 0;
-    const gboolean force_dirty = previous == NULL;
+/*
+ * 功能：彻底销毁分析结果，供回收池满或池销毁时调用。
+ * 逻辑：释放帧引用与脏块位图后释放结构体。
+ * 参数：data 分析结果。
+ * 外部接口：GLib g_clear_object/g_free；drd_dirty_map_free。
+ */
+static void drd_gfx_analysis_destroy(gpointer data)
+{
+    DrdGfxAnalysis *analysis = data;
+
+    g_clear_object(&analysis->frame);
+    g_clear_pointer(&analysis->dirty_map, drd_dirty_map_free);
+    g_free(analysis);
+}
 
-    for (guint y = 0; y < self->gfx_diff_height; y += 64)
+/*
+ * 功能：释放分析结果。
+ * 逻辑：来自回收池的结果释放帧引用后归还池（脏块位图保留容量，下次分析时重置），否则直接销毁。
+ * 参数：analysis 分析结果，可为 NULL。
+ * 外部接口：drd_recycle_pool_release/drd_recycle_pool_unref。
+ */
+void drd_gfx_analysis_free(DrdGfxAnalysis *analysis)
+{
+    if (analysis == NULL)
     {
-        const guint tile_h = MIN(64u, self->gfx_diff_height - y);
-        for (guint x = 0; x < self->gfx_diff_width; x += 64)
-        {
-            const guint tile_w = MIN(64u, self->gfx_diff_width - x);
-            const guint index = (y / 64) * self->gfx_tiles_x + (x / 64);
-            const guint64 hash = drd_gfx_hash_tile(data, stride, x, y, tile_w, tile_h);
-            const guint64 stored = g_array_index(self->gfx_tile_hashes, guint64, index);
-            gboolean different = force_dirty || stored != hash;
+        return;
+    }
 
-            if (different && !force_dirty)
-            {
-                different = FALSE;
-                for (guint row = 0; row < tile_h; ++row)
-                {
-                    const guint offset = ((y + row) * stride) + x * 4;
-                    if (memcmp(previous + offset, data + offset, tile_w * 4) != 0)
-                    {
-                        different = TRUE;
-                        break;
-                    }
-                }
-            }
+    DrdRecyclePool *pool = g_steal_pointer(&analysis->pool);
+    if (pool == NULL)
+    {
+        drd_gfx_analysis_destroy(analysis);
+        return;
+    }
 
-            if (dirty_flags != NULL)
-            {
-                gboolean *flag = &g_array_index(dirty_flags, gboolean, index);
-                *flag = different;
-            }
+    g_clear_object(&analysis->frame);
+    analysis->changed_tiles = 0;
+    analysis->geometry_changed = FALSE;
+    drd_recycle_pool_release(pool, analysis);
+    drd_recycle_pool_unref(pool);
+}
 
-            if (different)
-            {
-                local_changed_tiles++;
-            }
-        }
+/*
+ * 功能：把未被编码阶段消费的旧分析结果并入新结果。
+ * 逻辑：分析线程每次分析后立即把当前帧作为新基线，旧结果被覆盖时其脏块若丢失将导致客户端残留旧画面，
+ *       因此几何一致时按位取并集并重算变化数；几何不一致或旧结果要求关键帧时新结果同样要求关键帧。
+ * 参数：newer 新分析结果；older 被覆盖的旧分析结果。
+ * 外部接口：无。
+ */
+void drd_gfx_analysis_merge(DrdGfxAnalysis *newer, const DrdGfxAnalysis *older)
+{
+    g_return_if_fail(newer != NULL);
+    g_return_if_fail(older != NULL);
+
+    if (older->geometry_changed || newer->tile_size != older->tile_size || newer->tiles_x != older->tiles_x ||
+        newer->tiles_y != older->tiles_y ||
+        drd_dirty_map_get_tiles_x(newer->dirty_map) != drd_dirty_map_get_tiles_x(older->dirty_map) ||
+        drd_dirty_map_get_tiles_y(newer->dirty_map) != drd_dirty_map_get_tiles_y(older->dirty_map))
+    {
+        newer->geometry_changed = TRUE;
+        return;
+    }
+
+    newer->changed_tiles = drd_dirty_map_merge(newer->dirty_map, older->dirty_map);
+}
+
+/*
+ * 功能：分析阶段：计算一帧相对上一基线的脏块分布。
+ * 逻辑：按帧几何与 tile 配置准备差分状态（变化时标记 geometry_changed），经 super tile hash 与 tile 比对两级
+ *       得到脏块标记与变化比例（hash 在比对时已更新），随后立即把当前帧存为新基线，
+ *       使分析线程不必等待编码/发送完成即可处理下一帧。
+ *       差分状态只由分析线程访问；分析结果取自回收池，稳态下不分配内存。
+ * 参数：self 管理器；input 捕获帧；out_analysis 输出分析结果（调用方释放）；error 错误输出。
+ * 外部接口：GLib g_set_error_literal；drd_encoding_manager_acquire_analysis；内部 hash/比对工具。
+ */
+gboolean drd_encoding_manager_analyze_gfx_frame(DrdEncodingManager *self, DrdFrame *input,
+                                                DrdGfxAnalysis **out_analysis, GError **error)
+{
+    g_return_val_if_fail(DRD_IS_ENCODING_MANAGER(self), FALSE);
+    g_return_val_if_fail(DRD_IS_FRAME(input), FALSE);
+    g_return_val_if_fail(out_analysis != NULL, FALSE);
+
+    if (!self->ready)
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Encoding manager not prepared");
+        return FALSE;
+    }
+
+    const guint width = drd_frame_get_width(input);
+    const guint height = drd_frame_get_height(input);
+    const guint stride = drd_frame_get_stride(input);
+    gsize data_size = 0;
+    const guint8 *data = drd_frame_get_data(input, &data_size);
+    if (data == NULL || data_size < (gsize) stride * height)
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Capture frame buffer too small");
+        return FALSE;
     }
 
-    if (changed_tiles != NULL)
+    const gboolean geometry_changed = drd_encoding_manager_prepare_gfx_diff_state(self, width, height, stride);
+    if (geometry_changed)
     {
-        *changed_tiles = local_changed_tiles;
+        /* 差分缓冲与脏块数组随几何重建，分析线程重新进入预热期；编码线程据 analysis->geometry_changed 自行重置 */
+        self->gfx_analysis_warm_frames = 0;
     }
+    DrdGfxAnalysis *analysis = drd_encoding_manager_acquire_analysis(self);
+    analysis->geometry_changed = geometry_changed;
+    const guint8 *previous_frame =
+            (self->gfx_previous_frame->len == (gsize) stride * height) ? self->gfx_previous_frame->data : NULL;
+    analysis->frame = g_object_ref(input);
+    analysis->width = width;
+    analysis->height = height;
+    analysis->stride = stride;
+    analysis->tile_size = self->gfx_diff_tile_size;
+    analysis->tiles_x = self->gfx_tiles_x;
+    analysis->tiles_y = self->gfx_tiles_y;
+    analysis->changed_tiles =
+            drd_encoding_manager_analyze_tiles(self, data, previous_frame, stride, analysis->dirty_map);
 
-    return ((gdouble) local_changed_tiles / (gdouble) total_tiles) >= threshold;
+    const guint total_tiles = analysis->tiles_x * analysis->tiles_y;
+    g_atomic_int_set(&self->gfx_change_ratio_ppm,
+                     total_tiles > 0 ? (gint) ((guint64) analysis->changed_tiles * 1000000u / total_tiles) : 0);
+
+    drd_encoding_manager_store_previous_frame(self, data, stride, height);
+    if (self->gfx_analysis_warm_frames < DRD_GFX_SCRATCH_WARMUP_FRAMES)
+    {
+        self->gfx_analysis_warm_frames++;
+    }
+
+    *out_analysis = analysis;
+    return TRUE;
 }
 
 /*
- * 功能：生成符合 Rdpgfx 要求的 32 位时间戳。
- * 逻辑：获取本地时间，按小时/分钟/秒/毫秒编码到 32 位整数。
- * 参数：无。
- * 外部接口：GLib GDateTime API 获取时间。
+ * 功能：重置编码帧以便复用。
+ * 逻辑：释放 FreeRDP 分配的 H264 元数据（内联元数据只需清零），清空命令与码流长度，保留暂存区容量。
+ * 参数：frame 编码帧。
+ * 外部接口：FreeRDP free_h264_metablock。
+ */
+static void drd_encoded_gfx_frame_reset(DrdEncodedGfxFrame *frame)
+{
+    if (!frame->meta_inline)
+    {
+        free_h264_metablock(&frame->avc420.meta);
+    }
+    free_h264_metablock(&frame->avc444.bitstream[0].meta);
+    free_h264_metablock(&frame->avc444.bitstream[1].meta);
+    memset(&frame->cmd, 0, sizeof(frame->cmd));
+    memset(&frame->avc420, 0, sizeof(frame->avc420));
+    memset(&frame->avc444, 0, sizeof(frame->avc444));
+    frame->meta_inline = FALSE;
+    frame->payload.len = 0;
+    frame->payload_aux.len = 0;
+    frame->h264 = FALSE;
+    frame->keyframe = FALSE;
+    frame->encoded_bytes = 0;
+    frame->capture_time_us = 0;
+    frame->sequence = 0;
+}
+
+/*
+ * 功能：彻底销毁编码帧，供回收池满或池销毁时调用。
+ * 逻辑：重置后释放两个码流暂存区与结构体。
+ * 参数：data 编码帧。
+ * 外部接口：GLib g_free。
+ */
+static void drd_encoded_gfx_frame_destroy(gpointer data)
+{
+    DrdEncodedGfxFrame *frame = data;
+
+    drd_encoded_gfx_frame_reset(frame);
+    g_free(frame->payload.data);
+    g_free(frame->payload_aux.data);
+    g_free(frame);
+}
+
+/*
+ * 功能：增加编码帧引用，供多名观看者共享同一份码流。
+ * 逻辑：原子自增引用计数。
+ * 参数：frame 编码帧。
+ * 外部接口：GLib g_atomic_int_inc。
+ * 返回：frame 本身。
  */
-static guint32 drd_rdp_graphics_pipeline_build_timestamp(void)
+DrdEncodedGfxFrame *drd_encoded_gfx_frame_ref(DrdEncodedGfxFrame *frame)
 {
-    guint32 timestamp = 0;
-    GDateTime *now = g_date_time_new_now_local();
+    g_return_val_if_fail(frame != NULL, NULL);
 
-    if (now != NULL)
+    g_atomic_int_inc(&frame->ref_count);
+    return frame;
+}
+
+/*
+ * 功能：释放一个编码帧引用。
+ * 逻辑：最后一个引用释放时，来自回收池的帧重置后归还池并释放池引用，否则直接销毁。
+ * 参数：frame 编码帧，可为 NULL。
+ * 外部接口：GLib g_atomic_int_dec_and_test；drd_recycle_pool_release/drd_recycle_pool_unref。
+ */
+void drd_encoded_gfx_frame_unref(DrdEncodedGfxFrame *frame)
+{
+    if (frame == NULL || !g_atomic_int_dec_and_test(&frame->ref_count))
     {
-        timestamp = ((guint32) g_date_time_get_hour(now) << 22) | ((guint32) g_date_time_get_minute(now) << 16) |
-                    ((guint32) g_date_time_get_second(now) << 10) |
-                    ((guint32) (g_date_time_get_microsecond(now) / 1000));
-        g_date_time_unref(now);
+        return;
     }
 
-    return timestamp;
+    DrdRecyclePool *pool = g_steal_pointer(&frame->pool);
+    if (pool == NULL)
+    {
+        drd_encoded_gfx_frame_destroy(frame);
+        return;
+    }
+
+    drd_encoded_gfx_frame_reset(frame);
+    drd_recycle_pool_release(pool, frame);
+    drd_recycle_pool_unref(pool);
 }
 
+gsize drd_encoded_gfx_frame_get_size(const DrdEncodedGfxFrame *frame)
+{
+    g_return_val_if_fail(frame != NULL, 0);
+
+    return frame->encoded_bytes;
+}
 
-gboolean drd_encoding_manager_encode_surface_gfx(DrdEncodingManager *self, rdpSettings *settings,
-                                                 RdpgfxServerContext *context, guint16 surface_id, DrdFrame *input,
-                                                 guint32 frame_id, gboolean *h264, gboolean auto_switch,
-                                                 GError **error)
+gboolean drd_encoded_gfx_frame_is_h264(const DrdEncodedGfxFrame *frame)
+{
+    g_return_val_if_fail(frame != NULL, FALSE);
+
+    return frame->h264;
+}
+
+gboolean drd_encoded_gfx_frame_is_keyframe(const DrdEncodedGfxFrame *frame)
+{
+    g_return_val_if_fail(frame != NULL, FALSE);
+
+    return frame->keyframe;
+}
+
+gint64 drd_encoded_gfx_frame_get_capture_time(const DrdEncodedGfxFrame *frame)
+{
+    g_return_val_if_fail(frame != NULL, 0);
+
+    return frame->capture_time_us;
+}
+
+guint64 drd_encoded_gfx_frame_get_sequence(const DrdEncodedGfxFrame *frame)
+{
+    g_return_val_if_fail(frame != NULL, 0);
+
+    return frame->sequence;
+}
+
+/*
+ * 功能：把 Rdpgfx codecId 映射为关键帧缓存槽位。
+ * 逻辑：逐一对应五种 Surface 编码。
+ * 参数：codec_id Rdpgfx codecId。
+ * 外部接口：无。
+ * 返回：槽位下标，未知编码返回 -1。
+ */
+static gint drd_gfx_keyframe_slot_for_codec(guint16 codec_id)
+{
+    switch (codec_id)
+    {
+        case RDPGFX_CODECID_AVC420:
+            return DRD_GFX_KEYFRAME_SLOT_AVC420;
+        case RDPGFX_CODECID_AVC444:
+            return DRD_GFX_KEYFRAME_SLOT_AVC444;
+        case RDPGFX_CODECID_AVC444v2:
+            return DRD_GFX_KEYFRAME_SLOT_AVC444V2;
+        case RDPGFX_CODECID_CAPROGRESSIVE:
+            return DRD_GFX_KEYFRAME_SLOT_PROGRESSIVE;
+        case RDPGFX_CODECID_CAVIDEO:
+            return DRD_GFX_KEYFRAME_SLOT_REMOTEFX;
+        default:
+            return -1;
+    }
+}
+
+/*
+ * 功能：清空关键帧缓存。
+ * 逻辑：持锁释放各槽位引用。编码器重置、流水线停止（此后捕获画面不再进入编码）时调用。
+ * 参数：self 管理器。
+ * 外部接口：drd_encoded_gfx_frame_unref。
+ */
+void drd_encoding_manager_drop_cached_keyframes(DrdEncodingManager *self)
+{
+    g_return_if_fail(DRD_IS_ENCODING_MANAGER(self));
+
+    g_mutex_lock(&self->gfx_keyframe_lock);
+    for (guint i = 0; i < DRD_GFX_KEYFRAME_SLOT_COUNT; ++i)
+    {
+        g_clear_pointer(&self->gfx_keyframe_cache[i], drd_encoded_gfx_frame_unref);
+    }
+    g_mutex_unlock(&self->gfx_keyframe_lock);
+}
+
+/*
+ * 功能：记录新编出的全帧关键帧。
+ * 逻辑：持锁替换对应编码的槽位；其余槽位是否仍有效由编码入口负责判定。
+ * 参数：self 管理器；frame 已完成的关键帧。
+ * 外部接口：drd_encoded_gfx_frame_ref/unref。
+ */
+static void drd_encoding_manager_store_keyframe(DrdEncodingManager *self, DrdEncodedGfxFrame *frame)
+{
+    const gint slot = drd_gfx_keyframe_slot_for_codec(frame->cmd.codecId);
+    if (slot < 0)
+    {
+        return;
+    }
+
+    g_mutex_lock(&self->gfx_keyframe_lock);
+    g_clear_pointer(&self->gfx_keyframe_cache[slot], drd_encoded_gfx_frame_unref);
+    self->gfx_keyframe_cache[slot] = drd_encoded_gfx_frame_ref(frame);
+    g_mutex_unlock(&self->gfx_keyframe_lock);
+}
+
+/*
+ * 功能：取缓存的全帧关键帧，供新观看者加入、参考链断开的观看者恢复或刷新请求直接发送。
+ * 逻辑：缓存中的帧都是最近一次编码的产物且此后没有增量帧，编码器参考状态与之一致，后续增量可直接接续；
+ *       持锁在符合编码类别的槽位中取编码序号最大者并增加引用。每个分析过的新画面都会作废缓存，
+ *       因此只在静止或低变化画面下命中，画面持续变化时调用方应退回强制关键帧。
+ * 参数：self 管理器；codec_class 需要的编码类别，UNKNOWN 表示不限。
+ * 外部接口：drd_encoded_gfx_frame_ref。
+ * 返回：关键帧引用（调用方释放），缓存无效时返回 NULL。
+ */
+DrdEncodedGfxFrame *drd_encoding_manager_lookup_keyframe(DrdEncodingManager *self, DrdEncodingCodecClass codec_class)
+{
+    g_return_val_if_fail(DRD_IS_ENCODING_MANAGER(self), NULL);
+
+    DrdEncodedGfxFrame *found = NULL;
+    g_mutex_lock(&self->gfx_keyframe_lock);
+    for (guint i = 0; i < DRD_GFX_KEYFRAME_SLOT_COUNT; ++i)
+    {
+        DrdEncodedGfxFrame *frame = self->gfx_keyframe_cache[i];
+        if (frame == NULL || (codec_class == DRD_ENCODING_CODEC_CLASS_AVC && !frame->h264) ||
+            (codec_class == DRD_ENCODING_CODEC_CLASS_NON_AVC && frame->h264))
+        {
+            continue;
+        }
+        if (found == NULL || frame->sequence > found->sequence)
+        {
+            found = frame;
+        }
+    }
+    if (found != NULL)
+    {
+        drd_encoded_gfx_frame_ref(found);
+    }
+    g_mutex_unlock(&self->gfx_keyframe_lock);
+    return found;
+}
+
+/*
+ * 功能：按当前几何预留编码暂存区。
+ * 逻辑：预留上限取整帧像素字节数加 64KiB 余量，各编码器的单帧码流都不会超过它；几何变化或上限改变时重新进入预热期，
+ *       并把 RemoteFX 输出流一次扩到上限，预热期内取到的编码帧也在使用前扩到上限（见 encode_gfx_frame），
+ *       稳态下码流暂存区不再随画面内容增长。大块分配由 mmap 提供，未写入的页不占物理内存。只在编码线程调用。
+ * 参数：self 管理器；stride 当前帧行步长；geometry_changed 分析阶段报告几何变化。
+ * 外部接口：WinPR Stream_EnsureCapacity。
+ */
+static void drd_encoding_manager_presize_scratch(DrdEncodingManager *self, guint stride, gboolean geometry_changed)
+{
+    const gsize reserve = (gsize) stride * self->frame_height + DRD_GFX_SCRATCH_MIN_CAPACITY;
+    if (!geometry_changed && reserve == self->gfx_payload_reserve)
+    {
+        return;
+    }
+
+    self->gfx_payload_reserve = reserve;
+    self->gfx_warm_frames = 0;
+    if (Stream_Capacity(self->gfx_rfx_stream) < reserve)
+    {
+        Stream_EnsureCapacity(self->gfx_rfx_stream, reserve);
+        drd_encoding_manager_note_scratch_alloc(self, "rfx stream", self->gfx_warm_frames);
+    }
+}
+
+/*
+ * 功能：编码阶段：按分析结果选择编码器并把帧压缩成自包含的编码帧。
+ * 逻辑：应用码率目标后按变化比例与当前画质档位判定大变化，选择 AVC444/AVC420/Progressive/RemoteFX；
+ *       Progressive/RemoteFX 在强制关键帧、关闭差分、刷新周期到达、几何变化或无分析结果（缓存帧刷新）时
+ *       输出全帧，否则只编码分析给出的脏块；AVC 在强制关键帧时重建编码上下文（VAAPI 为请求 IDR）。
+ *       码流拷贝进编码帧并标记是否为关键帧，不在此处发送。有新画面时先作废关键帧缓存，
+ *       产出全帧关键帧则按编码存入缓存（缓存帧刷新不改变画面，其他编码的缓存仍有效）。
+ * 参数：self 管理器；settings 客户端编码能力；input 待编码帧；analysis 分析结果，NULL 表示整帧刷新；
+ *       auto_switch 自动切换编码策略；out_frame 输出编码帧；error 错误输出（无新数据时为 G_IO_ERROR_PENDING）。
+ * 外部接口：FreeRDP avc444_compress/avc420_compress/progressive_compress/rfx_compose_message；
+ *           内部 VAAPI 编码路径；GLib g_set_error_literal。
+ */
+gboolean drd_encoding_manager_encode_gfx_frame(DrdEncodingManager *self, rdpSettings *settings, DrdFrame *input,
+                                               const DrdGfxAnalysis *analysis, gboolean auto_switch,
+                                               DrdEncodedGfxFrame **out_frame, GError **error)
 {
     g_return_val_if_fail(DRD_IS_ENCODING_MANAGER(self), FALSE);
     g_return_val_if_fail(settings != NULL, FALSE);
-    g_return_val_if_fail(context != NULL, FALSE);
     g_return_val_if_fail(DRD_IS_FRAME(input), FALSE);
+    g_return_val_if_fail(out_frame != NULL, FALSE);
 
     if (!self->ready)
     {
@@ -1200,28 +1940,33 @@ gboolean drd_encoding_manager_encode_surface_gfx(DrdEncodingManager *self, rdpSe
     const gboolean gfx_progressive = freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive);
     const guint32 id = freerdp_settings_get_uint32(settings, FreeRDP_RemoteFxCodecId);
 
-    // DRD_LOG_MESSAGE("avc420 %d;avc444 %d;avc444v2 %d;remotefx %d;progressive %d",gfx_avc420,gfx_avc444,gfx_avc444v2,gfx_remotefx,gfx_remotefx);
-    RDPGFX_SURFACE_COMMAND cmd;
-    RDPGFX_START_FRAME_PDU cmd_start;
-    RDPGFX_END_FRAME_PDU cmd_end;
-
-
     self->frame_width = drd_frame_get_width(input);
     self->frame_height = drd_frame_get_height(input);
 
-
     const guint stride = drd_frame_get_stride(input);
     gsize data_size = 0;
     const guint8 *data = drd_frame_get_data(input, &data_size);
-    *h264 = FALSE;
 
-    drd_encoding_manager_prepare_gfx_diff_state(self, self->frame_width, self->frame_height, stride);
-    const guint8 *previous_frame =
-            (self->gfx_previous_frame->len == (gsize) stride * self->frame_height) ? self->gfx_previous_frame->data : NULL;
-    gboolean success = FALSE;
-    GArray *dirty_flags = g_array_sized_new(FALSE, TRUE, sizeof(gboolean), self->gfx_tiles_x * self->gfx_tiles_y);
-    const gboolean large_change = drd_encoding_manager_analyze_tiles(
-            self, data, previous_frame, stride, self->gfx_large_change_threshold, dirty_flags, NULL);
+    drd_encoding_manager_apply_rate_target(self);
+    if (analysis != NULL)
+    {
+        /* 新画面会推进编码器参考状态（即使最终没有输出），缓存的关键帧不再能被后续增量接续 */
+        drd_encoding_manager_drop_cached_keyframes(self);
+    }
+    if (analysis == NULL || analysis->geometry_changed)
+    {
+        g_atomic_int_set(&self->gfx_force_keyframe, TRUE);
+        self->gfx_progressive_rfx_frames = 0;
+    }
+    drd_encoding_manager_presize_scratch(self, stride, analysis != NULL && analysis->geometry_changed);
+
+    /* 链路拥塞或实测带宽偏低时画质档位升高，降低大变化阈值，让自动模式更早切到受码率约束的 AVC */
+    const guint quality_level = MIN(self->gfx_quality_level + (guint) g_atomic_int_get(&self->gfx_link_quality_bias),
+                                    (guint) DRD_RATE_CONTROLLER_MAX_QUALITY_LEVEL);
+    const gdouble large_change_threshold = self->gfx_large_change_threshold / (gdouble) (1u << quality_level);
+    const guint total_tiles = analysis != NULL ? analysis->tiles_x * analysis->tiles_y : 0;
+    const gboolean large_change = total_tiles > 0 &&
+                                  ((gdouble) analysis->changed_tiles / (gdouble) total_tiles) >= large_change_threshold;
     gboolean use_avc444 = FALSE;
     gboolean use_avc420 = FALSE;
     gboolean use_progressive = FALSE;
@@ -1303,101 +2048,112 @@ gboolean drd_encoding_manager_encode_surface_gfx(DrdEncodingManager *self, rdpSe
         use_remotefx = gfx_remotefx && id != 0;
     }
 
-    cmd_start.frameId = frame_id;
-    cmd_start.timestamp = drd_rdp_graphics_pipeline_build_timestamp();
-    cmd_end.frameId = cmd_start.frameId;
-    cmd.surfaceId = surface_id;
-    cmd.format = PIXEL_FORMAT_BGRX32;
-    cmd.left = 0;
-    cmd.top = 0;
-    cmd.right = cmd.left + self->frame_width;
-    cmd.bottom = cmd.top + self->frame_height;
-    cmd.width = self->frame_width;
-    cmd.height = self->frame_height;
-    gint if_error = CHANNEL_RC_OK;
+    if (use_avc444 && gfx_avc420 && g_atomic_int_get(&self->gfx_client_decode_slow))
+    {
+        /* 客户端解码吃力时 AVC444 的双路码流会进一步积压，退回单路 AVC420 */
+        use_avc444 = FALSE;
+        use_avc420 = TRUE;
+    }
+
+    g_autoptr(DrdEncodedGfxFrame) encoded = drd_encoding_manager_acquire_encoded_frame(self);
+    if (self->gfx_warm_frames < DRD_GFX_SCRATCH_WARMUP_FRAMES)
+    {
+        /* 预热期内把本帧暂存区一次扩到预留上限，稳态不再随画面内容逐步增长 */
+        drd_encoding_manager_reserve_payload(self, &encoded->payload, self->gfx_payload_reserve);
+        if (use_avc444)
+        {
+            drd_encoding_manager_reserve_payload(self, &encoded->payload_aux, self->gfx_payload_reserve);
+        }
+    }
+    /* 缓存帧刷新复用旧像素，不代表一次新的捕获，不计入捕获→发送时延 */
+    encoded->capture_time_us = analysis != NULL ? (gint64) drd_frame_get_timestamp(input) : 0;
+    RDPGFX_SURFACE_COMMAND *cmd = &encoded->cmd;
+    cmd->format = PIXEL_FORMAT_BGRX32;
+    cmd->left = 0;
+    cmd->top = 0;
+    cmd->right = cmd->left + self->frame_width;
+    cmd->bottom = cmd->top + self->frame_height;
+    cmd->width = self->frame_width;
+    cmd->height = self->frame_height;
 
     if (use_avc444)
     {
         DRD_LOG_MESSAGE("avc444 encode");
         // avc444 encode
         gint32 rc = 0;
-        RDPGFX_AVC444_BITMAP_STREAM avc444 = {0};
+        RDPGFX_AVC444_BITMAP_STREAM *avc444 = &encoded->avc444;
         RECTANGLE_16 regionRect = {0};
         BYTE version = gfx_avc444v2 ? 2 : 1;
-        *h264 = TRUE;
-        WINPR_ASSERT(cmd.left <= UINT16_MAX);
-        WINPR_ASSERT(cmd.top <= UINT16_MAX);
-        WINPR_ASSERT(cmd.right <= UINT16_MAX);
-        WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-        regionRect.left = (UINT16)cmd.left;
-        regionRect.top = (UINT16)cmd.top;
-        regionRect.right = (UINT16)cmd.right;
-        regionRect.bottom = (UINT16)cmd.bottom;
+        BYTE *main_data = NULL;
+        BYTE *aux_data = NULL;
+        WINPR_ASSERT(cmd->left <= UINT16_MAX);
+        WINPR_ASSERT(cmd->top <= UINT16_MAX);
+        WINPR_ASSERT(cmd->right <= UINT16_MAX);
+        WINPR_ASSERT(cmd->bottom <= UINT16_MAX);
+        regionRect.left = (UINT16)cmd->left;
+        regionRect.top = (UINT16)cmd->top;
+        regionRect.right = (UINT16)cmd->right;
+        regionRect.bottom = (UINT16)cmd->bottom;
 
         if (!drd_encoder_prepare(self, FREERDP_CODEC_AVC444, settings))
         {
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "failed to prepare encoder FREERDP_CODEC_AVC444");
-            goto out;
+            return FALSE;
         }
-        rc = avc444_compress(self->h264, data, cmd.format, stride, self->frame_width, self->frame_height, version, &regionRect,
-                             &avc444.LC, &avc444.bitstream[0].data, &avc444.bitstream[0].length,
-                             &avc444.bitstream[1].data, &avc444.bitstream[1].length, &avc444.bitstream[0].meta,
-                             &avc444.bitstream[1].meta);
+        /* 重建 H264 编码上下文即从 IDR 重新开始，供参考链断开的客户端恢复 */
+        const gboolean keyframe_encode = g_atomic_int_get(&self->gfx_force_keyframe);
+        if (keyframe_encode && !h264_context_reset(self->h264, self->frame_width, self->frame_height))
+        {
+            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "failed to reset h264 context for keyframe");
+            return FALSE;
+        }
+        rc = avc444_compress(self->h264, data, cmd->format, stride, self->frame_width, self->frame_height, version, &regionRect,
+                             &avc444->LC, &main_data, &avc444->bitstream[0].length,
+                             &aux_data, &avc444->bitstream[1].length, &avc444->bitstream[0].meta,
+                             &avc444->bitstream[1].meta);
         if (rc < 0)
         {
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "avc444_compress failed");
-            goto out;
+            return FALSE;
         }
         if (rc == 0)
         {
-            free_h264_metablock(&avc444.bitstream[0].meta);
-            free_h264_metablock(&avc444.bitstream[1].meta);
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PENDING, "no avc444 frame produced");
-            goto out;
-        }
-        if (rc > 0)
-        {
-            avc444.cbAvc420EncodedBitstream1 = rdpgfx_estimate_h264_avc420(&avc444.bitstream[0]);
-            cmd.codecId = gfx_avc444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
-            cmd.extra = (void *) &avc444;
-            IFCALLRET(context->SurfaceFrameCommand, if_error, context, &cmd, &cmd_start, &cmd_end);
-        }
-        free_h264_metablock(&avc444.bitstream[0].meta);
-        free_h264_metablock(&avc444.bitstream[1].meta);
-        if (if_error)
-        {
-            g_autofree gchar *err_msg = g_strdup_printf("SurfaceFrameCommand failed with error %" PRIu32 "", if_error);
-            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, err_msg);
-            goto out;
+            return FALSE;
         }
-        if (rc > 0)
+        drd_encoding_manager_assign_payload(self, &encoded->payload, main_data, avc444->bitstream[0].length);
+        drd_encoding_manager_assign_payload(self, &encoded->payload_aux, aux_data, avc444->bitstream[1].length);
+        avc444->cbAvc420EncodedBitstream1 = rdpgfx_estimate_h264_avc420(&avc444->bitstream[0]);
+        cmd->codecId = gfx_avc444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
+        encoded->encoded_bytes = (gsize) avc444->bitstream[0].length + avc444->bitstream[1].length;
+        encoded->h264 = TRUE;
+        encoded->keyframe = keyframe_encode;
+        drd_encoding_manager_register_codec_result(self, DRD_ENCODING_CODEC_CLASS_AVC, TRUE);
+        if (keyframe_encode)
         {
-            drd_encoding_manager_store_previous_frame(self, data, stride, self->frame_height);
-            drd_encoding_manager_update_tile_hashes(self, data, stride);
-            drd_encoding_manager_register_codec_result(self, DRD_ENCODING_CODEC_CLASS_AVC, TRUE);
+            g_atomic_int_set(&self->gfx_force_keyframe, FALSE);
         }
     }
     else if (use_avc420)
     {
         INT32 rc = 0;
-        RDPGFX_AVC420_BITMAP_STREAM avc420 = {0};
+        RDPGFX_AVC420_BITMAP_STREAM *avc420 = &encoded->avc420;
         RECTANGLE_16 regionRect;
-        g_autoptr(GByteArray) vaapi_bitstream = NULL;
         gboolean use_vaapi = FALSE;
-        *h264 = TRUE;
         if (!drd_encoder_prepare(self, FREERDP_CODEC_AVC420, settings))
         {
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to prepare encoder FREERDP_CODEC_AVC420");
-            goto out;
+            return FALSE;
         }
-        regionRect.left = (UINT16) cmd.left;
-        regionRect.top = (UINT16) cmd.top;
-        regionRect.right = (UINT16) cmd.right;
-        regionRect.bottom = (UINT16) cmd.bottom;
+        regionRect.left = (UINT16) cmd->left;
+        regionRect.top = (UINT16) cmd->top;
+        regionRect.right = (UINT16) cmd->right;
+        regionRect.bottom = (UINT16) cmd->bottom;
+        const gboolean keyframe_encode = g_atomic_int_get(&self->gfx_force_keyframe);
 
         if (self->h264_hw_accel)
         {
-            if (drd_vaapi_encode_avc420(self, data, stride, &regionRect, &avc420, &vaapi_bitstream, error))
+            if (drd_vaapi_encode_avc420(self, data, stride, &regionRect, keyframe_encode, encoded, error))
             {
                 DRD_LOG_MESSAGE("VAAPI avc420 encode");
                 rc = 1;
@@ -1407,7 +2163,7 @@ gboolean drd_encoding_manager_encode_surface_gfx(DrdEncodingManager *self, rdpSe
             {
                 if (error != NULL && *error != NULL && g_error_matches(*error, G_IO_ERROR, G_IO_ERROR_PENDING))
                 {
-                    goto out;
+                    return FALSE;
                 }
                 g_clear_error(error);
                 g_warning("VAAPI avc420 encode failed, fallback to software");
@@ -1416,46 +2172,34 @@ gboolean drd_encoding_manager_encode_surface_gfx(DrdEncodingManager *self, rdpSe
 
         if (!use_vaapi)
         {
-            rc = avc420_compress(self->h264, data, cmd.format, stride, self->frame_width, self->frame_height, &regionRect,
-                                 &avc420.data, &avc420.length, &avc420.meta);
+            BYTE *avc_data = NULL;
+            if (keyframe_encode && !h264_context_reset(self->h264, self->frame_width, self->frame_height))
+            {
+                g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "failed to reset h264 context for keyframe");
+                return FALSE;
+            }
+            rc = avc420_compress(self->h264, data, cmd->format, stride, self->frame_width, self->frame_height, &regionRect,
+                                 &avc_data, &avc420->length, &avc420->meta);
             if (rc < 0)
             {
                 g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "avc420_compress failed");
-                goto out;
+                return FALSE;
             }
             if (rc == 0)
             {
-                free_h264_metablock(&avc420.meta);
                 g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PENDING, "no avc420 frame produced");
-                goto out;
+                return FALSE;
             }
+            drd_encoding_manager_assign_payload(self, &encoded->payload, avc_data, avc420->length);
+            encoded->keyframe = keyframe_encode;
         }
-        /* rc > 0 means new data */
-        if (rc > 0)
-        {
-            cmd.codecId = RDPGFX_CODECID_AVC420;
-            cmd.extra = (void *) &avc420;
-
-            IFCALLRET(context->SurfaceFrameCommand, if_error, context, &cmd, &cmd_start, &cmd_end);
-        }
-        free_h264_metablock(&avc420.meta);
-
-        if (if_error)
-        {
-            g_autofree gchar *err_msg = g_strdup_printf("SurfaceFrameCommand failed with error %" PRIu32 "", if_error);
-            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, err_msg);
-            goto out;
-        }
-        if (rc > 0)
-        {
-            drd_encoding_manager_store_previous_frame(self, data, stride, self->frame_height);
-            drd_encoding_manager_update_tile_hashes(self, data, stride);
-            drd_encoding_manager_register_codec_result(self, DRD_ENCODING_CODEC_CLASS_AVC, TRUE);
-        }
-
-        if (use_vaapi)
+        cmd->codecId = RDPGFX_CODECID_AVC420;
+        encoded->encoded_bytes = avc420->length;
+        encoded->h264 = TRUE;
+        drd_encoding_manager_register_codec_result(self, DRD_ENCODING_CODEC_CLASS_AVC, TRUE);
+        if (keyframe_encode)
         {
-            g_clear_pointer(&vaapi_bitstream, g_byte_array_unref);
+            g_atomic_int_set(&self->gfx_force_keyframe, FALSE);
         }
     }
     else if (use_progressive)
@@ -1464,70 +2208,61 @@ gboolean drd_encoding_manager_encode_surface_gfx(DrdEncodingManager *self, rdpSe
         INT32 rc = 0;
         REGION16 region;
         RECTANGLE_16 regionRect;
+        BYTE *progressive_data = NULL;
+        UINT32 progressive_length = 0;
         if (!drd_encoder_prepare(self, FREERDP_CODEC_PROGRESSIVE, settings))
         {
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED,
                                 "failed to prepare encoder FREERDP_CODEC_PROGRESSIVE");
-            goto out;
+            return FALSE;
         }
 
-        WINPR_ASSERT(cmd.left <= UINT16_MAX);
-        WINPR_ASSERT(cmd.top <= UINT16_MAX);
-        WINPR_ASSERT(cmd.right <= UINT16_MAX);
-        WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
+        WINPR_ASSERT(cmd->left <= UINT16_MAX);
+        WINPR_ASSERT(cmd->top <= UINT16_MAX);
+        WINPR_ASSERT(cmd->right <= UINT16_MAX);
+        WINPR_ASSERT(cmd->bottom <= UINT16_MAX);
         WINPR_ASSERT(self->frame_width <= UINT16_MAX);
         WINPR_ASSERT(self->frame_height <= UINT16_MAX);
         const gboolean refresh_interval_reached = drd_encoding_manager_refresh_interval_reached(self);
-        const gboolean keyframe_encode = self->gfx_force_keyframe || !self->enable_diff || refresh_interval_reached;
+        const gboolean keyframe_encode =
+                g_atomic_int_get(&self->gfx_force_keyframe) || !self->enable_diff || refresh_interval_reached;
 
         region16_init(&region);
         if (keyframe_encode)
         {
             DRD_LOG_MESSAGE("frame key refresh");
-            memset(self->gfx_tile_hashes->data, 0, self->gfx_tile_hashes->len * sizeof(guint64));
-            regionRect.left = (UINT16) cmd.left;
-            regionRect.top = (UINT16) cmd.top;
-            regionRect.right = (UINT16) cmd.right;
-            regionRect.bottom = (UINT16) cmd.bottom;
+            regionRect.left = (UINT16) cmd->left;
+            regionRect.top = (UINT16) cmd->top;
+            regionRect.right = (UINT16) cmd->right;
+            regionRect.bottom = (UINT16) cmd->bottom;
             region16_union_rect(&region, &region, &regionRect);
         }
-        else if (!drd_encoding_manager_collect_dirty_region(self, dirty_flags, &region))
+        else if (!drd_encoding_manager_collect_dirty_region(self, analysis, &region))
         {
             region16_uninit(&region);
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PENDING, "not exist dirty region");
-            goto out;
+            return FALSE;
         }
-        rc = progressive_compress(self->progressive, data, stride * self->frame_height, cmd.format, self->frame_width, self->frame_height, stride, &region,
-                                  &cmd.data, &cmd.length);
+        rc = progressive_compress(self->progressive, data, stride * self->frame_height, cmd->format, self->frame_width, self->frame_height, stride, &region,
+                                  &progressive_data, &progressive_length);
         region16_uninit(&region);
         if (rc < 0)
         {
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "progressive_compress failed");
-            goto out;
+            return FALSE;
         }
-
-        /* rc > 0 means new data */
-        if (rc > 0)
+        if (rc == 0)
         {
-            cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
-
-            IFCALLRET(context->SurfaceFrameCommand, if_error, context, &cmd, &cmd_start, &cmd_end);
+            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PENDING, "no progressive frame produced");
+            return FALSE;
         }
 
-        if (if_error)
-        {
-            g_autofree gchar *err_msg = g_strdup_printf("SurfaceFrameCommand failed with error %" PRIu32 "", if_error);
-            self->gfx_force_keyframe = TRUE;
-            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, err_msg);
-            goto out;
-        }
-        if (rc > 0)
-        {
-            drd_encoding_manager_store_previous_frame(self, data, stride, self->frame_height);
-            drd_encoding_manager_update_tile_hashes(self, data, stride);
-            drd_encoding_manager_register_codec_result(self, DRD_ENCODING_CODEC_CLASS_NON_AVC, keyframe_encode);
-            self->gfx_force_keyframe = FALSE;
-        }
+        drd_encoding_manager_assign_payload(self, &encoded->payload, progressive_data, progressive_length);
+        cmd->codecId = RDPGFX_CODECID_CAPROGRESSIVE;
+        encoded->encoded_bytes = progressive_length;
+        encoded->keyframe = keyframe_encode;
+        drd_encoding_manager_register_codec_result(self, DRD_ENCODING_CODEC_CLASS_NON_AVC, keyframe_encode);
+        g_atomic_int_set(&self->gfx_force_keyframe, FALSE);
     }
     else if (use_remotefx)
     {
@@ -1540,83 +2275,163 @@ gboolean drd_encoding_manager_encode_surface_gfx(DrdEncodingManager *self, rdpSe
         {
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED,
                                 "failed to prepare encoder FREERDP_CODEC_REMOTEFX");
-            goto out;
+            return FALSE;
         }
 
-        s = Stream_New(NULL, 1024);
-        WINPR_ASSERT(s);
-
         WINPR_ASSERT(rects != NULL);
         g_array_set_size(rects, 0);
         WINPR_ASSERT(self->frame_width <= UINT16_MAX);
         WINPR_ASSERT(self->frame_height <= UINT16_MAX);
         const gboolean refresh_interval_reached = drd_encoding_manager_refresh_interval_reached(self);
-        const gboolean keyframe_encode = self->gfx_force_keyframe || !self->enable_diff || refresh_interval_reached;
+        const gboolean keyframe_encode =
+                g_atomic_int_get(&self->gfx_force_keyframe) || !self->enable_diff || refresh_interval_reached;
 
         if (keyframe_encode)
         {
-            memset(self->gfx_tile_hashes->data, 0, self->gfx_tile_hashes->len * sizeof(guint64));
             RFX_RECT full = {0, 0, (UINT16) self->frame_width, (UINT16) self->frame_height};
             g_array_append_val(rects, full);
         }
-        else if (!drd_encoding_manager_collect_dirty_rects(self, dirty_flags, rects))
+        else if (!drd_encoding_manager_collect_dirty_rects(self, analysis, rects))
         {
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PENDING, "not exist dirty region");
-            Stream_Free(s, TRUE);
-            goto out;
+            return FALSE;
         }
 
+        s = self->gfx_rfx_stream;
+        WINPR_ASSERT(s);
+        Stream_SetPosition(s, 0);
+        const size_t stream_capacity = Stream_Capacity(s);
+
         WINPR_ASSERT(rects->len <= UINT16_MAX);
         rc = rfx_compose_message(self->rfx, s, (RFX_RECT *) rects->data, rects->len, data, self->frame_width, self->frame_height, stride);
 
         if (!rc)
         {
             g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "rfx_compose_message failed");
-            Stream_Free(s, TRUE);
-            goto out;
+            return FALSE;
         }
-        /* rc > 0 means new data */
-        if (rc > 0)
+        if (Stream_Capacity(s) > stream_capacity)
         {
-            const size_t pos = Stream_GetPosition(s);
-            WINPR_ASSERT(pos <= UINT32_MAX);
-
-            cmd.codecId = RDPGFX_CODECID_CAVIDEO;
-            cmd.data = Stream_Buffer(s);
-            cmd.length = (UINT32) pos;
-
-            IFCALLRET(context->SurfaceFrameCommand, if_error, context, &cmd, &cmd_start, &cmd_end);
+            drd_encoding_manager_note_scratch_alloc(self, "rfx stream", self->gfx_warm_frames);
         }
 
-        Stream_Free(s, TRUE);
-        if (if_error)
-        {
-            g_autofree gchar *err_msg = g_strdup_printf("SurfaceFrameCommand failed with error %" PRIu32 "", if_error);
-            self->gfx_force_keyframe = TRUE;
-            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, err_msg);
-            goto out;
-        }
-        if (rc > 0)
-        {
-            drd_encoding_manager_store_previous_frame(self, data, stride, self->frame_height);
-            drd_encoding_manager_update_tile_hashes(self, data, stride);
-            drd_encoding_manager_register_codec_result(self, DRD_ENCODING_CODEC_CLASS_NON_AVC, keyframe_encode);
-            self->gfx_force_keyframe = FALSE;
-        }
+        const size_t pos = Stream_GetPosition(s);
+        WINPR_ASSERT(pos <= UINT32_MAX);
+        drd_encoding_manager_assign_payload(self, &encoded->payload, Stream_Buffer(s), pos);
+
+        cmd->codecId = RDPGFX_CODECID_CAVIDEO;
+        encoded->encoded_bytes = pos;
+        encoded->keyframe = keyframe_encode;
+        drd_encoding_manager_register_codec_result(self, DRD_ENCODING_CODEC_CLASS_NON_AVC, keyframe_encode);
+        g_atomic_int_set(&self->gfx_force_keyframe, FALSE);
     }
     else
     {
         // not reached:planar and freerdp_image_copy_no_overlap
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "No usable Rdpgfx codec negotiated");
+        return FALSE;
+    }
+
+    if (cmd->codecId != self->gfx_scratch_codec_id)
+    {
+        /* 换用编码器后码流规模不同，暂存区需要重新适应 */
+        self->gfx_scratch_codec_id = cmd->codecId;
+        self->gfx_warm_frames = 0;
+    }
+    else if (self->gfx_warm_frames < DRD_GFX_SCRATCH_WARMUP_FRAMES)
+    {
+        self->gfx_warm_frames++;
+    }
+
+    encoded->sequence = ++self->gfx_encode_sequence;
+    if (encoded->keyframe)
+    {
+        drd_encoding_manager_store_keyframe(self, encoded);
+    }
+
+    *out_frame = g_steal_pointer(&encoded);
+    return TRUE;
+}
+
+/*
+ * 功能：发送阶段：把编码帧作为一组 StartFrame/SurfaceCommand/EndFrame 提交到 Rdpgfx。
+ * 逻辑：编码帧可能被多名观看者共享，只读访问：在栈上复制 Surface 命令与 AVC 码流描述，填入本会话的 surface、
+ *       帧序号与按源帧捕获时刻生成的时间戳后调用 SurfaceFrameCommand；失败时客户端参考链已断，由调用方按观看者恢复
+ *       （优先取关键帧缓存，未命中再强制关键帧），不在此处影响其他观看者。
+ * 参数：self 管理器；context Rdpgfx 上下文；surface_id 目标 surface；frame_id 帧序号；frame 编码帧；error 错误输出。
+ * 外部接口：FreeRDP RdpgfxServerContext::SurfaceFrameCommand；drd_timestamp_rdpgfx_from_monotonic。
+ */
+gboolean drd_encoding_manager_submit_gfx_frame(DrdEncodingManager *self, RdpgfxServerContext *context,
+                                               guint16 surface_id, guint32 frame_id, const DrdEncodedGfxFrame *frame,
+                                               GError **error)
+{
+    g_return_val_if_fail(DRD_IS_ENCODING_MANAGER(self), FALSE);
+    g_return_val_if_fail(context != NULL, FALSE);
+    g_return_val_if_fail(frame != NULL, FALSE);
+
+    RDPGFX_START_FRAME_PDU cmd_start;
+    RDPGFX_END_FRAME_PDU cmd_end;
+    RDPGFX_SURFACE_COMMAND cmd = frame->cmd;
+    RDPGFX_AVC420_BITMAP_STREAM avc420;
+    RDPGFX_AVC444_BITMAP_STREAM avc444;
+    gint if_error = CHANNEL_RC_OK;
+
+    cmd_start.frameId = frame_id;
+    /* 时间戳反映像素捕获时刻，客户端据此分析的时延才有意义；缓存帧刷新取当前时刻 */
+    const gint64 capture_time = frame->capture_time_us > 0 ? frame->capture_time_us : g_get_monotonic_time();
+    cmd_start.timestamp = drd_timestamp_rdpgfx_from_monotonic(capture_time);
+    cmd_end.frameId = cmd_start.frameId;
+    cmd.surfaceId = surface_id;
+
+    switch (cmd.codecId)
+    {
+        case RDPGFX_CODECID_AVC444:
+        case RDPGFX_CODECID_AVC444v2:
+            avc444 = frame->avc444;
+            avc444.bitstream[0].data = frame->payload.len > 0 ? frame->payload.data : NULL;
+            avc444.bitstream[1].data = frame->payload_aux.len > 0 ? frame->payload_aux.data : NULL;
+            cmd.extra = &avc444;
+            break;
+        case RDPGFX_CODECID_AVC420:
+            avc420 = frame->avc420;
+            avc420.data = frame->payload.len > 0 ? frame->payload.data : NULL;
+            cmd.extra = &avc420;
+            break;
+        default:
+            cmd.data = frame->payload.len > 0 ? frame->payload.data : NULL;
+            cmd.length = (UINT32) frame->payload.len;
+            break;
     }
-    success = TRUE;
 
-out:
-    if (dirty_flags != NULL)
+    IFCALLRET(context->SurfaceFrameCommand, if_error, context, &cmd, &cmd_start, &cmd_end);
+    if (if_error)
     {
-        g_array_free(dirty_flags, TRUE);
+        g_autofree gchar *err_msg = g_strdup_printf("SurfaceFrameCommand failed with error %" PRIu32 "", if_error);
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, err_msg);
+        return FALSE;
     }
 
-    return success;
+    return TRUE;
+}
+
+/*
+ * 功能：登记一帧已成功发送，驱动码率控制闭环。
+ * 逻辑：把帧序号与负载大小交给码率控制器并记录最近编码字节数；多观看者共享编码时只由主观看者调用，
+ *       避免不同会话的帧序号混入同一个在途表。
+ * 参数：self 管理器；frame_id 帧序号；frame 已提交的编码帧。
+ * 外部接口：drd_rate_controller_on_frame_sent；GLib g_get_monotonic_time。
+ */
+void drd_encoding_manager_note_frame_sent(DrdEncodingManager *self, guint32 frame_id, const DrdEncodedGfxFrame *frame)
+{
+    g_return_if_fail(DRD_IS_ENCODING_MANAGER(self));
+    g_return_if_fail(frame != NULL);
+
+    if (frame->encoded_bytes > 0)
+    {
+        drd_rate_controller_on_frame_sent(self->rate_controller, frame_id, frame->encoded_bytes,
+                                          g_get_monotonic_time());
+    }
+    self->gfx_last_encoded_bytes = frame->encoded_bytes;
 }
 
 /*
@@ -1653,5 +2468,5 @@ gboolean drd_encoding_manager_encode_surface_bit(DrdEncodingManager *self, rdpCo
 void drd_encoding_manager_force_keyframe(DrdEncodingManager *self)
 {
     g_return_if_fail(DRD_IS_ENCODING_MANAGER(self));
-    self->gfx_force_keyframe = TRUE;
+    g_atomic_int_set(&self->gfx_force_keyframe, TRUE);
 }
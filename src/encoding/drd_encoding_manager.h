@@ -6,7 +6,9 @@
 #include <freerdp/server/rdpgfx.h>
 
 #include "core/drd_encoding_options.h"
+#include "utils/drd_dirty_map.h"
 #include "utils/drd_frame.h"
+#include "utils/drd_recycle_pool.h"
 
 G_BEGIN_DECLS
 
@@ -20,6 +22,42 @@ typedef enum
     DRD_ENCODING_CODEC_CLASS_NON_AVC
 } DrdEncodingCodecClass;
 
+/*
+ * 分析阶段输出：一帧相对上一基线的 tile 脏块分布（tile 边长可配置）。几何信息随结果携带，
+ * 编码阶段据此收集脏区域而无需访问分析线程持有的差分状态。
+ */
+typedef struct
+{
+    DrdFrame *frame;           /* 被分析的捕获帧（持有引用） */
+    DrdDirtyMap *dirty_map;    /* 每个 tile 一位的脏块位图 */
+    guint width;
+    guint height;
+    guint stride;
+    guint tile_size;           /* tile 边长（像素） */
+    guint tiles_x;
+    guint tiles_y;
+    guint changed_tiles;
+    gboolean geometry_changed; /* 分辨率/stride 变化，编码阶段须输出关键帧 */
+    DrdRecyclePool *pool;      /* 来源回收池（持有引用），释放时归还 */
+} DrdGfxAnalysis;
+
+/* 编码阶段输出：自包含的一帧 Rdpgfx Surface 命令，可由发送阶段在其他线程提交；引用计数，编码完成后只读 */
+typedef struct _DrdEncodedGfxFrame DrdEncodedGfxFrame;
+
+void drd_gfx_analysis_free(DrdGfxAnalysis *analysis);
+void drd_gfx_analysis_merge(DrdGfxAnalysis *newer, const DrdGfxAnalysis *older);
+
+DrdEncodedGfxFrame *drd_encoded_gfx_frame_ref(DrdEncodedGfxFrame *frame);
+void drd_encoded_gfx_frame_unref(DrdEncodedGfxFrame *frame);
+gsize drd_encoded_gfx_frame_get_size(const DrdEncodedGfxFrame *frame);
+gboolean drd_encoded_gfx_frame_is_h264(const DrdEncodedGfxFrame *frame);
+gboolean drd_encoded_gfx_frame_is_keyframe(const DrdEncodedGfxFrame *frame);
+gint64 drd_encoded_gfx_frame_get_capture_time(const DrdEncodedGfxFrame *frame);
+guint64 drd_encoded_gfx_frame_get_sequence(const DrdEncodedGfxFrame *frame);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdGfxAnalysis, drd_gfx_analysis_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdEncodedGfxFrame, drd_encoded_gfx_frame_unref)
+
 DrdEncodingManager *drd_encoding_manager_new(void);
 gboolean drd_encoding_manager_prepare(DrdEncodingManager *self,
                                        const DrdEncodingOptions *options,
@@ -29,23 +67,26 @@ gboolean drd_encoding_manager_refresh_interval_reached( DrdEncodingManager *self
 gboolean drd_encoding_manager_has_avc_to_non_avc_transition( DrdEncodingManager *self);
 guint drd_encoding_manager_get_refresh_timeout_ms( DrdEncodingManager *self);
 
-gboolean drd_encoding_manager_encode_surface_gfx(DrdEncodingManager *self,
-                                                 rdpSettings *settings,
-                                                 RdpgfxServerContext *context,
-                                                 guint16 surface_id,
-                                                 DrdFrame *input,
-                                                 guint32 frame_id,
-                                                 gboolean *h264,
-                                                 gboolean auto_switch,
-                                                 GError **error);
-gboolean drd_encoding_manager_encode_cached_frame_gfx(DrdEncodingManager *self,
-                                                     rdpSettings *settings,
-                                                     RdpgfxServerContext *context,
-                                                     guint16 surface_id,
-                                                     guint32 frame_id,
-                                                     gboolean *h264,
-                                                     gboolean auto_switch,
-                                                     GError **error);
+gboolean drd_encoding_manager_analyze_gfx_frame(DrdEncodingManager *self,
+                                                DrdFrame *input,
+                                                DrdGfxAnalysis **out_analysis,
+                                                GError **error);
+gboolean drd_encoding_manager_encode_gfx_frame(DrdEncodingManager *self,
+                                               rdpSettings *settings,
+                                               DrdFrame *input,
+                                               const DrdGfxAnalysis *analysis,
+                                               gboolean auto_switch,
+                                               DrdEncodedGfxFrame **out_frame,
+                                               GError **error);
+gboolean drd_encoding_manager_submit_gfx_frame(DrdEncodingManager *self,
+                                               RdpgfxServerContext *context,
+                                               guint16 surface_id,
+                                               guint32 frame_id,
+                                               const DrdEncodedGfxFrame *frame,
+                                               GError **error);
+void drd_encoding_manager_note_frame_sent(DrdEncodingManager *self,
+                                          guint32 frame_id,
+                                          const DrdEncodedGfxFrame *frame);
 gboolean drd_encoding_manager_encode_surface_bit(DrdEncodingManager *self,
                                                  rdpContext *context,
                                                  DrdFrame *input,
@@ -55,6 +96,21 @@ gboolean drd_encoding_manager_encode_surface_bit(DrdEncodingManager *self,
 
 
 void drd_encoding_manager_force_keyframe(DrdEncodingManager *self);
+/*
+ * 关键帧缓存只保存最近一次编码的全帧关键帧，任何新画面进入编码即作废（不保留其后的增量链）：
+ * 静止或低变化画面下才有命中，画面持续变化时几乎总是为空，加入与恢复退回强制关键帧。
+ */
+DrdEncodedGfxFrame *drd_encoding_manager_lookup_keyframe(DrdEncodingManager *self, DrdEncodingCodecClass codec_class);
+void drd_encoding_manager_drop_cached_keyframes(DrdEncodingManager *self);
+void drd_encoding_manager_notify_frame_ack(DrdEncodingManager *self, guint32 frame_id, guint32 queue_depth);
+gdouble drd_encoding_manager_get_change_ratio(DrdEncodingManager *self);
+gsize drd_encoding_manager_get_last_encoded_bytes(DrdEncodingManager *self);
+void drd_encoding_manager_get_scratch_alloc_stats(DrdEncodingManager *self, guint *out_total, guint *out_steady);
+void drd_encoding_manager_update_network_estimate(DrdEncodingManager *self,
+                                                  guint64 bandwidth_bps,
+                                                  gint64 rtt_us,
+                                                  gdouble loss_ratio);
+void drd_encoding_manager_set_client_decode_time(DrdEncodingManager *self, gint64 decode_p95_us);
 void drd_encoding_manager_register_codec_result(DrdEncodingManager *self,
                                                 DrdEncodingCodecClass codec_class,
                                                 gboolean keyframe_encode);
@@ -0,0 +1,437 @@
+#include "encoding/drd_rate_controller.h"
+
+#include <string.h>
+
+#define DRD_RATE_CONTROLLER_HISTORY 32
+
+typedef struct
+{
+    guint32 frame_id;
+    gint64 sent_us;
+    gsize bytes;
+    gboolean in_flight;
+} DrdRateSample;
+
+struct _DrdRateController
+{
+    GMutex lock;
+
+    gboolean enabled;
+    guint min_bitrate;
+    guint max_bitrate;
+    guint min_qp;
+    guint max_qp;
+    gint64 interval_us;
+    gint64 target_latency_us;
+
+    DrdRateTarget target;
+
+    DrdRateSample samples[DRD_RATE_CONTROLLER_HISTORY];
+    gdouble latency_ewma_us;
+    guint64 latency_samples;
+    guint32 window_max_queue_depth;
+    guint64 window_sent_bytes;
+    guint64 window_acked_bytes;
+    guint window_acks;
+    gint64 last_update_us;
+
+    guint64 link_bitrate; /* 网络探测得到的可用码率上限，0 表示未知 */
+    gdouble link_loss_ratio;
+};
+
+/*
+ * 功能：把数值限制在 [min, max] 范围内。
+ * 逻辑：先与下界取大，再与上界取小；上界小于下界时以下界为准。
+ * 参数：value 原值；min/max 边界。
+ * 外部接口：无。
+ */
+static guint
+drd_rate_controller_clamp(gint64 value, guint min, guint max)
+{
+    if (max < min)
+    {
+        max = min;
+    }
+    if (value < (gint64) min)
+    {
+        return min;
+    }
+    if (value > (gint64) max)
+    {
+        return max;
+    }
+    return (guint) value;
+}
+
+/*
+ * 功能：清空统计窗口与在途帧记录。
+ * 逻辑：在持锁状态下清零 ACK 时延估计、queueDepth 峰值、字节计数与在途环形记录。
+ * 参数：self 控制器。
+ * 外部接口：C 标准库 memset。
+ */
+static void
+drd_rate_controller_clear_window_locked(DrdRateController *self)
+{
+    memset(self->samples, 0, sizeof(self->samples));
+    self->latency_ewma_us = 0.0;
+    self->latency_samples = 0;
+    self->window_max_queue_depth = 0;
+    self->window_sent_bytes = 0;
+    self->window_acked_bytes = 0;
+    self->window_acks = 0;
+    self->last_update_us = 0;
+}
+
+/*
+ * 功能：创建码率控制器。
+ * 逻辑：分配结构并初始化互斥量，按默认边界填充初始目标值。
+ * 参数：无。
+ * 外部接口：GLib g_new0/g_mutex_init。
+ */
+DrdRateController *
+drd_rate_controller_new(void)
+{
+    DrdRateController *self = g_new0(DrdRateController, 1);
+    g_mutex_init(&self->lock);
+
+    DrdEncodingOptions defaults = {0};
+    defaults.h264_bitrate = DRD_H264_DEFAULT_BITRATE;
+    defaults.h264_qp = DRD_H264_DEFAULT_QP;
+    defaults.abr_enable = DRD_ABR_DEFAULT_ENABLE;
+    defaults.abr_min_bitrate = DRD_ABR_DEFAULT_MIN_BITRATE;
+    defaults.abr_max_bitrate = DRD_ABR_DEFAULT_MAX_BITRATE;
+    defaults.abr_min_qp = DRD_ABR_DEFAULT_MIN_QP;
+    defaults.abr_max_qp = DRD_ABR_DEFAULT_MAX_QP;
+    defaults.abr_interval_ms = DRD_ABR_DEFAULT_INTERVAL_MS;
+    defaults.abr_target_latency_ms = DRD_ABR_DEFAULT_TARGET_LATENCY_MS;
+    drd_rate_controller_configure(self, &defaults);
+    return self;
+}
+
+/*
+ * 功能：释放码率控制器。
+ * 逻辑：清理互斥量后释放结构体。
+ * 参数：self 控制器，可为空。
+ * 外部接口：GLib g_mutex_clear/g_free。
+ */
+void
+drd_rate_controller_free(DrdRateController *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    g_mutex_clear(&self->lock);
+    g_free(self);
+}
+
+/*
+ * 功能：按编码配置写入调节边界与初始目标。
+ * 逻辑：读取 abr_* 边界并校正上下界顺序，以 h264_bitrate/h264_qp 作为起始目标并夹在边界内，
+ *       同时清空统计窗口。
+ * 参数：self 控制器；options 编码配置。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_rate_controller_configure(DrdRateController *self, const DrdEncodingOptions *options)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(options != NULL);
+
+    g_mutex_lock(&self->lock);
+    self->enabled = options->abr_enable;
+    self->min_bitrate = options->abr_min_bitrate > 0 ? options->abr_min_bitrate : DRD_ABR_DEFAULT_MIN_BITRATE;
+    self->max_bitrate = MAX(options->abr_max_bitrate, self->min_bitrate);
+    self->min_qp = options->abr_min_qp > 0 ? options->abr_min_qp : DRD_ABR_DEFAULT_MIN_QP;
+    self->max_qp = MAX(options->abr_max_qp, self->min_qp);
+    self->interval_us = (gint64) MAX(options->abr_interval_ms, 50u) * G_TIME_SPAN_MILLISECOND;
+    self->target_latency_us = (gint64) MAX(options->abr_target_latency_ms, 10u) * G_TIME_SPAN_MILLISECOND;
+
+    if (self->enabled)
+    {
+        self->target.bitrate = drd_rate_controller_clamp(options->h264_bitrate, self->min_bitrate, self->max_bitrate);
+        self->target.qp = drd_rate_controller_clamp(options->h264_qp, self->min_qp, self->max_qp);
+    }
+    else
+    {
+        self->target.bitrate = options->h264_bitrate;
+        self->target.qp = options->h264_qp;
+    }
+    self->target.quality_level = 0;
+    drd_rate_controller_clear_window_locked(self);
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：重置统计窗口与画质档位，保留当前码率目标。
+ * 逻辑：清空在途帧与时延估计，画质档位归零；用于 surface 重建或编码器重置。
+ * 参数：self 控制器。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_rate_controller_reset(DrdRateController *self)
+{
+    g_return_if_fail(self != NULL);
+
+    g_mutex_lock(&self->lock);
+    self->target.quality_level = 0;
+    drd_rate_controller_clear_window_locked(self);
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：记录一帧已提交到 Rdpgfx 的编码结果。
+ * 逻辑：按 frame_id 取模写入环形在途记录，保存提交时间与编码字节数，并累计窗口发送字节。
+ * 参数：self 控制器；frame_id 帧序号；encoded_bytes 编码字节数；now_us 单调时钟。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_rate_controller_on_frame_sent(DrdRateController *self,
+                                  guint32 frame_id,
+                                  gsize encoded_bytes,
+                                  gint64 now_us)
+{
+    g_return_if_fail(self != NULL);
+
+    g_mutex_lock(&self->lock);
+    DrdRateSample *sample = &self->samples[frame_id % DRD_RATE_CONTROLLER_HISTORY];
+    sample->frame_id = frame_id;
+    sample->sent_us = now_us;
+    sample->bytes = encoded_bytes;
+    sample->in_flight = TRUE;
+    self->window_sent_bytes += encoded_bytes;
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：消费客户端 FrameAcknowledge，更新往返时延与队列深度。
+ * 逻辑：匹配在途记录得到提交→ACK 时延并做 EWMA 平滑（alpha=0.2），累计窗口已确认字节；
+ *       queueDepth 取窗口内峰值供下一次调节使用。
+ * 参数：self 控制器；frame_id ACK 的帧序号；queue_depth 客户端未解码帧数；now_us 单调时钟。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_rate_controller_on_frame_ack(DrdRateController *self,
+                                 guint32 frame_id,
+                                 guint32 queue_depth,
+                                 gint64 now_us)
+{
+    g_return_if_fail(self != NULL);
+
+    g_mutex_lock(&self->lock);
+    DrdRateSample *sample = &self->samples[frame_id % DRD_RATE_CONTROLLER_HISTORY];
+    if (sample->in_flight && sample->frame_id == frame_id && now_us >= sample->sent_us)
+    {
+        const gdouble latency_us = (gdouble) (now_us - sample->sent_us);
+        if (self->latency_samples == 0)
+        {
+            self->latency_ewma_us = latency_us;
+        }
+        else
+        {
+            self->latency_ewma_us = self->latency_ewma_us * 0.8 + latency_us * 0.2;
+        }
+        self->latency_samples++;
+        self->window_acked_bytes += sample->bytes;
+        self->window_acks++;
+        sample->in_flight = FALSE;
+    }
+    self->window_max_queue_depth = MAX(self->window_max_queue_depth, queue_depth);
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：写入网络自动探测得到的链路估计。
+ * 逻辑：以实测带宽的 80% 作为拥塞时的视频码率上限（预留协议与输入开销），同时记录探测丢包率；带宽为 0 表示未知。
+ * 参数：self 控制器；bandwidth_bps 平滑带宽；loss_ratio 探测丢包率。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_rate_controller_set_link_estimate(DrdRateController *self, guint64 bandwidth_bps, gdouble loss_ratio)
+{
+    g_return_if_fail(self != NULL);
+
+    g_mutex_lock(&self->lock);
+    self->link_bitrate = bandwidth_bps * 4 / 5;
+    self->link_loss_ratio = loss_ratio;
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：计算最早一帧在途记录的等待时长。
+ * 逻辑：遍历环形记录，取仍在途且提交时间最早的一帧，返回其距 now_us 的时长。
+ * 参数：self 控制器（需持锁）；now_us 单调时钟。
+ * 外部接口：无。
+ */
+static gint64
+drd_rate_controller_oldest_in_flight_locked(DrdRateController *self, gint64 now_us)
+{
+    gint64 oldest = 0;
+
+    for (guint i = 0; i < DRD_RATE_CONTROLLER_HISTORY; i++)
+    {
+        const DrdRateSample *sample = &self->samples[i];
+        if (sample->in_flight && now_us > sample->sent_us)
+        {
+            oldest = MAX(oldest, now_us - sample->sent_us);
+        }
+    }
+
+    return oldest;
+}
+
+/*
+ * 功能：周期性执行一次码率/QP/画质档位调节。
+ * 逻辑：未到 abr_interval_ms 时直接返回；否则根据平滑时延、queueDepth 峰值与在途帧时长判定拥塞程度：
+ *       严重拥塞时码率乘 0.7 并不超过实测 ACK 吞吐、QP+3、画质档位升一级；轻度拥塞码率乘 0.9、QP+1；
+ *       链路空闲（时延低于目标一半且客户端无积压）时码率加性增长、QP-1、画质档位降一级；
+ *       编码输出持续超出目标码率时额外提高 QP；探测丢包率超过 2% 至少按轻度拥塞处理，拥塞时码率不超过实测链路上限。
+ *       结果夹在配置边界内并清空统计窗口。
+ * 参数：self 控制器；now_us 单调时钟；out_target 输出当前目标（可为空）。
+ * 外部接口：GLib g_mutex_lock/unlock。返回值表示目标是否发生变化。
+ */
+gboolean
+drd_rate_controller_update(DrdRateController *self, gint64 now_us, DrdRateTarget *out_target)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+
+    gboolean changed = FALSE;
+
+    g_mutex_lock(&self->lock);
+    if (!self->enabled)
+    {
+        goto out;
+    }
+
+    if (self->last_update_us == 0)
+    {
+        self->last_update_us = now_us;
+        goto out;
+    }
+
+    const gint64 elapsed_us = now_us - self->last_update_us;
+    if (elapsed_us < self->interval_us)
+    {
+        goto out;
+    }
+
+    if (self->window_sent_bytes == 0 && self->window_acks == 0)
+    {
+        /* 画面静止时没有样本，保持当前目标，避免用陈旧时延持续降档 */
+        self->last_update_us = now_us;
+        self->window_max_queue_depth = 0;
+        goto out;
+    }
+
+    const gdouble latency_us = self->latency_ewma_us;
+    const gint64 oldest_in_flight_us = drd_rate_controller_oldest_in_flight_locked(self, now_us);
+    const gdouble sent_bps = (gdouble) self->window_sent_bytes * 8.0 * G_USEC_PER_SEC / (gdouble) elapsed_us;
+    const gdouble acked_bps = (gdouble) self->window_acked_bytes * 8.0 * G_USEC_PER_SEC / (gdouble) elapsed_us;
+    const gdouble target_latency_us = (gdouble) self->target_latency_us;
+
+    const gboolean severe = (self->latency_samples > 0 && latency_us > target_latency_us * 2.0) ||
+                            self->window_max_queue_depth >= 3 ||
+                            oldest_in_flight_us > self->target_latency_us * 4;
+    const gboolean mild = (self->latency_samples > 0 && latency_us > target_latency_us) ||
+                          self->window_max_queue_depth >= 2 || self->link_loss_ratio > 0.02;
+    const gboolean idle = self->window_acks > 0 && latency_us < target_latency_us / 2.0 &&
+                          self->window_max_queue_depth == 0;
+
+    gint64 bitrate = self->target.bitrate;
+    gint64 qp = self->target.qp;
+    guint quality_level = self->target.quality_level;
+
+    if (severe)
+    {
+        bitrate = (gint64) ((gdouble) bitrate * 0.7);
+        if (acked_bps > 0.0)
+        {
+            bitrate = MIN(bitrate, (gint64) (acked_bps * 0.9));
+        }
+        qp += 3;
+        quality_level = MIN(quality_level + 1, DRD_RATE_CONTROLLER_MAX_QUALITY_LEVEL);
+    }
+    else if (mild)
+    {
+        bitrate = (gint64) ((gdouble) bitrate * 0.9);
+        qp += 1;
+    }
+    else if (idle)
+    {
+        bitrate += MAX(self->max_bitrate / 20, 100000u);
+        qp -= 1;
+        if (quality_level > 0)
+        {
+            quality_level--;
+        }
+    }
+
+    if (!idle && sent_bps > (gdouble) self->target.bitrate * 1.5)
+    {
+        qp += 1;
+    }
+
+    if ((severe || mild) && self->link_bitrate > 0)
+    {
+        /* 连续探测只统计实际业务流量，仅在拥塞（链路饱和）时把它当作容量上限 */
+        bitrate = MIN(bitrate, (gint64) self->link_bitrate);
+    }
+
+    const guint new_bitrate = drd_rate_controller_clamp(bitrate, self->min_bitrate, self->max_bitrate);
+    const guint new_qp = drd_rate_controller_clamp(qp, self->min_qp, self->max_qp);
+
+    changed = new_bitrate != self->target.bitrate || new_qp != self->target.qp ||
+              quality_level != self->target.quality_level;
+    self->target.bitrate = new_bitrate;
+    self->target.qp = new_qp;
+    self->target.quality_level = quality_level;
+
+    self->last_update_us = now_us;
+    self->window_max_queue_depth = 0;
+    self->window_sent_bytes = 0;
+    self->window_acked_bytes = 0;
+    self->window_acks = 0;
+
+out:
+    if (out_target != NULL)
+    {
+        *out_target = self->target;
+    }
+    g_mutex_unlock(&self->lock);
+    return changed;
+}
+
+/*
+ * 功能：读取当前调节目标。
+ * 逻辑：持锁复制 target。
+ * 参数：self 控制器；out_target 输出。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_rate_controller_get_target(DrdRateController *self, DrdRateTarget *out_target)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(out_target != NULL);
+
+    g_mutex_lock(&self->lock);
+    *out_target = self->target;
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：查询码率自适应是否启用。
+ * 逻辑：持锁读取 enabled。
+ * 参数：self 控制器。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+gboolean
+drd_rate_controller_is_enabled(DrdRateController *self)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+
+    g_mutex_lock(&self->lock);
+    const gboolean enabled = self->enabled;
+    g_mutex_unlock(&self->lock);
+    return enabled;
+}
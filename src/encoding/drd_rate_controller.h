@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glib.h>
+
+#include "core/drd_encoding_options.h"
+
+G_BEGIN_DECLS
+
+/*
+ * 闭环码率控制器：以 FrameAcknowledge 往返时延、客户端 queueDepth 与每帧编码字节数为输入，
+ * 每隔 abr_interval_ms 在配置边界内调节 H264 码率/QP 与非 AVC 画质档位。
+ */
+typedef struct _DrdRateController DrdRateController;
+
+typedef struct
+{
+    guint bitrate;
+    guint qp;
+    guint quality_level; /* 0 表示链路良好，数值越大越倾向于省带宽 */
+} DrdRateTarget;
+
+#define DRD_RATE_CONTROLLER_MAX_QUALITY_LEVEL 3
+
+DrdRateController *drd_rate_controller_new(void);
+void drd_rate_controller_free(DrdRateController *self);
+
+void drd_rate_controller_configure(DrdRateController *self, const DrdEncodingOptions *options);
+void drd_rate_controller_reset(DrdRateController *self);
+
+void drd_rate_controller_on_frame_sent(DrdRateController *self,
+                                       guint32 frame_id,
+                                       gsize encoded_bytes,
+                                       gint64 now_us);
+void drd_rate_controller_on_frame_ack(DrdRateController *self,
+                                      guint32 frame_id,
+                                      guint32 queue_depth,
+                                      gint64 now_us);
+
+void drd_rate_controller_set_link_estimate(DrdRateController *self, guint64 bandwidth_bps, gdouble loss_ratio);
+
+gboolean drd_rate_controller_update(DrdRateController *self, gint64 now_us, DrdRateTarget *out_target);
+void drd_rate_controller_get_target(DrdRateController *self, DrdRateTarget *out_target);
+gboolean drd_rate_controller_is_enabled(DrdRateController *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdRateController, drd_rate_controller_free)
+
+G_END_DECLS
@@ -0,0 +1,402 @@
+#include "security/drd_auth_pool.h"
+
+#include <string.h>
+
+#include "utils/drd_log.h"
+
+/* PAM 时延直方图各桶上界（毫秒），最后一桶不设上界 */
+static const guint drd_auth_pool_bucket_bounds_ms[DRD_AUTH_POOL_LATENCY_BUCKETS] = {
+    50, 100, 250, 500, 1000, 2500, 5000, G_MAXUINT
+};
+
+struct _DrdAuthPool
+{
+    GThreadPool *pool;
+    GMutex lock;              /* 保护以下计数与统计 */
+    guint max_workers;
+    guint max_queued;
+    gint64 timeout_us;        /* 受理到进入 PAM 的上限，也是请求方等待结果的上限 */
+    guint running;
+    guint queued;
+    gboolean stopping;
+    DrdAuthPoolStats stats;
+};
+
+struct _DrdAuthRequest
+{
+    gint ref_count;           /* 请求方与认证线程各持一份 */
+    GMutex lock;              /* 串行化完成回调与 release，release 返回后回调不再发生 */
+    gboolean released;
+    gchar *pam_service;
+    gchar *username;
+    gchar *domain;
+    gchar *password;
+    gchar *remote_host;
+    DrdAuthPoolCallback callback;
+    gpointer user_data;
+    gint64 submitted_us;
+    gint64 deadline_us;
+};
+
+/*
+ * 功能：覆盖并释放敏感字符串。
+ * 逻辑：若字符串存在则用 0 覆盖后释放，并将指针置空。
+ * 参数：value 字符串指针地址。
+ * 外部接口：C 库 memset/strlen，GLib g_free。
+ */
+static void
+drd_auth_pool_scrub_string(gchar **value)
+{
+    if (*value == NULL)
+    {
+        return;
+    }
+    memset(*value, 0, strlen(*value));
+    g_clear_pointer(value, g_free);
+}
+
+/*
+ * 功能：释放请求的一份引用。
+ * 逻辑：最后一份引用释放时清除密码并释放全部字段。
+ * 参数：request 认证请求。
+ * 外部接口：GLib g_atomic_int_dec_and_test/g_mutex_clear。
+ */
+static void
+drd_auth_request_unref(DrdAuthRequest *request)
+{
+    if (!g_atomic_int_dec_and_test(&request->ref_count))
+    {
+        return;
+    }
+
+    drd_auth_pool_scrub_string(&request->password);
+    g_free(request->pam_service);
+    g_free(request->username);
+    g_free(request->domain);
+    g_free(request->remote_host);
+    g_mutex_clear(&request->lock);
+    g_free(request);
+}
+
+/*
+ * 功能：把一次 PAM 耗时计入直方图。
+ * 逻辑：须持 lock 调用；找到第一个上界不小于耗时的桶并累加，同时刷新最大值。
+ * 参数：self 线程池；latency_us PAM 耗时。
+ * 外部接口：无。
+ */
+static void
+drd_auth_pool_record_latency_locked(DrdAuthPool *self, gint64 latency_us)
+{
+    const gint64 latency_ms = latency_us / 1000;
+    guint bucket = 0;
+    while (bucket + 1 < DRD_AUTH_POOL_LATENCY_BUCKETS &&
+           latency_ms >= (gint64) drd_auth_pool_bucket_bounds_ms[bucket])
+    {
+        bucket++;
+    }
+    self->stats.latency_buckets[bucket]++;
+    self->stats.max_latency_us = MAX(self->stats.max_latency_us, latency_us);
+}
+
+/*
+ * 功能：把直方图格式化为单行文本。
+ * 逻辑：按桶输出“<上界ms:次数”，最后一桶输出“>=上一上界ms:次数”。
+ * 参数：stats 统计快照。
+ * 外部接口：GLib GString。
+ * 返回：新分配的字符串。
+ */
+static gchar *
+drd_auth_pool_format_histogram(const DrdAuthPoolStats *stats)
+{
+    GString *text = g_string_new(NULL);
+    for (guint i = 0; i < DRD_AUTH_POOL_LATENCY_BUCKETS; ++i)
+    {
+        if (i + 1 < DRD_AUTH_POOL_LATENCY_BUCKETS)
+        {
+            g_string_append_printf(text, "%s<%ums:%" G_GUINT64_FORMAT,
+                                   i > 0 ? " " : "",
+                                   drd_auth_pool_bucket_bounds_ms[i],
+                                   stats->latency_buckets[i]);
+        }
+        else
+        {
+            g_string_append_printf(text, " >=%ums:%" G_GUINT64_FORMAT,
+                                   drd_auth_pool_bucket_bounds_ms[i - 1],
+                                   stats->latency_buckets[i]);
+        }
+    }
+    return g_string_free(text, FALSE);
+}
+
+/*
+ * 功能：认证线程入口，执行一次 PAM 会话并交付结果。
+ * 逻辑：请求方已放弃的请求直接跳过；线程池停止或排队已超时的请求不进入 PAM，以错误交付；
+ *       其余调用 drd_local_session_new 并计入时延直方图。持请求锁交付结果，请求方已放弃时在本线程关闭本地会话。
+ * 参数：data 认证请求；user_data 线程池。
+ * 外部接口：drd_local_session_new/drd_local_session_close；日志 DRD_LOG_MESSAGE。
+ */
+static void
+drd_auth_pool_worker(gpointer data, gpointer user_data)
+{
+    DrdAuthRequest *request = data;
+    DrdAuthPool *self = user_data;
+    const gint64 start = g_get_monotonic_time();
+
+    g_mutex_lock(&self->lock);
+    self->queued--;
+    const gboolean stopping = self->stopping;
+    g_mutex_unlock(&self->lock);
+
+    g_mutex_lock(&request->lock);
+    const gboolean released = request->released;
+    g_mutex_unlock(&request->lock);
+
+    DrdLocalSession *local_session = NULL;
+    g_autoptr(GError) error = NULL;
+    gint64 latency_us = -1;
+    if (released)
+    {
+        /* 请求方已放弃，不再进入 PAM */
+    }
+    else if (stopping)
+    {
+        g_set_error_literal(&error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Authentication pool is shutting down");
+    }
+    else if (start >= request->deadline_us)
+    {
+        g_set_error(&error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                    "Waited %.1f s for an authentication worker",
+                    (start - request->submitted_us) / (gdouble) G_USEC_PER_SEC);
+    }
+    else
+    {
+        g_mutex_lock(&self->lock);
+        self->running++;
+        g_mutex_unlock(&self->lock);
+
+        local_session = drd_local_session_new(request->pam_service,
+                                              request->username,
+                                              request->domain,
+                                              request->password,
+                                              request->remote_host,
+                                              &error);
+        latency_us = g_get_monotonic_time() - start;
+
+        g_mutex_lock(&self->lock);
+        self->running--;
+        drd_auth_pool_record_latency_locked(self, latency_us);
+        g_mutex_unlock(&self->lock);
+    }
+    drd_auth_pool_scrub_string(&request->password);
+
+    const gboolean succeeded = local_session != NULL;
+    g_mutex_lock(&request->lock);
+    const gboolean delivered = !request->released;
+    if (delivered)
+    {
+        request->callback(local_session, error, request->user_data);
+        local_session = NULL;
+    }
+    g_mutex_unlock(&request->lock);
+    g_clear_pointer(&local_session, drd_local_session_close);
+
+    g_mutex_lock(&self->lock);
+    if (!delivered)
+    {
+        self->stats.abandoned++;
+    }
+    else if (succeeded)
+    {
+        self->stats.succeeded++;
+    }
+    else if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+    {
+        self->stats.timed_out++;
+    }
+    else
+    {
+        self->stats.failed++;
+    }
+    DrdAuthPoolStats snapshot = self->stats;
+    snapshot.running = self->running;
+    snapshot.queued = self->queued;
+    g_mutex_unlock(&self->lock);
+
+    if (latency_us >= 0)
+    {
+        g_autofree gchar *histogram = drd_auth_pool_format_histogram(&snapshot);
+        DRD_LOG_MESSAGE("PAM authentication for %s from %s %s in %.1f ms (queued %.1f ms), "
+                        "running=%u queued=%u abandoned=%" G_GUINT64_FORMAT ", latency %s",
+                        request->username,
+                        request->remote_host != NULL ? request->remote_host : "unknown",
+                        succeeded ? "succeeded" : (delivered ? "failed" : "abandoned"),
+                        latency_us / 1000.0,
+                        (start - request->submitted_us) / 1000.0,
+                        snapshot.running,
+                        snapshot.queued,
+                        snapshot.abandoned,
+                        histogram);
+    }
+
+    drd_auth_request_unref(request);
+}
+
+/*
+ * 功能：创建 PAM 认证线程池。
+ * 逻辑：初始化计数与锁，创建非独占的 GThreadPool，线程按需创建、空闲后回收。
+ * 参数：max_workers 并发认证上限，0 按默认值；max_queued 排队上限；timeout_ms 请求超时，0 按默认值。
+ * 外部接口：GLib g_thread_pool_new/g_mutex_init。
+ */
+DrdAuthPool *
+drd_auth_pool_new(guint max_workers, guint max_queued, guint timeout_ms)
+{
+    DrdAuthPool *self = g_new0(DrdAuthPool, 1);
+    g_mutex_init(&self->lock);
+    self->max_workers = max_workers != 0 ? max_workers : DRD_AUTH_POOL_DEFAULT_WORKERS;
+    self->max_queued = max_queued;
+    self->timeout_us = (gint64) (timeout_ms != 0 ? timeout_ms : DRD_AUTH_POOL_DEFAULT_TIMEOUT_MS) * 1000;
+    self->stats.workers = self->max_workers;
+    self->pool = g_thread_pool_new(drd_auth_pool_worker, self, (gint) self->max_workers, FALSE, NULL);
+    return self;
+}
+
+/*
+ * 功能：释放认证线程池。
+ * 逻辑：标记停止后等待线程池排空：排队中的请求不再进入 PAM、以取消错误交付，正在执行的 PAM 调用须等其返回。
+ * 参数：self 线程池，可为 NULL。
+ * 外部接口：GLib g_thread_pool_free/g_mutex_clear。
+ */
+void
+drd_auth_pool_free(DrdAuthPool *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock(&self->lock);
+    self->stopping = TRUE;
+    g_mutex_unlock(&self->lock);
+
+    g_thread_pool_free(self->pool, FALSE, TRUE);
+    g_mutex_clear(&self->lock);
+    g_free(self);
+}
+
+void
+drd_auth_pool_get_stats(DrdAuthPool *self, DrdAuthPoolStats *out_stats)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&self->lock);
+    *out_stats = self->stats;
+    out_stats->running = self->running;
+    out_stats->queued = self->queued;
+    g_mutex_unlock(&self->lock);
+}
+
+guint
+drd_auth_pool_latency_bucket_bound_ms(guint bucket)
+{
+    g_return_val_if_fail(bucket < DRD_AUTH_POOL_LATENCY_BUCKETS, G_MAXUINT);
+    return drd_auth_pool_bucket_bounds_ms[bucket];
+}
+
+/*
+ * 功能：提交一次 PAM 认证。
+ * 逻辑：排队与执行中的请求总数达到上限时拒绝；否则复制凭据、记录截止时间并投递到线程池，立即返回。
+ *       结果经 callback 在认证线程上交付。
+ * 参数：self 线程池；pam_service/username/domain/password/remote_host 同 drd_local_session_new；
+ *       callback 完成回调；user_data 回调数据；error 错误输出。
+ * 外部接口：GLib g_thread_pool_push；日志 DRD_LOG_WARNING。
+ * 返回：请求句柄，请求方用完后须调用 drd_auth_request_release；失败返回 NULL。
+ */
+DrdAuthRequest *
+drd_auth_pool_submit(DrdAuthPool *self,
+                     const gchar *pam_service,
+                     const gchar *username,
+                     const gchar *domain,
+                     const gchar *password,
+                     const gchar *remote_host,
+                     DrdAuthPoolCallback callback,
+                     gpointer user_data,
+                     GError **error)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+    g_return_val_if_fail(callback != NULL, NULL);
+
+    g_mutex_lock(&self->lock);
+    const guint pending = self->queued + self->running;
+    const gboolean admitted = !self->stopping && pending < self->max_workers + self->max_queued;
+    if (admitted)
+    {
+        self->queued++;
+    }
+    else
+    {
+        self->stats.rejected++;
+    }
+    g_mutex_unlock(&self->lock);
+
+    if (!admitted)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                    "Authentication queue is full (%u pending)", pending);
+        return NULL;
+    }
+
+    DrdAuthRequest *request = g_new0(DrdAuthRequest, 1);
+    request->ref_count = 2;
+    g_mutex_init(&request->lock);
+    request->pam_service = g_strdup(pam_service);
+    request->username = g_strdup(username);
+    request->domain = g_strdup(domain);
+    request->password = g_strdup(password);
+    request->remote_host = g_strdup(remote_host);
+    request->callback = callback;
+    request->user_data = user_data;
+    request->submitted_us = g_get_monotonic_time();
+    request->deadline_us = request->submitted_us + self->timeout_us;
+
+    g_autoptr(GError) push_error = NULL;
+    if (!g_thread_pool_push(self->pool, request, &push_error))
+    {
+        DRD_LOG_WARNING("Authentication worker unavailable, request for %s stays queued: %s",
+                        username, push_error->message);
+    }
+    return request;
+}
+
+/*
+ * 功能：判断请求是否已超过等待上限。
+ * 逻辑：与提交时记录的截止时间比较；请求方据此放弃迟迟未返回的 PAM 调用。
+ * 参数：request 认证请求。
+ * 外部接口：GLib g_get_monotonic_time。
+ */
+gboolean
+drd_auth_request_is_expired(DrdAuthRequest *request)
+{
+    g_return_val_if_fail(request != NULL, TRUE);
+    return g_get_monotonic_time() >= request->deadline_us;
+}
+
+/*
+ * 功能：请求方释放请求。
+ * 逻辑：持请求锁标记放弃，正在交付的回调完成后才返回，之后回调不会再发生；尚未完成的 PAM 结果由认证线程丢弃。
+ * 参数：request 认证请求，可为 NULL，调用后失效。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_auth_request_release(DrdAuthRequest *request)
+{
+    if (request == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock(&request->lock);
+    request->released = TRUE;
+    g_mutex_unlock(&request->lock);
+    drd_auth_request_unref(request);
+}
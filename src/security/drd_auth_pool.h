@@ -0,0 +1,61 @@
+#pragma once
+
+#include <gio/gio.h>
+
+#include "security/drd_local_session.h"
+
+G_BEGIN_DECLS
+
+/*
+ * PAM 认证线程池：TLS-only 登录的 PAM 会话（authenticate → open_session）在有界的认证线程上执行，
+ * 不再占用会话事件处理方。并发数与排队数有上限，排队超时的请求不再进入 PAM；
+ * 请求方放弃（超时或断线）后，迟到的结果在认证线程上直接关闭。
+ */
+typedef struct _DrdAuthPool DrdAuthPool;
+typedef struct _DrdAuthRequest DrdAuthRequest;
+
+#define DRD_AUTH_POOL_DEFAULT_WORKERS 4
+#define DRD_AUTH_POOL_DEFAULT_MAX_QUEUED 64
+#define DRD_AUTH_POOL_DEFAULT_TIMEOUT_MS (20 * 1000)
+
+/* PAM 时延直方图分桶数，各桶上界见 drd_auth_pool_latency_bucket_bound_ms */
+#define DRD_AUTH_POOL_LATENCY_BUCKETS 8
+
+/*
+ * 认证完成回调，在认证线程上调用且每个请求至多一次，请求方 release 之后不再调用。
+ * local_session 所有权交给回调，失败时为 NULL 并带 error。
+ */
+typedef void (*DrdAuthPoolCallback)(DrdLocalSession *local_session, const GError *error, gpointer user_data);
+
+typedef struct
+{
+    guint workers;                                       /* 并发认证上限 */
+    guint running;                                       /* 正在执行 PAM 的请求数 */
+    guint queued;                                        /* 排队等待认证线程的请求数 */
+    guint64 succeeded;
+    guint64 failed;
+    guint64 rejected;                                    /* 排队已满被拒绝 */
+    guint64 timed_out;                                   /* 排队超时，未进入 PAM */
+    guint64 abandoned;                                   /* 请求方已放弃，结果被丢弃 */
+    guint64 latency_buckets[DRD_AUTH_POOL_LATENCY_BUCKETS]; /* PAM 耗时分布 */
+    gint64 max_latency_us;
+} DrdAuthPoolStats;
+
+DrdAuthPool *drd_auth_pool_new(guint max_workers, guint max_queued, guint timeout_ms);
+void drd_auth_pool_free(DrdAuthPool *self);
+void drd_auth_pool_get_stats(DrdAuthPool *self, DrdAuthPoolStats *out_stats);
+guint drd_auth_pool_latency_bucket_bound_ms(guint bucket);
+
+DrdAuthRequest *drd_auth_pool_submit(DrdAuthPool *self,
+                                     const gchar *pam_service,
+                                     const gchar *username,
+                                     const gchar *domain,
+                                     const gchar *password,
+                                     const gchar *remote_host,
+                                     DrdAuthPoolCallback callback,
+                                     gpointer user_data,
+                                     GError **error);
+gboolean drd_auth_request_is_expired(DrdAuthRequest *request);
+void drd_auth_request_release(DrdAuthRequest *request);
+
+G_END_DECLS
@@ -5,6 +5,7 @@
 #include <glib/gstdio.h>
 #include <inttypes.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -14,7 +15,9 @@
 
 struct _DrdNlaSamFile
 {
+    gint ref_count;
     gchar *path;
+    int memfd;         /* 内存后端的 memfd，路径为其 /proc/self/fd 链接；磁盘后端为 -1 */
 };
 
 /*
@@ -60,13 +63,13 @@ drd_nla_sam_format_entry(const gchar *username, const gchar *nt_hash_hex)
 }
 
 /*
- * 功能：将单条 SAM 记录写入文件并刷盘。
- * 逻辑：循环 write 写满所有字节，处理中断重试；写入完成后 fsync 保证落盘，最后清零内存缓存。
- * 参数：fd 打开的文件描述符；username 用户名；nt_hash_hex NT 哈希字符串；error 错误输出。
+ * 功能：将单条 SAM 记录写入文件。
+ * 逻辑：循环 write 写满所有字节，处理中断重试；磁盘文件写入完成后 fsync 保证落盘，最后清零内存缓存。
+ * 参数：fd 打开的文件描述符；username 用户名；nt_hash_hex NT 哈希字符串；sync 是否刷盘；error 错误输出。
  * 外部接口：POSIX write/fsync；GLib g_set_error、g_io_error_from_errno；依赖 drd_nla_sam_format_entry 构造内容。
  */
 static gboolean
-drd_nla_sam_write_entry(int fd, const gchar *username, const gchar *nt_hash_hex, GError **error)
+drd_nla_sam_write_entry(int fd, const gchar *username, const gchar *nt_hash_hex, gboolean sync, GError **error)
 {
     g_autofree gchar *entry = drd_nla_sam_format_entry(username, nt_hash_hex);
     const gsize total = strlen(entry);
@@ -86,12 +89,14 @@ drd_nla_sam_write_entry(int fd, const gchar *username, const gchar *nt_hash_hex,
                         g_io_error_from_errno(errno),
                         "Failed to write SAM file: %s",
                         g_strerror(errno));
+            drd_nla_memzero(entry, total);
             return FALSE;
         }
         written += (gsize) ret;
     }
 
-    if (fsync(fd) != 0)
+    drd_nla_memzero(entry, total);
+    if (sync && fsync(fd) != 0)
     {
         g_set_error(error,
                     G_IO_ERROR,
@@ -101,8 +106,6 @@ drd_nla_sam_write_entry(int fd, const gchar *username, const gchar *nt_hash_hex,
         return FALSE;
     }
 
-    drd_nla_memzero(entry, total);
-
     return TRUE;
 }
 
@@ -124,17 +127,60 @@ drd_nla_sam_default_dir(void)
 }
 
 /*
- * 功能：创建包含 NLA 凭据的临时 SAM 文件。
- * 逻辑：确定目录并创建（0700）；使用 mkstemp 模板创建临时文件；写入用户名与 NT 哈希；成功则返回封装的 DrdNlaSamFile，失败时清理文件。
+ * 功能：在密封的 memfd 中创建 SAM 数据库。
+ * 逻辑：创建允许密封的 memfd 并写入记录，随后封住写入与尺寸变化，内容此后不可修改；
+ *       返回 /proc/self/fd 路径供 WinPR 按只读方式重新打开，每次打开各自持有文件偏移，可被多个连接并发读取。
  * 参数：username 用户名；nt_hash_hex NT 哈希；error 错误输出。
- * 外部接口：GLib g_mkdir_with_parents/g_build_filename/g_mkstemp_full/g_unlink；POSIX write/close；内部 drd_nla_sam_write_entry。
+ * 外部接口：Linux memfd_create/fcntl(F_ADD_SEALS)；内部 drd_nla_sam_write_entry。
+ * 返回：成功返回对象；内核不支持 memfd 时返回 NULL 且 error 为 G_IO_ERROR_NOT_SUPPORTED。
  */
-DrdNlaSamFile *
-drd_nla_sam_file_new(const gchar *username, const gchar *nt_hash_hex, GError **error)
+static DrdNlaSamFile *
+drd_nla_sam_file_new_memfd(const gchar *username, const gchar *nt_hash_hex, GError **error)
 {
-    g_return_val_if_fail(username != NULL && *username != '\0', NULL);
-    g_return_val_if_fail(nt_hash_hex != NULL && *nt_hash_hex != '\0', NULL);
+    int fd = memfd_create("drd-nla-sam", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+    {
+        g_set_error(error,
+                    G_IO_ERROR,
+                    errno == ENOSYS || errno == EINVAL ? G_IO_ERROR_NOT_SUPPORTED : g_io_error_from_errno(errno),
+                    "Failed to create in-memory SAM database: %s",
+                    g_strerror(errno));
+        return NULL;
+    }
+
+    if (!drd_nla_sam_write_entry(fd, username, nt_hash_hex, FALSE, error))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+    {
+        g_set_error(error,
+                    G_IO_ERROR,
+                    g_io_error_from_errno(errno),
+                    "Failed to seal in-memory SAM database: %s",
+                    g_strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    DrdNlaSamFile *sam_file = g_new0(DrdNlaSamFile, 1);
+    sam_file->ref_count = 1;
+    sam_file->memfd = fd;
+    sam_file->path = g_strdup_printf("/proc/self/fd/%d", fd);
+    return sam_file;
+}
 
+/*
+ * 功能：在磁盘临时文件中创建 SAM 数据库（memfd 不可用时的回退）。
+ * 逻辑：确定目录并创建（0700）；使用 mkstemp 模板创建临时文件；写入用户名与 NT 哈希并刷盘，失败时清理文件。
+ * 参数：username 用户名；nt_hash_hex NT 哈希；error 错误输出。
+ * 外部接口：GLib g_mkdir_with_parents/g_build_filename/g_mkstemp_full/g_unlink；POSIX close；内部 drd_nla_sam_write_entry。
+ */
+static DrdNlaSamFile *
+drd_nla_sam_file_new_disk(const gchar *username, const gchar *nt_hash_hex, GError **error)
+{
     g_autofree gchar *base_dir = drd_nla_sam_default_dir();
     if (g_mkdir_with_parents(base_dir, 0700) != 0 && errno != EEXIST)
     {
@@ -159,7 +205,7 @@ drd_nla_sam_file_new(const gchar *username, const gchar *nt_hash_hex, GError **e
         return NULL;
     }
 
-    if (!drd_nla_sam_write_entry(fd, username, nt_hash_hex, error))
+    if (!drd_nla_sam_write_entry(fd, username, nt_hash_hex, TRUE, error))
     {
         close(fd);
         g_unlink(template_path);
@@ -169,13 +215,43 @@ drd_nla_sam_file_new(const gchar *username, const gchar *nt_hash_hex, GError **e
     close(fd);
 
     DrdNlaSamFile *sam_file = g_new0(DrdNlaSamFile, 1);
+    sam_file->ref_count = 1;
+    sam_file->memfd = -1;
     sam_file->path = g_strdup(template_path);
     return sam_file;
 }
 
 /*
- * 功能：获取 SAM 文件路径。
- * 逻辑：校验对象后返回路径字符串。
+ * 功能：创建包含 NLA 凭据的 SAM 数据库。
+ * 逻辑：优先使用密封的 memfd，不落盘；内核不支持时回退到临时文件并记录日志。
+ * 参数：username 用户名；nt_hash_hex NT 哈希；error 错误输出。
+ * 外部接口：内部 drd_nla_sam_file_new_memfd/drd_nla_sam_file_new_disk；日志 DRD_LOG_MESSAGE。
+ */
+DrdNlaSamFile *
+drd_nla_sam_file_new(const gchar *username, const gchar *nt_hash_hex, GError **error)
+{
+    g_return_val_if_fail(username != NULL && *username != '\0', NULL);
+    g_return_val_if_fail(nt_hash_hex != NULL && *nt_hash_hex != '\0', NULL);
+
+    g_autoptr(GError) memfd_error = NULL;
+    DrdNlaSamFile *sam_file = drd_nla_sam_file_new_memfd(username, nt_hash_hex, &memfd_error);
+    if (sam_file != NULL)
+    {
+        return sam_file;
+    }
+    if (!g_error_matches(memfd_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+    {
+        g_propagate_error(error, g_steal_pointer(&memfd_error));
+        return NULL;
+    }
+
+    DRD_LOG_MESSAGE("%s, falling back to a temporary SAM file", memfd_error->message);
+    return drd_nla_sam_file_new_disk(username, nt_hash_hex, error);
+}
+
+/*
+ * 功能：获取 SAM 数据库路径。
+ * 逻辑：校验对象后返回路径字符串；内存后端为 /proc/self/fd 链接，仅本进程可用。
  * 参数：sam_file SAM 文件对象。
  * 外部接口：无额外外部库。
  */
@@ -187,20 +263,39 @@ drd_nla_sam_file_get_path(DrdNlaSamFile *sam_file)
 }
 
 /*
- * 功能：删除并释放 SAM 文件对象。
- * 逻辑：存在路径则先 unlink 文件，再释放路径与对象内存。
+ * 功能：增加一份 SAM 数据库引用。
+ * 逻辑：原子递增引用计数；监听器共用同一份 SAM，各连接的 peer 设置期间各持一份引用，最后一份释放时才清理。
  * 参数：sam_file SAM 文件对象。
- * 外部接口：GLib g_unlink/g_free。
+ * 外部接口：GLib g_atomic_int_inc。
+ * 返回：传入的 sam_file，便于链式赋值。
+ */
+DrdNlaSamFile *
+drd_nla_sam_file_ref(DrdNlaSamFile *sam_file)
+{
+    g_return_val_if_fail(sam_file != NULL, NULL);
+    g_atomic_int_inc(&sam_file->ref_count);
+    return sam_file;
+}
+
+/*
+ * 功能：释放一份 SAM 数据库引用。
+ * 逻辑：最后一份引用释放时关闭 memfd（内存随之回收）或 unlink 临时文件，再释放路径与对象内存。
+ * 参数：sam_file SAM 文件对象，可为 NULL。
+ * 外部接口：GLib g_atomic_int_dec_and_test/g_unlink/g_free；POSIX close。
  */
 void
-drd_nla_sam_file_free(DrdNlaSamFile *sam_file)
+drd_nla_sam_file_unref(DrdNlaSamFile *sam_file)
 {
-    if (sam_file == NULL)
+    if (sam_file == NULL || !g_atomic_int_dec_and_test(&sam_file->ref_count))
     {
         return;
     }
 
-    if (sam_file->path != NULL)
+    if (sam_file->memfd >= 0)
+    {
+        close(sam_file->memfd);
+    }
+    else if (sam_file->path != NULL)
     {
         g_unlink(sam_file->path);
     }
@@ -4,13 +4,18 @@
 
 G_BEGIN_DECLS
 
+/*
+ * NLA 使用的 SAM 数据库：优先放在密封的匿名内存文件（memfd）中，经 /proc/self/fd 路径交给 WinPR 读取，
+ * 不落盘；内核不支持时回退到运行时目录下的临时文件。对象带引用计数，同一配置用户的所有连接共用一份。
+ */
 typedef struct _DrdNlaSamFile DrdNlaSamFile;
 
 DrdNlaSamFile *drd_nla_sam_file_new(const gchar *username,
                                       const gchar *nt_hash_hex,
                                       GError **error);
 const gchar *drd_nla_sam_file_get_path(DrdNlaSamFile *sam_file);
-void drd_nla_sam_file_free(DrdNlaSamFile *sam_file);
+DrdNlaSamFile *drd_nla_sam_file_ref(DrdNlaSamFile *sam_file);
+void drd_nla_sam_file_unref(DrdNlaSamFile *sam_file);
 gchar *drd_nla_sam_hash_password(const gchar *password);
 
 G_END_DECLS
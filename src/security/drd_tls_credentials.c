@@ -1,59 +1,192 @@
 #include "security/drd_tls_credentials.h"
 
 #include <gio/gio.h>
+#include <string.h>
 
 #include <freerdp/crypto/certificate.h>
 #include <freerdp/crypto/privatekey.h>
 #include <freerdp/settings.h>
 
+#include "utils/drd_log.h"
+
+/* 证书/私钥文件变化后等待该时长再重载，合并轮换时先后写入两个文件产生的多次事件 */
+#define DRD_TLS_CREDENTIALS_RELOAD_DELAY_MS 500
+
+struct _DrdTlsMaterial
+{
+    gint ref_count;
+    gchar *certificate_pem;
+    gchar *private_key_pem;
+    rdpCertificate *certificate;   /* 预解析对象，各 peer 从这里复制一份交给 settings */
+    rdpPrivateKey *private_key;
+};
+
 struct _DrdTlsCredentials
 {
     GObject parent_instance;
 
     gchar *certificate_path;
     gchar *private_key_path;
-    gchar *certificate_pem;
-    gchar *private_key_pem;
-    rdpCertificate *certificate;
-    rdpPrivateKey *private_key;
+    GMutex lock;                     /* 保护 material 替换；peer 设置在接入工作线程上读取 */
+    DrdTlsMaterial *material;        /* 当前生效的凭据快照 */
+    guint generation;                /* 每次替换快照加一 */
+    GFileMonitor *certificate_monitor;
+    GFileMonitor *private_key_monitor;
+    GMainContext *watch_context;     /* 文件监视回调所在的主循环，重载定时器挂在这里 */
+    GSource *reload_source;          /* 文件变化后的去抖重载 */
 };
 
 G_DEFINE_TYPE(DrdTlsCredentials, drd_tls_credentials, G_TYPE_OBJECT)
 
+DrdTlsMaterial *
+drd_tls_material_ref(DrdTlsMaterial *material)
+{
+    g_return_val_if_fail(material != NULL, NULL);
+    g_atomic_int_inc(&material->ref_count);
+    return material;
+}
+
+/*
+ * 功能：释放凭据快照的一份引用。
+ * 逻辑：最后一份引用释放时释放 FreeRDP 证书/私钥对象，并清零后释放 PEM 文本。
+ * 参数：material 凭据快照，可为 NULL。
+ * 外部接口：FreeRDP freerdp_certificate_free/freerdp_key_free；GLib g_atomic_int_dec_and_test。
+ */
+void
+drd_tls_material_unref(DrdTlsMaterial *material)
+{
+    if (material == NULL || !g_atomic_int_dec_and_test(&material->ref_count))
+    {
+        return;
+    }
+
+    freerdp_certificate_free(material->certificate);
+    freerdp_key_free(material->private_key);
+    g_free(material->certificate_pem);
+    if (material->private_key_pem != NULL)
+    {
+        memset(material->private_key_pem, 0, strlen(material->private_key_pem));
+        g_free(material->private_key_pem);
+    }
+    g_free(material);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdTlsMaterial, drd_tls_material_unref)
+
+/*
+ * 功能：解析 PEM 文本生成凭据快照。
+ * 逻辑：解析 PEM 生成 rdpCertificate/rdpPrivateKey 并复制 PEM 文本；任一解析失败写入错误。
+ * 参数：certificate_pem 证书 PEM；private_key_pem 私钥 PEM；error 错误输出。
+ * 外部接口：FreeRDP freerdp_certificate_new_from_pem/freerdp_key_new_from_pem；GLib g_set_error_literal/g_strdup。
+ */
+static DrdTlsMaterial *
+drd_tls_material_new(const gchar *certificate_pem, const gchar *private_key_pem, GError **error)
+{
+    rdpCertificate *certificate = freerdp_certificate_new_from_pem(certificate_pem);
+    if (certificate == NULL)
+    {
+        g_set_error_literal(error,
+                            G_IO_ERROR,
+                            G_IO_ERROR_FAILED,
+                            "Failed to parse TLS certificate material");
+        return NULL;
+    }
+
+    rdpPrivateKey *key = freerdp_key_new_from_pem(private_key_pem);
+    if (key == NULL)
+    {
+        freerdp_certificate_free(certificate);
+        g_set_error_literal(error,
+                            G_IO_ERROR,
+                            G_IO_ERROR_FAILED,
+                            "Failed to parse TLS private key material");
+        return NULL;
+    }
+
+    DrdTlsMaterial *material = g_new0(DrdTlsMaterial, 1);
+    material->ref_count = 1;
+    material->certificate = certificate;
+    material->private_key = key;
+    material->certificate_pem = g_strdup(certificate_pem);
+    material->private_key_pem = g_strdup(private_key_pem);
+    return material;
+}
+
+/*
+ * 功能：取得当前凭据快照的引用。
+ * 逻辑：持锁增加引用后返回，调用方用完后 unref；尚未加载时返回 NULL。
+ * 参数：self 凭据实例。
+ * 外部接口：GLib g_mutex_lock/g_atomic_int_inc。
+ */
+static DrdTlsMaterial *
+drd_tls_credentials_dup_material(DrdTlsCredentials *self)
+{
+    g_mutex_lock(&self->lock);
+    DrdTlsMaterial *material = self->material;
+    if (material != NULL)
+    {
+        g_atomic_int_inc(&material->ref_count);
+    }
+    g_mutex_unlock(&self->lock);
+    return material;
+}
+
 /*
  * 功能：释放 TLS 凭据持有的资源。
- * 逻辑：释放 FreeRDP 证书/私钥对象，清理路径与 PEM 字符串，最后交由父类 dispose。
+ * 逻辑：停止文件监视与待执行的重载，释放当前凭据快照（仍被读取方引用时由其最后释放），清理路径，最后交由父类 dispose。
  * 参数：object 基类指针，期望为 DrdTlsCredentials。
- * 外部接口：FreeRDP freerdp_certificate_free/freerdp_key_free；GLib g_clear_pointer/g_free；GObjectClass::dispose。
+ * 外部接口：GLib g_file_monitor_cancel/g_source_destroy/g_clear_pointer；GObjectClass::dispose。
  */
 static void
 drd_tls_credentials_dispose(GObject *object)
 {
     DrdTlsCredentials *self = DRD_TLS_CREDENTIALS(object);
 
-    if (self->certificate != NULL)
+    if (self->certificate_monitor != NULL)
     {
-        freerdp_certificate_free(self->certificate);
-        self->certificate = NULL;
+        g_file_monitor_cancel(self->certificate_monitor);
+        g_clear_object(&self->certificate_monitor);
     }
-
-    if (self->private_key != NULL)
+    if (self->private_key_monitor != NULL)
     {
-        freerdp_key_free(self->private_key);
-        self->private_key = NULL;
+        g_file_monitor_cancel(self->private_key_monitor);
+        g_clear_object(&self->private_key_monitor);
     }
+    if (self->reload_source != NULL)
+    {
+        g_source_destroy(self->reload_source);
+        g_clear_pointer(&self->reload_source, g_source_unref);
+    }
+    g_clear_pointer(&self->watch_context, g_main_context_unref);
+
+    g_mutex_lock(&self->lock);
+    DrdTlsMaterial *material = g_steal_pointer(&self->material);
+    g_mutex_unlock(&self->lock);
+    drd_tls_material_unref(material);
 
     g_clear_pointer(&self->certificate_path, g_free);
     g_clear_pointer(&self->private_key_path, g_free);
-    g_clear_pointer(&self->certificate_pem, g_free);
-    g_clear_pointer(&self->private_key_pem, g_free);
 
     G_OBJECT_CLASS(drd_tls_credentials_parent_class)->dispose(object);
 }
 
+/*
+ * 功能：释放凭据实例的锁。
+ * 逻辑：清理 dispose 之后不再使用的互斥量，再交由父类 finalize。
+ * 参数：object 基类指针。
+ * 外部接口：GLib g_mutex_clear；GObjectClass::finalize。
+ */
+static void
+drd_tls_credentials_finalize(GObject *object)
+{
+    DrdTlsCredentials *self = DRD_TLS_CREDENTIALS(object);
+    g_mutex_clear(&self->lock);
+    G_OBJECT_CLASS(drd_tls_credentials_parent_class)->finalize(object);
+}
+
 /*
  * 功能：绑定类级别的析构回调。
- * 逻辑：将自定义 dispose 安装到 GObjectClass。
+ * 逻辑：将自定义 dispose/finalize 安装到 GObjectClass。
  * 参数：klass 类结构。
  * 外部接口：GLib 类型系统。
  */
@@ -62,30 +195,34 @@ drd_tls_credentials_class_init(DrdTlsCredentialsClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
     object_class->dispose = drd_tls_credentials_dispose;
+    object_class->finalize = drd_tls_credentials_finalize;
 }
 
 /*
  * 功能：初始化 TLS 凭据实例字段。
- * 逻辑：将路径/PEM/对象指针置空。
+ * 逻辑：将路径/快照/监视器指针置空并初始化锁。
  * 参数：self 凭据实例。
- * 外部接口：无额外外部库。
+ * 外部接口：GLib g_mutex_init。
  */
 static void
 drd_tls_credentials_init(DrdTlsCredentials *self)
 {
     self->certificate_path = NULL;
     self->private_key_path = NULL;
-    self->certificate_pem = NULL;
-    self->private_key_pem = NULL;
-    self->certificate = NULL;
-    self->private_key = NULL;
+    g_mutex_init(&self->lock);
+    self->material = NULL;
+    self->generation = 0;
+    self->certificate_monitor = NULL;
+    self->private_key_monitor = NULL;
+    self->watch_context = NULL;
+    self->reload_source = NULL;
 }
 
 /*
- * 功能：用 PEM 文本解析并缓存 FreeRDP 证书/私钥。
- * 逻辑：解析 PEM 生成 rdpCertificate/rdpPrivateKey，替换旧缓存并复制 PEM 文本；解析失败写入错误。
+ * 功能：用 PEM 文本解析生成新快照并替换当前快照。
+ * 逻辑：先完整解析，成功后持锁整体替换并递增代数，旧快照在最后一个读取方释放后回收；解析失败时保持原快照不变。
  * 参数：self 凭据实例；certificate_pem 证书 PEM；private_key_pem 私钥 PEM；error 错误输出。
- * 外部接口：FreeRDP freerdp_certificate_new_from_pem/freerdp_key_new_from_pem；GLib g_set_error_literal/g_strdup/g_free。
+ * 外部接口：内部 drd_tls_material_new/drd_tls_material_unref；GLib g_mutex_lock/unlock。
  */
 static gboolean
 drd_tls_credentials_apply_pem(DrdTlsCredentials *self,
@@ -96,42 +233,18 @@ drd_tls_credentials_apply_pem(DrdTlsCredentials *self,
     g_return_val_if_fail(certificate_pem != NULL, FALSE);
     g_return_val_if_fail(private_key_pem != NULL, FALSE);
 
-    rdpCertificate *certificate = freerdp_certificate_new_from_pem(certificate_pem);
-    if (certificate == NULL)
+    DrdTlsMaterial *material = drd_tls_material_new(certificate_pem, private_key_pem, error);
+    if (material == NULL)
     {
-        g_set_error_literal(error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_FAILED,
-                            "Failed to parse TLS certificate material");
         return FALSE;
     }
 
-    rdpPrivateKey *key = freerdp_key_new_from_pem(private_key_pem);
-    if (key == NULL)
-    {
-        freerdp_certificate_free(certificate);
-        g_set_error_literal(error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_FAILED,
-                            "Failed to parse TLS private key material");
-        return FALSE;
-    }
-
-    if (self->certificate != NULL)
-    {
-        freerdp_certificate_free(self->certificate);
-    }
-    if (self->private_key != NULL)
-    {
-        freerdp_key_free(self->private_key);
-    }
-    g_free(self->certificate_pem);
-    g_free(self->private_key_pem);
-
-    self->certificate = certificate;
-    self->private_key = key;
-    self->certificate_pem = g_strdup(certificate_pem);
-    self->private_key_pem = g_strdup(private_key_pem);
+    g_mutex_lock(&self->lock);
+    DrdTlsMaterial *previous = self->material;
+    self->material = material;
+    self->generation++;
+    g_mutex_unlock(&self->lock);
+    drd_tls_material_unref(previous);
     return TRUE;
 }
 
@@ -166,11 +279,130 @@ drd_tls_credentials_load(DrdTlsCredentials *self, const gchar *certificate_path,
     return TRUE;
 }
 
+/*
+ * 功能：文件变化去抖到期后重新加载证书与私钥。
+ * 逻辑：在监视所在的主循环上执行；文件内容与当前快照相同则忽略，否则解析并原子替换，之后新建的 peer 使用新凭据，
+ *       已建立的连接不受影响；读取或解析失败时保留旧凭据并记录警告，等待下一次文件事件。
+ * 参数：user_data 凭据实例。
+ * 外部接口：GLib g_file_get_contents；内部 drd_tls_credentials_apply_pem；日志 DRD_LOG_MESSAGE/DRD_LOG_WARNING。
+ */
+static gboolean
+drd_tls_credentials_on_reload_timeout(gpointer user_data)
+{
+    DrdTlsCredentials *self = DRD_TLS_CREDENTIALS(user_data);
+    g_clear_pointer(&self->reload_source, g_source_unref);
+
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *cert_data = NULL;
+    g_autofree gchar *key_data = NULL;
+    if (!g_file_get_contents(self->certificate_path, &cert_data, NULL, &error) ||
+        !g_file_get_contents(self->private_key_path, &key_data, NULL, &error))
+    {
+        DRD_LOG_WARNING("TLS credentials unchanged, failed to read rotated files: %s", error->message);
+        return G_SOURCE_REMOVE;
+    }
+
+    g_autoptr(DrdTlsMaterial) current = drd_tls_credentials_dup_material(self);
+    const gboolean unchanged = current != NULL && g_strcmp0(current->certificate_pem, cert_data) == 0 &&
+                               g_strcmp0(current->private_key_pem, key_data) == 0;
+    if (!unchanged)
+    {
+        if (drd_tls_credentials_apply_pem(self, cert_data, key_data, &error))
+        {
+            DRD_LOG_MESSAGE("TLS credentials reloaded from %s (generation %u)",
+                            self->certificate_path,
+                            drd_tls_credentials_get_generation(self));
+        }
+        else
+        {
+            DRD_LOG_WARNING("TLS credentials unchanged, rotated files are invalid: %s", error->message);
+        }
+    }
+    memset(key_data, 0, strlen(key_data));
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * 功能：证书或私钥文件变化回调。
+ * 逻辑：内容写完、新建、移入或重命名到该路径时安排一次去抖重载；删除等事件忽略，等待新文件出现。
+ * 参数：monitor 文件监视器；file/other_file 事件文件；event_type 事件类型；user_data 凭据实例。
+ * 外部接口：GLib g_timeout_source_new/g_source_attach。
+ */
+static void
+drd_tls_credentials_on_file_changed(GFileMonitor *monitor G_GNUC_UNUSED,
+                                    GFile *file G_GNUC_UNUSED,
+                                    GFile *other_file G_GNUC_UNUSED,
+                                    GFileMonitorEvent event_type,
+                                    gpointer user_data)
+{
+    DrdTlsCredentials *self = DRD_TLS_CREDENTIALS(user_data);
+
+    switch (event_type)
+    {
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        case G_FILE_MONITOR_EVENT_CREATED:
+        case G_FILE_MONITOR_EVENT_MOVED_IN:
+        case G_FILE_MONITOR_EVENT_RENAMED:
+            break;
+        default:
+            return;
+    }
+
+    if (self->reload_source != NULL)
+    {
+        return;
+    }
+    self->reload_source = g_timeout_source_new(DRD_TLS_CREDENTIALS_RELOAD_DELAY_MS);
+    g_source_set_callback(self->reload_source, drd_tls_credentials_on_reload_timeout, self, NULL);
+    g_source_attach(self->reload_source, self->watch_context);
+}
+
+/*
+ * 功能：监视单个凭据文件。
+ * 逻辑：创建 inotify 后端的文件监视器（跟踪移动，以覆盖先写临时文件再 rename 的轮换方式）并连接变化回调。
+ * 参数：self 凭据实例；path 文件路径；error 错误输出。
+ * 外部接口：GLib g_file_new_for_path/g_file_monitor_file/g_signal_connect。
+ */
+static GFileMonitor *
+drd_tls_credentials_monitor_path(DrdTlsCredentials *self, const gchar *path, GError **error)
+{
+    g_autoptr(GFile) file = g_file_new_for_path(path);
+    GFileMonitor *monitor = g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES, NULL, error);
+    if (monitor == NULL)
+    {
+        return NULL;
+    }
+    g_signal_connect(monitor, "changed", G_CALLBACK(drd_tls_credentials_on_file_changed), self);
+    return monitor;
+}
+
+/*
+ * 功能：开始监视证书与私钥文件，变化后自动重载。
+ * 逻辑：回调与重载都在调用线程的 thread-default 主循环上执行；监视失败只记录警告，凭据仍可使用，只是轮换后需要重启。
+ * 参数：self 凭据实例。
+ * 外部接口：GLib g_main_context_ref_thread_default；内部 drd_tls_credentials_monitor_path；日志 DRD_LOG_WARNING。
+ */
+static void
+drd_tls_credentials_watch(DrdTlsCredentials *self)
+{
+    g_autoptr(GError) error = NULL;
+    self->watch_context = g_main_context_ref_thread_default();
+    self->certificate_monitor = drd_tls_credentials_monitor_path(self, self->certificate_path, &error);
+    if (self->certificate_monitor != NULL)
+    {
+        self->private_key_monitor = drd_tls_credentials_monitor_path(self, self->private_key_path, &error);
+    }
+    if (error != NULL)
+    {
+        DRD_LOG_WARNING("TLS credential hot-reload disabled: %s", error->message);
+    }
+}
+
 /*
  * 功能：根据证书/私钥路径构造 TLS 凭据。
- * 逻辑：创建对象并保存路径，然后加载文件解析 PEM；失败则释放对象并返回 NULL。
+ * 逻辑：创建对象并保存路径，然后加载文件解析 PEM；失败则释放对象并返回 NULL；成功后监视两个文件以支持证书轮换。
  * 参数：certificate_path 证书路径；private_key_path 私钥路径；error 错误输出。
- * 外部接口：GLib g_object_new/g_strdup；内部 drd_tls_credentials_load。
+ * 外部接口：GLib g_object_new/g_strdup；内部 drd_tls_credentials_load/drd_tls_credentials_watch。
  */
 DrdTlsCredentials *
 drd_tls_credentials_new(const gchar *certificate_path, const gchar *private_key_path, GError **error)
@@ -188,6 +420,7 @@ drd_tls_credentials_new(const gchar *certificate_path, const gchar *private_key_
         return NULL;
     }
 
+    drd_tls_credentials_watch(self);
     return self;
 }
 
@@ -229,35 +462,20 @@ drd_tls_credentials_get_private_key_path(DrdTlsCredentials *self)
     return self->private_key_path;
 }
 
-/*
- * 功能：获取 FreeRDP 证书对象。
- * 逻辑：类型检查后返回缓存的 rdpCertificate。
- * 参数：self 凭据实例。
- * 外部接口：无额外外部库。
- */
-rdpCertificate *
-drd_tls_credentials_get_certificate(DrdTlsCredentials *self)
+guint
+drd_tls_credentials_get_generation(DrdTlsCredentials *self)
 {
-    g_return_val_if_fail(DRD_IS_TLS_CREDENTIALS(self), NULL);
-    return self->certificate;
-}
+    g_return_val_if_fail(DRD_IS_TLS_CREDENTIALS(self), 0);
 
-/*
- * 功能：获取 FreeRDP 私钥对象。
- * 逻辑：类型检查后返回缓存的 rdpPrivateKey。
- * 参数：self 凭据实例。
- * 外部接口：无额外外部库。
- */
-rdpPrivateKey *
-drd_tls_credentials_get_private_key(DrdTlsCredentials *self)
-{
-    g_return_val_if_fail(DRD_IS_TLS_CREDENTIALS(self), NULL);
-    return self->private_key;
+    g_mutex_lock(&self->lock);
+    const guint generation = self->generation;
+    g_mutex_unlock(&self->lock);
+    return generation;
 }
 
 /*
  * 功能：读取缓存的 PEM 文本。
- * 逻辑：若缓存存在则复制证书/私钥字符串到调用方，缺失时设置错误并清理已分配的输出。
+ * 逻辑：从当前快照复制证书/私钥字符串到调用方，两者来自同一快照；缺失时设置错误并清理已分配的输出。
  * 参数：self 凭据实例；certificate/key 输出字符串指针；error 错误输出。
  * 外部接口：GLib g_set_error_literal/g_strdup/g_free。
  */
@@ -269,9 +487,10 @@ drd_tls_credentials_read_material(DrdTlsCredentials *self,
 {
     g_return_val_if_fail(DRD_IS_TLS_CREDENTIALS(self), FALSE);
 
+    g_autoptr(DrdTlsMaterial) material = drd_tls_credentials_dup_material(self);
     if (certificate != NULL)
     {
-        if (self->certificate_pem == NULL)
+        if (material == NULL)
         {
             g_set_error_literal(error,
                                 G_IO_ERROR,
@@ -279,12 +498,12 @@ drd_tls_credentials_read_material(DrdTlsCredentials *self,
                                 "TLS certificate material unavailable");
             return FALSE;
         }
-        *certificate = g_strdup(self->certificate_pem);
+        *certificate = g_strdup(material->certificate_pem);
     }
 
     if (key != NULL)
     {
-        if (self->private_key_pem == NULL)
+        if (material == NULL)
         {
             g_set_error_literal(error,
                                 G_IO_ERROR,
@@ -297,7 +516,7 @@ drd_tls_credentials_read_material(DrdTlsCredentials *self,
             }
             return FALSE;
         }
-        *key = g_strdup(self->private_key_pem);
+        *key = g_strdup(material->private_key_pem);
     }
 
     return TRUE;
@@ -327,17 +546,22 @@ drd_tls_credentials_reload_from_pem(DrdTlsCredentials *self,
 
 /*
  * 功能：将 TLS 凭据应用到 FreeRDP settings。
- * 逻辑：确保缓存的 PEM 存在后重新解析生成新的证书/私钥对象，并通过 freerdp_settings_set_pointer_len 注入 settings；任一步失败则写入错误并释放临时对象。
+ * 逻辑：取当前快照的引用，从快照中预先解析好的证书/私钥对象复制出本连接私有的副本，以转移所有权的方式写入
+ *       settings，由 FreeRDP 随 settings 一并释放，连接建立时不再解析 PEM。快照引用只在复制期间持有，
+ *       保证与重载并发时读到成对且未被释放的对象；可在接入工作线程上调用。
  * 参数：self 凭据实例；settings FreeRDP 设置；error 错误输出。
- * 外部接口：FreeRDP freerdp_certificate_new_from_pem/freerdp_key_new_from_pem/freerdp_settings_set_pointer_len；GLib g_set_error_literal。
+ * 外部接口：FreeRDP freerdp_certificate_clone/freerdp_key_clone/freerdp_settings_set_pointer_len；GLib g_set_error_literal。
  */
 gboolean
-drd_tls_credentials_apply(DrdTlsCredentials *self, rdpSettings *settings, GError **error)
+drd_tls_credentials_apply(DrdTlsCredentials *self,
+                          rdpSettings *settings,
+                          GError **error)
 {
     g_return_val_if_fail(DRD_IS_TLS_CREDENTIALS(self), FALSE);
     g_return_val_if_fail(settings != NULL, FALSE);
 
-    if (self->certificate_pem == NULL || self->private_key_pem == NULL)
+    g_autoptr(DrdTlsMaterial) material = drd_tls_credentials_dup_material(self);
+    if (material == NULL)
     {
         g_set_error_literal(error,
                             G_IO_ERROR,
@@ -346,31 +570,21 @@ drd_tls_credentials_apply(DrdTlsCredentials *self, rdpSettings *settings, GError
         return FALSE;
     }
 
-    rdpCertificate *certificate = freerdp_certificate_new_from_pem(self->certificate_pem);
-    if (certificate == NULL)
-    {
-        g_set_error_literal(error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_FAILED,
-                            "Failed to parse TLS certificate material");
-        return FALSE;
-    }
-
-    rdpPrivateKey *key = freerdp_key_new_from_pem(self->private_key_pem);
-    if (key == NULL)
+    rdpCertificate *certificate = freerdp_certificate_clone(material->certificate);
+    rdpPrivateKey *key = freerdp_key_clone(material->private_key);
+    if (certificate == NULL || key == NULL)
     {
         freerdp_certificate_free(certificate);
+        freerdp_key_free(key);
         g_set_error_literal(error,
                             G_IO_ERROR,
                             G_IO_ERROR_FAILED,
-                            "Failed to parse TLS private key material");
+                            "Failed to copy TLS material for settings");
         return FALSE;
     }
 
-    if (!freerdp_settings_set_pointer_len(settings,
-                                          FreeRDP_RdpServerCertificate,
-                                          certificate,
-                                          1))
+    /* set_pointer_len 释放 settings 中的旧值并接管副本；失败时副本未被接管，仍由这里释放 */
+    if (!freerdp_settings_set_pointer_len(settings, FreeRDP_RdpServerCertificate, certificate, 1))
     {
         freerdp_certificate_free(certificate);
         freerdp_key_free(key);
@@ -380,14 +594,13 @@ drd_tls_credentials_apply(DrdTlsCredentials *self, rdpSettings *settings, GError
                             "Failed to assign server certificate to settings");
         return FALSE;
     }
-
     if (!freerdp_settings_set_pointer_len(settings, FreeRDP_RdpServerRsaKey, key, 1))
     {
         freerdp_key_free(key);
         g_set_error_literal(error,
                             G_IO_ERROR,
                             G_IO_ERROR_FAILED,
-                            "Failed to assign private key to settings");
+                            "Failed to assign server private key to settings");
         return FALSE;
     }
 
@@ -8,6 +8,12 @@ G_BEGIN_DECLS
 #define DRD_TYPE_TLS_CREDENTIALS (drd_tls_credentials_get_type())
 G_DECLARE_FINAL_TYPE(DrdTlsCredentials, drd_tls_credentials, DRD, TLS_CREDENTIALS, GObject)
 
+/*
+ * 一份已解析的凭据快照，创建后不再修改。读取方持引用使用，重载时整体替换，
+ * 同一次读取看到的证书与私钥总是成对的。
+ */
+typedef struct _DrdTlsMaterial DrdTlsMaterial;
+
 DrdTlsCredentials *drd_tls_credentials_new(const gchar *certificate_path,
                                              const gchar *private_key_path,
                                              GError **error);
@@ -17,10 +23,13 @@ DrdTlsCredentials *drd_tls_credentials_new_empty(void);
 const gchar *drd_tls_credentials_get_certificate_path(DrdTlsCredentials *self);
 const gchar *drd_tls_credentials_get_private_key_path(DrdTlsCredentials *self);
 
-gboolean drd_tls_credentials_apply(DrdTlsCredentials *self, rdpSettings *settings, GError **error);
+gboolean drd_tls_credentials_apply(DrdTlsCredentials *self,
+                                   rdpSettings *settings,
+                                   GError **error);
 
-rdpCertificate *drd_tls_credentials_get_certificate(DrdTlsCredentials *self);
-rdpPrivateKey *drd_tls_credentials_get_private_key(DrdTlsCredentials *self);
+DrdTlsMaterial *drd_tls_material_ref(DrdTlsMaterial *material);
+void drd_tls_material_unref(DrdTlsMaterial *material);
+guint drd_tls_credentials_get_generation(DrdTlsCredentials *self);
 
 gboolean drd_tls_credentials_read_material(DrdTlsCredentials *self,
                                            gchar **certificate,
@@ -0,0 +1,114 @@
+#include "session/drd_decode_time_tracker.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* 约覆盖最近 2 秒（60fps）的样本，足以反映客户端当前解码负载 */
+#define DRD_DECODE_TIME_WINDOW 128
+
+struct _DrdDecodeTimeTracker
+{
+    gint64 window[DRD_DECODE_TIME_WINDOW];
+    guint count;
+    guint next;
+    guint64 samples;
+};
+
+/*
+ * 功能：创建解码耗时统计器。
+ * 逻辑：分配零初始化结构。
+ * 参数：无。
+ * 外部接口：GLib g_new0。
+ */
+DrdDecodeTimeTracker *
+drd_decode_time_tracker_new(void)
+{
+    return g_new0(DrdDecodeTimeTracker, 1);
+}
+
+/*
+ * 功能：释放解码耗时统计器。
+ * 逻辑：直接释放结构体。
+ * 参数：self 统计器，可为空。
+ * 外部接口：GLib g_free。
+ */
+void
+drd_decode_time_tracker_free(DrdDecodeTimeTracker *self)
+{
+    g_free(self);
+}
+
+/*
+ * 功能：清空统计窗口。
+ * 逻辑：用于 surface 重建或编码格式切换后重新采样；累计样本数一并清零。
+ * 参数：self 统计器。
+ * 外部接口：C 标准库 memset。
+ */
+void
+drd_decode_time_tracker_reset(DrdDecodeTimeTracker *self)
+{
+    g_return_if_fail(self != NULL);
+
+    memset(self, 0, sizeof(*self));
+}
+
+/*
+ * 功能：记录一次客户端解码耗时。
+ * 逻辑：写入环形窗口，窗口满后覆盖最旧样本。
+ * 参数：self 统计器；decode_time_us 解码耗时（微秒）。
+ * 外部接口：无。
+ */
+void
+drd_decode_time_tracker_add(DrdDecodeTimeTracker *self, gint64 decode_time_us)
+{
+    g_return_if_fail(self != NULL);
+
+    self->window[self->next] = MAX(decode_time_us, (gint64) 0);
+    self->next = (self->next + 1) % DRD_DECODE_TIME_WINDOW;
+    self->count = MIN(self->count + 1, (guint) DRD_DECODE_TIME_WINDOW);
+    self->samples++;
+}
+
+/*
+ * 功能：qsort 比较函数，按耗时升序。
+ * 逻辑：比较两个 gint64。
+ * 参数：a/b 元素指针。
+ * 外部接口：供 C 标准库 qsort 使用。
+ */
+static int
+drd_decode_time_tracker_compare(const void *a, const void *b)
+{
+    const gint64 lhs = *(const gint64 *) a;
+    const gint64 rhs = *(const gint64 *) b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+/*
+ * 功能：计算窗口内解码耗时分位数。
+ * 逻辑：复制窗口到栈上排序，按最近秩法取 p50/p95/p99 与最大值；无样本时全部为 0。
+ * 参数：self 统计器；out_stats 输出。
+ * 外部接口：C 标准库 qsort。
+ */
+void
+drd_decode_time_tracker_get_stats(DrdDecodeTimeTracker *self, DrdDecodeTimeStats *out_stats)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(out_stats != NULL);
+
+    memset(out_stats, 0, sizeof(*out_stats));
+    out_stats->samples = self->samples;
+    if (self->count == 0)
+    {
+        return;
+    }
+
+    gint64 sorted[DRD_DECODE_TIME_WINDOW];
+    memcpy(sorted, self->window, sizeof(gint64) * self->count);
+    qsort(sorted, self->count, sizeof(gint64), drd_decode_time_tracker_compare);
+
+    const guint last = self->count - 1;
+    out_stats->p50_us = sorted[last * 50 / 100];
+    out_stats->p95_us = sorted[last * 95 / 100];
+    out_stats->p99_us = sorted[last * 99 / 100];
+    out_stats->max_us = sorted[last];
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * 客户端解码耗时统计：保存最近若干个 RDPGFX QoE FrameAcknowledge 上报的解码耗时，
+ * 按需计算分位数，供指标输出与帧率/编码格式决策使用。调用方负责加锁。
+ */
+typedef struct _DrdDecodeTimeTracker DrdDecodeTimeTracker;
+
+typedef struct
+{
+    guint64 samples; /* 累计 QoE 样本数 */
+    gint64 p50_us;   /* 最近窗口解码耗时中位数 */
+    gint64 p95_us;
+    gint64 p99_us;
+    gint64 max_us;
+} DrdDecodeTimeStats;
+
+DrdDecodeTimeTracker *drd_decode_time_tracker_new(void);
+void drd_decode_time_tracker_free(DrdDecodeTimeTracker *self);
+
+void drd_decode_time_tracker_reset(DrdDecodeTimeTracker *self);
+void drd_decode_time_tracker_add(DrdDecodeTimeTracker *self, gint64 decode_time_us);
+void drd_decode_time_tracker_get_stats(DrdDecodeTimeTracker *self, DrdDecodeTimeStats *out_stats);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdDecodeTimeTracker, drd_decode_time_tracker_free)
+
+G_END_DECLS
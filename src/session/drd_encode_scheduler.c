@@ -0,0 +1,364 @@
+#include "session/drd_encode_scheduler.h"
+
+#include <time.h>
+
+#include "utils/drd_log.h"
+
+/* 虚拟时间精度：CPU 微秒乘以该系数后再除以权重，避免小权重差异被整除截断 */
+#define DRD_ENCODE_SCHEDULER_VTIME_SCALE 1000
+
+struct _DrdEncodeSchedulerClient
+{
+    DrdEncodeScheduler *scheduler;
+    guint64 vtime;  /* 加权虚拟时间，受 scheduler->lock 保护 */
+    guint waiting[DRD_ENCODE_STAGE_COUNT]; /* 本客户端各阶段排队中的任务数 */
+    guint running[DRD_ENCODE_STAGE_COUNT]; /* 本客户端各阶段执行中的任务数 */
+    DrdEncodeSchedulerClientStats stats;
+};
+
+struct _DrdEncodeScheduler
+{
+    GMutex lock;
+    GCond cond;         /* 配额释放、权重或预算变化时广播 */
+    guint core_budget;  /* 每个阶段的配额 */
+    guint running[DRD_ENCODE_STAGE_COUNT];
+    guint waiting[DRD_ENCODE_STAGE_COUNT];
+    guint64 vclock;     /* 最近观测到的活跃客户端最小虚拟时间，单调不减 */
+    guint64 contended;
+    GPtrArray *clients; /* 登记顺序，虚拟时间相同时靠前者优先 */
+};
+
+/*
+ * 功能：读取当前线程已消耗的 CPU 时间。
+ * 逻辑：使用线程 CPU 时钟，只统计调用线程本身；VAAPI 驱动与 openh264 等编解码库自建的工作线程不计入，
+ *       这类编码器的任务按调用线程的 CPU 时间被低估计费，虚拟时间只是各组实际 CPU 占用的近似。
+ * 参数：无。
+ * 外部接口：POSIX clock_gettime(CLOCK_THREAD_CPUTIME_ID)。
+ */
+static gint64 drd_encode_scheduler_thread_cpu_us(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    {
+        return 0;
+    }
+    return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/*
+ * 功能：按 CPU 数推导默认核心配额。
+ * 逻辑：配额按阶段计数，编码计算合计取 CPU 数的一半，在分析与编码两个阶段间平分，每阶段至少 1，
+ *       为捕获、会话发送与编解码库内部线程留出余量。
+ * 参数：无。
+ * 外部接口：GLib g_get_num_processors。
+ */
+static guint drd_encode_scheduler_default_budget(void)
+{
+    return MAX(g_get_num_processors() / (2 * DRD_ENCODE_STAGE_COUNT), 1u);
+}
+
+/*
+ * 功能：判断客户端是否有排队或执行中的任务。
+ * 逻辑：须持 lock 调用；任一阶段有任务即为活跃。
+ * 参数：client 客户端。
+ * 外部接口：无。
+ */
+static gboolean drd_encode_scheduler_client_active_locked(const DrdEncodeSchedulerClient *client)
+{
+    for (guint stage = 0; stage < DRD_ENCODE_STAGE_COUNT; ++stage)
+    {
+        if (client->waiting[stage] > 0 || client->running[stage] > 0)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * 功能：推进并返回全局虚拟时钟。
+ * 逻辑：须持 lock 调用；取活跃客户端虚拟时间的最小值（公平排队的系统虚拟时间），时钟只前移不回退；
+ *       全部客户端闲置时保持最近一次观测值。取最小值而非最大值，重新活跃者与最慢的活跃者同起跑，
+ *       不会被推到最快者之后而长期落后。
+ * 参数：self 调度器。
+ * 外部接口：无。
+ */
+static guint64 drd_encode_scheduler_advance_vclock_locked(DrdEncodeScheduler *self)
+{
+    gboolean found = FALSE;
+    guint64 min_vtime = 0;
+    for (guint i = 0; i < self->clients->len; ++i)
+    {
+        const DrdEncodeSchedulerClient *client = g_ptr_array_index(self->clients, i);
+        if (drd_encode_scheduler_client_active_locked(client) && (!found || client->vtime < min_vtime))
+        {
+            min_vtime = client->vtime;
+            found = TRUE;
+        }
+    }
+    if (found)
+    {
+        self->vclock = MAX(self->vclock, min_vtime);
+    }
+    return self->vclock;
+}
+
+/*
+ * 功能：选出某阶段下一个应获得配额的客户端。
+ * 逻辑：须持 lock 调用；在该阶段有任务排队的客户端中取虚拟时间最小者，相同时取先登记者。
+ * 参数：self 调度器；stage 阶段。
+ * 外部接口：无。
+ * 返回：客户端，无人排队时返回 NULL。
+ */
+static DrdEncodeSchedulerClient *drd_encode_scheduler_pick_locked(DrdEncodeScheduler *self, DrdEncodeStage stage)
+{
+    DrdEncodeSchedulerClient *next = NULL;
+    for (guint i = 0; i < self->clients->len; ++i)
+    {
+        DrdEncodeSchedulerClient *client = g_ptr_array_index(self->clients, i);
+        if (client->waiting[stage] > 0 && (next == NULL || client->vtime < next->vtime))
+        {
+            next = client;
+        }
+    }
+    return next;
+}
+
+/*
+ * 功能：创建编码 CPU 调度器。
+ * 逻辑：初始化锁与客户端列表，core_budget 为 0 时按 CPU 数推导。
+ * 参数：core_budget 同时执行的任务数上限，0 表示自动。
+ * 外部接口：GLib g_new0/g_mutex_init/g_cond_init。
+ */
+DrdEncodeScheduler *drd_encode_scheduler_new(guint core_budget)
+{
+    DrdEncodeScheduler *self = g_new0(DrdEncodeScheduler, 1);
+    g_mutex_init(&self->lock);
+    g_cond_init(&self->cond);
+    self->core_budget = core_budget != 0 ? core_budget : drd_encode_scheduler_default_budget();
+    self->clients = g_ptr_array_new();
+    return self;
+}
+
+/*
+ * 功能：释放调度器。
+ * 逻辑：此时各编码组应已注销；残留客户端一并释放并给出警告。
+ * 参数：self 调度器，可为 NULL。
+ * 外部接口：GLib g_ptr_array_unref/g_mutex_clear/g_cond_clear；日志 DRD_LOG_WARNING。
+ */
+void drd_encode_scheduler_free(DrdEncodeScheduler *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    if (self->clients->len > 0)
+    {
+        DRD_LOG_WARNING("Encode scheduler freed with %u client(s) still registered", self->clients->len);
+    }
+    g_ptr_array_set_free_func(self->clients, g_free);
+    g_ptr_array_unref(self->clients);
+    g_cond_clear(&self->cond);
+    g_mutex_clear(&self->lock);
+    g_free(self);
+}
+
+/*
+ * 功能：调整核心配额。
+ * 逻辑：持锁更新每个阶段的上限并唤醒排队者；调小时执行中的任务不受影响，新任务按新上限准入。
+ * 参数：self 调度器；core_budget 每个阶段的新上限，0 表示自动。
+ * 外部接口：GLib g_cond_broadcast；日志 DRD_LOG_MESSAGE。
+ */
+void drd_encode_scheduler_set_core_budget(DrdEncodeScheduler *self, guint core_budget)
+{
+    g_return_if_fail(self != NULL);
+
+    const guint budget = core_budget != 0 ? core_budget : drd_encode_scheduler_default_budget();
+    g_mutex_lock(&self->lock);
+    const gboolean changed = self->core_budget != budget;
+    self->core_budget = budget;
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->lock);
+
+    if (changed)
+    {
+        DRD_LOG_MESSAGE("Encode scheduler core budget set to %u", budget);
+    }
+}
+
+void drd_encode_scheduler_get_stats(DrdEncodeScheduler *self, DrdEncodeSchedulerStats *out_stats)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&self->lock);
+    out_stats->core_budget = self->core_budget;
+    out_stats->clients = self->clients->len;
+    out_stats->running = 0;
+    out_stats->waiting = 0;
+    for (guint stage = 0; stage < DRD_ENCODE_STAGE_COUNT; ++stage)
+    {
+        out_stats->running += self->running[stage];
+        out_stats->waiting += self->waiting[stage];
+    }
+    out_stats->contended = self->contended;
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：登记一个客户端（编码组）。
+ * 逻辑：新客户端的虚拟时间从全局时钟（活跃客户端最小虚拟时间）起步，与已有客户端公平竞争。
+ * 参数：self 调度器；weight 公平份额权重，0 按 1 处理。
+ * 外部接口：GLib g_ptr_array_add。
+ * 返回：客户端句柄，交给 drd_encode_scheduler_unregister 注销。
+ */
+DrdEncodeSchedulerClient *drd_encode_scheduler_register(DrdEncodeScheduler *self, guint weight)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+
+    DrdEncodeSchedulerClient *client = g_new0(DrdEncodeSchedulerClient, 1);
+    client->scheduler = self;
+    client->stats.weight = MAX(weight, 1u);
+
+    g_mutex_lock(&self->lock);
+    client->vtime = drd_encode_scheduler_advance_vclock_locked(self);
+    g_ptr_array_add(self->clients, client);
+    g_mutex_unlock(&self->lock);
+    return client;
+}
+
+/*
+ * 功能：注销客户端。
+ * 逻辑：调用方须保证该客户端没有执行中或排队中的任务（流水线线程已停止）；移出列表后唤醒排队者重新选取。
+ * 参数：client 客户端，可为 NULL，调用后失效。
+ * 外部接口：GLib g_ptr_array_remove/g_cond_broadcast。
+ */
+void drd_encode_scheduler_unregister(DrdEncodeSchedulerClient *client)
+{
+    if (client == NULL)
+    {
+        return;
+    }
+
+    DrdEncodeScheduler *self = client->scheduler;
+    g_mutex_lock(&self->lock);
+    g_warn_if_fail(!drd_encode_scheduler_client_active_locked(client));
+    g_ptr_array_remove(self->clients, client);
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->lock);
+    g_free(client);
+}
+
+/*
+ * 功能：调整客户端权重。
+ * 逻辑：只影响此后结算的任务，已累积的虚拟时间不回溯。
+ * 参数：client 客户端；weight 新权重，0 按 1 处理。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void drd_encode_scheduler_client_set_weight(DrdEncodeSchedulerClient *client, guint weight)
+{
+    g_return_if_fail(client != NULL);
+
+    g_mutex_lock(&client->scheduler->lock);
+    client->stats.weight = MAX(weight, 1u);
+    g_mutex_unlock(&client->scheduler->lock);
+}
+
+/*
+ * 功能：读取客户端（编码组）的累计调度统计。
+ * 逻辑：持调度器锁复制权重、任务数、CPU 时间与排队时长。
+ * 参数：client 客户端；out_stats 输出。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void drd_encode_scheduler_client_get_stats(DrdEncodeSchedulerClient *client, DrdEncodeSchedulerClientStats *out_stats)
+{
+    g_return_if_fail(client != NULL);
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&client->scheduler->lock);
+    *out_stats = client->stats;
+    g_mutex_unlock(&client->scheduler->lock);
+}
+
+/*
+ * 功能：申请执行一次分析/编码任务的核心配额。
+ * 逻辑：客户端由闲置转为活跃时虚拟时间追平全局时钟（活跃客户端的最小虚拟时间）；该阶段配额已满或自己不是该阶段
+ *       虚拟时间最小的排队者时等待。两个阶段的配额独立计数，同一客户端可同时持有分析与编码配额。
+ *       获得配额后若该阶段仍有空闲配额与排队者则继续唤醒，避免多个配额同时空出时只放行一个。
+ *       任务本身是有界的单帧计算，等待总会随其他任务结束而解除。
+ * 参数：client 客户端；stage 任务所属阶段；ticket 输出凭据，交给 drd_encode_scheduler_end。
+ * 外部接口：GLib g_cond_wait/g_cond_broadcast/g_get_monotonic_time；clock_gettime 线程 CPU 时钟。
+ */
+void drd_encode_scheduler_begin(DrdEncodeSchedulerClient *client, DrdEncodeStage stage, DrdEncodeTicket *ticket)
+{
+    g_return_if_fail(client != NULL);
+    g_return_if_fail(stage < DRD_ENCODE_STAGE_COUNT);
+    g_return_if_fail(ticket != NULL);
+
+    DrdEncodeScheduler *self = client->scheduler;
+    const gint64 start = g_get_monotonic_time();
+    gboolean queued = FALSE;
+
+    g_mutex_lock(&self->lock);
+    if (!drd_encode_scheduler_client_active_locked(client))
+    {
+        client->vtime = MAX(client->vtime, drd_encode_scheduler_advance_vclock_locked(self));
+    }
+    client->waiting[stage]++;
+    self->waiting[stage]++;
+    while (self->running[stage] >= self->core_budget || drd_encode_scheduler_pick_locked(self, stage) != client)
+    {
+        queued = TRUE;
+        g_cond_wait(&self->cond, &self->lock);
+    }
+    client->waiting[stage]--;
+    self->waiting[stage]--;
+    client->running[stage]++;
+    self->running[stage]++;
+    if (queued)
+    {
+        self->contended++;
+    }
+    if (self->waiting[stage] > 0 && self->running[stage] < self->core_budget)
+    {
+        g_cond_broadcast(&self->cond);
+    }
+    g_mutex_unlock(&self->lock);
+
+    ticket->stage = stage;
+    ticket->wait_us = g_get_monotonic_time() - start;
+    ticket->cpu_start_us = drd_encode_scheduler_thread_cpu_us();
+}
+
+/*
+ * 功能：结束任务并归还配额。
+ * 逻辑：按本线程实际消耗的 CPU 时间除以权重推进客户端虚拟时间并计入统计，随后推进全局时钟；
+ *       有排队者时唤醒其重新竞争。
+ * 参数：client 客户端；ticket begin 填写的凭据。
+ * 外部接口：GLib g_cond_broadcast；clock_gettime 线程 CPU 时钟。
+ * 返回：本次任务消耗的线程 CPU 时间（微秒）。
+ */
+gint64 drd_encode_scheduler_end(DrdEncodeSchedulerClient *client, const DrdEncodeTicket *ticket)
+{
+    g_return_val_if_fail(client != NULL, 0);
+    g_return_val_if_fail(ticket != NULL, 0);
+
+    DrdEncodeScheduler *self = client->scheduler;
+    const gint64 cpu_us = MAX(drd_encode_scheduler_thread_cpu_us() - ticket->cpu_start_us, 0);
+
+    g_mutex_lock(&self->lock);
+    client->vtime += (guint64) cpu_us * DRD_ENCODE_SCHEDULER_VTIME_SCALE / client->stats.weight;
+    drd_encode_scheduler_advance_vclock_locked(self);
+    client->running[ticket->stage]--;
+    self->running[ticket->stage]--;
+    client->stats.tasks++;
+    client->stats.cpu_us += (guint64) cpu_us;
+    client->stats.wait_us += (guint64) ticket->wait_us;
+    if (self->waiting[DRD_ENCODE_STAGE_ANALYSIS] > 0 || self->waiting[DRD_ENCODE_STAGE_ENCODE] > 0)
+    {
+        g_cond_broadcast(&self->cond);
+    }
+    g_mutex_unlock(&self->lock);
+    return cpu_us;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * 编码 CPU 调度器：进程内全部编码组的分析与编码任务按阶段共享核心配额（每个阶段同时执行的重计算任务数上限），
+ * 同一编码组的分析与编码两个阶段可以同时持有配额，小核数机器上流水线不会退化为串行。
+ * 任务开始前申请所属阶段的配额，配额不足时按加权虚拟时间排队：每个客户端（编码组）的虚拟时间按任务实际消耗的
+ * 线程 CPU 时间除以权重推进（两个阶段共用），空出的配额总是交给该阶段虚拟时间最小的等待者，重负载会话不会饿死轻负载会话；
+ * 闲置后重新活跃的客户端虚拟时间追平活跃客户端中的最小虚拟时间，不能囤积额度，也不会被推到最快者之后。
+ */
+typedef struct _DrdEncodeScheduler DrdEncodeScheduler;
+typedef struct _DrdEncodeSchedulerClient DrdEncodeSchedulerClient;
+
+/* 申请配额的流水线阶段，各阶段的配额独立计数 */
+typedef enum
+{
+    DRD_ENCODE_STAGE_ANALYSIS = 0,
+    DRD_ENCODE_STAGE_ENCODE,
+    DRD_ENCODE_STAGE_COUNT
+} DrdEncodeStage;
+
+/* 一次任务的配额凭据，由 begin 填写、交给 end 结算 */
+typedef struct
+{
+    DrdEncodeStage stage; /* 占用配额的阶段 */
+    gint64 cpu_start_us; /* 获得配额时的线程 CPU 时间 */
+    gint64 wait_us;      /* 排队等待配额的时长 */
+} DrdEncodeTicket;
+
+typedef struct
+{
+    guint core_budget;  /* 每个阶段同时执行的任务数上限 */
+    guint clients;      /* 已登记的客户端数 */
+    guint running;      /* 各阶段正在执行的任务数之和 */
+    guint waiting;      /* 各阶段排队等待配额的任务数之和 */
+    guint64 contended;  /* 需要排队才获得配额的任务数 */
+} DrdEncodeSchedulerStats;
+
+typedef struct
+{
+    guint weight;     /* 公平份额权重 */
+    guint64 tasks;    /* 已完成的任务数 */
+    guint64 cpu_us;   /* 累计消耗的线程 CPU 时间 */
+    guint64 wait_us;  /* 累计排队时长 */
+} DrdEncodeSchedulerClientStats;
+
+DrdEncodeScheduler *drd_encode_scheduler_new(guint core_budget);
+void drd_encode_scheduler_free(DrdEncodeScheduler *self);
+void drd_encode_scheduler_set_core_budget(DrdEncodeScheduler *self, guint core_budget);
+void drd_encode_scheduler_get_stats(DrdEncodeScheduler *self, DrdEncodeSchedulerStats *out_stats);
+
+DrdEncodeSchedulerClient *drd_encode_scheduler_register(DrdEncodeScheduler *self, guint weight);
+void drd_encode_scheduler_unregister(DrdEncodeSchedulerClient *client);
+void drd_encode_scheduler_client_set_weight(DrdEncodeSchedulerClient *client, guint weight);
+void drd_encode_scheduler_client_get_stats(DrdEncodeSchedulerClient *client, DrdEncodeSchedulerClientStats *out_stats);
+
+void drd_encode_scheduler_begin(DrdEncodeSchedulerClient *client, DrdEncodeStage stage, DrdEncodeTicket *ticket);
+gint64 drd_encode_scheduler_end(DrdEncodeSchedulerClient *client, const DrdEncodeTicket *ticket);
+
+G_END_DECLS
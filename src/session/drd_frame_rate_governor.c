@@ -0,0 +1,180 @@
+#include "session/drd_frame_rate_governor.h"
+
+/* 评估周期：足够平滑 ACK 抖动，又能在数百毫秒内响应场景变化 */
+#define DRD_FRAME_RATE_GOVERNOR_INTERVAL_US (500 * G_TIME_SPAN_MILLISECOND)
+/* 变化比例达到该值视为全屏运动（与默认 gfx_large_change_threshold 一致） */
+#define DRD_FRAME_RATE_GOVERNOR_FULL_MOTION_RATIO 0.05
+/* 仅有光标/输入等小范围变化时的帧率上限，保证交互延迟不超过约 40ms */
+#define DRD_FRAME_RATE_GOVERNOR_LOW_MOTION_FPS 24u
+
+struct _DrdFrameRateGovernor
+{
+    guint max_fps;
+    guint min_fps;
+    guint current_fps;
+
+    gdouble motion;
+    guint64 last_frames_sent;
+
+    gint64 window_start_us;
+    guint64 window_frames_sent;
+    guint64 window_frames_acked;
+};
+
+/*
+ * 功能：创建会话帧率调节器。
+ * 逻辑：校正上下界（min 至少 1 且不超过 max），初始帧率取上界。
+ * 参数：max_fps 配置的目标帧率；min_fps 允许下调到的最低帧率。
+ * 外部接口：GLib g_new0。
+ */
+DrdFrameRateGovernor *
+drd_frame_rate_governor_new(guint max_fps, guint min_fps)
+{
+    DrdFrameRateGovernor *self = g_new0(DrdFrameRateGovernor, 1);
+
+    self->max_fps = MAX(max_fps, 1u);
+    self->min_fps = CLAMP(min_fps, 1u, self->max_fps);
+    drd_frame_rate_governor_reset(self);
+    return self;
+}
+
+/*
+ * 功能：释放帧率调节器。
+ * 逻辑：直接释放结构体。
+ * 参数：self 调节器，可为空。
+ * 外部接口：GLib g_free。
+ */
+void
+drd_frame_rate_governor_free(DrdFrameRateGovernor *self)
+{
+    g_free(self);
+}
+
+/*
+ * 功能：恢复到满帧率并清空统计窗口。
+ * 逻辑：用于图形管线重建或传输模式切换，避免沿用旧 ACK 计数。
+ * 参数：self 调节器。
+ * 外部接口：无。
+ */
+void
+drd_frame_rate_governor_reset(DrdFrameRateGovernor *self)
+{
+    g_return_if_fail(self != NULL);
+
+    self->current_fps = self->max_fps;
+    self->motion = 1.0;
+    self->last_frames_sent = 0;
+    self->window_start_us = 0;
+    self->window_frames_sent = 0;
+    self->window_frames_acked = 0;
+}
+
+/*
+ * 功能：按客户端反馈与画面变化重新计算有效帧率。
+ * 逻辑：每次调用以峰值衰减方式跟踪变化比例；每 500ms 评估一次：
+ *       1) ACK 吞吐明显低于发送速率时以 ACK 帧率为上限；
+ *       2) 已知解码耗时时以 80% 解码能力为上限；
+ *       3) 变化比例越小帧率上限越接近低运动帧率；
+ *       取三者最小值并夹在 [min_fps, max_fps]，下调立即生效、上调每次最多提升 25%。
+ * 参数：self 调节器；now_us 单调时钟；sample 会话累计计数与最新反馈。
+ * 外部接口：无。返回值表示有效帧率是否变化。
+ */
+gboolean
+drd_frame_rate_governor_update(DrdFrameRateGovernor *self, gint64 now_us, const DrdFrameRateSample *sample)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+    g_return_val_if_fail(sample != NULL, FALSE);
+
+    if (sample->frames_sent != self->last_frames_sent)
+    {
+        self->motion = MAX(sample->change_ratio, self->motion * 0.85);
+        self->last_frames_sent = sample->frames_sent;
+    }
+
+    if (self->window_start_us == 0 || sample->frames_sent < self->window_frames_sent ||
+        sample->frames_acked < self->window_frames_acked)
+    {
+        self->window_start_us = now_us;
+        self->window_frames_sent = sample->frames_sent;
+        self->window_frames_acked = sample->frames_acked;
+        return FALSE;
+    }
+
+    const gint64 elapsed_us = now_us - self->window_start_us;
+    if (elapsed_us < DRD_FRAME_RATE_GOVERNOR_INTERVAL_US)
+    {
+        return FALSE;
+    }
+
+    const guint64 sent = sample->frames_sent - self->window_frames_sent;
+    const guint64 acked = sample->frames_acked - self->window_frames_acked;
+    const gdouble sent_fps = (gdouble) sent * G_USEC_PER_SEC / (gdouble) elapsed_us;
+    const gdouble acked_fps = (gdouble) acked * G_USEC_PER_SEC / (gdouble) elapsed_us;
+
+    self->window_start_us = now_us;
+    self->window_frames_sent = sample->frames_sent;
+    self->window_frames_acked = sample->frames_acked;
+
+    if (sent == 0)
+    {
+        /* 画面静止：没有可评估的样本，保持当前帧率 */
+        return FALSE;
+    }
+
+    gdouble ceiling = (gdouble) self->max_fps;
+
+    if (!sample->acks_suspended && acked_fps < sent_fps * 0.9)
+    {
+        ceiling = MIN(ceiling, acked_fps);
+    }
+
+    if (sample->decode_time_us > 0)
+    {
+        ceiling = MIN(ceiling, (gdouble) G_USEC_PER_SEC / (gdouble) sample->decode_time_us * 0.8);
+    }
+
+    const guint low_motion_fps = MIN(DRD_FRAME_RATE_GOVERNOR_LOW_MOTION_FPS, self->max_fps);
+    const gdouble motion = MIN(self->motion / DRD_FRAME_RATE_GOVERNOR_FULL_MOTION_RATIO, 1.0);
+    ceiling = MIN(ceiling, (gdouble) low_motion_fps + (gdouble) (self->max_fps - low_motion_fps) * motion);
+
+    const guint target = CLAMP((guint) (ceiling + 0.5), self->min_fps, self->max_fps);
+    guint next = target;
+    if (target > self->current_fps)
+    {
+        next = MIN(target, self->current_fps + MAX(self->current_fps / 4, 2u));
+    }
+
+    if (next == self->current_fps)
+    {
+        return FALSE;
+    }
+
+    self->current_fps = next;
+    return TRUE;
+}
+
+/*
+ * 功能：获取当前有效帧率。
+ * 逻辑：返回最近一次评估结果。
+ * 参数：self 调节器。
+ * 外部接口：无。
+ */
+guint
+drd_frame_rate_governor_get_fps(DrdFrameRateGovernor *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+    return self->current_fps;
+}
+
+/*
+ * 功能：获取当前有效帧间隔（微秒）。
+ * 逻辑：按 current_fps 换算。
+ * 参数：self 调节器。
+ * 外部接口：无。
+ */
+gint64
+drd_frame_rate_governor_get_interval_us(DrdFrameRateGovernor *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+    return G_USEC_PER_SEC / (gint64) MAX(self->current_fps, 1u);
+}
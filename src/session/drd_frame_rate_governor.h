@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * 会话级帧率调节器：结合客户端 ACK 吞吐、解码耗时（QoE）与画面变化比例，
+ * 在 [min_fps, max_fps] 内给出当前会话的有效采集/编码帧率。
+ */
+typedef struct _DrdFrameRateGovernor DrdFrameRateGovernor;
+
+typedef struct
+{
+    guint64 frames_sent;     /* 累计已提交帧数 */
+    guint64 frames_acked;    /* 累计收到 FrameAcknowledge 的帧数 */
+    gboolean acks_suspended; /* 客户端暂停 ACK 时不以 ACK 吞吐限速 */
+    guint32 decode_time_us;  /* 客户端解码耗时（QoE p95），0 表示未知 */
+    gdouble change_ratio;    /* 最近一帧脏 tile 占比 */
+} DrdFrameRateSample;
+
+DrdFrameRateGovernor *drd_frame_rate_governor_new(guint max_fps, guint min_fps);
+void drd_frame_rate_governor_free(DrdFrameRateGovernor *self);
+
+void drd_frame_rate_governor_reset(DrdFrameRateGovernor *self);
+gboolean drd_frame_rate_governor_update(DrdFrameRateGovernor *self, gint64 now_us, const DrdFrameRateSample *sample);
+guint drd_frame_rate_governor_get_fps(DrdFrameRateGovernor *self);
+gint64 drd_frame_rate_governor_get_interval_us(DrdFrameRateGovernor *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdFrameRateGovernor, drd_frame_rate_governor_free)
+
+G_END_DECLS
@@ -0,0 +1,950 @@
+#include "session/drd_gfx_broadcast.h"
+
+#include <gio/gio.h>
+
+#include "utils/drd_log.h"
+
+/* 分发线程单次等待上限，用于及时响应停止 */
+#define DRD_GFX_BROADCAST_POLL_US (16 * G_TIME_SPAN_MILLISECOND)
+/* 其他观看者已收下本帧后，慢观看者邮箱最多再等待这么久，超时即跳到下一关键帧 */
+#define DRD_GFX_BROADCAST_LAG_BUDGET_US (33 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct _DrdGfxEncodeGroup DrdGfxEncodeGroup;
+
+struct _DrdGfxViewer
+{
+    DrdGfxBroadcast *broadcast;
+    DrdGfxEncodeGroup *group;       /* 所属编码组，加入后不变 */
+    rdpSettings *settings;          /* 会话对端设置，生命周期由会话保证 */
+    DrdEncodedGfxFrame *pending;    /* 深度 1 邮箱，受 broadcast->lock 保护 */
+    guint64 fanout_serial;          /* 最近处理过的分发序号，同一帧只投递或跳过一次 */
+    guint64 resume_sequence;        /* 已从关键帧缓存收下的编码序号，不大于它的在途帧直接略过 */
+    gboolean awaiting_keyframe;     /* 参考链已断开，只接受关键帧 */
+    gboolean keyframe_requested;    /* 等待期间已请求过关键帧 */
+    gint primary;                   /* 是否为组内主观看者，broadcast->lock 下随成员变化更新，每帧路径原子读取 */
+    DrdGfxViewerStats stats;
+};
+
+/*
+ * 编码组：编码能力一致的观看者共享一个编码器（差分状态、编解码上下文、刷新计时与关键帧缓存）
+ * 及其分阶段流水线；能力不同的会话各自成组，互不改写对方的编码状态。
+ */
+struct _DrdGfxEncodeGroup
+{
+    DrdGfxBroadcast *broadcast;
+    DrdEncodingManager *encoder;         /* 本组独占 */
+    DrdEncodeSchedulerClient *scheduler; /* 本组在编码调度器上的客户端，权重为组内观看者数 */
+    DrdStagePipeline *pipeline;          /* 受 pipeline_lock 保护，由持 restarting 标记的线程发布、control_lock 下摘除 */
+    GMutex pipeline_lock;                /* 只保护 pipeline 指针及每帧的统计/刷新调用，在 control_lock 之后获取 */
+    GThread *fanout_thread;              /* 受 broadcast->control_lock 保护，restarting 期间归发起者 */
+    gboolean restarting;                 /* 流水线正在锁外回收或启动，由发起者负责收尾，受 control_lock 保护 */
+    GCond cond;                          /* 本组邮箱投递/腾空时广播，配合 broadcast->lock */
+    GPtrArray *viewers;                  /* 首个元素为本组主观看者，受 broadcast->lock 保护 */
+    gint running;
+    guint64 fanout_serial;
+};
+
+struct _DrdGfxBroadcast
+{
+    DrdServerRuntime *runtime; /* 不持有引用：广播由运行时持有 */
+    GMutex control_lock;       /* 串行化加入/离开的成员变化，不在持有期间准备编码器或启动线程 */
+    GCond control_cond;        /* 编码组结束锁外启停时广播，配合 control_lock */
+    GMutex lock;               /* 保护编码组列表、各组观看者列表与各邮箱 */
+    GPtrArray *groups;         /* 编码组列表，按创建顺序排列 */
+};
+
+/*
+ * 功能：判断新观看者能否共享编码组的编码器。
+ * 逻辑：Rdpgfx 编码器按组内主观看者协商的能力选择，新观看者的 AVC/RemoteFX/Progressive 能力须与之一致。
+ * 参数：primary 主观看者设置；candidate 新观看者设置。
+ * 外部接口：FreeRDP freerdp_settings_get_bool/get_uint32。
+ */
+static gboolean drd_gfx_broadcast_codecs_compatible(rdpSettings *primary, rdpSettings *candidate)
+{
+    static const FreeRDP_Settings_Keys_Bool keys[] = {
+            FreeRDP_GfxH264, FreeRDP_GfxAVC444, FreeRDP_GfxAVC444v2, FreeRDP_RemoteFxCodec, FreeRDP_GfxProgressive,
+    };
+
+    for (gsize i = 0; i < G_N_ELEMENTS(keys); ++i)
+    {
+        if (freerdp_settings_get_bool(primary, keys[i]) != freerdp_settings_get_bool(candidate, keys[i]))
+        {
+            return FALSE;
+        }
+    }
+    return (freerdp_settings_get_uint32(primary, FreeRDP_RemoteFxCodecId) != 0) ==
+           (freerdp_settings_get_uint32(candidate, FreeRDP_RemoteFxCodecId) != 0);
+}
+
+/*
+ * 功能：标记观看者参考链断开，只接受下一关键帧。
+ * 逻辑：须持 lock 调用；清除已请求标记，由分发线程在邮箱空闲时再请求关键帧。
+ * 参数：viewer 观看者。
+ * 外部接口：无。
+ */
+static void drd_gfx_broadcast_mark_awaiting(DrdGfxViewer *viewer)
+{
+    viewer->awaiting_keyframe = TRUE;
+    viewer->keyframe_requested = FALSE;
+}
+
+/*
+ * 功能：用缓存的关键帧让观看者立即（重新）接上参考链。
+ * 逻辑：须持 lock 且邮箱为空时调用；缓存有效说明该关键帧是本组编码器最近一次编码的产物，编码交接槽与分发中的帧
+ *       编码序号都不大于它，记下序号后由分发跳过这些在途帧，之后的增量直接接续。
+ * 参数：group 编码组；viewer 观看者。
+ * 外部接口：drd_encoding_manager_lookup_keyframe；drd_encoded_gfx_frame_get_sequence；GLib g_cond_broadcast。
+ * 返回：缓存命中并已投递时返回 TRUE。
+ */
+static gboolean drd_gfx_broadcast_seed_keyframe_locked(DrdGfxEncodeGroup *group, DrdGfxViewer *viewer)
+{
+    DrdEncodedGfxFrame *cached =
+            drd_encoding_manager_lookup_keyframe(group->encoder, DRD_ENCODING_CODEC_CLASS_UNKNOWN);
+    if (cached == NULL)
+    {
+        return FALSE;
+    }
+
+    viewer->pending = cached;
+    viewer->resume_sequence = drd_encoded_gfx_frame_get_sequence(cached);
+    viewer->awaiting_keyframe = FALSE;
+    viewer->keyframe_requested = FALSE;
+    viewer->stats.delivered_frames++;
+    viewer->stats.cached_keyframes++;
+    g_cond_broadcast(&group->cond);
+    return TRUE;
+}
+
+/*
+ * 功能：把一个编码帧分发给编码组内全部观看者。
+ * 逻辑：持锁逐个处理：已从缓存收下更新关键帧的观看者略过本帧；等待关键帧的观看者跳过非关键帧
+ *       （邮箱已空时先尝试缓存关键帧，未命中再请求一次关键帧），邮箱空闲的直接投递引用；
+ *       仍有邮箱未腾空时等待消费。已有观看者收下本帧且等待超过滞后预算后，把仍满的观看者跳到下一关键帧；
+ *       组内只有一名观看者或无人收下时持续等待，背压经编码交接槽传回本组编码阶段。
+ * 参数：group 编码组；frame 编码帧（调用方持有引用）。
+ * 外部接口：drd_encoded_gfx_frame_ref/is_keyframe/get_sequence；drd_encoding_manager_force_keyframe；
+ *           GLib g_cond_wait_until。
+ */
+static void drd_gfx_broadcast_fan_out(DrdGfxEncodeGroup *group, DrdEncodedGfxFrame *frame)
+{
+    DrdGfxBroadcast *self = group->broadcast;
+    const gboolean keyframe = drd_encoded_gfx_frame_is_keyframe(frame);
+    const guint64 sequence = drd_encoded_gfx_frame_get_sequence(frame);
+    const gint64 lag_deadline = g_get_monotonic_time() + DRD_GFX_BROADCAST_LAG_BUDGET_US;
+    gboolean delivered = FALSE;
+    gboolean request_keyframe = FALSE;
+
+    g_mutex_lock(&self->lock);
+    const guint64 serial = ++group->fanout_serial;
+    while (g_atomic_int_get(&group->running))
+    {
+        guint blocked = 0;
+        gboolean woke = FALSE;
+        for (guint i = 0; i < group->viewers->len; ++i)
+        {
+            DrdGfxViewer *viewer = g_ptr_array_index(group->viewers, i);
+            if (viewer->fanout_serial == serial)
+            {
+                continue;
+            }
+            if (sequence <= viewer->resume_sequence)
+            {
+                viewer->fanout_serial = serial;
+                continue;
+            }
+
+            if (viewer->awaiting_keyframe && !keyframe)
+            {
+                viewer->fanout_serial = serial;
+                viewer->stats.skipped_frames++;
+                if (viewer->pending == NULL && !viewer->keyframe_requested &&
+                    !drd_gfx_broadcast_seed_keyframe_locked(group, viewer))
+                {
+                    viewer->keyframe_requested = TRUE;
+                    viewer->stats.keyframe_waits++;
+                    request_keyframe = TRUE;
+                }
+                continue;
+            }
+
+            if (viewer->pending != NULL)
+            {
+                blocked++;
+                continue;
+            }
+
+            viewer->pending = drd_encoded_gfx_frame_ref(frame);
+            viewer->fanout_serial = serial;
+            viewer->awaiting_keyframe = FALSE;
+            viewer->keyframe_requested = FALSE;
+            viewer->stats.delivered_frames++;
+            delivered = TRUE;
+            woke = TRUE;
+        }
+
+        if (woke)
+        {
+            g_cond_broadcast(&group->cond);
+        }
+        if (blocked == 0)
+        {
+            break;
+        }
+
+        const gboolean may_skip = delivered && group->viewers->len > 1;
+        if (may_skip && g_get_monotonic_time() >= lag_deadline)
+        {
+            for (guint i = 0; i < group->viewers->len; ++i)
+            {
+                DrdGfxViewer *viewer = g_ptr_array_index(group->viewers, i);
+                if (viewer->fanout_serial != serial)
+                {
+                    viewer->fanout_serial = serial;
+                    viewer->stats.skipped_frames++;
+                    viewer->stats.lag_events++;
+                    drd_gfx_broadcast_mark_awaiting(viewer);
+                }
+            }
+            break;
+        }
+
+        const gint64 poll_deadline = g_get_monotonic_time() + DRD_GFX_BROADCAST_POLL_US;
+        g_cond_wait_until(&group->cond, &self->lock, may_skip ? MIN(lag_deadline, poll_deadline) : poll_deadline);
+    }
+    g_mutex_unlock(&self->lock);
+
+    if (request_keyframe)
+    {
+        drd_encoding_manager_force_keyframe(group->encoder);
+    }
+}
+
+/* 分发线程的启动参数：流水线指针在线程启动时固定，control_lock 下摘除 group->pipeline 不影响仍在退出中的线程 */
+typedef struct
+{
+    DrdGfxEncodeGroup *group;
+    DrdStagePipeline *pipeline;
+} DrdGfxFanoutArgs;
+
+/*
+ * 功能：编码组分发线程主循环。
+ * 逻辑：从启动时绑定的流水线编码交接槽取帧并分发，取走后编码线程即可继续；分发阻塞期间编码交接槽保持满，背压自然传导。
+ * 参数：user_data 分发线程参数，线程退出时释放。
+ * 外部接口：drd_stage_pipeline_wait_encoded；drd_encoded_gfx_frame_unref。
+ */
+static gpointer drd_gfx_broadcast_fanout_thread(gpointer user_data)
+{
+    DrdGfxFanoutArgs *args = user_data;
+    DrdGfxEncodeGroup *group = args->group;
+
+    while (g_atomic_int_get(&group->running))
+    {
+        g_autoptr(DrdEncodedGfxFrame) frame = NULL;
+        if (!drd_stage_pipeline_wait_encoded(args->pipeline, DRD_GFX_BROADCAST_POLL_US, &frame))
+        {
+            continue;
+        }
+        drd_gfx_broadcast_fan_out(group, frame);
+    }
+
+    g_free(args);
+    return NULL;
+}
+
+/*
+ * 功能：把编码组的分发线程与流水线从编码组上摘下。
+ * 逻辑：须持 control_lock 调用；清除运行标志并唤醒分发线程，在 pipeline_lock 下摘除流水线指针，把线程与流水线交给
+ *       调用方，在释放 control_lock 后经 drd_gfx_broadcast_group_reap 回收，join 期间其他会话的加入/离开与统计
+ *       不被阻塞；编码器保留，重建流水线时沿用。
+ * 参数：group 编码组；out_pipeline/out_thread 输出待回收的流水线与分发线程（可能为 NULL）。
+ * 外部接口：GLib g_cond_broadcast。
+ */
+static void drd_gfx_broadcast_group_detach_locked(DrdGfxEncodeGroup *group, DrdStagePipeline **out_pipeline,
+                                                  GThread **out_thread)
+{
+    DrdGfxBroadcast *self = group->broadcast;
+
+    g_mutex_lock(&self->lock);
+    g_atomic_int_set(&group->running, 0);
+    g_cond_broadcast(&group->cond);
+    g_mutex_unlock(&self->lock);
+
+    *out_thread = g_steal_pointer(&group->fanout_thread);
+    g_mutex_lock(&group->pipeline_lock);
+    *out_pipeline = g_steal_pointer(&group->pipeline);
+    g_mutex_unlock(&group->pipeline_lock);
+}
+
+/*
+ * 功能：回收摘下的分发线程与流水线。
+ * 逻辑：不持任何广播锁调用；先 join 分发线程（它仍在读取流水线），再释放流水线（其内部线程随之停止，捕获订阅一并注销）。
+ * 参数：pipeline 流水线，可为 NULL；fanout_thread 分发线程，可为 NULL。
+ * 外部接口：GLib g_thread_join；drd_stage_pipeline_free。
+ */
+static void drd_gfx_broadcast_group_reap(DrdStagePipeline *pipeline, GThread *fanout_thread)
+{
+    if (fanout_thread != NULL)
+    {
+        g_thread_join(fanout_thread);
+    }
+    g_clear_pointer(&pipeline, drd_stage_pipeline_free);
+}
+
+/*
+ * 功能：按组内主观看者设置启动流水线与分发线程。
+ * 逻辑：不持 control_lock 调用，调用方须独占编码组（尚未发布，或持 restarting 标记）且旧的分发线程已回收；
+ *       流水线使用本组编码器并订阅共享捕获，启动成功后才在 pipeline_lock 下发布，每帧路径不会看到未启动的流水线；
+ *       启动失败或分发线程创建失败时回滚并返回错误（回滚只停止刚启动的流水线线程）。
+ * 参数：group 编码组；settings 主观看者对端设置；error 错误输出。
+ * 外部接口：drd_stage_pipeline_new/start；GLib g_thread_try_new。
+ */
+static gboolean drd_gfx_broadcast_group_start(DrdGfxEncodeGroup *group, rdpSettings *settings, GError **error)
+{
+    DrdStagePipeline *pipeline =
+            drd_stage_pipeline_new(group->broadcast->runtime, group->encoder, group->scheduler, settings);
+    if (!drd_stage_pipeline_start(pipeline, error))
+    {
+        drd_stage_pipeline_free(pipeline);
+        return FALSE;
+    }
+
+    DrdGfxFanoutArgs *args = g_new0(DrdGfxFanoutArgs, 1);
+    args->group = group;
+    args->pipeline = pipeline;
+    g_atomic_int_set(&group->running, 1);
+    GThread *fanout_thread = g_thread_try_new("drd-gfx-fanout", drd_gfx_broadcast_fanout_thread, args, error);
+    if (fanout_thread == NULL)
+    {
+        g_free(args);
+        g_atomic_int_set(&group->running, 0);
+        drd_stage_pipeline_free(pipeline);
+        return FALSE;
+    }
+
+    group->fanout_thread = fanout_thread;
+    g_mutex_lock(&group->pipeline_lock);
+    group->pipeline = pipeline;
+    g_mutex_unlock(&group->pipeline_lock);
+    return TRUE;
+}
+
+/*
+ * 功能：判断编码组的流水线是否在运行。
+ * 逻辑：持 pipeline_lock 读取流水线指针。
+ * 参数：group 编码组。
+ * 外部接口：无。
+ */
+static gboolean drd_gfx_broadcast_group_has_pipeline(DrdGfxEncodeGroup *group)
+{
+    g_mutex_lock(&group->pipeline_lock);
+    const gboolean running = group->pipeline != NULL;
+    g_mutex_unlock(&group->pipeline_lock);
+    return running;
+}
+
+/*
+ * 功能：释放 control_lock 重启编码组流水线，完成后重新获取。
+ * 逻辑：须持 control_lock 且已置 restarting 调用；锁外按主观看者设置启动流水线（restarting 期间主观看者的离开会等待，
+ *       其设置保持有效），重新持锁后清除 restarting 并广播 control_cond，唤醒等待的离开者。
+ * 参数：self 广播；group 编码组；settings 主观看者对端设置；error 错误输出。
+ * 外部接口：GLib g_cond_broadcast。
+ * 返回：流水线启动成功返回 TRUE；返回时仍持 control_lock。
+ */
+static gboolean drd_gfx_broadcast_group_restart_unlocked(DrdGfxBroadcast *self, DrdGfxEncodeGroup *group,
+                                                         rdpSettings *settings, GError **error)
+{
+    g_mutex_unlock(&self->control_lock);
+    const gboolean started = drd_gfx_broadcast_group_start(group, settings, error);
+    g_mutex_lock(&self->control_lock);
+    group->restarting = FALSE;
+    g_cond_broadcast(&self->control_cond);
+    return started;
+}
+
+/*
+ * 功能：释放编码组。
+ * 逻辑：编码组已移出广播、其他线程不再可达时调用，无需持 control_lock；摘下并回收仍在运行的流水线后注销调度客户端，
+ *       释放编码器上下文与残留观看者。
+ * 参数：group 编码组。
+ * 外部接口：drd_encode_scheduler_unregister；drd_encoding_manager_reset；drd_encoded_gfx_frame_unref；
+ *           GLib g_object_unref/g_ptr_array_unref/g_cond_clear。
+ */
+static void drd_gfx_broadcast_group_free(DrdGfxEncodeGroup *group)
+{
+    DrdStagePipeline *pipeline = NULL;
+    GThread *fanout_thread = NULL;
+    drd_gfx_broadcast_group_detach_locked(group, &pipeline, &fanout_thread);
+    drd_gfx_broadcast_group_reap(pipeline, fanout_thread);
+    g_clear_pointer(&group->scheduler, drd_encode_scheduler_unregister);
+
+    for (guint i = 0; i < group->viewers->len; ++i)
+    {
+        DrdGfxViewer *viewer = g_ptr_array_index(group->viewers, i);
+        g_clear_pointer(&viewer->pending, drd_encoded_gfx_frame_unref);
+        g_free(viewer);
+    }
+    g_ptr_array_unref(group->viewers);
+    drd_encoding_manager_reset(group->encoder);
+    g_clear_object(&group->encoder);
+    g_cond_clear(&group->cond);
+    g_mutex_clear(&group->pipeline_lock);
+    g_free(group);
+}
+
+/*
+ * 功能：为一组编码能力创建独立的编码器并启动流水线。
+ * 逻辑：不持任何广播锁调用，编码组发布前只有调用方可达；按运行时缓存的编码配置准备新编码器（编解码上下文在首帧
+ *       编码时按需创建），登记为编码调度器的客户端，随后以主观看者设置启动流水线；任一步失败即释放并返回错误。
+ * 参数：self 广播；settings 组内主观看者对端设置；error 错误输出。
+ * 外部接口：drd_server_runtime_get_encoding_options/get_encode_scheduler；drd_encoding_manager_new/prepare；
+ *           drd_encode_scheduler_register；GLib g_set_error_literal。
+ * 返回：已启动的编码组（尚未登记到广播），失败返回 NULL。
+ */
+static DrdGfxEncodeGroup *drd_gfx_broadcast_group_new(DrdGfxBroadcast *self, rdpSettings *settings, GError **error)
+{
+    DrdEncodingOptions options;
+    if (!drd_server_runtime_get_encoding_options(self->runtime, &options))
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED, "Encoding options are not configured");
+        return NULL;
+    }
+
+    DrdGfxEncodeGroup *group = g_new0(DrdGfxEncodeGroup, 1);
+    group->broadcast = self;
+    group->encoder = drd_encoding_manager_new();
+    group->scheduler = drd_encode_scheduler_register(drd_server_runtime_get_encode_scheduler(self->runtime), 1);
+    group->viewers = g_ptr_array_new();
+    g_cond_init(&group->cond);
+    g_mutex_init(&group->pipeline_lock);
+
+    if (!drd_encoding_manager_prepare(group->encoder, &options, error) ||
+        !drd_gfx_broadcast_group_start(group, settings, error))
+    {
+        /* 启动失败时没有运行中的线程，释放不会 join */
+        drd_gfx_broadcast_group_free(group);
+        return NULL;
+    }
+    return group;
+}
+
+/*
+ * 功能：创建广播（不启动线程）。
+ * 逻辑：观看者加入时才按其编码能力创建编码组并启动流水线。
+ * 参数：runtime 服务运行时（不持有引用，广播随运行时销毁）。
+ * 外部接口：GLib g_new0/g_mutex_init/g_ptr_array_new。
+ */
+DrdGfxBroadcast *drd_gfx_broadcast_new(DrdServerRuntime *runtime)
+{
+    g_return_val_if_fail(DRD_IS_SERVER_RUNTIME(runtime), NULL);
+
+    DrdGfxBroadcast *self = g_new0(DrdGfxBroadcast, 1);
+    self->runtime = runtime;
+    g_mutex_init(&self->control_lock);
+    g_cond_init(&self->control_cond);
+    g_mutex_init(&self->lock);
+    self->groups = g_ptr_array_new();
+    return self;
+}
+
+/*
+ * 功能：释放广播。
+ * 逻辑：持锁摘下全部编码组后在锁外逐个停止并释放；此时所有会话应已离开，残留观看者一并释放。
+ * 参数：self 广播，可为 NULL。
+ * 外部接口：GLib g_ptr_array_unref/g_mutex_clear。
+ */
+void drd_gfx_broadcast_free(DrdGfxBroadcast *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock(&self->control_lock);
+    g_mutex_lock(&self->lock);
+    g_autoptr(GPtrArray) groups = g_steal_pointer(&self->groups);
+    self->groups = g_ptr_array_new();
+    g_mutex_unlock(&self->lock);
+    g_mutex_unlock(&self->control_lock);
+
+    for (guint i = groups->len; i > 0; --i)
+    {
+        drd_gfx_broadcast_group_free(g_ptr_array_index(groups, i - 1));
+    }
+
+    g_ptr_array_unref(self->groups);
+    g_mutex_clear(&self->lock);
+    g_cond_clear(&self->control_cond);
+    g_mutex_clear(&self->control_lock);
+    g_free(self);
+}
+
+/*
+ * 功能：查找编码能力一致的编码组。
+ * 逻辑：须持 control_lock 调用；持 lock 比较各组主观看者的编码能力。
+ * 参数：self 广播；settings 新观看者对端设置；out_primary_settings 输出命中组的主观看者设置。
+ * 外部接口：无。
+ * 返回：命中的编码组，没有时返回 NULL。
+ */
+static DrdGfxEncodeGroup *drd_gfx_broadcast_find_group_locked(DrdGfxBroadcast *self, rdpSettings *settings,
+                                                              rdpSettings **out_primary_settings)
+{
+    DrdGfxEncodeGroup *group = NULL;
+    g_mutex_lock(&self->lock);
+    for (guint i = 0; i < self->groups->len && group == NULL; ++i)
+    {
+        DrdGfxEncodeGroup *candidate = g_ptr_array_index(self->groups, i);
+        DrdGfxViewer *primary = g_ptr_array_index(candidate->viewers, 0);
+        if (drd_gfx_broadcast_codecs_compatible(primary->settings, settings))
+        {
+            group = candidate;
+            *out_primary_settings = primary->settings;
+        }
+    }
+    g_mutex_unlock(&self->lock);
+    return group;
+}
+
+/*
+ * 功能：会话加入广播成为观看者。
+ * 逻辑：优先并入编码能力一致的已有编码组，共享其编码；没有时新建编码组（独立编码器与流水线，共享同一路捕获），
+ *       不同能力的会话互不改写编码状态。编码器准备与线程启动都在 control_lock 外完成：新建编码组在锁外准备好，
+ *       重新持锁后若并发加入已建好同能力的编码组则并入它并丢弃本次新建的；已停止的编码组置 restarting 后锁外重启。
+ *       新观看者从关键帧开始接收：本组关键帧缓存有效时直接投递缓存帧，首帧耗时只取决于网络；否则请求一次关键帧
+ *       （组内已在观看的会话随之多收一个关键帧）。
+ * 参数：self 广播；settings 会话对端设置（离开前须保持有效）；error 错误输出。
+ * 外部接口：drd_encoding_manager_force_keyframe；日志 DRD_LOG_MESSAGE。
+ * 返回：观看者句柄，离开时交给 drd_gfx_broadcast_leave。
+ */
+DrdGfxViewer *drd_gfx_broadcast_join(DrdGfxBroadcast *self, rdpSettings *settings, GError **error)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+    g_return_val_if_fail(settings != NULL, NULL);
+
+    rdpSettings *group_settings = NULL;
+    g_mutex_lock(&self->control_lock);
+    DrdGfxEncodeGroup *group = drd_gfx_broadcast_find_group_locked(self, settings, &group_settings);
+    g_mutex_unlock(&self->control_lock);
+
+    DrdGfxEncodeGroup *fresh = NULL;
+    if (group == NULL)
+    {
+        fresh = drd_gfx_broadcast_group_new(self, settings, error);
+        if (fresh == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    g_mutex_lock(&self->control_lock);
+    group = drd_gfx_broadcast_find_group_locked(self, settings, &group_settings);
+    const gboolean created = group == NULL;
+    if (created)
+    {
+        group = g_steal_pointer(&fresh);
+    }
+    else if (!group->restarting && !drd_gfx_broadcast_group_has_pipeline(group))
+    {
+        /* 主观看者离开后重建失败的编码组，借本次加入重试；正在锁外回收的编码组由发起者重建 */
+        group->restarting = TRUE;
+        if (!drd_gfx_broadcast_group_restart_unlocked(self, group, group_settings, error))
+        {
+            g_mutex_unlock(&self->control_lock);
+            g_clear_pointer(&fresh, drd_gfx_broadcast_group_free);
+            return NULL;
+        }
+    }
+
+    DrdGfxViewer *viewer = g_new0(DrdGfxViewer, 1);
+    viewer->broadcast = self;
+    viewer->group = group;
+    viewer->settings = settings;
+
+    g_mutex_lock(&self->lock);
+    if (created)
+    {
+        g_ptr_array_add(self->groups, group);
+    }
+    viewer->fanout_serial = group->fanout_serial;
+    drd_gfx_broadcast_mark_awaiting(viewer);
+    g_ptr_array_add(group->viewers, viewer);
+    const guint group_viewers = group->viewers->len;
+    g_atomic_int_set(&viewer->primary, group_viewers == 1);
+    drd_encode_scheduler_client_set_weight(group->scheduler, group_viewers);
+    const guint groups = self->groups->len;
+    const gboolean seeded = drd_gfx_broadcast_seed_keyframe_locked(group, viewer);
+    g_mutex_unlock(&self->lock);
+    if (!seeded)
+    {
+        drd_encoding_manager_force_keyframe(group->encoder);
+    }
+    g_mutex_unlock(&self->control_lock);
+
+    /* 并发加入已建好同能力的编码组，本次新建的未发布，锁外回收 */
+    g_clear_pointer(&fresh, drd_gfx_broadcast_group_free);
+
+    DRD_LOG_MESSAGE("Rdpgfx viewer joined %s encoder (%u viewer(s) in group, %u group(s))",
+                    created ? "a new" : "a shared", group_viewers, groups);
+    return viewer;
+}
+
+/*
+ * 功能：锁外回收完成后重建或释放编码组。
+ * 逻辑：由摘下旧流水线的 leave 调用，此时旧线程已 join；重新持 control_lock，组内已无观看者（编码组已移出广播）
+ *       则释放编码组，否则按当前主观看者设置在锁外重建流水线并请求关键帧，完成后清除 restarting。
+ * 参数：self 广播；group 编码组。
+ * 外部接口：drd_encoding_manager_force_keyframe；日志 DRD_LOG_WARNING。
+ */
+static void drd_gfx_broadcast_group_finish_restart(DrdGfxBroadcast *self, DrdGfxEncodeGroup *group)
+{
+    g_mutex_lock(&self->control_lock);
+    g_mutex_lock(&self->lock);
+    rdpSettings *settings =
+            group->viewers->len > 0 ? ((DrdGfxViewer *) g_ptr_array_index(group->viewers, 0))->settings : NULL;
+    g_mutex_unlock(&self->lock);
+
+    if (settings == NULL)
+    {
+        g_mutex_unlock(&self->control_lock);
+        drd_gfx_broadcast_group_free(group);
+        return;
+    }
+
+    g_autoptr(GError) error = NULL;
+    if (!drd_gfx_broadcast_group_restart_unlocked(self, group, settings, &error))
+    {
+        DRD_LOG_WARNING("Failed to restart group encoder for remaining viewers: %s",
+                        error != NULL ? error->message : "unknown error");
+    }
+    drd_encoding_manager_force_keyframe(group->encoder);
+    g_mutex_unlock(&self->control_lock);
+}
+
+/*
+ * 功能：观看者离开广播。
+ * 逻辑：编码组正在锁外启停时先在 control_cond 上等待其完成（启动中的流水线引用主观看者设置，须在其离开前就绪）；
+ *       随后移出所属编码组并释放邮箱中的帧，新的组内首位标记为主观看者；组内最后一名观看者离开时停止流水线
+ *       并释放该组编码器。主观看者离开而组内仍有其他观看者时，流水线引用的对端设置即将失效，沿用本组编码器
+ *       按新的主观看者设置重建流水线；重建丢弃了交接槽中的帧，组内剩余观看者都改为等待关键帧。
+ *       旧流水线在 control_lock 内摘下，释放锁后 join 并在锁外重建，其他会话的加入/离开与每帧路径不必等待；
+ *       期间编码组标记为 restarting，由本次调用负责收尾。
+ * 参数：self 广播；viewer 观看者，可为 NULL，调用后失效。
+ * 外部接口：drd_stage_pipeline_*；drd_encoding_manager_force_keyframe；GLib g_cond_wait；日志 DRD_LOG_*。
+ */
+void drd_gfx_broadcast_leave(DrdGfxBroadcast *self, DrdGfxViewer *viewer)
+{
+    g_return_if_fail(self != NULL);
+
+    if (viewer == NULL)
+    {
+        return;
+    }
+
+    DrdGfxEncodeGroup *group = viewer->group;
+    g_mutex_lock(&self->control_lock);
+    while (group->restarting)
+    {
+        g_cond_wait(&self->control_cond, &self->control_lock);
+    }
+    g_mutex_lock(&self->lock);
+    const gboolean was_primary = g_ptr_array_index(group->viewers, 0) == viewer;
+    g_ptr_array_remove(group->viewers, viewer);
+    g_clear_pointer(&viewer->pending, drd_encoded_gfx_frame_unref);
+    const guint remaining = group->viewers->len;
+    if (remaining == 0)
+    {
+        g_ptr_array_remove(self->groups, group);
+    }
+    else
+    {
+        drd_encode_scheduler_client_set_weight(group->scheduler, remaining);
+    }
+    if (remaining > 0 && was_primary)
+    {
+        g_atomic_int_set(&((DrdGfxViewer *) g_ptr_array_index(group->viewers, 0))->primary, TRUE);
+        for (guint i = 0; i < group->viewers->len; ++i)
+        {
+            drd_gfx_broadcast_mark_awaiting(g_ptr_array_index(group->viewers, i));
+        }
+    }
+    const guint groups = self->groups->len;
+    g_cond_broadcast(&group->cond);
+    g_mutex_unlock(&self->lock);
+
+    DrdStagePipeline *pipeline = NULL;
+    GThread *fanout_thread = NULL;
+    const gboolean teardown = remaining == 0 || was_primary;
+    if (teardown)
+    {
+        group->restarting = TRUE;
+        drd_gfx_broadcast_group_detach_locked(group, &pipeline, &fanout_thread);
+    }
+    g_mutex_unlock(&self->control_lock);
+
+    if (teardown)
+    {
+        drd_gfx_broadcast_group_reap(pipeline, fanout_thread);
+        drd_gfx_broadcast_group_finish_restart(self, group);
+    }
+
+    DRD_LOG_MESSAGE("Rdpgfx viewer left encoder group (%u viewer(s) remaining in group, %u group(s))",
+                    remaining, groups);
+    g_free(viewer);
+}
+
+/*
+ * 功能：统计全部编码组的观看者总数。
+ * 逻辑：持锁累加各组观看者数。
+ * 参数：self 广播。
+ * 外部接口：无。
+ */
+guint drd_gfx_broadcast_get_viewer_count(DrdGfxBroadcast *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+
+    guint count = 0;
+    g_mutex_lock(&self->lock);
+    for (guint i = 0; i < self->groups->len; ++i)
+    {
+        count += ((DrdGfxEncodeGroup *) g_ptr_array_index(self->groups, i))->viewers->len;
+    }
+    g_mutex_unlock(&self->lock);
+    return count;
+}
+
+guint drd_gfx_broadcast_get_group_count(DrdGfxBroadcast *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+
+    g_mutex_lock(&self->lock);
+    const guint count = self->groups->len;
+    g_mutex_unlock(&self->lock);
+    return count;
+}
+
+/*
+ * 功能：判断观看者是否为所在编码组的主观看者。
+ * 逻辑：组内首个元素为主观看者，其反馈驱动本组编码器的码率控制；身份在加入/离开时随成员变化更新，
+ *       每帧调用只原子读取缓存的标记，不取广播锁。
+ * 参数：viewer 观看者。
+ * 外部接口：GLib g_atomic_int_get。
+ */
+gboolean drd_gfx_viewer_is_primary(DrdGfxViewer *viewer)
+{
+    g_return_val_if_fail(viewer != NULL, FALSE);
+
+    return g_atomic_int_get(&viewer->primary);
+}
+
+/*
+ * 功能：获取观看者所在编码组的编码器。
+ * 逻辑：编码组在组内仍有观看者期间不会释放，观看者离开前返回值持续有效；跨线程长期持有须自行加引用。
+ * 参数：viewer 观看者。
+ * 外部接口：无。
+ */
+DrdEncodingManager *drd_gfx_viewer_get_encoder(DrdGfxViewer *viewer)
+{
+    g_return_val_if_fail(viewer != NULL, NULL);
+
+    return viewer->group->encoder;
+}
+
+/*
+ * 功能：请求一次全量关键帧刷新。
+ * 逻辑：转交所在编码组的流水线，刷新帧分发给组内全部观看者。
+ * 参数：viewer 观看者。
+ * 外部接口：drd_stage_pipeline_request_refresh。
+ */
+void drd_gfx_viewer_request_refresh(DrdGfxViewer *viewer)
+{
+    g_return_if_fail(viewer != NULL);
+
+    DrdGfxEncodeGroup *group = viewer->group;
+    g_mutex_lock(&group->pipeline_lock);
+    if (group->pipeline != NULL)
+    {
+        drd_stage_pipeline_request_refresh(group->pipeline);
+    }
+    g_mutex_unlock(&group->pipeline_lock);
+}
+
+/*
+ * 功能：观看者确认有发送容量后授予捕获一次抓帧额度。
+ * 逻辑：任一观看者授信即可抓帧，该帧投递到全部编码组；捕获节奏跟随最快的观看者，慢者靠跳帧追赶。
+ * 参数：viewer 观看者。
+ * 外部接口：drd_capture_manager_grant_credit。
+ */
+void drd_gfx_viewer_grant_capture_credit(DrdGfxViewer *viewer)
+{
+    g_return_if_fail(viewer != NULL);
+
+    drd_capture_manager_grant_credit(drd_server_runtime_get_capture(viewer->broadcast->runtime));
+}
+
+/*
+ * 功能：观看者取下一帧编码结果。
+ * 逻辑：带超时等待邮箱投递，取走后唤醒可能在等待腾空的本组分发线程。
+ * 参数：viewer 观看者；timeout_us 超时（微秒）；out_frame 输出编码帧（调用方释放引用）。
+ * 外部接口：GLib g_cond_wait_until/g_cond_broadcast。
+ */
+gboolean drd_gfx_viewer_wait_encoded(DrdGfxViewer *viewer, gint64 timeout_us, DrdEncodedGfxFrame **out_frame)
+{
+    g_return_val_if_fail(viewer != NULL, FALSE);
+    g_return_val_if_fail(out_frame != NULL, FALSE);
+
+    DrdGfxBroadcast *self = viewer->broadcast;
+    DrdGfxEncodeGroup *group = viewer->group;
+    const gint64 deadline = g_get_monotonic_time() + timeout_us;
+
+    g_mutex_lock(&self->lock);
+    while (viewer->pending == NULL)
+    {
+        if (!g_cond_wait_until(&group->cond, &self->lock, deadline))
+        {
+            break;
+        }
+    }
+
+    DrdEncodedGfxFrame *frame = g_steal_pointer(&viewer->pending);
+    if (frame != NULL)
+    {
+        g_cond_broadcast(&group->cond);
+    }
+    g_mutex_unlock(&self->lock);
+
+    *out_frame = frame;
+    return frame != NULL;
+}
+
+/*
+ * 功能：发送失败后丢弃本观看者已投递但未发送的帧。
+ * 逻辑：客户端参考链已断：清空邮箱、改为等待关键帧；本组关键帧缓存有效时直接投递缓存帧，否则请求关键帧；
+ *       其他观看者不受影响。
+ * 参数：viewer 观看者。
+ * 外部接口：drd_encoded_gfx_frame_unref；drd_encoding_manager_force_keyframe。
+ */
+void drd_gfx_viewer_discard_pending(DrdGfxViewer *viewer)
+{
+    g_return_if_fail(viewer != NULL);
+
+    DrdGfxBroadcast *self = viewer->broadcast;
+    DrdGfxEncodeGroup *group = viewer->group;
+    g_mutex_lock(&self->lock);
+    g_clear_pointer(&viewer->pending, drd_encoded_gfx_frame_unref);
+    drd_gfx_broadcast_mark_awaiting(viewer);
+    const gboolean seeded = drd_gfx_broadcast_seed_keyframe_locked(group, viewer);
+    if (!seeded)
+    {
+        viewer->keyframe_requested = TRUE;
+        viewer->stats.keyframe_waits++;
+    }
+    g_cond_broadcast(&group->cond);
+    g_mutex_unlock(&self->lock);
+
+    if (!seeded)
+    {
+        drd_encoding_manager_force_keyframe(group->encoder);
+    }
+}
+
+/*
+ * 功能：记录发送阶段耗时。
+ * 逻辑：只有组内主观看者的发送耗时计入本组流水线统计，避免多个会话的样本混在一起。
+ * 参数：viewer 观看者；duration_us 提交耗时。
+ * 外部接口：drd_stage_pipeline_record_transmit。
+ */
+void drd_gfx_viewer_record_transmit(DrdGfxViewer *viewer, gint64 duration_us)
+{
+    g_return_if_fail(viewer != NULL);
+
+    if (!drd_gfx_viewer_is_primary(viewer))
+    {
+        return;
+    }
+
+    DrdGfxEncodeGroup *group = viewer->group;
+    g_mutex_lock(&group->pipeline_lock);
+    if (group->pipeline != NULL)
+    {
+        drd_stage_pipeline_record_transmit(group->pipeline, duration_us);
+    }
+    g_mutex_unlock(&group->pipeline_lock);
+}
+
+/*
+ * 功能：记录一帧的捕获→发送时延。
+ * 逻辑：同 record_transmit，仅组内主观看者计入。
+ * 参数：viewer 观看者；frame 已提交的编码帧。
+ * 外部接口：drd_stage_pipeline_record_sent。
+ */
+void drd_gfx_viewer_record_sent(DrdGfxViewer *viewer, const DrdEncodedGfxFrame *frame)
+{
+    g_return_if_fail(viewer != NULL);
+    g_return_if_fail(frame != NULL);
+
+    if (!drd_gfx_viewer_is_primary(viewer))
+    {
+        return;
+    }
+
+    DrdGfxEncodeGroup *group = viewer->group;
+    g_mutex_lock(&group->pipeline_lock);
+    if (group->pipeline != NULL)
+    {
+        drd_stage_pipeline_record_sent(group->pipeline, frame);
+    }
+    g_mutex_unlock(&group->pipeline_lock);
+}
+
+/*
+ * 功能：读取所在编码组流水线的阶段耗时统计。
+ * 逻辑：只有组内主观看者开启新统计窗口，其他观看者只读。
+ * 参数：viewer 观看者；reset_max 是否清零窗口最大值；out_stats 输出。
+ * 外部接口：drd_stage_pipeline_get_stats。
+ * 返回：流水线未运行时返回 FALSE。
+ */
+gboolean drd_gfx_viewer_get_stage_stats(DrdGfxViewer *viewer, gboolean reset_max, DrdStagePipelineStats *out_stats)
+{
+    g_return_val_if_fail(viewer != NULL, FALSE);
+    g_return_val_if_fail(out_stats != NULL, FALSE);
+
+    const gboolean primary = drd_gfx_viewer_is_primary(viewer);
+    DrdGfxEncodeGroup *group = viewer->group;
+    g_mutex_lock(&group->pipeline_lock);
+    const gboolean running = group->pipeline != NULL;
+    if (running)
+    {
+        drd_stage_pipeline_get_stats(group->pipeline, reset_max && primary, out_stats);
+    }
+    g_mutex_unlock(&group->pipeline_lock);
+    return running;
+}
+
+/*
+ * 功能：读取所在编码组在编码调度器中的累计统计。
+ * 逻辑：调度客户端随编码组创建、随编码组释放，观看者离开前持续有效。
+ * 参数：viewer 观看者；out_stats 输出。
+ * 外部接口：drd_encode_scheduler_client_get_stats。
+ * 返回：编码组未登记调度客户端时返回 FALSE。
+ */
+gboolean drd_gfx_viewer_get_scheduler_stats(DrdGfxViewer *viewer, DrdEncodeSchedulerClientStats *out_stats)
+{
+    g_return_val_if_fail(viewer != NULL, FALSE);
+    g_return_val_if_fail(out_stats != NULL, FALSE);
+
+    if (viewer->group->scheduler == NULL)
+    {
+        return FALSE;
+    }
+    drd_encode_scheduler_client_get_stats(viewer->group->scheduler, out_stats);
+    return TRUE;
+}
+
+void drd_gfx_viewer_get_stats(DrdGfxViewer *viewer, DrdGfxViewerStats *out_stats)
+{
+    g_return_if_fail(viewer != NULL);
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&viewer->broadcast->lock);
+    *out_stats = viewer->stats;
+    g_mutex_unlock(&viewer->broadcast->lock);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glib.h>
+
+#include <freerdp/freerdp.h>
+
+#include "core/drd_server_runtime.h"
+#include "encoding/drd_encoding_manager.h"
+#include "session/drd_stage_pipeline.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Rdpgfx 多观看者广播：运行时内只有一路捕获，观看者按协商的编码能力分入编码组。每个编码组独占一个编码器
+ * （差分状态、编解码上下文、刷新计时与关键帧缓存）和一条分阶段流水线，订阅共享捕获后一次编码，分发线程把每个
+ * 编码帧按引用投递到组内各观看者的深度 1 邮箱；能力不同的会话各自成组，互不改写编码状态。
+ * 观看者邮箱由各自会话按 ACK 驱动的发送容量消费：邮箱未腾空时分发线程最多等待一个滞后预算，若组内其他观看者
+ * 已收下该帧则跳过慢者，慢者此后只接受关键帧；组内仅一名观看者或全员都满时照常阻塞，背压传导回本组编码阶段，
+ * 与单会话行为一致。组内首个加入的观看者为主观看者，流水线按其设置编码，其反馈驱动本组码率控制。
+ * 新观看者加入或参考链断开时优先从本组编码器的关键帧缓存取帧，缓存无效才请求重编关键帧。
+ * 每个编码组登记为进程级编码调度器的客户端，权重为组内观看者数，各组按会话数加权分享编码核心配额。
+ */
+typedef struct _DrdGfxViewer DrdGfxViewer;
+
+typedef struct
+{
+    guint64 delivered_frames; /* 投递到邮箱的帧数 */
+    guint64 skipped_frames;   /* 因参考链断开而跳过的帧数 */
+    guint64 lag_events;       /* 邮箱超过滞后预算仍未腾空、被跳到下一关键帧的次数 */
+    guint64 keyframe_waits;   /* 为本观看者请求关键帧的次数 */
+    guint64 cached_keyframes; /* 加入或恢复时直接取自关键帧缓存、免于重编的次数 */
+} DrdGfxViewerStats;
+
+DrdGfxBroadcast *drd_gfx_broadcast_new(DrdServerRuntime *runtime);
+void drd_gfx_broadcast_free(DrdGfxBroadcast *self);
+
+DrdGfxViewer *drd_gfx_broadcast_join(DrdGfxBroadcast *self, rdpSettings *settings, GError **error);
+void drd_gfx_broadcast_leave(DrdGfxBroadcast *self, DrdGfxViewer *viewer);
+guint drd_gfx_broadcast_get_viewer_count(DrdGfxBroadcast *self);
+guint drd_gfx_broadcast_get_group_count(DrdGfxBroadcast *self);
+
+gboolean drd_gfx_viewer_is_primary(DrdGfxViewer *viewer);
+DrdEncodingManager *drd_gfx_viewer_get_encoder(DrdGfxViewer *viewer);
+void drd_gfx_viewer_request_refresh(DrdGfxViewer *viewer);
+void drd_gfx_viewer_grant_capture_credit(DrdGfxViewer *viewer);
+gboolean drd_gfx_viewer_wait_encoded(DrdGfxViewer *viewer, gint64 timeout_us, DrdEncodedGfxFrame **out_frame);
+void drd_gfx_viewer_discard_pending(DrdGfxViewer *viewer);
+void drd_gfx_viewer_record_transmit(DrdGfxViewer *viewer, gint64 duration_us);
+void drd_gfx_viewer_record_sent(DrdGfxViewer *viewer, const DrdEncodedGfxFrame *frame);
+gboolean drd_gfx_viewer_get_stage_stats(DrdGfxViewer *viewer, gboolean reset_max, DrdStagePipelineStats *out_stats);
+gboolean drd_gfx_viewer_get_scheduler_stats(DrdGfxViewer *viewer, DrdEncodeSchedulerClientStats *out_stats);
+void drd_gfx_viewer_get_stats(DrdGfxViewer *viewer, DrdGfxViewerStats *out_stats);
+
+G_END_DECLS
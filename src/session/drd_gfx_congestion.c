@@ -0,0 +1,329 @@
+#include "session/drd_gfx_congestion.h"
+
+#include <string.h>
+
+#define DRD_GFX_CONGESTION_SLOTS 64
+#define DRD_GFX_CONGESTION_INITIAL_FRAMES 3.0
+#define DRD_GFX_CONGESTION_MIN_FRAMES 1.0
+#define DRD_GFX_CONGESTION_MAX_FRAMES 16.0
+#define DRD_GFX_CONGESTION_INITIAL_BYTES (1024.0 * 1024.0)
+#define DRD_GFX_CONGESTION_MIN_BYTES (64.0 * 1024.0)
+#define DRD_GFX_CONGESTION_MAX_BYTES (16.0 * 1024.0 * 1024.0)
+#define DRD_GFX_CONGESTION_DECREASE 0.7
+/* 排队时延超过 max(min_rtt, 30ms) 视为拥塞 */
+#define DRD_GFX_CONGESTION_MIN_QUEUE_DELAY_US (30 * G_TIME_SPAN_MILLISECOND)
+#define DRD_GFX_CONGESTION_MIN_RTT_WINDOW_US (10 * G_TIME_SPAN_SECOND)
+#define DRD_GFX_CONGESTION_MIN_LOSS_TIMEOUT_US G_TIME_SPAN_SECOND
+
+typedef struct
+{
+    guint32 frame_id;
+    gint64 sent_us;
+    gsize bytes;
+    gboolean in_flight;
+    gboolean lost; /* 已超时判定丢失，仍占用窗口直到迟到的 ACK 或通道重置 */
+} DrdGfxCongestionSlot;
+
+struct _DrdGfxCongestion
+{
+    DrdGfxCongestionSlot slots[DRD_GFX_CONGESTION_SLOTS];
+    gdouble cwnd_frames;
+    gdouble cwnd_bytes;
+    guint inflight_frames;
+    gsize inflight_bytes;
+    gint64 srtt_us;
+    gint64 min_rtt_us;
+    gint64 min_rtt_stamp_us;
+    gint64 last_decrease_us;
+    guint64 lost_frames;
+};
+
+/*
+ * 功能：创建 Rdpgfx 拥塞窗口。
+ * 逻辑：分配结构并按初始窗口复位。
+ * 参数：无。
+ * 外部接口：GLib g_new0。
+ */
+DrdGfxCongestion *
+drd_gfx_congestion_new(void)
+{
+    DrdGfxCongestion *self = g_new0(DrdGfxCongestion, 1);
+    drd_gfx_congestion_reset(self);
+    return self;
+}
+
+/*
+ * 功能：释放拥塞窗口。
+ * 逻辑：直接释放结构体。
+ * 参数：self 拥塞窗口，可为空。
+ * 外部接口：GLib g_free。
+ */
+void
+drd_gfx_congestion_free(DrdGfxCongestion *self)
+{
+    g_free(self);
+}
+
+/*
+ * 功能：恢复初始窗口并清空时延估计与在途帧。
+ * 逻辑：用于 surface 重建；丢帧计数保留以便观测整个会话。
+ * 参数：self 拥塞窗口。
+ * 外部接口：无。
+ */
+void
+drd_gfx_congestion_reset(DrdGfxCongestion *self)
+{
+    g_return_if_fail(self != NULL);
+
+    drd_gfx_congestion_clear_inflight(self);
+    self->cwnd_frames = DRD_GFX_CONGESTION_INITIAL_FRAMES;
+    self->cwnd_bytes = DRD_GFX_CONGESTION_INITIAL_BYTES;
+    self->srtt_us = 0;
+    self->min_rtt_us = 0;
+    self->min_rtt_stamp_us = 0;
+    self->last_decrease_us = 0;
+}
+
+/*
+ * 功能：清空在途帧记录，窗口大小保持不变。
+ * 逻辑：客户端暂停 ACK 时调用，避免无 ACK 的帧长期占用窗口。
+ * 参数：self 拥塞窗口。
+ * 外部接口：C 标准库 memset。
+ */
+void
+drd_gfx_congestion_clear_inflight(DrdGfxCongestion *self)
+{
+    g_return_if_fail(self != NULL);
+
+    memset(self->slots, 0, sizeof(self->slots));
+    self->inflight_frames = 0;
+    self->inflight_bytes = 0;
+}
+
+/*
+ * 功能：移除一条在途记录并回收窗口占用。
+ * 逻辑：扣减在途帧数与字节数后清除槽位。
+ * 参数：self 拥塞窗口；slot 在途槽位。
+ * 外部接口：无。
+ */
+static void
+drd_gfx_congestion_release_slot(DrdGfxCongestion *self, DrdGfxCongestionSlot *slot)
+{
+    if (self->inflight_frames > 0)
+    {
+        self->inflight_frames--;
+    }
+    self->inflight_bytes -= MIN(self->inflight_bytes, slot->bytes);
+    slot->in_flight = FALSE;
+    slot->lost = FALSE;
+}
+
+/*
+ * 功能：执行一次乘性减窗。
+ * 逻辑：同一个 RTT 内只减一次，帧数与字节窗口同时乘以 0.7 并夹在下限之上。
+ * 参数：self 拥塞窗口；now_us 单调时钟。
+ * 外部接口：无。
+ */
+static void
+drd_gfx_congestion_decrease(DrdGfxCongestion *self, gint64 now_us)
+{
+    const gint64 guard_us = MAX(self->srtt_us, DRD_GFX_CONGESTION_MIN_QUEUE_DELAY_US);
+    if (self->last_decrease_us != 0 && now_us - self->last_decrease_us < guard_us)
+    {
+        return;
+    }
+
+    self->cwnd_frames = MAX(self->cwnd_frames * DRD_GFX_CONGESTION_DECREASE, DRD_GFX_CONGESTION_MIN_FRAMES);
+    self->cwnd_bytes = MAX(self->cwnd_bytes * DRD_GFX_CONGESTION_DECREASE, DRD_GFX_CONGESTION_MIN_BYTES);
+    self->last_decrease_us = now_us;
+}
+
+/*
+ * 功能：登记一帧已提交到 Rdpgfx。
+ * 逻辑：按 frame_id 取模写入槽位；若槽位仍被更早的帧占用则按丢失处理（已判定丢失的不重复计数），
+ *       再累计在途帧数与字节数。
+ * 参数：self 拥塞窗口；frame_id 帧序号；bytes 编码字节数；now_us 提交时刻。
+ * 外部接口：无。
+ */
+void
+drd_gfx_congestion_on_submit(DrdGfxCongestion *self, guint32 frame_id, gsize bytes, gint64 now_us)
+{
+    g_return_if_fail(self != NULL);
+
+    DrdGfxCongestionSlot *slot = &self->slots[frame_id % DRD_GFX_CONGESTION_SLOTS];
+    if (slot->in_flight)
+    {
+        if (!slot->lost)
+        {
+            self->lost_frames++;
+        }
+        drd_gfx_congestion_release_slot(self, slot);
+    }
+
+    slot->frame_id = frame_id;
+    slot->sent_us = now_us;
+    slot->bytes = bytes;
+    slot->in_flight = TRUE;
+    self->inflight_frames++;
+    self->inflight_bytes += bytes;
+}
+
+/*
+ * 功能：消费一帧 FrameAcknowledge 并调整窗口。
+ * 逻辑：匹配在途槽位（含已判定丢失的）回收窗口占用并得到 RTT 样本，更新 srtt（1/8 平滑）与 10 秒窗口内最小 RTT；
+ *       迟到的 ACK 只回收占用，判定丢失时已减过窗，不再调整窗口；其余按排队时延超过阈值时乘性减窗，
+ *       否则帧窗口每 ACK 加 1/cwnd、字节窗口按本帧字节/cwnd 加性增长。
+ * 参数：self 拥塞窗口；frame_id ACK 帧序号；now_us 单调时钟。
+ * 外部接口：无。返回值表示是否匹配到在途帧。
+ */
+gboolean
+drd_gfx_congestion_on_ack(DrdGfxCongestion *self, guint32 frame_id, gint64 now_us)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+
+    DrdGfxCongestionSlot *slot = &self->slots[frame_id % DRD_GFX_CONGESTION_SLOTS];
+    if (!slot->in_flight || slot->frame_id != frame_id)
+    {
+        return FALSE;
+    }
+
+    const gint64 rtt_us = MAX(now_us - slot->sent_us, (gint64) 1);
+    const gsize bytes = slot->bytes;
+    const gboolean late = slot->lost;
+    drd_gfx_congestion_release_slot(self, slot);
+
+    self->srtt_us = self->srtt_us == 0 ? rtt_us : (self->srtt_us * 7 + rtt_us) / 8;
+    if (self->min_rtt_us == 0 || rtt_us <= self->min_rtt_us ||
+        now_us - self->min_rtt_stamp_us > DRD_GFX_CONGESTION_MIN_RTT_WINDOW_US)
+    {
+        self->min_rtt_us = rtt_us;
+        self->min_rtt_stamp_us = now_us;
+    }
+    if (late)
+    {
+        return TRUE;
+    }
+
+    const gint64 queue_delay_us = rtt_us - self->min_rtt_us;
+    if (queue_delay_us > MAX(self->min_rtt_us, DRD_GFX_CONGESTION_MIN_QUEUE_DELAY_US))
+    {
+        drd_gfx_congestion_decrease(self, now_us);
+    }
+    else
+    {
+        self->cwnd_frames = MIN(self->cwnd_frames + 1.0 / self->cwnd_frames, DRD_GFX_CONGESTION_MAX_FRAMES);
+        self->cwnd_bytes = MIN(self->cwnd_bytes + (gdouble) bytes / self->cwnd_frames, DRD_GFX_CONGESTION_MAX_BYTES);
+    }
+
+    return TRUE;
+}
+
+/*
+ * 功能：计算在途帧的丢失判定超时。
+ * 逻辑：取 4 倍 srtt 与 1 秒中的较大者。
+ * 参数：self 拥塞窗口。
+ * 外部接口：无。
+ */
+static gint64
+drd_gfx_congestion_loss_timeout(DrdGfxCongestion *self)
+{
+    return MAX(self->srtt_us * 4, DRD_GFX_CONGESTION_MIN_LOSS_TIMEOUT_US);
+}
+
+/*
+ * 功能：把超时未确认的在途帧判定为丢失。
+ * 逻辑：遍历槽位，超过丢失超时的帧标记丢失并计数，存在新丢失时执行一次乘性减窗。丢失帧不释放窗口占用：
+ *       客户端可能仍在处理积压，提前回收会让服务端继续加塞；占用只在迟到的 ACK 到达或通道重置时回收。
+ * 参数：self 拥塞窗口；now_us 单调时钟。
+ * 外部接口：无。返回值表示是否有帧新判定为丢失，调用方据此请求关键帧。
+ */
+gboolean
+drd_gfx_congestion_expire(DrdGfxCongestion *self, gint64 now_us)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+
+    const gint64 timeout_us = drd_gfx_congestion_loss_timeout(self);
+    gboolean expired = FALSE;
+
+    for (guint i = 0; i < DRD_GFX_CONGESTION_SLOTS; i++)
+    {
+        DrdGfxCongestionSlot *slot = &self->slots[i];
+        if (slot->in_flight && !slot->lost && now_us - slot->sent_us >= timeout_us)
+        {
+            slot->lost = TRUE;
+            self->lost_frames++;
+            expired = TRUE;
+        }
+    }
+
+    if (expired)
+    {
+        drd_gfx_congestion_decrease(self, now_us);
+    }
+
+    return expired;
+}
+
+/*
+ * 功能：判断窗口是否允许再提交一帧。
+ * 逻辑：无在途帧时总是允许（保证超大关键帧也能发出）；否则需同时满足帧数与字节窗口。
+ * 参数：self 拥塞窗口。
+ * 外部接口：无。
+ */
+gboolean
+drd_gfx_congestion_can_submit(DrdGfxCongestion *self)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+
+    if (self->inflight_frames == 0)
+    {
+        return TRUE;
+    }
+
+    return self->inflight_frames < (guint) self->cwnd_frames && (gdouble) self->inflight_bytes < self->cwnd_bytes;
+}
+
+/*
+ * 功能：获取最早一帧在途记录的丢失判定时刻。
+ * 逻辑：遍历尚未判定丢失的在途槽位，取最早提交时间加丢失超时；没有这样的帧返回 0。
+ * 参数：self 拥塞窗口。
+ * 外部接口：无。
+ */
+gint64
+drd_gfx_congestion_get_next_expiry(DrdGfxCongestion *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+
+    gint64 oldest = 0;
+    for (guint i = 0; i < DRD_GFX_CONGESTION_SLOTS; i++)
+    {
+        const DrdGfxCongestionSlot *slot = &self->slots[i];
+        if (slot->in_flight && !slot->lost && (oldest == 0 || slot->sent_us < oldest))
+        {
+            oldest = slot->sent_us;
+        }
+    }
+
+    return oldest == 0 ? 0 : oldest + drd_gfx_congestion_loss_timeout(self);
+}
+
+/*
+ * 功能：导出窗口状态供指标与日志使用。
+ * 逻辑：复制窗口、在途量、时延估计与丢失计数。
+ * 参数：self 拥塞窗口；out_stats 输出。
+ * 外部接口：无。
+ */
+void
+drd_gfx_congestion_get_stats(DrdGfxCongestion *self, DrdGfxCongestionStats *out_stats)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(out_stats != NULL);
+
+    out_stats->cwnd_frames = (guint) self->cwnd_frames;
+    out_stats->cwnd_bytes = (gsize) self->cwnd_bytes;
+    out_stats->inflight_frames = self->inflight_frames;
+    out_stats->inflight_bytes = self->inflight_bytes;
+    out_stats->srtt_us = self->srtt_us;
+    out_stats->min_rtt_us = self->min_rtt_us;
+    out_stats->lost_frames = self->lost_frames;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Rdpgfx 拥塞窗口：提交时为每帧打时间戳，按 FrameAcknowledge 往返时延以 AIMD + 时延判定
+ * 同时约束在途帧数与在途字节数，对所有编码格式生效。调用方负责加锁。
+ */
+typedef struct _DrdGfxCongestion DrdGfxCongestion;
+
+typedef struct
+{
+    guint cwnd_frames;     /* 当前帧数窗口 */
+    gsize cwnd_bytes;      /* 当前字节窗口 */
+    guint inflight_frames; /* 已提交未确认帧数 */
+    gsize inflight_bytes;  /* 已提交未确认字节数 */
+    gint64 srtt_us;        /* 平滑往返时延 */
+    gint64 min_rtt_us;     /* 窗口期内最小往返时延 */
+    guint64 lost_frames;   /* 超时未确认而被判定丢失的帧数（仍占用窗口，迟到的 ACK 到达时回收） */
+} DrdGfxCongestionStats;
+
+DrdGfxCongestion *drd_gfx_congestion_new(void);
+void drd_gfx_congestion_free(DrdGfxCongestion *self);
+
+void drd_gfx_congestion_reset(DrdGfxCongestion *self);
+void drd_gfx_congestion_clear_inflight(DrdGfxCongestion *self);
+void drd_gfx_congestion_on_submit(DrdGfxCongestion *self, guint32 frame_id, gsize bytes, gint64 now_us);
+gboolean drd_gfx_congestion_on_ack(DrdGfxCongestion *self, guint32 frame_id, gint64 now_us);
+gboolean drd_gfx_congestion_expire(DrdGfxCongestion *self, gint64 now_us);
+gboolean drd_gfx_congestion_can_submit(DrdGfxCongestion *self);
+gint64 drd_gfx_congestion_get_next_expiry(DrdGfxCongestion *self);
+void drd_gfx_congestion_get_stats(DrdGfxCongestion *self, DrdGfxCongestionStats *out_stats);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdGfxCongestion, drd_gfx_congestion_free)
+
+G_END_DECLS
@@ -0,0 +1,266 @@
+#include "session/drd_network_autodetect.h"
+
+#include "utils/drd_log.h"
+
+#define DRD_AUTODETECT_PING_SLOTS 8
+/* 连接初期以较短间隔快速建立 RTT 基线，之后转为 1 秒一次的持续探测 */
+#define DRD_AUTODETECT_CONNECT_PROBES 5
+#define DRD_AUTODETECT_CONNECT_RTT_INTERVAL_US (200 * G_TIME_SPAN_MILLISECOND)
+#define DRD_AUTODETECT_RTT_INTERVAL_US G_TIME_SPAN_SECOND
+#define DRD_AUTODETECT_RTT_TIMEOUT_US (2 * G_TIME_SPAN_SECOND)
+/* 连续带宽探测：每 5 秒开启一次、持续 1 秒，统计期间实际传输的业务数据 */
+#define DRD_AUTODETECT_BW_INTERVAL_US (5 * G_TIME_SPAN_SECOND)
+#define DRD_AUTODETECT_BW_DURATION_US G_TIME_SPAN_SECOND
+/* 探测窗口内数据过少时链路处于空闲，结果只反映业务量而非容量，不予采纳 */
+#define DRD_AUTODETECT_BW_MIN_BYTES (64 * 1024)
+
+typedef struct
+{
+    guint16 sequence;
+    gint64 sent_us;
+    gboolean pending;
+} DrdAutodetectPing;
+
+struct _DrdNetworkAutodetect
+{
+    GMutex lock;
+    rdpAutoDetect *autodetect;
+
+    guint16 next_sequence;
+    DrdAutodetectPing pings[DRD_AUTODETECT_PING_SLOTS];
+    guint rtt_probes_sent;
+    gint64 next_rtt_us;
+
+    gboolean bw_active;
+    guint16 bw_sequence;
+    gint64 bw_stop_us;
+    gint64 next_bw_us;
+
+    DrdNetworkEstimate estimate;
+    gboolean estimate_dirty;
+};
+
+/*
+ * 功能：消费客户端 RTT Measure Response。
+ * 逻辑：按序号匹配在途探测得到 RTT，srtt 以 1/8 平滑、记录最小 RTT，并把本次成功计入丢包率 EWMA。
+ * 参数：autodetect FreeRDP 探测上下文；transport 传输类型；sequence_number 序号。
+ * 外部接口：FreeRDP 在 peer I/O 线程回调。
+ */
+static BOOL
+drd_network_autodetect_rtt_response(rdpAutoDetect *autodetect,
+                                    RDP_TRANSPORT_TYPE transport G_GNUC_UNUSED,
+                                    UINT16 sequence_number)
+{
+    DrdNetworkAutodetect *self = autodetect != NULL ? autodetect->custom : NULL;
+    if (self == NULL)
+    {
+        return TRUE;
+    }
+
+    const gint64 now_us = g_get_monotonic_time();
+    g_mutex_lock(&self->lock);
+    DrdAutodetectPing *ping = &self->pings[sequence_number % DRD_AUTODETECT_PING_SLOTS];
+    if (ping->pending && ping->sequence == sequence_number)
+    {
+        const gint64 rtt_us = MAX(now_us - ping->sent_us, (gint64) 1);
+        ping->pending = FALSE;
+        if (!self->estimate.has_rtt)
+        {
+            self->estimate.srtt_us = rtt_us;
+            self->estimate.min_rtt_us = rtt_us;
+            self->estimate.has_rtt = TRUE;
+        }
+        else
+        {
+            self->estimate.srtt_us = (self->estimate.srtt_us * 7 + rtt_us) / 8;
+            self->estimate.min_rtt_us = MIN(self->estimate.min_rtt_us, rtt_us);
+        }
+        self->estimate.loss_ratio *= 0.9;
+        self->estimate_dirty = TRUE;
+    }
+    g_mutex_unlock(&self->lock);
+    return TRUE;
+}
+
+/*
+ * 功能：消费客户端 Bandwidth Measure Results。
+ * 逻辑：以 byteCount/timeDelta 计算带宽；探测窗口数据量不足时视为链路空闲而忽略，
+ *       否则以 0.7/0.3 平滑更新带宽估计。
+ * 参数：autodetect 探测上下文；transport 传输类型；response_type 响应类型；sequence_number 序号；
+ *       time_delta_ms 客户端统计时长；byte_count 客户端收到的字节数。
+ * 外部接口：FreeRDP 在 peer I/O 线程回调。
+ */
+static BOOL
+drd_network_autodetect_bw_results(rdpAutoDetect *autodetect,
+                                  RDP_TRANSPORT_TYPE transport G_GNUC_UNUSED,
+                                  UINT16 response_type G_GNUC_UNUSED,
+                                  UINT16 sequence_number G_GNUC_UNUSED,
+                                  UINT32 time_delta_ms,
+                                  UINT32 byte_count)
+{
+    DrdNetworkAutodetect *self = autodetect != NULL ? autodetect->custom : NULL;
+    if (self == NULL || time_delta_ms == 0 || byte_count < DRD_AUTODETECT_BW_MIN_BYTES)
+    {
+        return TRUE;
+    }
+
+    const gdouble bandwidth_bps = (gdouble) byte_count * 8.0 * 1000.0 / (gdouble) time_delta_ms;
+    g_mutex_lock(&self->lock);
+    if (!self->estimate.has_bandwidth)
+    {
+        self->estimate.bandwidth_bps = (guint64) bandwidth_bps;
+        self->estimate.has_bandwidth = TRUE;
+    }
+    else
+    {
+        self->estimate.bandwidth_bps = (guint64) ((gdouble) self->estimate.bandwidth_bps * 0.7 + bandwidth_bps * 0.3);
+    }
+    self->estimate_dirty = TRUE;
+    g_mutex_unlock(&self->lock);
+    return TRUE;
+}
+
+/*
+ * 功能：创建网络探测器并挂接 FreeRDP 回调。
+ * 逻辑：记录 rdpAutoDetect，通过 custom 指针回指自身，注册 RTT/带宽响应回调；首次 tick 立即开始探测。
+ * 参数：autodetect peer 上下文中的探测对象。
+ * 外部接口：GLib g_new0/g_mutex_init；FreeRDP rdpAutoDetect 回调表。
+ */
+DrdNetworkAutodetect *
+drd_network_autodetect_new(rdpAutoDetect *autodetect)
+{
+    g_return_val_if_fail(autodetect != NULL, NULL);
+
+    DrdNetworkAutodetect *self = g_new0(DrdNetworkAutodetect, 1);
+    g_mutex_init(&self->lock);
+    self->autodetect = autodetect;
+    autodetect->custom = self;
+    autodetect->RTTMeasureResponse = drd_network_autodetect_rtt_response;
+    autodetect->BandwidthMeasureResults = drd_network_autodetect_bw_results;
+    return self;
+}
+
+/*
+ * 功能：释放网络探测器并解除回调。
+ * 逻辑：清空 rdpAutoDetect 的 custom 与回调指针，避免 FreeRDP 之后回调到已释放对象。
+ * 参数：self 探测器，可为空。
+ * 外部接口：GLib g_mutex_clear/g_free。
+ */
+void
+drd_network_autodetect_free(DrdNetworkAutodetect *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    if (self->autodetect != NULL && self->autodetect->custom == self)
+    {
+        self->autodetect->custom = NULL;
+        self->autodetect->RTTMeasureResponse = NULL;
+        self->autodetect->BandwidthMeasureResults = NULL;
+    }
+    g_mutex_clear(&self->lock);
+    g_free(self);
+}
+
+/*
+ * 功能：推进探测状态机，按计划发送 RTT 与带宽探测。
+ * 逻辑：超时未响应的 RTT 探测计为丢失并更新丢包率；到期时发送新的 RTT 请求（连接初期 200ms 间隔，之后 1 秒）；
+ *       带宽探测窗口到期则发送 Stop，否则按 5 秒周期发送 Start。发送在锁外进行。
+ * 参数：self 探测器；now_us 单调时钟。
+ * 外部接口：FreeRDP RTTMeasureRequest/BandwidthMeasureStart/BandwidthMeasureStop。
+ *           返回值表示自上次调用以来估计是否更新，供调用方决定是否发布。
+ */
+gboolean
+drd_network_autodetect_tick(DrdNetworkAutodetect *self, gint64 now_us)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+
+    gboolean send_rtt = FALSE;
+    guint16 rtt_sequence = 0;
+    gboolean send_bw_start = FALSE;
+    gboolean send_bw_stop = FALSE;
+    guint16 bw_sequence = 0;
+
+    g_mutex_lock(&self->lock);
+    for (guint i = 0; i < DRD_AUTODETECT_PING_SLOTS; i++)
+    {
+        DrdAutodetectPing *ping = &self->pings[i];
+        if (ping->pending && now_us - ping->sent_us > DRD_AUTODETECT_RTT_TIMEOUT_US)
+        {
+            ping->pending = FALSE;
+            self->estimate.loss_ratio = self->estimate.loss_ratio * 0.9 + 0.1;
+            self->estimate_dirty = TRUE;
+        }
+    }
+
+    if (now_us >= self->next_rtt_us)
+    {
+        rtt_sequence = self->next_sequence++;
+        DrdAutodetectPing *ping = &self->pings[rtt_sequence % DRD_AUTODETECT_PING_SLOTS];
+        ping->sequence = rtt_sequence;
+        ping->sent_us = now_us;
+        ping->pending = TRUE;
+        self->rtt_probes_sent++;
+        self->next_rtt_us = now_us + (self->rtt_probes_sent < DRD_AUTODETECT_CONNECT_PROBES
+                                              ? DRD_AUTODETECT_CONNECT_RTT_INTERVAL_US
+                                              : DRD_AUTODETECT_RTT_INTERVAL_US);
+        send_rtt = TRUE;
+    }
+
+    if (self->bw_active && now_us >= self->bw_stop_us)
+    {
+        bw_sequence = self->bw_sequence;
+        self->bw_active = FALSE;
+        send_bw_stop = TRUE;
+    }
+    else if (!self->bw_active && now_us >= self->next_bw_us)
+    {
+        bw_sequence = self->bw_sequence = self->next_sequence++;
+        self->bw_active = TRUE;
+        self->bw_stop_us = now_us + DRD_AUTODETECT_BW_DURATION_US;
+        self->next_bw_us = now_us + DRD_AUTODETECT_BW_INTERVAL_US;
+        send_bw_start = TRUE;
+    }
+
+    const gboolean dirty = self->estimate_dirty;
+    self->estimate_dirty = FALSE;
+    g_mutex_unlock(&self->lock);
+
+    rdpAutoDetect *autodetect = self->autodetect;
+    if (send_rtt && autodetect->RTTMeasureRequest != NULL &&
+        !autodetect->RTTMeasureRequest(autodetect, RDP_TRANSPORT_TCP, rtt_sequence))
+    {
+        DRD_LOG_DEBUG("Autodetect RTT request %u failed", rtt_sequence);
+    }
+    if (send_bw_start && autodetect->BandwidthMeasureStart != NULL &&
+        !autodetect->BandwidthMeasureStart(autodetect, RDP_TRANSPORT_TCP, bw_sequence))
+    {
+        DRD_LOG_DEBUG("Autodetect bandwidth start %u failed", bw_sequence);
+    }
+    if (send_bw_stop && autodetect->BandwidthMeasureStop != NULL &&
+        !autodetect->BandwidthMeasureStop(autodetect, RDP_TRANSPORT_TCP, bw_sequence, 0))
+    {
+        DRD_LOG_DEBUG("Autodetect bandwidth stop %u failed", bw_sequence);
+    }
+
+    return dirty;
+}
+
+/*
+ * 功能：读取当前网络估计。
+ * 逻辑：持锁复制估计结构。
+ * 参数：self 探测器；out_estimate 输出。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_network_autodetect_get_estimate(DrdNetworkAutodetect *self, DrdNetworkEstimate *out_estimate)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(out_estimate != NULL);
+
+    g_mutex_lock(&self->lock);
+    *out_estimate = self->estimate;
+    g_mutex_unlock(&self->lock);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glib.h>
+
+#include <freerdp/autodetect.h>
+
+G_BEGIN_DECLS
+
+/*
+ * RDP 网络自动探测：在 peer I/O 线程上周期性发送 RTT 与连续带宽探测请求，
+ * 维护平滑 RTT、最小 RTT、带宽与丢包估计，供编码与会话指标使用。
+ */
+typedef struct _DrdNetworkAutodetect DrdNetworkAutodetect;
+
+typedef struct
+{
+    gboolean has_rtt;       /* 是否已有 RTT 样本 */
+    gboolean has_bandwidth; /* 是否已有有效带宽样本 */
+    gint64 srtt_us;         /* 平滑往返时延 */
+    gint64 min_rtt_us;      /* 最小往返时延 */
+    guint64 bandwidth_bps;  /* 平滑带宽估计 */
+    gdouble loss_ratio;     /* RTT 探测丢失率（EWMA） */
+} DrdNetworkEstimate;
+
+DrdNetworkAutodetect *drd_network_autodetect_new(rdpAutoDetect *autodetect);
+void drd_network_autodetect_free(DrdNetworkAutodetect *self);
+
+gboolean drd_network_autodetect_tick(DrdNetworkAutodetect *self, gint64 now_us);
+void drd_network_autodetect_get_estimate(DrdNetworkAutodetect *self, DrdNetworkEstimate *out_estimate);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdNetworkAutodetect, drd_network_autodetect_free)
+
+G_END_DECLS
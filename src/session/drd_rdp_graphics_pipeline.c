@@ -9,6 +9,8 @@
 #include <gio/gio.h>
 
 #include "core/drd_server_runtime.h"
+#include "session/drd_decode_time_tracker.h"
+#include "session/drd_gfx_congestion.h"
 #include "utils/drd_log.h"
 
 struct _DrdRdpGraphicsPipeline
@@ -27,13 +29,13 @@ struct _DrdRdpGraphicsPipeline
     guint16 surface_id;
     guint32 codec_context_id;
     guint32 next_frame_id;
-    gint outstanding_frames;
-    guint max_outstanding_frames;
+    DrdGfxCongestion *congestion; /* 在途帧/字节拥塞窗口，受 lock 保护 */
     guint32 channel_id;
     gboolean frame_acks_suspended; /* Rdpgfx 客户端暂停 ACK 时跳过背压 */
+    gint loss_keyframe_due;        /* 在途帧新判定丢失后置位，由渲染线程取走并为本会话请求关键帧 */
     GMutex lock;
     /*
-     * capacity_cond: Rdpgfx 背压的条件变量。当 outstanding_frames 达到上限时，
+     * capacity_cond: Rdpgfx 背压的条件变量。当拥塞窗口已满时，
      * renderer 线程会在 drd_rdp_graphics_pipeline_wait_for_capacity() 内等待该条件;
      * 客户端发送 FrameAcknowledge 或提交失败时唤醒，保证编码/发送速率与客户端 ACK
      * 节奏一致，避免“先编码再丢弃”导致的花屏。
@@ -42,6 +44,12 @@ struct _DrdRdpGraphicsPipeline
 
     DrdServerRuntime *runtime;
     gboolean last_frame_h264;
+    DrdEncodingManager *feedback_encoder; /* 接收 ACK/QoE 反馈的编码组编码器，仅组内主观看者设置，受 lock 保护 */
+
+    guint64 acked_frames;
+    guint32 last_queue_depth;
+    DrdDecodeTimeTracker *decode_times; /* QoE 上报的客户端解码耗时，受 lock 保护 */
+    guint64 qoe_frames;
 };
 
 G_DEFINE_TYPE(DrdRdpGraphicsPipeline, drd_rdp_graphics_pipeline, G_TYPE_OBJECT)
@@ -63,33 +71,12 @@ static BOOL drd_rdpgfx_channel_assigned(RdpgfxServerContext *context, UINT32 cha
 static UINT drd_rdpgfx_frame_ack(RdpgfxServerContext *context,
                                  const RDPGFX_FRAME_ACKNOWLEDGE_PDU *ack);
 
+static UINT drd_rdpgfx_qoe_frame_ack(RdpgfxServerContext *context,
+                                     const RDPGFX_QOE_FRAME_ACKNOWLEDGE_PDU *qoe_ack);
+
 static UINT shadow_client_rdpgfx_caps_advertise(RdpgfxServerContext* context,
                                                 const RDPGFX_CAPS_ADVERTISE_PDU* capsAdvertise);
 
-/*
- * 功能：生成符合 Rdpgfx 要求的 32 位时间戳。
- * 逻辑：获取本地时间，按小时/分钟/秒/毫秒编码到 32 位整数。
- * 参数：无。
- * 外部接口：GLib GDateTime API 获取时间。
- */
-static guint32
-drd_rdp_graphics_pipeline_build_timestamp(void)
-{
-    guint32 timestamp = 0;
-    GDateTime *now = g_date_time_new_now_local();
-
-    if (now != NULL)
-    {
-        timestamp = ((guint32) g_date_time_get_hour(now) << 22) |
-                    ((guint32) g_date_time_get_minute(now) << 16) |
-                    ((guint32) g_date_time_get_second(now) << 10) |
-                    ((guint32)(g_date_time_get_microsecond(now) / 1000));
-        g_date_time_unref(now);
-    }
-
-    return timestamp;
-}
-
 /*
  * 功能：在持有锁的情况下重置 Rdpgfx surface 与上下文。
  * 逻辑：发送 ResetGraphics、CreateSurface、MapSurfaceToOutput 三个 PDU，重置帧计数、背压与标志位。
@@ -147,7 +134,9 @@ drd_rdp_graphics_pipeline_reset_locked(DrdRdpGraphicsPipeline *self)
     }
 
     self->next_frame_id = 1;
-    self->outstanding_frames = 0;
+    drd_gfx_congestion_reset(self->congestion);
+    g_atomic_int_set(&self->loss_keyframe_due, 0);
+    drd_decode_time_tracker_reset(self->decode_times);
     self->surface_ready = TRUE;
     self->last_frame_h264 = FALSE;
     self->frame_acks_suspended = FALSE;
@@ -189,9 +178,9 @@ drd_rdp_graphics_pipeline_dispose(GObject *object)
 
 /*
  * 功能：释放同步原语与 Rdpgfx 上下文。
- * 逻辑：清理条件变量/互斥量，释放 Rdpgfx server context，委托父类 finalize。
+ * 逻辑：清理条件变量/互斥量，释放反馈编码器引用与 Rdpgfx server context，委托父类 finalize。
  * 参数：object GObject 指针。
- * 外部接口：GLib g_cond_clear/g_mutex_clear；FreeRDP rdpgfx_server_context_free。
+ * 外部接口：GLib g_cond_clear/g_mutex_clear/g_clear_object；FreeRDP rdpgfx_server_context_free。
  */
 static void
 drd_rdp_graphics_pipeline_finalize(GObject *object)
@@ -200,6 +189,9 @@ drd_rdp_graphics_pipeline_finalize(GObject *object)
 
     g_cond_clear(&self->capacity_cond);
     g_mutex_clear(&self->lock);
+    g_clear_object(&self->feedback_encoder);
+    g_clear_pointer(&self->congestion, drd_gfx_congestion_free);
+    g_clear_pointer(&self->decode_times, drd_decode_time_tracker_free);
     g_clear_pointer(&self->rdpgfx_context, rdpgfx_server_context_free);
 
     G_OBJECT_CLASS(drd_rdp_graphics_pipeline_parent_class)->finalize(object);
@@ -219,7 +211,8 @@ drd_rdp_graphics_pipeline_init(DrdRdpGraphicsPipeline *self)
     self->surface_id = 1;
     self->codec_context_id = 1;
     self->next_frame_id = 1;
-    self->max_outstanding_frames = 3;
+    self->congestion = drd_gfx_congestion_new();
+    self->decode_times = drd_decode_time_tracker_new();
     self->frame_acks_suspended = FALSE;
 }
 
@@ -274,6 +267,7 @@ drd_rdp_graphics_pipeline_new(freerdp_peer *peer,
     rdpgfx_context->ChannelIdAssigned = drd_rdpgfx_channel_assigned;
     rdpgfx_context->CapsAdvertise = shadow_client_rdpgfx_caps_advertise;
     rdpgfx_context->FrameAcknowledge = drd_rdpgfx_frame_ack;
+    rdpgfx_context->QoeFrameAcknowledge = drd_rdpgfx_qoe_frame_ack;
 
     return self;
 }
@@ -353,9 +347,10 @@ drd_rdp_graphics_pipeline_is_ready(DrdRdpGraphicsPipeline *self)
 
 /*
  * 功能：检查是否允许提交新帧（背压控制）。
- * 逻辑：持锁判断 surface_ready 且 outstanding_frames 未超过上限，或客户端暂停 ACK。
+ * 逻辑：持锁先把超时未确认的在途帧判定为丢失（只减窗并登记关键帧请求，不回收占用），再判断 surface_ready 且
+ *       拥塞窗口有余量，或客户端暂停 ACK；对所有编码格式一致生效。
  * 参数：self 图形管线。
- * 外部接口：无额外外部库调用。
+ * 外部接口：drd_gfx_congestion_expire/drd_gfx_congestion_can_submit。
  */
 gboolean
 drd_rdp_graphics_pipeline_can_submit(DrdRdpGraphicsPipeline *self)
@@ -363,14 +358,31 @@ drd_rdp_graphics_pipeline_can_submit(DrdRdpGraphicsPipeline *self)
     g_return_val_if_fail(DRD_IS_RDP_GRAPHICS_PIPELINE(self), FALSE);
 
     g_mutex_lock(&self->lock);
+    if (drd_gfx_congestion_expire(self->congestion, g_get_monotonic_time()))
+    {
+        g_atomic_int_set(&self->loss_keyframe_due, 1);
+    }
     gboolean ok = self->surface_ready &&
-                  (self->frame_acks_suspended ||
-                   self->outstanding_frames < (gint) self->max_outstanding_frames ||
-                   self->last_frame_h264);
+                  (self->frame_acks_suspended || drd_gfx_congestion_can_submit(self->congestion));
     g_mutex_unlock(&self->lock);
     return ok;
 }
 
+/*
+ * 功能：取走在途帧丢失后登记的关键帧请求。
+ * 逻辑：原子交换清除标记，同一批丢失只取走一次。
+ * 参数：self 图形管线。
+ * 外部接口：GLib g_atomic_int_compare_and_exchange。
+ * 返回：自上次取走后有帧新判定丢失时返回 TRUE。
+ */
+gboolean
+drd_rdp_graphics_pipeline_take_loss_keyframe(DrdRdpGraphicsPipeline *self)
+{
+    g_return_val_if_fail(DRD_IS_RDP_GRAPHICS_PIPELINE(self), FALSE);
+
+    return g_atomic_int_compare_and_exchange(&self->loss_keyframe_due, 1, 0);
+}
+
 guint16
 drd_rdp_graphics_pipeline_get_surface_id(DrdRdpGraphicsPipeline *self)
 {
@@ -379,33 +391,53 @@ drd_rdp_graphics_pipeline_get_surface_id(DrdRdpGraphicsPipeline *self)
     return self->surface_id;
 }
 
-void drd_rdp_graphics_pipeline_out_frame_change(DrdRdpGraphicsPipeline *self, gboolean add)
+/*
+ * 功能：登记一帧已通过 SurfaceFrameCommand 提交。
+ * 逻辑：客户端未暂停 ACK 时在拥塞窗口中以当前时刻为该帧打时间戳并累计在途帧数/字节数。
+ * 参数：self 管线；frame_id 帧序号；bytes 编码字节数。
+ * 外部接口：GLib g_get_monotonic_time；drd_gfx_congestion_on_submit。
+ */
+void
+drd_rdp_graphics_pipeline_frame_submitted(DrdRdpGraphicsPipeline *self, guint32 frame_id, gsize bytes)
 {
+    g_return_if_fail(DRD_IS_RDP_GRAPHICS_PIPELINE(self));
+
     g_mutex_lock(&self->lock);
-    if (add)
-    {
-        if (!self->frame_acks_suspended)
-        {
-            self->outstanding_frames++;
-        }
-    }
-    else
+    if (!self->frame_acks_suspended)
     {
-        if (!self->frame_acks_suspended && self->outstanding_frames > 0)
-        {
-            self->outstanding_frames--;
-        }
-        g_cond_broadcast(&self->capacity_cond);
+        drd_gfx_congestion_on_submit(self->congestion, frame_id, bytes, g_get_monotonic_time());
     }
     g_mutex_unlock(&self->lock);
 }
 
 /*
- * 功能：等待 Rdpgfx 管线具备提交容量（基于 outstanding_frames）。
- * 逻辑：在 surface_ready 时根据 timeout_us 在条件变量上等待 outstanding_frames 降至上限以下，
- *       支持无限或超时等待。
+ * 功能：读取 FrameAcknowledge、拥塞窗口与客户端解码耗时统计，供会话帧率调节与指标日志使用。
+ * 逻辑：持锁复制累计 ACK 数、最近 queueDepth、ACK 暂停状态、拥塞窗口状态与解码耗时分位数。
+ * 参数：self 管线；out_stats 输出。
+ * 外部接口：GLib g_mutex_lock/unlock；drd_gfx_congestion_get_stats。
+ */
+void
+drd_rdp_graphics_pipeline_get_stats(DrdRdpGraphicsPipeline *self, DrdRdpGraphicsPipelineStats *out_stats)
+{
+    g_return_if_fail(DRD_IS_RDP_GRAPHICS_PIPELINE(self));
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&self->lock);
+    out_stats->acked_frames = self->acked_frames;
+    out_stats->last_queue_depth = self->last_queue_depth;
+    out_stats->acks_suspended = self->frame_acks_suspended;
+    drd_gfx_congestion_get_stats(self->congestion, &out_stats->congestion);
+    drd_decode_time_tracker_get_stats(self->decode_times, &out_stats->decode);
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：等待 Rdpgfx 管线具备提交容量（基于拥塞窗口）。
+ * 逻辑：在 surface_ready 时于条件变量上等待窗口出现余量；等待期间按最早在途帧的丢失判定时刻醒来，
+ *       把超时帧判定为丢失（减窗并登记关键帧请求，占用等迟到的 ACK 或通道重置回收）；支持无限或超时等待，
+ *       渲染线程总是带超时调用。
  * 参数：self 管线；timeout_us 等待时间，-1 表示无限。
- * 外部接口：GLib g_cond_wait/g_cond_wait_until。
+ * 外部接口：GLib g_cond_wait_until；drd_gfx_congestion_*。
  */
 gboolean
 drd_rdp_graphics_pipeline_wait_for_capacity(DrdRdpGraphicsPipeline *self,
@@ -413,10 +445,9 @@ drd_rdp_graphics_pipeline_wait_for_capacity(DrdRdpGraphicsPipeline *self,
 {
     g_return_val_if_fail(DRD_IS_RDP_GRAPHICS_PIPELINE(self), FALSE);
     /*
-     * capacity 的定义：未被客户端 RDPGFX_FRAME_ACKNOWLEDGE 确认的帧数
-     * (outstanding_frames) 必须始终小于 max_outstanding_frames（默认 3）。
-     * 当编码线程调用本函数时，如果 outstanding>=max，就在 capacity_cond 上阻塞，
-     * 直到 FrameAcknowledge 或提交失败/Reset 释放槽位。
+     * capacity 的定义：未被客户端 RDPGFX_FRAME_ACKNOWLEDGE 确认的帧数与字节数
+     * 必须同时小于拥塞窗口。窗口按 ACK 往返时延 AIMD 调整，H264 与非 H264 一视同仁；
+     * 当窗口已满时在 capacity_cond 上阻塞，直到 FrameAcknowledge（含超时后迟到的）或 Reset 释放槽位。
      */
     gint64 deadline = 0;
     if (timeout_us > 0)
@@ -425,27 +456,39 @@ drd_rdp_graphics_pipeline_wait_for_capacity(DrdRdpGraphicsPipeline *self,
     }
 
     g_mutex_lock(&self->lock);
-    if (self->last_frame_h264)
-    {
-        g_mutex_unlock(&self->lock);
-        return TRUE;
-    }
-    while (self->surface_ready && !self->frame_acks_suspended &&
-           self->outstanding_frames >= (gint) self->max_outstanding_frames)
+    while (self->surface_ready && !self->frame_acks_suspended)
     {
-        if (timeout_us < 0)
+        const gint64 now = g_get_monotonic_time();
+        if (drd_gfx_congestion_expire(self->congestion, now))
         {
-            g_cond_wait(&self->capacity_cond, &self->lock);
+            g_atomic_int_set(&self->loss_keyframe_due, 1);
+        }
+        if (drd_gfx_congestion_can_submit(self->congestion))
+        {
+            break;
         }
-        else if (!g_cond_wait_until(&self->capacity_cond, &self->lock, deadline))
+        if (deadline > 0 && now >= deadline)
         {
             break;
         }
+
+        gint64 wake = drd_gfx_congestion_get_next_expiry(self->congestion);
+        if (deadline > 0 && (wake == 0 || wake > deadline))
+        {
+            wake = deadline;
+        }
+        if (wake == 0)
+        {
+            g_cond_wait(&self->capacity_cond, &self->lock);
+        }
+        else
+        {
+            g_cond_wait_until(&self->capacity_cond, &self->lock, wake);
+        }
     }
 
     gboolean ready = self->surface_ready &&
-                     (self->frame_acks_suspended ||
-                      self->outstanding_frames < (gint) self->max_outstanding_frames);
+                     (self->frame_acks_suspended || drd_gfx_congestion_can_submit(self->congestion));
     g_mutex_unlock(&self->lock);
     return ready;
 }
@@ -764,8 +807,8 @@ static UINT shadow_client_rdpgfx_caps_advertise(RdpgfxServerContext* context,
 
 /*
  * 功能：处理客户端 FrameAcknowledge，维护背压与 ACK 状态。
- * 逻辑：在 SUSPEND_FRAME_ACKNOWLEDGEMENT 时清零 outstanding 并挂起背压；正常情况将 outstanding 减 1，
- *       并唤醒等待容量的线程。
+ * 逻辑：在 SUSPEND_FRAME_ACKNOWLEDGEMENT 时清空拥塞窗口在途帧并挂起背压；正常情况以 frameId
+ *       匹配在途帧计算往返时延并调整窗口，唤醒等待容量的线程，再把 frameId/queueDepth 转交码率控制器。
  * 参数：context Rdpgfx 上下文；ack 客户端 ACK PDU。
  * 外部接口：FreeRDP 调用该回调；日志使用 DRD_LOG_MESSAGE。
  */
@@ -787,7 +830,7 @@ drd_rdpgfx_frame_ack(RdpgfxServerContext *context,
             DRD_LOG_MESSAGE("RDPGFX client suspended frame acknowledgements");
         }
         self->frame_acks_suspended = TRUE;
-        self->outstanding_frames = 0;
+        drd_gfx_congestion_clear_inflight(self->congestion);
         g_cond_broadcast(&self->capacity_cond);
         g_mutex_unlock(&self->lock);
         return CHANNEL_RC_OK;
@@ -798,22 +841,69 @@ drd_rdpgfx_frame_ack(RdpgfxServerContext *context,
         DRD_LOG_MESSAGE("RDPGFX client resumed frame acknowledgements");
     }
     self->frame_acks_suspended = FALSE;
+    self->acked_frames++;
+    self->last_queue_depth = ack->queueDepth;
     /*
      * 客户端在成功解码/渲染一帧 Progressive 数据后会发送 RDPGFX_FRAME_ACKNOWLEDGE_PDU，
-     * 告知服务器 frameId、totalFramesDecoded 以及 queueDepth。我们只需要把
-     * outstanding_frames 减 1 并唤醒等待 capacity_cond 的编码线程，保证新的帧
-     * 只有在客户端确认后才继续发送。
+     * 告知服务器 frameId、totalFramesDecoded 以及 queueDepth。按 frameId 找到对应的
+     * 在途帧，以提交时间戳计算往返时延并据此伸缩拥塞窗口，再唤醒等待 capacity_cond 的
+     * 编码线程。
      */
-    if (self->outstanding_frames > 0)
+    drd_gfx_congestion_on_ack(self->congestion, ack->frameId, g_get_monotonic_time());
+    g_cond_broadcast(&self->capacity_cond);
+    g_autoptr(DrdEncodingManager) encoder =
+            self->feedback_encoder != NULL ? g_object_ref(self->feedback_encoder) : NULL;
+    g_mutex_unlock(&self->lock);
+
+    /* ACK 往返时延与 queueDepth 交给码率控制器做闭环调节 */
+    if (encoder != NULL)
     {
-        if (self->last_frame_h264)
-            self->outstanding_frames = 0;
-        else
-            self->outstanding_frames--;
+        drd_encoding_manager_notify_frame_ack(encoder, ack->frameId, ack->queueDepth);
+    }
+
+    return CHANNEL_RC_OK;
+}
+
+/*
+ * 功能：处理客户端 QoE FrameAcknowledge，统计客户端解码耗时。
+ * 逻辑：以 timeDiffSE（收到 StartFrame→EndFrame）与 timeDiffEDR（EndFrame→解码渲染完成）之和作为一帧的客户端处理耗时
+ *       写入统计窗口；每 16 个样本把 p95 交给编码管理器，供编码格式选择避开客户端解不动的格式。
+ * 参数：context Rdpgfx 上下文；qoe_ack 客户端 QoE ACK PDU。
+ * 外部接口：FreeRDP 调用该回调；drd_decode_time_tracker_*；drd_encoding_manager_set_client_decode_time。
+ */
+static UINT
+drd_rdpgfx_qoe_frame_ack(RdpgfxServerContext *context,
+                         const RDPGFX_QOE_FRAME_ACKNOWLEDGE_PDU *qoe_ack)
+{
+    DrdRdpGraphicsPipeline *self = context != NULL ? context->custom : NULL;
+
+    if (self == NULL || qoe_ack == NULL)
+    {
+        return CHANNEL_RC_OK;
+    }
+
+    const gint64 decode_time_us =
+            ((gint64) qoe_ack->timeDiffSE + (gint64) qoe_ack->timeDiffEDR) * G_TIME_SPAN_MILLISECOND;
+    DrdDecodeTimeStats stats;
+    gboolean publish = FALSE;
+
+    g_mutex_lock(&self->lock);
+    drd_decode_time_tracker_add(self->decode_times, decode_time_us);
+    /* 分位数需要排序窗口，只在发布时计算 */
+    publish = (self->qoe_frames++ % 16) == 0;
+    g_autoptr(DrdEncodingManager) encoder = NULL;
+    if (publish)
+    {
+        drd_decode_time_tracker_get_stats(self->decode_times, &stats);
+        encoder = self->feedback_encoder != NULL ? g_object_ref(self->feedback_encoder) : NULL;
     }
-    g_cond_broadcast(&self->capacity_cond);
     g_mutex_unlock(&self->lock);
 
+    if (encoder != NULL)
+    {
+        drd_encoding_manager_set_client_decode_time(encoder, stats.p95_us);
+    }
+
     return CHANNEL_RC_OK;
 }
 
@@ -827,3 +917,19 @@ void drd_rdp_graphics_pipeline_set_last_frame_mode(DrdRdpGraphicsPipeline *self,
     self->last_frame_h264 = h264;
     g_mutex_unlock(&self->lock);
 }
+
+/*
+ * 功能：设置接收客户端 ACK/QoE 反馈的编码器。
+ * 逻辑：反馈交给本会话所在编码组的编码器；组内多个会话共享一路编码时只采纳主观看者的反馈，
+ *       避免不同会话的帧序号与解码耗时混在一起；本会话自身的拥塞窗口与统计不受影响。
+ * 参数：self 图形管线；encoder 编码组编码器，NULL 表示不上报。
+ * 外部接口：GLib g_set_object。
+ */
+void drd_rdp_graphics_pipeline_set_encoder_feedback(DrdRdpGraphicsPipeline *self, DrdEncodingManager *encoder)
+{
+    g_return_if_fail(DRD_IS_RDP_GRAPHICS_PIPELINE(self));
+
+    g_mutex_lock(&self->lock);
+    g_set_object(&self->feedback_encoder, encoder);
+    g_mutex_unlock(&self->lock);
+}
@@ -7,6 +7,8 @@
 #include <winpr/wtypes.h>
 
 #include "core/drd_server_runtime.h"
+#include "session/drd_decode_time_tracker.h"
+#include "session/drd_gfx_congestion.h"
 
 #define DRD_RDP_GRAPHICS_PIPELINE_ERROR (drd_rdp_graphics_pipeline_error_quark())
 
@@ -37,10 +39,23 @@ gboolean drd_rdp_graphics_pipeline_is_ready(DrdRdpGraphicsPipeline *self);
 gboolean drd_rdp_graphics_pipeline_can_submit(DrdRdpGraphicsPipeline *self);
 gboolean drd_rdp_graphics_pipeline_wait_for_capacity(DrdRdpGraphicsPipeline *self,
                                                      gint64 timeout_us);
+gboolean drd_rdp_graphics_pipeline_take_loss_keyframe(DrdRdpGraphicsPipeline *self);
 guint16 drd_rdp_graphics_pipeline_get_surface_id(DrdRdpGraphicsPipeline *self);
 
-void drd_rdp_graphics_pipeline_out_frame_change(DrdRdpGraphicsPipeline *self,gboolean add);
+void drd_rdp_graphics_pipeline_frame_submitted(DrdRdpGraphicsPipeline *self, guint32 frame_id, gsize bytes);
+
+typedef struct
+{
+    guint64 acked_frames;     /* 累计收到的 FrameAcknowledge 数 */
+    guint32 last_queue_depth; /* 最近一次 ACK 上报的客户端积压帧数 */
+    gboolean acks_suspended;  /* 客户端是否暂停 ACK */
+    DrdGfxCongestionStats congestion; /* 拥塞窗口状态 */
+    DrdDecodeTimeStats decode;        /* QoE 上报的客户端解码耗时分位数 */
+} DrdRdpGraphicsPipelineStats;
+
+void drd_rdp_graphics_pipeline_get_stats(DrdRdpGraphicsPipeline *self, DrdRdpGraphicsPipelineStats *out_stats);
 
 RdpgfxServerContext* drd_rdpgfx_get_context(DrdRdpGraphicsPipeline *self);
 void drd_rdp_graphics_pipeline_set_last_frame_mode(DrdRdpGraphicsPipeline *self,gboolean h264);
+void drd_rdp_graphics_pipeline_set_encoder_feedback(DrdRdpGraphicsPipeline *self, DrdEncodingManager *encoder);
 G_END_DECLS
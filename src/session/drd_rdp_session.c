@@ -20,12 +20,25 @@
 #include <winpr/wtypes.h>
 
 #include "core/drd_server_runtime.h"
+#include "security/drd_auth_pool.h"
 #include "security/drd_local_session.h"
+#include "session/drd_frame_rate_governor.h"
 #include "session/drd_rdp_graphics_pipeline.h"
+#include "session/drd_gfx_broadcast.h"
+#include "session/drd_session_reactor.h"
+#include "transport/drd_peer_socket.h"
 #include "utils/drd_capture_metrics.h"
 #include "utils/drd_log.h"
 
 #define ELEMENT_TYPE_CERTIFICATE 32
+/* 网络自动探测运行时事件处理的唤醒间隔 */
+#define DRD_RDP_SESSION_AUTODETECT_TICK_MS 100
+/* 等待 PAM 认证结果期间检查请求是否超时的唤醒间隔 */
+#define DRD_RDP_SESSION_AUTH_TICK_MS 250
+/* 渲染线程等待 Rdpgfx 容量的总时限，超时视为拥塞持续并回退 SurfaceBits */
+#define DRD_RDP_SESSION_GFX_CAPACITY_TIMEOUT_US (5 * G_USEC_PER_SEC)
+/* 等待 Rdpgfx 容量期间检查停止标志的间隔 */
+#define DRD_RDP_SESSION_GFX_CAPACITY_SLICE_US (50 * 1000)
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(rdpCertificate, freerdp_certificate_free)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(rdpRedirection, redirection_free)
@@ -39,7 +52,10 @@ struct _DrdRdpSession
     gchar *state;
     DrdServerRuntime *runtime;
     HANDLE vcm;
-    GThread *vcm_thread;
+    GThread *vcm_thread;                      /* 反应器不可用时回退的独立事件线程 */
+    DrdSessionReactor *reactor;               /* 运行时的会话事件反应器，登记成功后记录 */
+    DrdSessionReactorSource *reactor_source;  /* 登记在反应器上的事件源，停止时原子认领后注销 */
+    DrdNetworkAutodetect *network_autodetect; /* 归事件处理方（反应器回调或 VCM 线程）所有 */
     DrdRdpGraphicsPipeline *graphics_pipeline;
     gboolean graphics_pipeline_ready;
     guint32 frame_sequence;
@@ -50,10 +66,18 @@ struct _DrdRdpSession
     gint connection_alive;
     GThread *render_thread;
     gint render_running;
+    GMutex render_lock; /* 与 render_cond 配合，渲染线程等待激活/runtime 就绪 */
+    GCond render_cond;  /* 激活、挂接 runtime 或停止渲染时广播 */
     DrdRdpSessionClosedFunc closed_cb;
     gpointer closed_cb_data;
     gint closed_cb_invoked;
     DrdLocalSession *local_session;
+    DrdAuthRequest *auth_request; /* 进行中的 PAM 认证，归事件处理方；期间暂停读取 peer 数据 */
+    HANDLE auth_event;            /* 认证线程交付结果时置位，纳入事件等待集合 */
+    GMutex auth_lock;             /* 保护认证线程交付的结果 */
+    gboolean auth_done;
+    DrdLocalSession *auth_result;
+    GError *auth_error;
     gboolean passive_mode;
     DrdRdpSessionError last_error;
     guint64 frame_pull_errors;
@@ -64,6 +88,12 @@ struct _DrdRdpSession
 
     guint refresh_timeout_source; /* avc 切换时的全量帧定时器 */
     gint refresh_timeout_due; /* 定时器到期后由渲染线程消费 */
+    gint socket_fd; /* peer TCP socket，用于查询内核发送队列 */
+    guint64 transport_stalls; /* 因发送队列未排空而跳过编码的次数 */
+    GMutex network_lock;
+    DrdNetworkEstimate network_estimate; /* 事件处理方发布的网络探测结果 */
+    DrdEncodingManager *gfx_encoder;      /* 所在编码组的编码器，渲染线程加入/离开广播时更新，受 network_lock 保护 */
+    DrdEncodingManager *feedback_encoder; /* 仅组内主观看者持有，网络探测结果交给它，受 network_lock 保护 */
 };
 
 G_DEFINE_TYPE(DrdRdpSession, drd_rdp_session, G_TYPE_OBJECT)
@@ -78,8 +108,14 @@ static gboolean drd_rdp_session_enforce_peer_desktop_size(DrdRdpSession *self);
 
 static gboolean drd_rdp_session_wait_for_graphics_capacity(DrdRdpSession *self, gint64 timeout_us);
 
+static void drd_rdp_session_set_gfx_encoder(DrdRdpSession *self, DrdEncodingManager *encoder, gboolean primary);
+
 static gboolean drd_rdp_session_start_render_thread(DrdRdpSession *self);
 
+static void drd_rdp_session_wake_render(DrdRdpSession *self);
+
+static void drd_rdp_session_halt_render(DrdRdpSession *self);
+
 static void drd_rdp_session_stop_render_thread(DrdRdpSession *self);
 
 static gpointer drd_rdp_session_render_thread(gpointer user_data);
@@ -100,13 +136,19 @@ static gboolean drd_rdp_session_on_refresh_timeout(gpointer user_data);
 
 static void drd_rdp_session_cancel_refresh_timer(DrdRdpSession *self);
 static void drd_rdp_session_update_refresh_timer_state(DrdRdpSession *self);
+static void drd_rdp_session_configure_peer_socket(DrdRdpSession *self);
+static gboolean drd_rdp_session_wait_for_transport_drain(DrdRdpSession *self);
+static void drd_rdp_session_tick_network_autodetect(DrdRdpSession *self);
+static gboolean drd_rdp_session_check_events(DrdRdpSession *self);
+static gboolean drd_rdp_session_register_reactor(DrdRdpSession *self);
 
 /*
  * 功能：释放会话持有的线程与资源，防止 FreeRDP peer 悬挂。
  * 逻辑：停止事件线程与渲染管线，等待 VCM 线程结束；若 peer context 仍存在则交由 FreeRDP 管理；
- *       释放运行时与本地会话引用，交给父类做剩余清理。
+ *       放弃未完成的 PAM 认证并关闭未取走的结果，释放运行时与本地会话引用，交给父类做剩余清理。
  * 参数：object GObject 指针，预期为 DrdRdpSession。
- * 外部接口：调用 GLib g_thread_join 等线程接口，依赖 drd_local_session_close 关闭本地会话。
+ * 外部接口：调用 GLib g_thread_join 等线程接口，依赖 drd_auth_request_release 放弃认证、
+ *           drd_local_session_close 关闭本地会话。
  */
 static void drd_rdp_session_dispose(GObject *object)
 {
@@ -127,6 +169,11 @@ static void drd_rdp_session_dispose(GObject *object)
         self->peer = NULL;
     }
 
+    /* release 返回后认证线程不再回调，结果字段可直接清理 */
+    g_clear_pointer(&self->auth_request, drd_auth_request_release);
+    g_clear_pointer(&self->auth_result, drd_local_session_close);
+    g_clear_error(&self->auth_error);
+
     g_clear_object(&self->runtime);
     g_clear_pointer(&self->local_session, drd_local_session_close);
 
@@ -135,10 +182,10 @@ static void drd_rdp_session_dispose(GObject *object)
 
 /*
  * 功能：释放会话中申请的动态字符串与图形管线。
- * 逻辑：停止事件线程，释放 peer_address/state 字符串以及 graphics_pipeline 引用，
+ * 逻辑：停止事件线程，释放 peer_address/state 字符串以及 graphics_pipeline、编码器引用与认证事件，
  *       最终交给父类 finalize。
  * 参数：object GObject 指针。
- * 外部接口：使用 GLib g_clear_pointer/g_clear_object 处理引用。
+ * 外部接口：使用 GLib g_clear_pointer/g_clear_object 处理引用；WinPR CloseHandle 关闭事件。
  */
 static void drd_rdp_session_finalize(GObject *object)
 {
@@ -147,6 +194,17 @@ static void drd_rdp_session_finalize(GObject *object)
     g_clear_pointer(&self->peer_address, g_free);
     g_clear_pointer(&self->state, g_free);
     g_clear_object(&self->graphics_pipeline);
+    g_clear_object(&self->gfx_encoder);
+    g_clear_object(&self->feedback_encoder);
+    g_mutex_clear(&self->network_lock);
+    if (self->auth_event != NULL)
+    {
+        CloseHandle(self->auth_event);
+        self->auth_event = NULL;
+    }
+    g_mutex_clear(&self->auth_lock);
+    g_mutex_clear(&self->render_lock);
+    g_cond_clear(&self->render_cond);
     G_OBJECT_CLASS(drd_rdp_session_parent_class)->finalize(object);
 }
 
@@ -165,9 +223,9 @@ static void drd_rdp_session_class_init(DrdRdpSessionClass *klass)
 
 /*
  * 功能：初始化会话实例字段为安全默认值。
- * 逻辑：填充 peer 地址/状态默认字符串，重置线程/句柄/计数器，初始化原子标志。
+ * 逻辑：填充 peer 地址/状态默认字符串，重置线程/句柄/计数器，初始化原子标志，创建手动复位的认证事件。
  * 参数：self 会话实例。
- * 外部接口：使用 GLib 原子操作 g_atomic_int_set。
+ * 外部接口：使用 GLib 原子操作 g_atomic_int_set；WinPR CreateEvent。
  */
 static void drd_rdp_session_init(DrdRdpSession *self)
 {
@@ -176,6 +234,9 @@ static void drd_rdp_session_init(DrdRdpSession *self)
     self->state = g_strdup("created");
     self->runtime = NULL;
     self->vcm_thread = NULL;
+    self->reactor = NULL;
+    self->reactor_source = NULL;
+    self->network_autodetect = NULL;
     self->vcm = INVALID_HANDLE_VALUE;
     self->graphics_pipeline = NULL;
     self->graphics_pipeline_ready = FALSE;
@@ -187,10 +248,18 @@ static void drd_rdp_session_init(DrdRdpSession *self)
     g_atomic_int_set(&self->connection_alive, 1);
     self->render_thread = NULL;
     g_atomic_int_set(&self->render_running, 0);
+    g_mutex_init(&self->render_lock);
+    g_cond_init(&self->render_cond);
     self->closed_cb = NULL;
     self->closed_cb_data = NULL;
     g_atomic_int_set(&self->closed_cb_invoked, 0);
     self->local_session = NULL;
+    self->auth_request = NULL;
+    self->auth_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    g_mutex_init(&self->auth_lock);
+    self->auth_done = FALSE;
+    self->auth_result = NULL;
+    self->auth_error = NULL;
     self->passive_mode = FALSE;
     self->last_error = DRD_RDP_SESSION_ERROR_NONE;
     self->frame_pull_errors = 0;
@@ -199,6 +268,12 @@ static void drd_rdp_session_init(DrdRdpSession *self)
     self->congestion_permanent_disabled = FALSE;
     self->refresh_timeout_source = 0;
     g_atomic_int_set(&self->refresh_timeout_due, 0);
+    self->socket_fd = -1;
+    self->transport_stalls = 0;
+    g_mutex_init(&self->network_lock);
+    memset(&self->network_estimate, 0, sizeof(self->network_estimate));
+    self->gfx_encoder = NULL;
+    self->feedback_encoder = NULL;
 }
 
 /*
@@ -286,6 +361,7 @@ void drd_rdp_session_set_runtime(DrdRdpSession *self, DrdServerRuntime *runtime)
     self->runtime = runtime;
 
     drd_rdp_session_maybe_init_graphics(self);
+    drd_rdp_session_wake_render(self);
 }
 
 /*
@@ -357,6 +433,118 @@ void drd_rdp_session_attach_local_session(DrdRdpSession *self, DrdLocalSession *
     self->local_session = session;
 }
 
+/*
+ * 功能：认证线程交付 PAM 结果。
+ * 逻辑：在认证线程上执行；持锁保存本地会话或错误副本，再置位 auth_event 唤醒事件处理方。
+ *       会话 dispose 先 release 请求，保证此回调不会晚于会话释放。
+ * 参数：local_session 认证成功时的本地会话（所有权转入）；error 失败原因；user_data 会话。
+ * 外部接口：GLib g_error_copy；WinPR SetEvent。
+ */
+static void drd_rdp_session_on_authenticated(DrdLocalSession *local_session, const GError *error, gpointer user_data)
+{
+    DrdRdpSession *self = user_data;
+
+    g_mutex_lock(&self->auth_lock);
+    self->auth_result = local_session;
+    self->auth_error = error != NULL ? g_error_copy(error) : NULL;
+    self->auth_done = TRUE;
+    g_mutex_unlock(&self->auth_lock);
+    SetEvent(self->auth_event);
+}
+
+/*
+ * 功能：把 TLS-only 登录的 PAM 认证提交到认证线程池。
+ * 逻辑：在事件处理方（PostConnect 回调）上调用，提交后立即返回；结果就绪前会话只等待 auth_event 与超时节拍，
+ *       不再读取 peer 数据，客户端停在激活之前，不会有输入或画面越过认证。
+ * 参数：self 会话；pool 认证线程池；pam_service/username/domain/password/remote_host 同 drd_local_session_new；
+ *       error 错误输出。
+ * 外部接口：drd_auth_pool_submit。
+ * 返回：已排队返回 TRUE；排队已满等失败返回 FALSE。
+ */
+gboolean drd_rdp_session_begin_authentication(DrdRdpSession *self,
+                                              DrdAuthPool *pool,
+                                              const gchar *pam_service,
+                                              const gchar *username,
+                                              const gchar *domain,
+                                              const gchar *password,
+                                              const gchar *remote_host,
+                                              GError **error)
+{
+    g_return_val_if_fail(DRD_IS_RDP_SESSION(self), FALSE);
+    g_return_val_if_fail(pool != NULL, FALSE);
+    g_return_val_if_fail(self->auth_request == NULL, FALSE);
+
+    if (self->auth_event == NULL)
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Authentication event unavailable");
+        return FALSE;
+    }
+
+    DrdAuthRequest *request = drd_auth_pool_submit(pool,
+                                                   pam_service,
+                                                   username,
+                                                   domain,
+                                                   password,
+                                                   remote_host,
+                                                   drd_rdp_session_on_authenticated,
+                                                   self,
+                                                   error);
+    if (request == NULL)
+    {
+        return FALSE;
+    }
+
+    self->auth_request = request;
+    drd_rdp_session_set_peer_state(self, "authenticating");
+    return TRUE;
+}
+
+/*
+ * 功能：在事件处理方上收取 PAM 认证结果。
+ * 逻辑：结果未就绪时检查请求是否超时；超时或失败则放弃请求并断开会话；成功则附加本地会话，
+ *       此后恢复读取 peer 数据继续连接流程。
+ * 参数：self 会话，须有进行中的认证请求。
+ * 外部接口：drd_auth_request_is_expired/drd_auth_request_release；WinPR ResetEvent；日志 DRD_LOG_MESSAGE/DRD_LOG_WARNING。
+ * 返回：会话需要断开时返回 FALSE。
+ */
+static gboolean drd_rdp_session_poll_authentication(DrdRdpSession *self)
+{
+    g_mutex_lock(&self->auth_lock);
+    const gboolean done = self->auth_done;
+    DrdLocalSession *local_session = g_steal_pointer(&self->auth_result);
+    g_autoptr(GError) error = g_steal_pointer(&self->auth_error);
+    self->auth_done = FALSE;
+    g_mutex_unlock(&self->auth_lock);
+
+    if (!done)
+    {
+        if (!drd_auth_request_is_expired(self->auth_request))
+        {
+            return TRUE;
+        }
+        g_clear_pointer(&self->auth_request, drd_auth_request_release);
+        DRD_LOG_WARNING("Session %s TLS/PAM single sign-on timed out", self->peer_address);
+        drd_rdp_session_disconnect(self, "tls-rdp-sso-auth-timeout");
+        return FALSE;
+    }
+
+    ResetEvent(self->auth_event);
+    g_clear_pointer(&self->auth_request, drd_auth_request_release);
+    if (local_session == NULL)
+    {
+        DRD_LOG_WARNING("Session %s TLS/PAM single sign-on failure: %s",
+                        self->peer_address,
+                        error != NULL ? error->message : "unknown error");
+        drd_rdp_session_disconnect(self, "tls-rdp-sso-auth-failed");
+        return FALSE;
+    }
+
+    drd_rdp_session_attach_local_session(self, local_session);
+    drd_rdp_session_set_peer_state(self, "authenticated");
+    DRD_LOG_MESSAGE("Session %s TLS/PAM single sign-on accepted", self->peer_address);
+    return TRUE;
+}
+
 /*
  * 功能：post-connect 钩子，更新状态。
  * 逻辑：设置状态为 post-connect 后返回 TRUE。
@@ -439,9 +627,11 @@ BOOL drd_rdp_session_activate(DrdRdpSession *self)
     }
 
     drd_rdp_session_refresh_surface_payload_limit(self);
+    drd_rdp_session_configure_peer_socket(self);
 
     drd_rdp_session_set_peer_state(self, "activated");
     self->is_activated = TRUE;
+    drd_rdp_session_wake_render(self);
     if (!drd_rdp_session_start_render_thread(self))
     {
         DRD_LOG_WARNING("Session %s failed to start renderer thread", self->peer_address);
@@ -451,9 +641,9 @@ BOOL drd_rdp_session_activate(DrdRdpSession *self)
 }
 
 /*
- * 功能：创建事件线程（含 VCM 线程），准备 Stop 事件。
+ * 功能：开始处理会话的 peer/VCM 事件，准备 Stop 事件。
  * 逻辑：校验 peer 有效与未重复创建；初始化 stop_event；重置 connection_alive；
- *       若存在 VCM 句柄则启动 drd_rdp_session_vcm_thread。
+ *       若存在 VCM 句柄则优先登记到运行时的会话事件反应器，登记失败时回退启动独立的 drd_rdp_session_vcm_thread。
  * 参数：self 会话。
  * 外部接口：使用 WinPR CreateEvent/SetEvent/WaitForSingleObject 操作事件，
  *           GLib g_thread_new 创建线程。
@@ -483,7 +673,8 @@ gboolean drd_rdp_session_start_event_thread(DrdRdpSession *self)
 
     g_atomic_int_set(&self->connection_alive, 1);
 
-    if (self->vcm != NULL && self->vcm != INVALID_HANDLE_VALUE && self->vcm_thread == NULL)
+    if (self->vcm != NULL && self->vcm != INVALID_HANDLE_VALUE && self->vcm_thread == NULL &&
+        g_atomic_pointer_get(&self->reactor_source) == NULL && !drd_rdp_session_register_reactor(self))
     {
         self->vcm_thread = g_thread_new("drd-rdp-vcm", drd_rdp_session_vcm_thread, self);
     }
@@ -521,9 +712,55 @@ static gboolean drd_rdp_session_start_render_thread(DrdRdpSession *self)
     return TRUE;
 }
 
+/*
+ * 功能：唤醒等待激活/runtime 就绪的渲染线程。
+ * 逻辑：调用方先更新状态再调用；持 render_lock 广播，渲染线程在同一把锁下检查条件，不会错过唤醒。
+ * 参数：self 会话。
+ * 外部接口：GLib g_mutex_lock/g_cond_broadcast。
+ */
+static void drd_rdp_session_wake_render(DrdRdpSession *self)
+{
+    g_mutex_lock(&self->render_lock);
+    g_cond_broadcast(&self->render_cond);
+    g_mutex_unlock(&self->render_lock);
+}
+
+/*
+ * 功能：清除渲染运行标志并唤醒渲染线程。
+ * 逻辑：置 render_running=0 后广播 render_cond，使等待激活的渲染线程立即退出。
+ * 参数：self 会话。
+ * 外部接口：GLib g_atomic_int_set。
+ */
+static void drd_rdp_session_halt_render(DrdRdpSession *self)
+{
+    g_atomic_int_set(&self->render_running, 0);
+    drd_rdp_session_wake_render(self);
+}
+
+/*
+ * 功能：渲染线程等待会话激活且 runtime 就绪。
+ * 逻辑：持 render_lock 在 render_cond 上等待，直到会话已激活且挂接 runtime，或渲染/连接已停止；
+ *       激活、挂接 runtime 与停止渲染都会广播该条件。
+ * 参数：self 会话。
+ * 外部接口：GLib g_cond_wait。
+ * 返回：会话已激活且 runtime 就绪返回 TRUE，渲染需要退出返回 FALSE。
+ */
+static gboolean drd_rdp_session_wait_render_ready(DrdRdpSession *self)
+{
+    g_mutex_lock(&self->render_lock);
+    while (g_atomic_int_get(&self->render_running) && g_atomic_int_get(&self->connection_alive) &&
+           (!self->is_activated || self->runtime == NULL))
+    {
+        g_cond_wait(&self->render_cond, &self->render_lock);
+    }
+    const gboolean ready = g_atomic_int_get(&self->render_running) && g_atomic_int_get(&self->connection_alive);
+    g_mutex_unlock(&self->render_lock);
+    return ready;
+}
+
 /*
  * 功能：停止渲染线程并等待退出。
- * 逻辑：若线程存在，清除运行标志并 join 线程。
+ * 逻辑：若线程存在，清除运行标志并唤醒渲染线程，再 join 线程。
  * 参数：self 会话。
  * 外部接口：GLib g_thread_join。
  */
@@ -536,7 +773,7 @@ static void drd_rdp_session_stop_render_thread(DrdRdpSession *self)
         return;
     }
 
-    g_atomic_int_set(&self->render_running, 0);
+    drd_rdp_session_halt_render(self);
     g_thread_join(self->render_thread);
     self->render_thread = NULL;
 }
@@ -544,9 +781,10 @@ static void drd_rdp_session_stop_render_thread(DrdRdpSession *self)
 /*
  * 功能：停止事件线程/渲染线程并通知关闭。
  * 逻辑：先停止渲染线程并置 connection_alive=0；触发 stop_event 唤醒等待；
- *       join 事件与 VCM 线程、关闭事件句柄，最后触发关闭回调。
+ *       join 事件与 VCM 线程，或从反应器注销事件源（原子认领，只注销一次；在反应器回调内调用时不等待自身），
+ *       关闭事件句柄，最后触发关闭回调。
  * 参数：self 会话。
- * 外部接口：WinPR SetEvent/CloseHandle 操作事件；GLib g_thread_join。
+ * 外部接口：WinPR SetEvent/CloseHandle 操作事件；GLib g_thread_join；drd_session_reactor_remove。
  */
 void drd_rdp_session_stop_event_thread(DrdRdpSession *self)
 {
@@ -555,6 +793,7 @@ void drd_rdp_session_stop_event_thread(DrdRdpSession *self)
     drd_rdp_session_stop_render_thread(self);
 
     g_atomic_int_set(&self->connection_alive, 0);
+    drd_rdp_session_wake_render(self);
 
     if (self->stop_event != NULL)
     {
@@ -574,6 +813,12 @@ void drd_rdp_session_stop_event_thread(DrdRdpSession *self)
         self->vcm_thread = NULL;
     }
 
+    DrdSessionReactorSource *source = g_atomic_pointer_get(&self->reactor_source);
+    if (source != NULL && g_atomic_pointer_compare_and_exchange(&self->reactor_source, source, NULL))
+    {
+        drd_session_reactor_remove(self->reactor, source);
+    }
+
     if (self->stop_event != NULL)
     {
         CloseHandle(self->stop_event);
@@ -901,7 +1146,7 @@ gboolean drd_rdp_session_send_server_redirection(DrdRdpSession *self, const gcha
 
 /*
  * 功能：主动断开会话并释放资源。
- * 逻辑：记录原因日志 -> 停止事件线程/图形管线 -> 清理本地会话并重置标志 -> 调用 peer->Disconnect。
+ * 逻辑：记录原因日志 -> 停止事件线程/图形管线 -> 放弃未完成的 PAM 认证、清理本地会话并重置标志 -> 调用 peer->Disconnect。
  * 参数：self 会话；reason 断开原因。
  * 外部接口：FreeRDP peer->Disconnect 终止连接；DRD_LOG_MESSAGE 输出日志。
  */
@@ -916,9 +1161,10 @@ void drd_rdp_session_disconnect(DrdRdpSession *self, const gchar *reason)
 
     drd_rdp_session_stop_event_thread(self);
     drd_rdp_session_disable_graphics_pipeline(self, NULL);
+    g_clear_pointer(&self->auth_request, drd_auth_request_release);
     g_clear_pointer(&self->local_session, drd_local_session_close);
-    g_atomic_int_set(&self->render_running, 0);
     g_atomic_int_set(&self->connection_alive, 0);
+    drd_rdp_session_halt_render(self);
     if (self->peer != NULL && self->peer->Disconnect != NULL)
     {
         self->peer->Disconnect(self->peer);
@@ -929,13 +1175,283 @@ void drd_rdp_session_disconnect(DrdRdpSession *self, const gchar *reason)
 }
 
 /*
- * 功能：在独立线程处理虚拟通道与 peer 事件，驱动 drdynvc/Rdpgfx 生命周期。
- * 逻辑：获取 VCM 事件句柄，循环等待 stop_event、channel_event 以及 peer 事件；
- *       调用 peer->CheckFileDescriptor 驱动 FreeRDP，监测 drdynvc 状态并触发 graphics 管线初始化，
- *       直到连接终止。
+ * 功能：在事件处理方（反应器回调或 VCM 线程）上驱动 RDP 网络自动探测并发布结果。
+ * 逻辑：会话激活且客户端协商了 NetworkAutoDetect 后惰性创建探测器（非被动模式）；每次唤醒推进探测状态机，
+ *       估计更新时写入会话副本并发布给编码管理器用于码率与编码格式决策。探测器归事件处理方所有，
+ *       在事件源注销或线程退出时释放，保证 FreeRDP peer 仍然有效。
+ * 参数：self 会话。
+ * 外部接口：drd_network_autodetect_*；drd_encoding_manager_update_network_estimate；
+ *           freerdp_settings_get_bool 读取 FreeRDP_NetworkAutoDetect。
+ */
+static void drd_rdp_session_tick_network_autodetect(DrdRdpSession *self)
+{
+    if (self->network_autodetect == NULL)
+    {
+        if (!self->is_activated || self->passive_mode || self->peer->context == NULL ||
+            self->peer->context->autodetect == NULL ||
+            !freerdp_settings_get_bool(self->peer->context->settings, FreeRDP_NetworkAutoDetect))
+        {
+            return;
+        }
+        self->network_autodetect = drd_network_autodetect_new(self->peer->context->autodetect);
+        DRD_LOG_MESSAGE("Session %s started network auto-detect", self->peer_address);
+    }
+
+    if (!drd_network_autodetect_tick(self->network_autodetect, g_get_monotonic_time()))
+    {
+        return;
+    }
+
+    DrdNetworkEstimate estimate;
+    drd_network_autodetect_get_estimate(self->network_autodetect, &estimate);
+    g_mutex_lock(&self->network_lock);
+    self->network_estimate = estimate;
+    g_autoptr(DrdEncodingManager) encoder =
+            self->feedback_encoder != NULL ? g_object_ref(self->feedback_encoder) : NULL;
+    g_mutex_unlock(&self->network_lock);
+
+    if (encoder != NULL)
+    {
+        drd_encoding_manager_update_network_estimate(encoder,
+                                                     estimate.has_bandwidth ? estimate.bandwidth_bps : 0,
+                                                     estimate.srtt_us,
+                                                     estimate.loss_ratio);
+    }
+}
+
+/*
+ * 功能：读取会话最近一次网络探测结果。
+ * 逻辑：持锁复制事件处理方发布的估计；尚未探测时各字段为 0 且 has_* 为 FALSE。
+ * 参数：self 会话；out_estimate 输出。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void drd_rdp_session_get_network_estimate(DrdRdpSession *self, DrdNetworkEstimate *out_estimate)
+{
+    g_return_if_fail(DRD_IS_RDP_SESSION(self));
+    g_return_if_fail(out_estimate != NULL);
+
+    g_mutex_lock(&self->network_lock);
+    *out_estimate = self->network_estimate;
+    g_mutex_unlock(&self->network_lock);
+}
+
+/*
+ * 功能：处理一轮 peer 与虚拟通道事件，驱动 drdynvc/Rdpgfx 生命周期。
+ * 逻辑：PAM 认证进行中时只收取认证结果，暂不读取 peer 数据；
+ *       否则调用 peer->CheckFileDescriptor 驱动 FreeRDP（Activate 等回调可能在此期间断开会话）；连接建立后推进网络探测，
+ *       监测 drdynvc 状态并触发 graphics 管线初始化，channel_event 就绪时处理 VCM 数据。
+ *       反应器回调与回退的 VCM 线程共用此函数。
+ * 参数：self 会话。
+ * 外部接口：FreeRDP peer->CheckFileDescriptor、WTSVirtualChannelManager*；WinPR SetEvent/WaitForSingleObject。
+ * 返回：连接已结束时返回 FALSE。
+ */
+static gboolean drd_rdp_session_check_events(DrdRdpSession *self)
+{
+    freerdp_peer *peer = self->peer;
+    HANDLE vcm = self->vcm;
+
+    if (peer == NULL || vcm == NULL || vcm == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    if (self->auth_request != NULL)
+    {
+        if (!drd_rdp_session_poll_authentication(self))
+        {
+            return FALSE;
+        }
+        if (self->auth_request != NULL)
+        {
+            return TRUE;
+        }
+    }
+
+    HANDLE channel_event = WTSVirtualChannelManagerGetEventHandle(vcm);
+
+    if (!peer->CheckFileDescriptor(peer))
+    {
+        g_message("[RDP] CheckFileDescriptor error, stopping session");
+        g_atomic_int_set(&self->connection_alive, 0);
+        return FALSE;
+    }
+
+    if (!g_atomic_int_get(&self->connection_alive))
+    {
+        return FALSE;
+    }
+
+    if (!peer->connected)
+    {
+        return TRUE;
+    }
+
+    drd_rdp_session_tick_network_autodetect(self);
+
+    if (!WTSVirtualChannelManagerIsChannelJoined(vcm, DRDYNVC_SVC_CHANNEL_NAME))
+    {
+        return TRUE;
+    }
+
+    switch (WTSVirtualChannelManagerGetDrdynvcState(vcm))
+    {
+        case DRDYNVC_STATE_NONE:
+            SetEvent(channel_event);
+            break;
+        case DRDYNVC_STATE_READY:
+            if (self->graphics_pipeline && g_atomic_int_get(&self->connection_alive))
+            {
+                drd_rdp_graphics_pipeline_maybe_init(self->graphics_pipeline);
+            }
+            break;
+    }
+    if (!g_atomic_int_get(&self->connection_alive))
+    {
+        return FALSE;
+    }
+    if (channel_event != NULL && WaitForSingleObject(channel_event, 0) == WAIT_OBJECT_0)
+    {
+        if (!WTSVirtualChannelManagerCheckFileDescriptor(vcm))
+        {
+            DRD_LOG_MESSAGE("Session %s failed to check VCM descriptor", self->peer_address);
+            g_atomic_int_set(&self->connection_alive, 0);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * 功能：向反应器提供会话当前的事件句柄。
+ * 逻辑：PAM 认证进行中只填入 auth_event；否则依次填入 VCM channel_event 与 peer 事件句柄，peer 不再提供句柄时视为连接结束。
+ * 参数：user_data 会话；handles 输出句柄数组；max_handles 数组容量。
+ * 外部接口：FreeRDP WTSVirtualChannelManagerGetEventHandle、peer->GetEventHandles。
+ * 返回：句柄数，0 表示连接已结束。
+ */
+static guint drd_rdp_session_reactor_handles(gpointer user_data, HANDLE *handles, guint max_handles)
+{
+    DrdRdpSession *self = DRD_RDP_SESSION(user_data);
+    freerdp_peer *peer = self->peer;
+    guint n_handles = 0;
+
+    if (peer == NULL || !g_atomic_int_get(&self->connection_alive))
+    {
+        return 0;
+    }
+
+    if (self->auth_request != NULL)
+    {
+        handles[n_handles++] = self->auth_event;
+        return n_handles;
+    }
+
+    HANDLE channel_event = WTSVirtualChannelManagerGetEventHandle(self->vcm);
+    if (channel_event != NULL)
+    {
+        handles[n_handles++] = channel_event;
+    }
+
+    const guint peer_handles = peer->GetEventHandles(peer, &handles[n_handles], max_handles - n_handles);
+    if (peer_handles == 0)
+    {
+        g_message("[RDP] peer_events_handles 0, stopping session");
+        g_atomic_int_set(&self->connection_alive, 0);
+        return 0;
+    }
+    return n_handles + peer_handles;
+}
+
+/*
+ * 功能：反应器就绪回调，处理一轮会话事件。
+ * 逻辑：调用 drd_rdp_session_check_events；PAM 认证进行中按认证节拍唤醒以检查超时，
+ *       网络探测运行时按其节拍设置周期唤醒，以便发送 RTT/带宽请求。
+ * 参数：source 反应器事件源；user_data 会话。
+ * 外部接口：drd_session_reactor_source_set_tick。
+ * 返回：连接已结束时返回 FALSE，事件源随之注销。
+ */
+static gboolean drd_rdp_session_reactor_dispatch(DrdSessionReactorSource *source, gpointer user_data)
+{
+    DrdRdpSession *self = DRD_RDP_SESSION(user_data);
+
+    if (!g_atomic_int_get(&self->connection_alive))
+    {
+        return FALSE;
+    }
+
+    const gboolean alive = drd_rdp_session_check_events(self);
+    guint tick_ms = 0;
+    if (self->auth_request != NULL)
+    {
+        tick_ms = DRD_RDP_SESSION_AUTH_TICK_MS;
+    }
+    else if (self->network_autodetect != NULL)
+    {
+        tick_ms = DRD_RDP_SESSION_AUTODETECT_TICK_MS;
+    }
+    drd_session_reactor_source_set_tick(source, tick_ms);
+    return alive;
+}
+
+/*
+ * 功能：事件源注销后的收尾，与 VCM 线程退出时的处理一致。
+ * 逻辑：释放网络探测器，停止渲染循环并触发关闭回调，最后释放登记时持有的会话引用。
+ * 参数：user_data 会话。
+ * 外部接口：drd_network_autodetect_free；GLib g_object_unref。
+ */
+static void drd_rdp_session_reactor_destroy(gpointer user_data)
+{
+    DrdRdpSession *self = DRD_RDP_SESSION(user_data);
+
+    g_clear_pointer(&self->network_autodetect, drd_network_autodetect_free);
+    drd_rdp_session_halt_render(self);
+    drd_rdp_session_notify_closed(self);
+    g_object_unref(self);
+}
+
+/*
+ * 功能：把会话的 peer/VCM 事件登记到运行时的会话事件反应器。
+ * 逻辑：反应器持有一份会话引用，注销后由 destroy 回调释放；句柄不可 poll 或反应器不可用时登记失败，
+ *       由调用方回退独立的 VCM 线程。
+ * 参数：self 会话。
+ * 外部接口：drd_server_runtime_get_session_reactor、drd_session_reactor_add；日志 DRD_LOG_WARNING。
+ * 返回：登记成功返回 TRUE。
+ */
+static gboolean drd_rdp_session_register_reactor(DrdRdpSession *self)
+{
+    DrdSessionReactor *reactor = self->runtime != NULL ? drd_server_runtime_get_session_reactor(self->runtime) : NULL;
+    if (reactor == NULL)
+    {
+        return FALSE;
+    }
+
+    g_autoptr(GError) error = NULL;
+    DrdSessionReactorSource *source = drd_session_reactor_add(reactor,
+                                                              drd_rdp_session_reactor_handles,
+                                                              drd_rdp_session_reactor_dispatch,
+                                                              g_object_ref(self),
+                                                              drd_rdp_session_reactor_destroy,
+                                                              &error);
+    if (source == NULL)
+    {
+        DRD_LOG_WARNING("Session %s falls back to a dedicated event thread: %s",
+                        self->peer_address,
+                        error != NULL ? error->message : "unknown error");
+        g_object_unref(self);
+        return FALSE;
+    }
+
+    self->reactor = reactor;
+    g_atomic_pointer_set(&self->reactor_source, source);
+    return TRUE;
+}
+
+/*
+ * 功能：在独立线程处理虚拟通道与 peer 事件（会话事件反应器不可用时的回退路径）。
+ * 逻辑：获取 VCM 事件句柄，循环等待 stop_event、channel_event 以及 peer 事件（PAM 认证进行中改为等待 auth_event），
+ *       每次唤醒调用 drd_rdp_session_check_events，直到连接终止。
  * 参数：user_data 会话指针。
- * 外部接口：WinPR WaitForMultipleObjects/WaitForSingleObject 等事件 API，
- *           FreeRDP WTSVirtualChannelManager*、peer->GetEventHandles/CheckFileDescriptor。
+ * 外部接口：WinPR WaitForMultipleObjects 等事件 API，
+ *           FreeRDP WTSVirtualChannelManagerGetEventHandle、peer->GetEventHandles。
  */
 static gpointer drd_rdp_session_vcm_thread(gpointer user_data)
 {
@@ -962,6 +1478,20 @@ static gpointer drd_rdp_session_vcm_thread(gpointer user_data)
         {
             events[n_events++] = self->stop_event;
         }
+        if (self->auth_request != NULL)
+        {
+            /* 认证结果就绪前不读取 peer 数据，按认证节拍检查超时 */
+            events[n_events++] = self->auth_event;
+            if (WaitForMultipleObjects(n_events, events, FALSE, DRD_RDP_SESSION_AUTH_TICK_MS) == WAIT_FAILED)
+            {
+                break;
+            }
+            if (!drd_rdp_session_check_events(self))
+            {
+                break;
+            }
+            continue;
+        }
         if (channel_event != NULL)
         {
             events[n_events++] = channel_event;
@@ -978,7 +1508,10 @@ static gpointer drd_rdp_session_vcm_thread(gpointer user_data)
         DWORD status = WAIT_TIMEOUT;
         if (n_events > 0)
         {
-            status = WaitForMultipleObjects(n_events, events, FALSE, INFINITE);
+            /* 网络探测运行时按其节拍醒来发送 RTT/带宽请求 */
+            status = WaitForMultipleObjects(n_events, events, FALSE,
+                                            self->network_autodetect != NULL ? DRD_RDP_SESSION_AUTODETECT_TICK_MS
+                                                                             : INFINITE);
         }
 
         if (status == WAIT_FAILED)
@@ -986,51 +1519,14 @@ static gpointer drd_rdp_session_vcm_thread(gpointer user_data)
             break;
         }
 
-        if (!peer->CheckFileDescriptor(peer))
-        {
-            g_message("[RDP] CheckFileDescriptor error, stopping session");
-            g_atomic_int_set(&self->connection_alive, 0);
-            break;
-        }
-
-        if (!peer->connected)
-        {
-            continue;
-        }
-
-        if (!WTSVirtualChannelManagerIsChannelJoined(vcm, DRDYNVC_SVC_CHANNEL_NAME))
-        {
-            continue;
-        }
-
-        switch (WTSVirtualChannelManagerGetDrdynvcState(vcm))
-        {
-            case DRDYNVC_STATE_NONE:
-                SetEvent(channel_event);
-                break;
-            case DRDYNVC_STATE_READY:
-                if (self->graphics_pipeline && g_atomic_int_get(&self->connection_alive))
-                {
-                    drd_rdp_graphics_pipeline_maybe_init(self->graphics_pipeline);
-                }
-                break;
-        }
-        if (!g_atomic_int_get(&self->connection_alive))
+        if (!drd_rdp_session_check_events(self))
         {
             break;
         }
-        if (channel_event != NULL && WaitForSingleObject(channel_event, 0) == WAIT_OBJECT_0)
-        {
-            if (!WTSVirtualChannelManagerCheckFileDescriptor(vcm))
-            {
-                DRD_LOG_MESSAGE("Session %s failed to check VCM descriptor", self->peer_address);
-                g_atomic_int_set(&self->connection_alive, 0);
-                break;
-            }
-        }
     }
 
-    g_atomic_int_set(&self->render_running, 0);
+    g_clear_pointer(&self->network_autodetect, drd_network_autodetect_free);
+    drd_rdp_session_halt_render(self);
     drd_rdp_session_notify_closed(self);
     g_object_unref(self);
     return NULL;
@@ -1147,12 +1643,67 @@ static void drd_rdp_session_refresh_surface_payload_limit(DrdRdpSession *self)
 }
 
 /*
- * 功能：渲染线程循环，从 runtime 拉取编码帧并选择 Rdpgfx 或 SurfaceBits 发送。
- * 逻辑：在连接/激活有效时，必要时等待图形管线容量；从 runtime 取帧，优先提交 Rdpgfx，
- *       若提交失败或不可用则回退 SurfaceBits 并处理 payload 限制，维护帧序列号。
+ * 功能：为 peer socket 启用低延迟发送参数并记录 fd。
+ * 逻辑：读取 FreeRDP peer 的 sockfd，设置 TCP_NODELAY 与 TCP_NOTSENT_LOWAT；失败时告警并清空记录的 fd——没有
+ *       NOTSENT_LOWAT 时 POLLOUT 只要有缓冲余量就立即返回，排空等待会退化为空转，渲染线程改为不做发送队列节流。
+ * 参数：self 会话。
+ * 外部接口：drd_peer_socket_configure_low_latency；日志 DRD_LOG_WARNING/DRD_LOG_DEBUG。
+ */
+static void drd_rdp_session_configure_peer_socket(DrdRdpSession *self)
+{
+    g_return_if_fail(DRD_IS_RDP_SESSION(self));
+
+    self->socket_fd = self->peer != NULL ? self->peer->sockfd : -1;
+    if (self->socket_fd < 0)
+    {
+        return;
+    }
+
+    g_autoptr(GError) error = NULL;
+    if (!drd_peer_socket_configure_low_latency(self->socket_fd, DRD_PEER_SOCKET_NOTSENT_LOWAT, &error))
+    {
+        DRD_LOG_WARNING("Session %s failed to tune peer socket, transport drain wait disabled: %s",
+                        self->peer_address, error != NULL ? error->message : "unknown error");
+        self->socket_fd = -1;
+        return;
+    }
+    DRD_LOG_DEBUG("Session %s peer socket tuned (TCP_NODELAY, NOTSENT_LOWAT=%u)", self->peer_address,
+                  DRD_PEER_SOCKET_NOTSENT_LOWAT);
+}
+
+/*
+ * 功能：在编码前确认 socket 发送队列已排空到阈值以下。
+ * 逻辑：内核未发送字节超过 NOTSENT_LOWAT 时最多等待一个帧间隔（16ms）；仍未排空则计数并让渲染线程跳过本轮，
+ *       下一轮再取最新帧编码，避免旧帧在 socket 缓冲中排队。
+ * 参数：self 会话。
+ * 外部接口：drd_peer_socket_wait_drain。
+ */
+static gboolean drd_rdp_session_wait_for_transport_drain(DrdRdpSession *self)
+{
+    if (self->socket_fd < 0)
+    {
+        return TRUE;
+    }
+
+    if (drd_peer_socket_wait_drain(self->socket_fd, DRD_PEER_SOCKET_NOTSENT_LOWAT, 16 * 1000))
+    {
+        return TRUE;
+    }
+    self->transport_stalls++;
+    return FALSE;
+}
+
+/*
+ * 功能：渲染线程循环，承担 Rdpgfx 流水线的发送阶段，或在 SurfaceBits 模式下直接拉帧发送。
+ * 逻辑：Rdpgfx 就绪后作为观看者加入运行时的广播（按编码能力并入或新建编码组，组内首个观看者启动分析/编码阶段线程）；
+ *       本线程等待图形管线容量与 socket 排空后从本会话邮箱取编码帧提交，提交失败丢弃邮箱中的帧并等待关键帧；Rdpgfx 不可用时离开广播并回退
+ *       SurfaceBits，维护帧序列号。只有组内主观看者向本组编码器登记发送/反馈，每个会话按自身帧率调节器的
+ *       有效间隔节流并向运行时登记采集帧率投票，退出时撤销。未激活或 runtime 未挂接时在 render_cond 上等待，
+ *       等待图形容量有总时限，超时视为拥塞持续。
  * 参数：user_data 会话指针。
- * 外部接口：drd_server_runtime_pull_encoded_frame 获取帧，drd_rdp_graphics_pipeline_* 操作图形通道，
- *           FreeRDP/WinPR 睡眠 g_usleep，日志使用 DRD_LOG_*。
+ * 外部接口：drd_gfx_broadcast_join/leave 与 drd_gfx_viewer_* 取帧，drd_encoding_manager_submit_gfx_frame 提交编码帧，
+ *           drd_rdp_graphics_pipeline_* 操作图形通道，drd_server_runtime_vote/withdraw_capture_fps 共享采集帧率，
+ *           g_usleep 节流，日志使用 DRD_LOG_*。
  */
 static gpointer drd_rdp_session_render_thread(gpointer user_data)
 {
@@ -1162,6 +1713,18 @@ static gpointer drd_rdp_session_render_thread(gpointer user_data)
     const gint64 stats_interval = drd_capture_metrics_get_stats_interval_us();
     guint stats_frames = 0;
     gint64 stats_window_start = 0;
+    g_autoptr(DrdFrameRateGovernor) governor = NULL;
+    gboolean fps_voted = FALSE;
+    DrdGfxBroadcast *broadcast = NULL;
+    DrdGfxViewer *viewer = NULL;
+    gboolean primary = FALSE;
+    guint64 frames_sent = 0;
+    gint64 next_frame_deadline = 0;
+
+    if (drd_capture_metrics_get_adaptive_fps())
+    {
+        governor = drd_frame_rate_governor_new(target_fps, drd_capture_metrics_get_min_fps());
+    }
 
     while (g_atomic_int_get(&self->render_running))
     {
@@ -1170,9 +1733,13 @@ static gpointer drd_rdp_session_render_thread(gpointer user_data)
             break;
         }
 
-        if (!self->is_activated || self->runtime == NULL)
+        if ((!self->is_activated || self->runtime == NULL) && !drd_rdp_session_wait_render_ready(self))
         {
-            g_usleep(1000);
+            break;
+        }
+        if (!drd_rdp_session_wait_for_transport_drain(self))
+        {
+            /* 内核发送队列仍积压，暂不编码，保证下一次发出的是最新画面 */
             continue;
         }
         g_autoptr(GError) error = NULL;
@@ -1195,84 +1762,104 @@ static gpointer drd_rdp_session_render_thread(gpointer user_data)
                 DRD_LOG_MESSAGE("Session %s graphics pipeline ready, switching to GFX", self->peer_address);
             }
 
+            if (self->graphics_pipeline_ready && viewer == NULL)
+            {
+                g_autoptr(GError) stage_error = NULL;
+                broadcast = drd_server_runtime_get_gfx_broadcast(self->runtime);
+                viewer = drd_gfx_broadcast_join(broadcast, self->peer->context->settings, &stage_error);
+                if (viewer == NULL)
+                {
+                    DRD_LOG_WARNING("Session %s failed to join Rdpgfx encoder: %s", self->peer_address,
+                                    stage_error != NULL ? stage_error->message : "unknown error");
+                    g_usleep(16 * 1000);
+                    continue;
+                }
+            }
+
             if (self->graphics_pipeline_ready)
             {
-                if (!drd_rdp_session_wait_for_graphics_capacity(self, -1) || !drd_rdp_graphics_pipeline_can_submit(self->graphics_pipeline))
+                if (!drd_rdp_session_wait_for_graphics_capacity(self, DRD_RDP_SESSION_GFX_CAPACITY_TIMEOUT_US) || !drd_rdp_graphics_pipeline_can_submit(self->graphics_pipeline))
                 {
+                    if (!g_atomic_int_get(&self->render_running) || !g_atomic_int_get(&self->connection_alive))
+                    {
+                        /* 等待期间会话停止，由循环条件退出 */
+                        continue;
+                    }
                     DRD_LOG_WARNING("Session %s Rdpgfx congestion persists, disabling graphics pipeline",
                                                        self->peer_address);
                     drd_rdp_session_disable_graphics_pipeline(self, "Rdpgfx congestion");
                     continue;
                 }
-                gboolean h264 = FALSE;
-                if (g_atomic_int_compare_and_exchange(&self->refresh_timeout_due, 1, 0))
+                if (drd_rdp_graphics_pipeline_take_loss_keyframe(self->graphics_pipeline))
                 {
-                    if (drd_server_runtime_send_cached_frame_surface_gfx(self->runtime,
-                                                                         self->peer->context->settings,
-                                                                         drd_rdpgfx_get_context(self->graphics_pipeline),
-                                                                         drd_rdp_graphics_pipeline_get_surface_id(self->graphics_pipeline),
-                                                                         self->frame_sequence,
-                                                                         &h264,
-                                                                         &error))
-                    {
-                        sent = TRUE;
-                        drd_rdp_graphics_pipeline_out_frame_change(self->graphics_pipeline, TRUE);
-
-                        drd_rdp_graphics_pipeline_set_last_frame_mode(self->graphics_pipeline, h264);
-                    }
-                    else if (error != NULL && error->domain == G_IO_ERROR &&
-                             (error->code == G_IO_ERROR_TIMED_OUT || error->code == G_IO_ERROR_PENDING))
-                    {
-                        g_clear_error(&error);
-                    }
-                    else if (error != NULL)
+                    /* 在途帧超时未确认：按客户端参考链可能已断处理，本观看者改为等待关键帧（优先用缓存） */
+                    drd_gfx_viewer_discard_pending(viewer);
+                }
+                if (next_frame_deadline > 0)
+                {
+                    /* 自适应帧率节流：未到下一帧时刻前不取帧编码 */
+                    const gint64 wait_us = next_frame_deadline - g_get_monotonic_time();
+                    if (wait_us > 0)
                     {
-                        self->frame_pull_errors++;
-                        DRD_LOG_WARNING("Session %s failed to send cached refresh: %s (errors=%" G_GUINT64_FORMAT ")",
-                                        self->peer_address,
-                                        error->message,
-                                        self->frame_pull_errors);
-                        g_clear_error(&error);
+                        g_usleep((gulong) wait_us);
                     }
                 }
-                if (!sent)
+                if (g_atomic_int_compare_and_exchange(&self->refresh_timeout_due, 1, 0))
                 {
-                    if (drd_server_runtime_pull_encoded_frame_surface_gfx(
-                            self->runtime,
-                            self->peer->context->settings,
-                            drd_rdpgfx_get_context(self->graphics_pipeline),
-                            drd_rdp_graphics_pipeline_get_surface_id(self->graphics_pipeline),
-                            16 * 1000,
-                            self->frame_sequence,
-                            &h264,
-                            &error))
-                    {
-                        sent = TRUE;
-                        drd_rdp_graphics_pipeline_out_frame_change(self->graphics_pipeline, TRUE);
-
-                        drd_rdp_graphics_pipeline_set_last_frame_mode(self->graphics_pipeline, h264);
+                    drd_gfx_viewer_request_refresh(viewer);
+                }
+                /* 主观看者身份可能随其他会话离开而转移，反馈只交给本组编码器一份 */
+                primary = drd_gfx_viewer_is_primary(viewer);
+                drd_rdp_session_set_gfx_encoder(self, drd_gfx_viewer_get_encoder(viewer), primary);
+                /* 已确认发送容量：授信捕获抓取一帧最新画面（拥塞时不授信，损坏在捕获端累积） */
+                drd_gfx_viewer_grant_capture_credit(viewer);
+
+                /* 发送阶段：取分发到本会话邮箱的下一帧提交到 Rdpgfx */
+                g_autoptr(DrdEncodedGfxFrame) encoded = NULL;
+                if (!drd_gfx_viewer_wait_encoded(viewer, 16 * 1000, &encoded))
+                {
+                    /* 无新数据情况：未提交帧，拥塞窗口无需登记 */
+                    continue;
+                }
 
-                    }
-                    else
-                    {
-                        if (error != NULL && error->domain == G_IO_ERROR &&
-                        (error->code == G_IO_ERROR_TIMED_OUT || error->code == G_IO_ERROR_PENDING))
-                        {
-                            /* 无新数据情况：不递增 outstanding_frames，无需人工调整 */
-                            g_clear_error(&error);
-                            continue;
-                        }
-                        if (error != NULL)
-                        {
-                            self->frame_pull_errors++;
-                            DRD_LOG_WARNING("Session %s failed to pull encoded frame: %s (errors=%" G_GUINT64_FORMAT ")",
-                                            self->peer_address, error->message, self->frame_pull_errors);
-                        }
-                        continue;
-                    }
+                const gint64 transmit_start = g_get_monotonic_time();
+                if (!drd_encoding_manager_submit_gfx_frame(drd_gfx_viewer_get_encoder(viewer),
+                                                           drd_rdpgfx_get_context(self->graphics_pipeline),
+                                                           drd_rdp_graphics_pipeline_get_surface_id(self->graphics_pipeline),
+                                                           self->frame_sequence,
+                                                           encoded,
+                                                           &error))
+                {
+                    drd_gfx_viewer_discard_pending(viewer);
+                    self->frame_pull_errors++;
+                    DRD_LOG_WARNING("Session %s failed to submit encoded frame: %s (errors=%" G_GUINT64_FORMAT ")",
+                                    self->peer_address, error != NULL ? error->message : "unknown error",
+                                    self->frame_pull_errors);
+                    continue;
+                }
+                if (primary)
+                {
+                    drd_encoding_manager_note_frame_sent(drd_gfx_viewer_get_encoder(viewer),
+                                                         self->frame_sequence,
+                                                         encoded);
                 }
+                drd_gfx_viewer_record_transmit(viewer, g_get_monotonic_time() - transmit_start);
+                drd_gfx_viewer_record_sent(viewer, encoded);
+                sent = TRUE;
+                drd_rdp_graphics_pipeline_frame_submitted(self->graphics_pipeline,
+                                                          self->frame_sequence,
+                                                          drd_encoded_gfx_frame_get_size(encoded));
+                drd_rdp_graphics_pipeline_set_last_frame_mode(self->graphics_pipeline,
+                                                              drd_encoded_gfx_frame_is_h264(encoded));
             }
         }
+        if (viewer != NULL && (transport != DRD_FRAME_TRANSPORT_GRAPHICS_PIPELINE || !self->graphics_pipeline_ready))
+        {
+            /* Rdpgfx 不可用时离开广播；最后一名观看者离开即停掉分析/编码线程，把捕获帧让给 SurfaceBits 路径 */
+            drd_rdp_session_set_gfx_encoder(self, NULL, FALSE);
+            drd_gfx_broadcast_leave(broadcast, g_steal_pointer(&viewer));
+            primary = FALSE;
+        }
         if (transport == DRD_FRAME_TRANSPORT_SURFACE_BITS)
         {
             const guint32 max_payload = (guint32) g_atomic_int_get(&self->max_surface_payload);
@@ -1322,14 +1909,148 @@ static gpointer drd_rdp_session_render_thread(gpointer user_data)
                 stats_window_start = now;
             }
             stats_frames++;
+            frames_sent++;
+
+            if (governor != NULL)
+            {
+                DrdFrameRateSample sample = {0};
+                sample.frames_sent = frames_sent;
+                sample.acks_suspended = TRUE;
+                if (transport == DRD_FRAME_TRANSPORT_GRAPHICS_PIPELINE && self->graphics_pipeline != NULL)
+                {
+                    DrdRdpGraphicsPipelineStats gfx_stats;
+                    drd_rdp_graphics_pipeline_get_stats(self->graphics_pipeline, &gfx_stats);
+                    sample.frames_acked = gfx_stats.acked_frames;
+                    sample.acks_suspended = gfx_stats.acks_suspended;
+                    sample.decode_time_us = (guint32) MIN(gfx_stats.decode.p95_us, (gint64) G_MAXUINT32);
+                }
+                sample.change_ratio = drd_encoding_manager_get_change_ratio(
+                        viewer != NULL ? drd_gfx_viewer_get_encoder(viewer) : drd_server_runtime_get_encoder(self->runtime));
+
+                const gboolean fps_changed = drd_frame_rate_governor_update(governor, now, &sample);
+                if (fps_changed || !fps_voted)
+                {
+                    const guint effective_fps = drd_frame_rate_governor_get_fps(governor);
+                    if (fps_changed)
+                    {
+                        DRD_LOG_MESSAGE("Session %s adaptive fps set to %u (target=%u)", self->peer_address,
+                                        effective_fps, target_fps);
+                    }
+                    /* 首帧即登记投票：共享采集帧率取全部在线会话建议值的最大值，与捕获归属哪个会话无关 */
+                    drd_server_runtime_vote_capture_fps(self->runtime, self,
+                                                        effective_fps < target_fps ? effective_fps : 0);
+                    fps_voted = TRUE;
+                }
+                next_frame_deadline = now + drd_frame_rate_governor_get_interval_us(governor);
+            }
 
             const gint64 elapsed = now - stats_window_start;
             if (elapsed >= stats_interval)
             {
                 const gdouble actual_fps = (gdouble) stats_frames * (gdouble) G_USEC_PER_SEC / (gdouble) elapsed;
-                const gboolean reached_target = actual_fps >= (gdouble) target_fps;
-                DRD_LOG_MESSAGE("Session %s render fps=%.2f (target=%u): %s", self->peer_address, actual_fps,
-                                target_fps, reached_target ? "reached target" : "below target");
+                const guint effective_fps = governor != NULL ? drd_frame_rate_governor_get_fps(governor) : target_fps;
+                const gboolean reached_target = actual_fps >= (gdouble) effective_fps;
+                DRD_LOG_MESSAGE("Session %s render fps=%.2f (target=%u effective=%u transport_stalls=%" G_GUINT64_FORMAT
+                                "): %s",
+                                self->peer_address, actual_fps, target_fps, effective_fps, self->transport_stalls,
+                                reached_target ? "reached target" : "below target");
+                DrdNetworkEstimate network;
+                drd_rdp_session_get_network_estimate(self, &network);
+                if (network.has_rtt)
+                {
+                    DRD_LOG_MESSAGE("Session %s network rtt=%" G_GINT64_FORMAT "us min_rtt=%" G_GINT64_FORMAT
+                                    "us bandwidth=%" G_GUINT64_FORMAT "bps loss=%.3f",
+                                    self->peer_address, network.srtt_us, network.min_rtt_us,
+                                    network.has_bandwidth ? network.bandwidth_bps : 0, network.loss_ratio);
+                }
+                if (transport == DRD_FRAME_TRANSPORT_GRAPHICS_PIPELINE && self->graphics_pipeline != NULL)
+                {
+                    DrdRdpGraphicsPipelineStats gfx_stats;
+                    drd_rdp_graphics_pipeline_get_stats(self->graphics_pipeline, &gfx_stats);
+                    DRD_LOG_MESSAGE("Session %s gfx cwnd=%u frames/%" G_GSIZE_FORMAT " bytes inflight=%u/%" G_GSIZE_FORMAT
+                                    " srtt=%" G_GINT64_FORMAT "us min_rtt=%" G_GINT64_FORMAT "us lost=%" G_GUINT64_FORMAT,
+                                    self->peer_address,
+                                    gfx_stats.congestion.cwnd_frames,
+                                    gfx_stats.congestion.cwnd_bytes,
+                                    gfx_stats.congestion.inflight_frames,
+                                    gfx_stats.congestion.inflight_bytes,
+                                    gfx_stats.congestion.srtt_us,
+                                    gfx_stats.congestion.min_rtt_us,
+                                    gfx_stats.congestion.lost_frames);
+                    if (gfx_stats.decode.samples > 0)
+                    {
+                        DRD_LOG_MESSAGE("Session %s client decode p50=%" G_GINT64_FORMAT "us p95=%" G_GINT64_FORMAT
+                                        "us p99=%" G_GINT64_FORMAT "us max=%" G_GINT64_FORMAT "us (qoe=%" G_GUINT64_FORMAT ")",
+                                        self->peer_address,
+                                        gfx_stats.decode.p50_us,
+                                        gfx_stats.decode.p95_us,
+                                        gfx_stats.decode.p99_us,
+                                        gfx_stats.decode.max_us,
+                                        gfx_stats.decode.samples);
+                    }
+                }
+                DrdStagePipelineStats stage_stats;
+                if (viewer != NULL && primary && drd_gfx_viewer_get_stage_stats(viewer, TRUE, &stage_stats))
+                {
+                    guint scratch_allocs = 0;
+                    guint steady_allocs = 0;
+                    drd_encoding_manager_get_scratch_alloc_stats(drd_gfx_viewer_get_encoder(viewer),
+                                                                 &scratch_allocs,
+                                                                 &steady_allocs);
+                    DrdEncodeSchedulerStats scheduler_stats;
+                    drd_encode_scheduler_get_stats(drd_server_runtime_get_encode_scheduler(self->runtime),
+                                                   &scheduler_stats);
+                    DrdEncodeSchedulerClientStats group_sched = {0};
+                    drd_gfx_viewer_get_scheduler_stats(viewer, &group_sched);
+                    DRD_LOG_MESSAGE("Session %s stage avg/max analysis=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT
+                                    "us encode=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "us transmit=%" G_GINT64_FORMAT
+                                    "/%" G_GINT64_FORMAT "us capture_to_send=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT
+                                    "us merged=%" G_GUINT64_FORMAT " stale_skipped=%" G_GUINT64_FORMAT
+                                    " encode_errors=%" G_GUINT64_FORMAT " refresh_cached=%" G_GUINT64_FORMAT
+                                    " scratch_allocs=%u steady_allocs=%u cpu=%.1fms sched_wait=%" G_GINT64_FORMAT
+                                    "/%" G_GINT64_FORMAT "us core_budget=%u group_weight=%u group_tasks=%" G_GUINT64_FORMAT
+                                    " group_cpu=%.1fms group_wait=%.1fms",
+                                    self->peer_address,
+                                    stage_stats.analysis.avg_us,
+                                    stage_stats.analysis.max_us,
+                                    stage_stats.encode.avg_us,
+                                    stage_stats.encode.max_us,
+                                    stage_stats.transmit.avg_us,
+                                    stage_stats.transmit.max_us,
+                                    stage_stats.latency.avg_us,
+                                    stage_stats.latency.max_us,
+                                    stage_stats.analysis_merged,
+                                    stage_stats.stale_skipped,
+                                    stage_stats.encode_errors,
+                                    stage_stats.refresh_cached,
+                                    scratch_allocs,
+                                    steady_allocs,
+                                    (gdouble) stage_stats.cpu_us / 1000.0,
+                                    stage_stats.sched_wait.avg_us,
+                                    stage_stats.sched_wait.max_us,
+                                    scheduler_stats.core_budget,
+                                    group_sched.weight,
+                                    group_sched.tasks,
+                                    (gdouble) group_sched.cpu_us / 1000.0,
+                                    (gdouble) group_sched.wait_us / 1000.0);
+                }
+                if (viewer != NULL)
+                {
+                    DrdGfxViewerStats viewer_stats;
+                    drd_gfx_viewer_get_stats(viewer, &viewer_stats);
+                    DRD_LOG_MESSAGE("Session %s viewer primary=%d viewers=%u groups=%u delivered=%" G_GUINT64_FORMAT
+                                    " skipped=%" G_GUINT64_FORMAT " lag_events=%" G_GUINT64_FORMAT
+                                    " keyframe_waits=%" G_GUINT64_FORMAT " cached_keyframes=%" G_GUINT64_FORMAT,
+                                    self->peer_address,
+                                    primary,
+                                    drd_gfx_broadcast_get_viewer_count(broadcast),
+                                    drd_gfx_broadcast_get_group_count(broadcast),
+                                    viewer_stats.delivered_frames,
+                                    viewer_stats.skipped_frames,
+                                    viewer_stats.lag_events,
+                                    viewer_stats.keyframe_waits,
+                                    viewer_stats.cached_keyframes);
+                }
                 stats_frames = 0;
                 stats_window_start = now;
             }
@@ -1344,6 +2065,18 @@ static gpointer drd_rdp_session_render_thread(gpointer user_data)
         }
     }
 
+    if (viewer != NULL)
+    {
+        drd_rdp_session_set_gfx_encoder(self, NULL, FALSE);
+        drd_gfx_broadcast_leave(broadcast, g_steal_pointer(&viewer));
+    }
+
+    if (fps_voted && self->runtime != NULL)
+    {
+        /* 撤销本会话投票；最后一个会话离开时运行时把采集帧率恢复为 0 */
+        drd_server_runtime_withdraw_capture_fps(self->runtime, self);
+    }
+
     g_object_unref(self);
     return NULL;
 }
@@ -1420,9 +2153,10 @@ static void drd_rdp_session_disable_graphics_pipeline(DrdRdpSession *self, const
 
 /*
  * 功能：等待 Rdpgfx 管线释放容量。
- * 逻辑：当 pipeline 就绪时调用 drd_rdp_graphics_pipeline_wait_for_capacity，按超时返回。
- * 参数：self 会话；timeout_us 等待时间，-1 表示阻塞。
- * 外部接口：drd_rdp_graphics_pipeline_wait_for_capacity。
+ * 逻辑：当 pipeline 就绪时按 DRD_RDP_SESSION_GFX_CAPACITY_SLICE_US 分片调用 drd_rdp_graphics_pipeline_wait_for_capacity，
+ *       分片之间检查渲染/连接停止标志，停止时立即返回；总等待不超过 timeout_us，surface 失效或超时返回 FALSE。
+ * 参数：self 会话；timeout_us 总等待时间，必须为正。
+ * 外部接口：drd_rdp_graphics_pipeline_wait_for_capacity/drd_rdp_graphics_pipeline_is_ready。
  */
 static gboolean drd_rdp_session_wait_for_graphics_capacity(DrdRdpSession *self, gint64 timeout_us)
 {
@@ -1431,7 +2165,25 @@ static gboolean drd_rdp_session_wait_for_graphics_capacity(DrdRdpSession *self,
         return FALSE;
     }
 
-    return drd_rdp_graphics_pipeline_wait_for_capacity(self->graphics_pipeline, timeout_us);
+    const gint64 deadline = g_get_monotonic_time() + timeout_us;
+    while (g_atomic_int_get(&self->render_running) && g_atomic_int_get(&self->connection_alive))
+    {
+        const gint64 remaining = deadline - g_get_monotonic_time();
+        if (remaining <= 0)
+        {
+            return FALSE;
+        }
+        if (drd_rdp_graphics_pipeline_wait_for_capacity(self->graphics_pipeline,
+                                                        MIN(remaining, DRD_RDP_SESSION_GFX_CAPACITY_SLICE_US)))
+        {
+            return TRUE;
+        }
+        if (!drd_rdp_graphics_pipeline_is_ready(self->graphics_pipeline))
+        {
+            return FALSE;
+        }
+    }
+    return FALSE;
 }
 
 static void drd_rdp_session_cancel_refresh_timer(DrdRdpSession *self)
@@ -1447,18 +2199,63 @@ static void drd_rdp_session_cancel_refresh_timer(DrdRdpSession *self)
     g_atomic_int_set(&self->refresh_timeout_due, 0);
 }
 
+/*
+ * 功能：记录本会话所在编码组的编码器。
+ * 逻辑：持 network_lock 更新编码器引用；仅组内主观看者同时登记为反馈编码器，网络探测与 ACK/QoE 反馈
+ *       只交给它一份。离开广播时传 NULL 清空。
+ * 参数：self 会话；encoder 编码组编码器，可为 NULL；primary 是否为组内主观看者。
+ * 外部接口：GLib g_set_object；drd_rdp_graphics_pipeline_set_encoder_feedback。
+ */
+static void drd_rdp_session_set_gfx_encoder(DrdRdpSession *self, DrdEncodingManager *encoder, gboolean primary)
+{
+    DrdEncodingManager *feedback = primary ? encoder : NULL;
+
+    g_mutex_lock(&self->network_lock);
+    g_set_object(&self->gfx_encoder, encoder);
+    g_set_object(&self->feedback_encoder, feedback);
+    g_mutex_unlock(&self->network_lock);
+
+    if (self->graphics_pipeline != NULL)
+    {
+        drd_rdp_graphics_pipeline_set_encoder_feedback(self->graphics_pipeline, feedback);
+    }
+}
+
+/*
+ * 功能：获取本会话当前使用的编码器。
+ * 逻辑：已加入 Rdpgfx 广播时返回所在编码组的编码器，否则回退运行时的 SurfaceBits 编码器。
+ * 参数：self 会话。
+ * 外部接口：drd_server_runtime_get_encoder；GLib g_object_ref。
+ * 返回：编码器引用（调用方释放），均不可用时返回 NULL。
+ */
+static DrdEncodingManager *drd_rdp_session_dup_encoder(DrdRdpSession *self)
+{
+    DrdEncodingManager *encoder = NULL;
+
+    g_mutex_lock(&self->network_lock);
+    if (self->gfx_encoder != NULL)
+    {
+        encoder = g_object_ref(self->gfx_encoder);
+    }
+    g_mutex_unlock(&self->network_lock);
+
+    if (encoder == NULL && self->runtime != NULL)
+    {
+        encoder = drd_server_runtime_get_encoder(self->runtime);
+        encoder = encoder != NULL ? g_object_ref(encoder) : NULL;
+    }
+    return encoder;
+}
+
 static gboolean drd_rdp_session_on_refresh_timeout(gpointer user_data)
 {
     DrdRdpSession *self = DRD_RDP_SESSION(user_data);
     self->refresh_timeout_source = 0;
 
-    if (self->runtime != NULL)
+    g_autoptr(DrdEncodingManager) encoder = drd_rdp_session_dup_encoder(self);
+    if (encoder != NULL && drd_encoding_manager_refresh_interval_reached(encoder))
     {
-        DrdEncodingManager *encoder = drd_server_runtime_get_encoder(self->runtime);
-        if (encoder != NULL && drd_encoding_manager_refresh_interval_reached(encoder))
-        {
-            g_atomic_int_set(&self->refresh_timeout_due, 1);
-        }
+        g_atomic_int_set(&self->refresh_timeout_due, 1);
     }
 
     return G_SOURCE_REMOVE;
@@ -1466,12 +2263,7 @@ static gboolean drd_rdp_session_on_refresh_timeout(gpointer user_data)
 
 static void drd_rdp_session_update_refresh_timer_state(DrdRdpSession *self)
 {
-    DrdEncodingManager *encoder = NULL;
-
-    if (self->runtime != NULL)
-    {
-        encoder = drd_server_runtime_get_encoder(self->runtime);
-    }
+    g_autoptr(DrdEncodingManager) encoder = drd_rdp_session_dup_encoder(self);
 
     if (encoder == NULL)
     {
@@ -6,8 +6,11 @@
 #include <winpr/wtypes.h>
 #include <glib-object.h>
 
+#include "session/drd_network_autodetect.h"
+
 typedef struct _DrdServerRuntime DrdServerRuntime;
 typedef struct _DrdLocalSession DrdLocalSession;
+typedef struct _DrdAuthPool DrdAuthPool;
 
 
 G_BEGIN_DECLS
@@ -38,6 +41,14 @@ void drd_rdp_session_set_closed_callback(DrdRdpSession *self,
                                          gpointer user_data);
 void drd_rdp_session_set_passive_mode(DrdRdpSession *self, gboolean passive);
 void drd_rdp_session_attach_local_session(DrdRdpSession *self, DrdLocalSession *session);
+gboolean drd_rdp_session_begin_authentication(DrdRdpSession *self,
+                                              DrdAuthPool *pool,
+                                              const gchar *pam_service,
+                                              const gchar *username,
+                                              const gchar *domain,
+                                              const gchar *password,
+                                              const gchar *remote_host,
+                                              GError **error);
 BOOL drd_rdp_session_post_connect(DrdRdpSession *self);
 BOOL drd_rdp_session_activate(DrdRdpSession *self);
 BOOL drd_rdp_session_pump(DrdRdpSession *self);
@@ -54,5 +65,6 @@ gboolean drd_rdp_session_client_is_mstsc(DrdRdpSession *self);
 gboolean drd_rdp_session_get_peer_resolution(DrdRdpSession *self,
                                              guint32 *out_width,
                                              guint32 *out_height);
+void drd_rdp_session_get_network_estimate(DrdRdpSession *self, DrdNetworkEstimate *out_estimate);
 
 G_END_DECLS
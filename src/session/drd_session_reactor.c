@@ -0,0 +1,632 @@
+#include "session/drd_session_reactor.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <winpr/synch.h>
+
+#include "utils/drd_log.h"
+
+/* 单个会话最多登记的事件句柄数，与原 VCM 线程的句柄数组一致 */
+#define DRD_SESSION_REACTOR_MAX_HANDLES 32
+/* 唤醒 fd 的 epoll 标识，事件源标识从 1 开始 */
+#define DRD_SESSION_REACTOR_WAKEUP_ID 0
+#define DRD_SESSION_REACTOR_MIN_THREADS 2
+#define DRD_SESSION_REACTOR_MAX_THREADS 4
+
+struct _DrdSessionReactorSource
+{
+    DrdSessionReactor *reactor;
+    guint64 id;
+    gint ref_count; /* 反应器登记、调用方句柄与回调中各持一份 */
+    DrdSessionReactorHandlesFunc handles_func;
+    DrdSessionReactorDispatchFunc dispatch_func;
+    gpointer user_data;
+    GDestroyNotify destroy;
+
+    GArray *fds;              /* 已登记到 epoll 的句柄 fd，受 reactor->lock 保护 */
+    gint timer_fd;            /* 周期唤醒用 timerfd，-1 表示未创建，受 reactor->lock 保护 */
+    guint tick_ms;
+    gboolean timer_registered;
+    GThread *dispatch_thread; /* 正在执行回调的线程，NULL 表示空闲 */
+    gboolean pending;         /* 回调期间又有 fd 就绪，回调结束后再执行一轮 */
+    gboolean detached;        /* 已从 epoll 注销，不再回调 */
+    gboolean destroyed;       /* destroy 已执行 */
+};
+
+struct _DrdSessionReactor
+{
+    gint epoll_fd;
+    gint wakeup_fd;   /* 停止时写入，唤醒全部线程 */
+    guint n_threads;
+    GPtrArray *threads;
+    gint running;
+
+    GMutex lock;
+    GCond cond;           /* 回调结束时广播，供 remove 等待 */
+    GHashTable *sources;  /* id → 事件源，表内持有反应器引用 */
+    guint64 next_id;
+    guint64 dispatches;
+    gint64 max_dispatch_us;
+};
+
+/*
+ * 功能：释放事件源的一份引用。
+ * 逻辑：最后一份引用释放时关闭 timerfd 并释放结构；destroy 回调在此之前已由注销路径执行。
+ * 参数：source 事件源。
+ * 外部接口：POSIX close；GLib g_atomic_int_dec_and_test。
+ */
+static void drd_session_reactor_source_unref(DrdSessionReactorSource *source)
+{
+    if (!g_atomic_int_dec_and_test(&source->ref_count))
+    {
+        return;
+    }
+
+    if (source->timer_fd >= 0)
+    {
+        close(source->timer_fd);
+    }
+    g_array_unref(source->fds);
+    g_free(source);
+}
+
+/*
+ * 功能：查询事件源当前的句柄并换算为可 poll 的 fd。
+ * 逻辑：调用句柄回调后对每个 WinPR 句柄取其底层 fd（事件为 eventfd/pipe，socket 事件为 socket 本身），去重后写入 out_fds。
+ * 参数：source 事件源；out_fds 输出 fd 数组（gint）；out_unsupported 是否存在无法 poll 的句柄。
+ * 外部接口：WinPR GetEventFileDescriptor。
+ * 返回：句柄数，0 表示连接已结束。
+ */
+static guint drd_session_reactor_collect_fds(DrdSessionReactorSource *source, GArray *out_fds,
+                                             gboolean *out_unsupported)
+{
+    HANDLE handles[DRD_SESSION_REACTOR_MAX_HANDLES];
+    const guint n_handles = source->handles_func(source->user_data, handles, G_N_ELEMENTS(handles));
+
+    *out_unsupported = FALSE;
+    for (guint i = 0; i < n_handles; ++i)
+    {
+        const gint fd = GetEventFileDescriptor(handles[i]);
+        if (fd < 0)
+        {
+            *out_unsupported = TRUE;
+            continue;
+        }
+
+        gboolean seen = FALSE;
+        for (guint j = 0; j < out_fds->len && !seen; ++j)
+        {
+            seen = g_array_index(out_fds, gint, j) == fd;
+        }
+        if (!seen)
+        {
+            g_array_append_val(out_fds, fd);
+        }
+    }
+    return n_handles;
+}
+
+/*
+ * 功能：判断 fd 是否在数组中。
+ * 逻辑：线性查找，句柄数很少。
+ * 参数：fds fd 数组；fd 目标。
+ * 外部接口：无。
+ */
+static gboolean drd_session_reactor_fds_contain(GArray *fds, gint fd)
+{
+    for (guint i = 0; i < fds->len; ++i)
+    {
+        if (g_array_index(fds, gint, i) == fd)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * 功能：按最新 fd 集合（重新）布防事件源。
+ * 逻辑：须持 lock 调用；不再出现的 fd 从 epoll 删除，其余以 EPOLLONESHOT 新增或重新布防（水平触发语义下仍就绪的 fd
+ *       会立即再次触发），timerfd 同样处理；随后以新集合替换旧集合。
+ * 参数：self 反应器；source 事件源；fds 最新 fd 集合（内容被拷贝）。
+ * 外部接口：Linux epoll_ctl。
+ */
+static void drd_session_reactor_arm_locked(DrdSessionReactor *self, DrdSessionReactorSource *source, GArray *fds)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.u64 = source->id;
+
+    for (guint i = 0; i < source->fds->len; ++i)
+    {
+        const gint fd = g_array_index(source->fds, gint, i);
+        if (!drd_session_reactor_fds_contain(fds, fd))
+        {
+            epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        }
+    }
+
+    for (guint i = 0; i < fds->len; ++i)
+    {
+        const gint fd = g_array_index(fds, gint, i);
+        const gboolean known = drd_session_reactor_fds_contain(source->fds, fd);
+        if (epoll_ctl(self->epoll_fd, known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0 && known &&
+            errno == ENOENT)
+        {
+            /* fd 号被关闭后复用时内核已自动移除旧登记 */
+            epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        }
+    }
+    g_array_set_size(source->fds, 0);
+    g_array_append_vals(source->fds, fds->data, fds->len);
+
+    if (source->timer_fd >= 0)
+    {
+        epoll_ctl(self->epoll_fd, source->timer_registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, source->timer_fd, &event);
+        source->timer_registered = TRUE;
+    }
+}
+
+/*
+ * 功能：把事件源从 epoll 与登记表中摘除。
+ * 逻辑：须持 lock 调用；只执行一次，此后不再回调。
+ * 参数：self 反应器；source 事件源。
+ * 外部接口：Linux epoll_ctl；GLib g_hash_table_steal。
+ * 返回：首次摘除时返回 TRUE，调用方须在解锁后释放登记表持有的引用。
+ */
+static gboolean drd_session_reactor_detach_locked(DrdSessionReactor *self, DrdSessionReactorSource *source)
+{
+    if (source->detached)
+    {
+        return FALSE;
+    }
+
+    source->detached = TRUE;
+    for (guint i = 0; i < source->fds->len; ++i)
+    {
+        epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, g_array_index(source->fds, gint, i), NULL);
+    }
+    g_array_set_size(source->fds, 0);
+    if (source->timer_registered)
+    {
+        epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, source->timer_fd, NULL);
+        source->timer_registered = FALSE;
+    }
+    g_hash_table_steal(self->sources, &source->id);
+    return TRUE;
+}
+
+/*
+ * 功能：认领 destroy 回调的执行权。
+ * 逻辑：须持 lock 调用；事件源已摘除且没有回调在执行时，第一个到达者负责执行 destroy。
+ * 参数：source 事件源。
+ * 外部接口：无。
+ */
+static gboolean drd_session_reactor_claim_destroy_locked(DrdSessionReactorSource *source)
+{
+    if (!source->detached || source->dispatch_thread != NULL || source->destroyed)
+    {
+        return FALSE;
+    }
+    source->destroyed = TRUE;
+    return TRUE;
+}
+
+/*
+ * 功能：处理一个就绪的事件源。
+ * 逻辑：持锁查找事件源；已有线程在处理时只记下 pending 由其再执行一轮，保证同一会话的回调串行。
+ *       解锁后排空 timerfd 并执行回调，回调返回 TRUE 时重新查询句柄、按新集合重新布防；
+ *       返回 FALSE 或句柄为空时摘除事件源。事件源在回调期间被注销时由本线程在回调结束后执行 destroy。
+ * 参数：self 反应器；id 事件源标识。
+ * 外部接口：POSIX read；GLib g_get_monotonic_time/g_cond_broadcast；日志 DRD_LOG_WARNING。
+ */
+static void drd_session_reactor_dispatch(DrdSessionReactor *self, guint64 id)
+{
+    g_mutex_lock(&self->lock);
+    DrdSessionReactorSource *source = g_hash_table_lookup(self->sources, &id);
+    if (source == NULL || source->detached)
+    {
+        g_mutex_unlock(&self->lock);
+        return;
+    }
+    if (source->dispatch_thread != NULL)
+    {
+        source->pending = TRUE;
+        g_mutex_unlock(&self->lock);
+        return;
+    }
+    source->dispatch_thread = g_thread_self();
+    g_atomic_int_inc(&source->ref_count);
+    g_mutex_unlock(&self->lock);
+
+    gboolean keep = TRUE;
+    gboolean again = FALSE;
+    do
+    {
+        if (source->timer_fd >= 0)
+        {
+            guint64 expirations = 0;
+            (void) !read(source->timer_fd, &expirations, sizeof(expirations));
+        }
+
+        const gint64 start = g_get_monotonic_time();
+        keep = source->dispatch_func(source, source->user_data);
+        const gint64 duration = g_get_monotonic_time() - start;
+
+        g_mutex_lock(&self->lock);
+        self->dispatches++;
+        self->max_dispatch_us = MAX(self->max_dispatch_us, duration);
+        again = keep && source->pending && !source->detached;
+        source->pending = FALSE;
+        g_mutex_unlock(&self->lock);
+    } while (again);
+
+    g_autoptr(GArray) fds = g_array_new(FALSE, FALSE, sizeof(gint));
+    gboolean unsupported = FALSE;
+    if (keep && !source->detached)
+    {
+        keep = drd_session_reactor_collect_fds(source, fds, &unsupported) > 0;
+        if (unsupported)
+        {
+            DRD_LOG_WARNING("Session reactor source %" G_GUINT64_FORMAT " exposes a handle without descriptor", id);
+        }
+    }
+
+    g_mutex_lock(&self->lock);
+    gboolean drop_registration = FALSE;
+    if (keep && !source->detached)
+    {
+        drd_session_reactor_arm_locked(self, source, fds);
+    }
+    else
+    {
+        drop_registration = drd_session_reactor_detach_locked(self, source);
+    }
+    source->dispatch_thread = NULL;
+    const gboolean run_destroy = drd_session_reactor_claim_destroy_locked(source);
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->lock);
+
+    if (run_destroy && source->destroy != NULL)
+    {
+        source->destroy(source->user_data);
+    }
+    if (drop_registration)
+    {
+        drd_session_reactor_source_unref(source);
+    }
+    drd_session_reactor_source_unref(source);
+}
+
+/*
+ * 功能：反应器线程主循环。
+ * 逻辑：每次只取一个就绪事件，空闲线程可以立即接手其他会话，单个会话的慢回调不会连带同批就绪的会话；
+ *       唤醒 fd 就绪且运行标志已清除时退出。
+ * 参数：user_data 反应器。
+ * 外部接口：Linux epoll_wait；日志 DRD_LOG_WARNING。
+ */
+static gpointer drd_session_reactor_thread(gpointer user_data)
+{
+    DrdSessionReactor *self = user_data;
+
+    while (g_atomic_int_get(&self->running))
+    {
+        struct epoll_event event;
+        const int ready = epoll_wait(self->epoll_fd, &event, 1, -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            DRD_LOG_WARNING("Session reactor epoll_wait failed: %s", g_strerror(errno));
+            break;
+        }
+        if (ready == 0 || event.data.u64 == DRD_SESSION_REACTOR_WAKEUP_ID)
+        {
+            continue;
+        }
+        drd_session_reactor_dispatch(self, event.data.u64);
+    }
+
+    return NULL;
+}
+
+/*
+ * 功能：按需启动反应器线程。
+ * 逻辑：须持 lock 调用；首个事件源登记时才创建线程，未接入连接的进程（如 handover）不占用线程。
+ * 参数：self 反应器；error 错误输出。
+ * 外部接口：GLib g_thread_try_new。
+ * 返回：至少有一个线程在运行时返回 TRUE。
+ */
+static gboolean drd_session_reactor_start_threads_locked(DrdSessionReactor *self, GError **error)
+{
+    if (self->threads->len > 0)
+    {
+        return TRUE;
+    }
+
+    g_atomic_int_set(&self->running, 1);
+    for (guint i = 0; i < self->n_threads; ++i)
+    {
+        g_autofree gchar *name = g_strdup_printf("drd-reactor-%u", i);
+        GThread *thread = g_thread_try_new(name, drd_session_reactor_thread, self, i == 0 ? error : NULL);
+        if (thread == NULL)
+        {
+            break;
+        }
+        g_ptr_array_add(self->threads, thread);
+    }
+    return self->threads->len > 0;
+}
+
+/*
+ * 功能：创建会话事件反应器（不启动线程）。
+ * 逻辑：创建 epoll 与用于停止的 eventfd；线程数为 0 时按 CPU 数的一半取值，限定在 2~4 之间。
+ *       epoll 不可用时仍返回对象，登记事件源会失败，调用方回退独立线程。
+ * 参数：n_threads 反应器线程数，0 表示自动。
+ * 外部接口：Linux epoll_create1/eventfd/epoll_ctl；GLib g_get_num_processors；日志 DRD_LOG_WARNING。
+ */
+DrdSessionReactor *drd_session_reactor_new(guint n_threads)
+{
+    DrdSessionReactor *self = g_new0(DrdSessionReactor, 1);
+    self->n_threads = n_threads != 0 ? n_threads
+                                     : CLAMP(g_get_num_processors() / 2, DRD_SESSION_REACTOR_MIN_THREADS,
+                                             DRD_SESSION_REACTOR_MAX_THREADS);
+    self->threads = g_ptr_array_new();
+    g_mutex_init(&self->lock);
+    g_cond_init(&self->cond);
+    self->sources = g_hash_table_new(g_int64_hash, g_int64_equal);
+
+    self->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    self->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (self->epoll_fd >= 0 && self->wakeup_fd >= 0)
+    {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = DRD_SESSION_REACTOR_WAKEUP_ID;
+        epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, self->wakeup_fd, &event);
+    }
+    else
+    {
+        DRD_LOG_WARNING("Session reactor unavailable, sessions fall back to dedicated threads: %s",
+                        g_strerror(errno));
+        if (self->epoll_fd >= 0)
+        {
+            close(self->epoll_fd);
+            self->epoll_fd = -1;
+        }
+    }
+    return self;
+}
+
+/*
+ * 功能：释放反应器。
+ * 逻辑：清除运行标志并写唤醒 fd（水平触发，全部线程都会醒来），join 后摘除残留事件源并执行其 destroy，最后关闭 fd。
+ *       此时会话应已全部注销。
+ * 参数：self 反应器，可为 NULL。
+ * 外部接口：POSIX write/close；GLib g_thread_join。
+ */
+void drd_session_reactor_free(DrdSessionReactor *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    g_atomic_int_set(&self->running, 0);
+    if (self->wakeup_fd >= 0)
+    {
+        const guint64 one = 1;
+        (void) !write(self->wakeup_fd, &one, sizeof(one));
+    }
+    for (guint i = 0; i < self->threads->len; ++i)
+    {
+        g_thread_join(g_ptr_array_index(self->threads, i));
+    }
+    g_ptr_array_unref(self->threads);
+
+    GHashTableIter iter;
+    gpointer value = NULL;
+    GPtrArray *leftovers = g_ptr_array_new();
+    g_mutex_lock(&self->lock);
+    g_hash_table_iter_init(&iter, self->sources);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+    {
+        g_ptr_array_add(leftovers, value);
+    }
+    for (guint i = 0; i < leftovers->len; ++i)
+    {
+        DrdSessionReactorSource *source = g_ptr_array_index(leftovers, i);
+        drd_session_reactor_detach_locked(self, source);
+        source->destroyed = TRUE;
+    }
+    g_mutex_unlock(&self->lock);
+
+    for (guint i = 0; i < leftovers->len; ++i)
+    {
+        DrdSessionReactorSource *source = g_ptr_array_index(leftovers, i);
+        if (source->destroy != NULL)
+        {
+            source->destroy(source->user_data);
+        }
+        drd_session_reactor_source_unref(source);
+    }
+    g_ptr_array_unref(leftovers);
+
+    g_hash_table_unref(self->sources);
+    g_cond_clear(&self->cond);
+    g_mutex_clear(&self->lock);
+    if (self->wakeup_fd >= 0)
+    {
+        close(self->wakeup_fd);
+    }
+    if (self->epoll_fd >= 0)
+    {
+        close(self->epoll_fd);
+    }
+    g_free(self);
+}
+
+/*
+ * 功能：登记一个会话事件源。
+ * 逻辑：查询句柄并换算 fd，任一句柄没有底层 fd 时拒绝（调用方回退独立线程）；随后按需启动线程、
+ *       分配标识并以 EPOLLONESHOT 布防。失败时不调用 destroy，user_data 仍归调用方。
+ * 参数：self 反应器；handles_func 句柄查询回调；dispatch_func 就绪回调（在反应器线程执行，同一事件源串行）；
+ *       user_data 回调数据；destroy 注销后释放 user_data 的回调，可为 NULL；error 错误输出。
+ * 外部接口：GLib g_set_error_literal；epoll 布防见 drd_session_reactor_arm_locked。
+ * 返回：事件源句柄，交给 drd_session_reactor_remove 注销；失败返回 NULL。
+ */
+DrdSessionReactorSource *drd_session_reactor_add(DrdSessionReactor *self,
+                                                 DrdSessionReactorHandlesFunc handles_func,
+                                                 DrdSessionReactorDispatchFunc dispatch_func,
+                                                 gpointer user_data,
+                                                 GDestroyNotify destroy,
+                                                 GError **error)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+    g_return_val_if_fail(handles_func != NULL, NULL);
+    g_return_val_if_fail(dispatch_func != NULL, NULL);
+
+    if (self->epoll_fd < 0)
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Session reactor is unavailable");
+        return NULL;
+    }
+
+    DrdSessionReactorSource *source = g_new0(DrdSessionReactorSource, 1);
+    source->reactor = self;
+    source->ref_count = 2;
+    source->handles_func = handles_func;
+    source->dispatch_func = dispatch_func;
+    source->user_data = user_data;
+    source->destroy = destroy;
+    source->fds = g_array_new(FALSE, FALSE, sizeof(gint));
+    source->timer_fd = -1;
+
+    g_autoptr(GArray) fds = g_array_new(FALSE, FALSE, sizeof(gint));
+    gboolean unsupported = FALSE;
+    if (drd_session_reactor_collect_fds(source, fds, &unsupported) == 0 || unsupported)
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                            "Session event handles are not pollable");
+        g_array_unref(source->fds);
+        g_free(source);
+        return NULL;
+    }
+
+    g_mutex_lock(&self->lock);
+    if (!drd_session_reactor_start_threads_locked(self, error))
+    {
+        g_mutex_unlock(&self->lock);
+        g_array_unref(source->fds);
+        g_free(source);
+        return NULL;
+    }
+    source->id = ++self->next_id;
+    g_hash_table_insert(self->sources, &source->id, source);
+    drd_session_reactor_arm_locked(self, source, fds);
+    g_mutex_unlock(&self->lock);
+    return source;
+}
+
+/*
+ * 功能：注销事件源并释放调用方句柄。
+ * 逻辑：摘除后若其他线程正在执行该事件源的回调则等待其结束，返回后不会再有回调；在回调内部（同一线程）注销时
+ *       不等待，destroy 推迟到回调返回后由反应器线程执行。
+ * 参数：self 反应器；source 事件源，调用后失效。
+ * 外部接口：GLib g_cond_wait。
+ */
+void drd_session_reactor_remove(DrdSessionReactor *self, DrdSessionReactorSource *source)
+{
+    g_return_if_fail(self != NULL);
+
+    if (source == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock(&self->lock);
+    const gboolean drop_registration = drd_session_reactor_detach_locked(self, source);
+    while (source->dispatch_thread != NULL && source->dispatch_thread != g_thread_self())
+    {
+        g_cond_wait(&self->cond, &self->lock);
+    }
+    const gboolean run_destroy = drd_session_reactor_claim_destroy_locked(source);
+    g_mutex_unlock(&self->lock);
+
+    if (run_destroy && source->destroy != NULL)
+    {
+        source->destroy(source->user_data);
+    }
+    if (drop_registration)
+    {
+        drd_session_reactor_source_unref(source);
+    }
+    drd_session_reactor_source_unref(source);
+}
+
+/*
+ * 功能：设置事件源的周期唤醒间隔。
+ * 逻辑：只能在该事件源的回调中调用；按需创建 timerfd 并设为周期触发，0 表示停止；新 timerfd 在回调结束重新布防时登记。
+ * 参数：source 事件源；interval_ms 唤醒间隔（毫秒）。
+ * 外部接口：Linux timerfd_create/timerfd_settime；日志 DRD_LOG_WARNING。
+ */
+void drd_session_reactor_source_set_tick(DrdSessionReactorSource *source, guint interval_ms)
+{
+    g_return_if_fail(source != NULL);
+
+    if (source->tick_ms == interval_ms)
+    {
+        return;
+    }
+
+    DrdSessionReactor *self = source->reactor;
+    g_mutex_lock(&self->lock);
+    if (source->timer_fd < 0 && interval_ms > 0)
+    {
+        source->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (source->timer_fd < 0)
+        {
+            DRD_LOG_WARNING("Session reactor failed to create tick timer: %s", g_strerror(errno));
+        }
+    }
+    if (source->timer_fd >= 0)
+    {
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_interval.tv_sec = interval_ms / 1000;
+        spec.it_interval.tv_nsec = (glong) (interval_ms % 1000) * 1000000;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(source->timer_fd, 0, &spec, NULL);
+        source->tick_ms = interval_ms;
+    }
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * 功能：读取反应器统计。
+ * 逻辑：持锁复制线程数、事件源数、累计回调次数与单次回调最长耗时。
+ * 参数：self 反应器；out_stats 输出统计。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void drd_session_reactor_get_stats(DrdSessionReactor *self, DrdSessionReactorStats *out_stats)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&self->lock);
+    out_stats->threads = self->threads->len;
+    out_stats->sources = g_hash_table_size(self->sources);
+    out_stats->dispatches = self->dispatches;
+    out_stats->max_dispatch_us = self->max_dispatch_us;
+    g_mutex_unlock(&self->lock);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glib.h>
+
+#include <winpr/wtypes.h>
+
+G_BEGIN_DECLS
+
+/*
+ * 会话事件反应器：进程内少量线程共用一个 epoll，复用全部会话的 FreeRDP peer 与 VCM 事件句柄，
+ * 取代每个连接一条阻塞在 WaitForMultipleObjects 上的 VCM 线程。每个事件源以 EPOLLONESHOT 登记，
+ * 同一会话的回调永不并发；回调返回后重新查询句柄集合并重新布防。
+ */
+typedef struct _DrdSessionReactor DrdSessionReactor;
+typedef struct _DrdSessionReactorSource DrdSessionReactorSource;
+
+/* 返回会话当前的事件句柄数，0 表示连接已结束 */
+typedef guint (*DrdSessionReactorHandlesFunc)(gpointer user_data, HANDLE *handles, guint max_handles);
+/* 处理一次就绪事件，返回 FALSE 表示连接已结束、事件源随之注销；source 供回调内调整周期唤醒 */
+typedef gboolean (*DrdSessionReactorDispatchFunc)(DrdSessionReactorSource *source, gpointer user_data);
+
+typedef struct
+{
+    guint threads;          /* 反应器线程数 */
+    guint sources;          /* 当前登记的事件源数 */
+    guint64 dispatches;     /* 累计回调次数 */
+    gint64 max_dispatch_us; /* 单次回调最长耗时，过长说明回调阻塞了同一线程上的其他会话 */
+} DrdSessionReactorStats;
+
+DrdSessionReactor *drd_session_reactor_new(guint n_threads);
+void drd_session_reactor_free(DrdSessionReactor *self);
+
+DrdSessionReactorSource *drd_session_reactor_add(DrdSessionReactor *self,
+                                                 DrdSessionReactorHandlesFunc handles_func,
+                                                 DrdSessionReactorDispatchFunc dispatch_func,
+                                                 gpointer user_data,
+                                                 GDestroyNotify destroy,
+                                                 GError **error);
+void drd_session_reactor_remove(DrdSessionReactor *self, DrdSessionReactorSource *source);
+void drd_session_reactor_source_set_tick(DrdSessionReactorSource *source, guint interval_ms);
+void drd_session_reactor_get_stats(DrdSessionReactor *self, DrdSessionReactorStats *out_stats);
+
+G_END_DECLS
@@ -0,0 +1,513 @@
+#include "session/drd_stage_pipeline.h"
+
+#include <gio/gio.h>
+
+#include "utils/drd_handoff_slot.h"
+#include "utils/drd_log.h"
+
+/* 分析/编码线程单次等待上限，用于及时响应停止与缓存帧刷新 */
+#define DRD_STAGE_PIPELINE_POLL_US (16 * G_TIME_SPAN_MILLISECOND)
+
+struct _DrdStagePipeline
+{
+    DrdServerRuntime *runtime;
+    DrdCaptureManager *capture;
+    DrdEncodingManager *encoder;
+    DrdEncodeSchedulerClient *scheduler; /* 编码组登记的调度客户端，不持有，可为 NULL */
+    DrdFrameQueue *frames; /* 运行期间订阅的捕获帧邮箱 */
+    rdpSettings *settings;
+    gboolean auto_switch;
+    gint64 stale_deadline_us; /* 捕获后超过该时长仍未编码的帧视为陈旧，0 表示不限 */
+
+    DrdHandoffSlot *analyzed; /* 分析 → 编码，最新者胜出 */
+    DrdHandoffSlot *encoded;  /* 编码 → 发送，阻塞 */
+    GThread *analysis_thread;
+    GThread *encode_thread;
+    gint running;
+    gint refresh_requested;
+    gboolean demand_held; /* 是否已登记按需抓帧 */
+
+    GMutex stats_lock;
+    DrdStagePipelineStats stats;
+    guint64 last_sent_sequence; /* 最近计入时延的编码序号，重发的缓存关键帧不重复计入 */
+};
+
+/*
+ * 功能：记录一次阶段耗时。
+ * 逻辑：持锁累加帧数，更新最近值、1/8 EWMA 与窗口最大值。
+ * 参数：self 流水线；timing 目标阶段统计；duration_us 本次耗时。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+static void drd_stage_pipeline_record(DrdStagePipeline *self, DrdStageTiming *timing, gint64 duration_us)
+{
+    g_mutex_lock(&self->stats_lock);
+    timing->frames++;
+    timing->last_us = duration_us;
+    timing->avg_us = timing->frames == 1 ? duration_us : timing->avg_us + (duration_us - timing->avg_us) / 8;
+    timing->max_us = MAX(timing->max_us, duration_us);
+    g_mutex_unlock(&self->stats_lock);
+}
+
+/*
+ * 功能：为一次分析/编码计算申请核心配额。
+ * 逻辑：未接入调度器时直接放行；否则按所属阶段的配额可能排队，等待时长计入 sched_wait。
+ * 参数：self 流水线；stage 分析或编码阶段；ticket 输出凭据。
+ * 外部接口：drd_encode_scheduler_begin。
+ */
+static void drd_stage_pipeline_begin_compute(DrdStagePipeline *self, DrdEncodeStage stage, DrdEncodeTicket *ticket)
+{
+    if (self->scheduler == NULL)
+    {
+        return;
+    }
+
+    drd_encode_scheduler_begin(self->scheduler, stage, ticket);
+    drd_stage_pipeline_record(self, &self->stats.sched_wait, ticket->wait_us);
+}
+
+/*
+ * 功能：结束一次分析/编码计算并归还核心配额。
+ * 逻辑：本次消耗的线程 CPU 时间计入调度器的公平份额与本流水线的窗口统计。
+ * 参数：self 流水线；ticket begin 填写的凭据。
+ * 外部接口：drd_encode_scheduler_end。
+ */
+static void drd_stage_pipeline_end_compute(DrdStagePipeline *self, const DrdEncodeTicket *ticket)
+{
+    if (self->scheduler == NULL)
+    {
+        return;
+    }
+
+    const gint64 cpu_us = drd_encode_scheduler_end(self->scheduler, ticket);
+    g_mutex_lock(&self->stats_lock);
+    self->stats.cpu_us += (guint64) cpu_us;
+    g_mutex_unlock(&self->stats_lock);
+}
+
+/*
+ * 功能：交接槽合并回调，把被覆盖的旧分析结果并入新结果。
+ * 逻辑：转调 drd_gfx_analysis_merge。
+ * 参数：newer 新分析结果；older 旧分析结果。
+ * 外部接口：drd_gfx_analysis_merge。
+ */
+static void drd_stage_pipeline_merge_analysis(gpointer newer, gpointer older)
+{
+    drd_gfx_analysis_merge((DrdGfxAnalysis *) newer, (const DrdGfxAnalysis *) older);
+}
+
+/*
+ * 功能：分析线程主循环。
+ * 逻辑：从本流水线订阅的捕获邮箱等待帧（带超时以便响应停止），申请核心配额后完成 tile 差分并立即放入“最新者胜出”交接槽；
+ *       编码阶段尚未取走的旧结果会被合并覆盖，分析线程永不因下游阻塞。
+ * 参数：user_data 流水线。
+ * 外部接口：drd_capture_manager_wait_subscribed；drd_encoding_manager_analyze_gfx_frame；drd_handoff_slot_replace。
+ */
+static gpointer drd_stage_pipeline_analysis_thread(gpointer user_data)
+{
+    DrdStagePipeline *self = user_data;
+
+    while (g_atomic_int_get(&self->running))
+    {
+        g_autoptr(DrdFrame) frame = NULL;
+        g_autoptr(GError) error = NULL;
+        if (!drd_capture_manager_wait_subscribed(self->capture, self->frames, DRD_STAGE_PIPELINE_POLL_US, &frame,
+                                                 &error))
+        {
+            if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+            {
+                /* 捕获未运行：避免空转 */
+                g_usleep(DRD_STAGE_PIPELINE_POLL_US);
+            }
+            continue;
+        }
+
+        DrdEncodeTicket ticket;
+        drd_stage_pipeline_begin_compute(self, DRD_ENCODE_STAGE_ANALYSIS, &ticket);
+        const gint64 start = g_get_monotonic_time();
+        DrdGfxAnalysis *analysis = NULL;
+        const gboolean analyzed = drd_encoding_manager_analyze_gfx_frame(self->encoder, frame, &analysis, &error);
+        drd_stage_pipeline_end_compute(self, &ticket);
+        if (!analyzed)
+        {
+            DRD_LOG_WARNING("Frame analysis failed: %s", error != NULL ? error->message : "unknown error");
+            continue;
+        }
+        drd_stage_pipeline_record(self, &self->stats.analysis, g_get_monotonic_time() - start);
+        drd_handoff_slot_replace(self->analyzed, analysis);
+    }
+
+    return NULL;
+}
+
+/*
+ * 功能：陈旧帧让位于更新的捕获。
+ * 逻辑：分析结果对应的捕获时刻超过陈旧期限时，授信捕获端抓取新帧并最多等待一个轮询周期；
+ *       等到更新的分析结果则把陈旧帧的脏块并入后替换之，否则说明画面此后未变化，陈旧帧像素仍是最新的，照常编码。
+ * 参数：self 流水线；analysis 待编码的分析结果（可能被替换）。
+ * 外部接口：drd_frame_get_timestamp；drd_capture_manager_grant_credit；drd_handoff_slot_take；drd_gfx_analysis_merge。
+ */
+static void drd_stage_pipeline_replace_stale(DrdStagePipeline *self, DrdGfxAnalysis **analysis)
+{
+    if (self->stale_deadline_us <= 0)
+    {
+        return;
+    }
+
+    const gint64 age = g_get_monotonic_time() - (gint64) drd_frame_get_timestamp((*analysis)->frame);
+    if (age <= self->stale_deadline_us)
+    {
+        return;
+    }
+
+    drd_capture_manager_grant_credit(self->capture);
+    gpointer item = NULL;
+    if (!drd_handoff_slot_take(self->analyzed, DRD_STAGE_PIPELINE_POLL_US, &item))
+    {
+        return;
+    }
+
+    DrdGfxAnalysis *fresher = item;
+    drd_gfx_analysis_merge(fresher, *analysis);
+    drd_gfx_analysis_free(*analysis);
+    *analysis = fresher;
+
+    g_mutex_lock(&self->stats_lock);
+    self->stats.stale_skipped++;
+    g_mutex_unlock(&self->stats_lock);
+}
+
+/*
+ * 功能：编码线程主循环。
+ * 逻辑：取最新分析结果编码（陈旧帧先让位于更新的捕获）；超时无新结果时若有刷新请求或刷新周期已到，则用最近编码过的帧整帧重编关键帧。
+ *       刷新请求（用于 AVC→非 AVC 切换后的残影清理）优先由非 AVC 关键帧缓存满足，直接重发而不重编，
+ *       并按一次非 AVC 关键帧登记编码结果，结束切换后的刷新跟踪，避免刷新周期到达后再整帧重编。
+ *       编码前申请核心配额。编码帧以阻塞方式交给发送阶段，发送端背压直接传导到本线程，期间分析结果在交接槽中持续合并。
+ * 参数：user_data 流水线。
+ * 外部接口：drd_encoding_manager_encode_gfx_frame/lookup_keyframe/register_codec_result/refresh_interval_reached/
+ *           force_keyframe；
+ *           drd_handoff_slot_take/put。
+ */
+static gpointer drd_stage_pipeline_encode_thread(gpointer user_data)
+{
+    DrdStagePipeline *self = user_data;
+    g_autoptr(DrdFrame) last_frame = NULL;
+    gboolean refresh_pending = FALSE;
+
+    while (g_atomic_int_get(&self->running))
+    {
+        if (g_atomic_int_compare_and_exchange(&self->refresh_requested, 1, 0))
+        {
+            DrdEncodedGfxFrame *cached =
+                    drd_encoding_manager_lookup_keyframe(self->encoder, DRD_ENCODING_CODEC_CLASS_NON_AVC);
+            if (cached != NULL)
+            {
+                g_mutex_lock(&self->stats_lock);
+                self->stats.refresh_cached++;
+                g_mutex_unlock(&self->stats_lock);
+                /* 重发的缓存帧就是刷新所需的全帧关键帧，清除切换后的待刷新状态 */
+                drd_encoding_manager_register_codec_result(self->encoder, DRD_ENCODING_CODEC_CLASS_NON_AVC, TRUE);
+                refresh_pending = FALSE;
+                if (!drd_handoff_slot_put(self->encoded, cached))
+                {
+                    break;
+                }
+                continue;
+            }
+            drd_encoding_manager_force_keyframe(self->encoder);
+            refresh_pending = TRUE;
+        }
+
+        g_autoptr(DrdGfxAnalysis) analysis = NULL;
+        DrdFrame *input = NULL;
+        gpointer item = NULL;
+        if (drd_handoff_slot_take(self->analyzed, DRD_STAGE_PIPELINE_POLL_US, &item))
+        {
+            analysis = item;
+            drd_stage_pipeline_replace_stale(self, &analysis);
+            input = analysis->frame;
+        }
+        else if (last_frame != NULL &&
+                 (refresh_pending || drd_encoding_manager_refresh_interval_reached(self->encoder)))
+        {
+            /* 捕获端暂无新帧：直接引用最近编码过的捕获帧，不复制像素、不重新分析，analysis 为 NULL 即整帧关键帧 */
+            input = last_frame;
+        }
+        else
+        {
+            continue;
+        }
+
+        g_autoptr(GError) error = NULL;
+        DrdEncodedGfxFrame *encoded = NULL;
+        DrdEncodeTicket ticket;
+        drd_stage_pipeline_begin_compute(self, DRD_ENCODE_STAGE_ENCODE, &ticket);
+        const gint64 start = g_get_monotonic_time();
+        const gboolean ok = drd_encoding_manager_encode_gfx_frame(
+                self->encoder, self->settings, input, analysis, self->auto_switch, &encoded, &error);
+        drd_stage_pipeline_record(self, &self->stats.encode, g_get_monotonic_time() - start);
+        drd_stage_pipeline_end_compute(self, &ticket);
+        if (input != last_frame)
+        {
+            g_set_object(&last_frame, input);
+        }
+
+        if (!ok)
+        {
+            if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_PENDING))
+            {
+                g_mutex_lock(&self->stats_lock);
+                const guint64 errors = ++self->stats.encode_errors;
+                g_mutex_unlock(&self->stats_lock);
+                DRD_LOG_WARNING("Frame encode failed: %s (errors=%" G_GUINT64_FORMAT ")",
+                                error != NULL ? error->message : "unknown error", errors);
+            }
+            continue;
+        }
+
+        refresh_pending = FALSE;
+        if (!drd_handoff_slot_put(self->encoded, encoded))
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * 功能：创建分阶段流水线（不启动线程）。
+ * 逻辑：持有运行时与编码器引用并缓存共享的捕获管理器，读取编码配置决定是否自动切换编码器及陈旧帧期限，创建两个交接槽。
+ * 参数：runtime 服务运行时；encoder 本流水线独占的编码器（编码组所有）；scheduler 编码组的调度客户端（编码组所有，
+ *       须比流水线活得久），NULL 表示不受核心配额约束；settings 对端 FreeRDP 设置（生命周期由会话保证）。
+ * 外部接口：drd_server_runtime_get_capture/get_encoding_options；drd_handoff_slot_new；GLib g_object_ref。
+ */
+DrdStagePipeline *drd_stage_pipeline_new(DrdServerRuntime *runtime, DrdEncodingManager *encoder,
+                                         DrdEncodeSchedulerClient *scheduler, rdpSettings *settings)
+{
+    g_return_val_if_fail(DRD_IS_SERVER_RUNTIME(runtime), NULL);
+    g_return_val_if_fail(DRD_IS_ENCODING_MANAGER(encoder), NULL);
+    g_return_val_if_fail(settings != NULL, NULL);
+
+    DrdStagePipeline *self = g_new0(DrdStagePipeline, 1);
+    self->runtime = g_object_ref(runtime);
+    self->capture = drd_server_runtime_get_capture(runtime);
+    self->encoder = g_object_ref(encoder);
+    self->scheduler = scheduler;
+    self->settings = settings;
+
+    DrdEncodingOptions options;
+    if (drd_server_runtime_get_encoding_options(runtime, &options))
+    {
+        self->auto_switch = options.mode == DRD_ENCODING_MODE_AUTO;
+        self->stale_deadline_us = (gint64) options.gfx_stale_frame_ms * G_TIME_SPAN_MILLISECOND;
+    }
+    else
+    {
+        self->auto_switch = FALSE;
+        self->stale_deadline_us = (gint64) DRD_GFX_DEFAULT_STALE_FRAME_MS * G_TIME_SPAN_MILLISECOND;
+    }
+
+    self->analyzed = drd_handoff_slot_new((GDestroyNotify) drd_gfx_analysis_free, drd_stage_pipeline_merge_analysis);
+    self->encoded = drd_handoff_slot_new((GDestroyNotify) drd_encoded_gfx_frame_unref, NULL);
+    g_mutex_init(&self->stats_lock);
+    return self;
+}
+
+/*
+ * 功能：释放流水线。
+ * 逻辑：先停止并回收线程，再释放交接槽（连同未消费的数据）与编码器、运行时引用。
+ * 参数：self 流水线，可为 NULL。
+ * 外部接口：drd_stage_pipeline_stop；drd_handoff_slot_free；GLib g_object_unref。
+ */
+void drd_stage_pipeline_free(DrdStagePipeline *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    drd_stage_pipeline_stop(self);
+    g_clear_pointer(&self->analyzed, drd_handoff_slot_free);
+    g_clear_pointer(&self->encoded, drd_handoff_slot_free);
+    g_mutex_clear(&self->stats_lock);
+    g_clear_object(&self->encoder);
+    g_clear_object(&self->runtime);
+    g_free(self);
+}
+
+/*
+ * 功能：启动分析与编码线程。
+ * 逻辑：已启动时直接返回；先订阅共享捕获，置运行标志后依次创建线程，任一失败则停止已创建的线程并返回错误；
+ *       线程就绪后登记按需抓帧，由发送阶段授信驱动抓帧。
+ * 参数：self 流水线；error 错误输出。
+ * 外部接口：drd_capture_manager_subscribe/hold_demand_mode；GLib g_thread_try_new。
+ */
+gboolean drd_stage_pipeline_start(DrdStagePipeline *self, GError **error)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+
+    if (g_atomic_int_get(&self->running))
+    {
+        return TRUE;
+    }
+
+    self->frames = drd_capture_manager_subscribe(self->capture);
+    g_atomic_int_set(&self->running, 1);
+    self->analysis_thread =
+            g_thread_try_new("drd-analysis-stage", drd_stage_pipeline_analysis_thread, self, error);
+    if (self->analysis_thread == NULL)
+    {
+        drd_stage_pipeline_stop(self);
+        return FALSE;
+    }
+
+    self->encode_thread = g_thread_try_new("drd-encode-stage", drd_stage_pipeline_encode_thread, self, error);
+    if (self->encode_thread == NULL)
+    {
+        drd_stage_pipeline_stop(self);
+        return FALSE;
+    }
+
+    drd_capture_manager_hold_demand_mode(self->capture);
+    self->demand_held = TRUE;
+    return TRUE;
+}
+
+/*
+ * 功能：停止分析与编码线程。
+ * 逻辑：注销按需抓帧（最后一条流水线注销时捕获恢复定时抓帧），清除运行标志并停止两个交接槽，
+ *       唤醒阻塞在 take/put 上的线程，随后 join 并注销捕获订阅；此后的捕获画面不再进入编码，关键帧缓存随之作废。
+ * 参数：self 流水线。
+ * 外部接口：drd_capture_manager_release_demand_mode/unsubscribe；drd_handoff_slot_stop；GLib g_thread_join；
+ *           drd_encoding_manager_drop_cached_keyframes。
+ */
+void drd_stage_pipeline_stop(DrdStagePipeline *self)
+{
+    g_return_if_fail(self != NULL);
+
+    if (self->demand_held)
+    {
+        drd_capture_manager_release_demand_mode(self->capture);
+        self->demand_held = FALSE;
+    }
+    g_atomic_int_set(&self->running, 0);
+    drd_handoff_slot_stop(self->analyzed);
+    drd_handoff_slot_stop(self->encoded);
+
+    if (self->analysis_thread != NULL)
+    {
+        g_thread_join(self->analysis_thread);
+        self->analysis_thread = NULL;
+    }
+    if (self->encode_thread != NULL)
+    {
+        g_thread_join(self->encode_thread);
+        self->encode_thread = NULL;
+    }
+    if (self->frames != NULL)
+    {
+        drd_capture_manager_unsubscribe(self->capture, self->frames);
+        g_clear_object(&self->frames);
+    }
+    drd_encoding_manager_drop_cached_keyframes(self->encoder);
+}
+
+/*
+ * 功能：请求编码阶段输出一次全量关键帧。
+ * 逻辑：置位原子标志，由编码线程在下一轮消费；无新捕获帧时复用最近一帧。
+ * 参数：self 流水线。
+ * 外部接口：GLib g_atomic_int_set。
+ */
+void drd_stage_pipeline_request_refresh(DrdStagePipeline *self)
+{
+    g_return_if_fail(self != NULL);
+
+    g_atomic_int_set(&self->refresh_requested, 1);
+}
+
+/*
+ * 功能：发送阶段取下一帧编码结果。
+ * 逻辑：从编码交接槽带超时取出；取走后编码线程即可继续下一帧。
+ * 参数：self 流水线；timeout_us 超时（微秒）；out_frame 输出编码帧（调用方释放）。
+ * 外部接口：drd_handoff_slot_take。
+ */
+gboolean drd_stage_pipeline_wait_encoded(DrdStagePipeline *self, gint64 timeout_us, DrdEncodedGfxFrame **out_frame)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+    g_return_val_if_fail(out_frame != NULL, FALSE);
+
+    gpointer item = NULL;
+    if (!drd_handoff_slot_take(self->encoded, timeout_us, &item))
+    {
+        return FALSE;
+    }
+    *out_frame = item;
+    return TRUE;
+}
+
+/*
+ * 功能：记录发送阶段耗时。
+ * 逻辑：由渲染线程在 SurfaceFrameCommand 返回后调用。
+ * 参数：self 流水线；duration_us 提交耗时。
+ * 外部接口：无。
+ */
+void drd_stage_pipeline_record_transmit(DrdStagePipeline *self, gint64 duration_us)
+{
+    g_return_if_fail(self != NULL);
+
+    drd_stage_pipeline_record(self, &self->stats.transmit, duration_us);
+}
+
+/*
+ * 功能：记录一帧的捕获→发送时延。
+ * 逻辑：由渲染线程在帧提交成功后调用；缓存帧刷新不携带捕获时刻，重发的缓存关键帧编码序号不大于已记录者，均跳过。
+ * 参数：self 流水线；frame 已提交的编码帧。
+ * 外部接口：drd_encoded_gfx_frame_get_capture_time/get_sequence。
+ */
+void drd_stage_pipeline_record_sent(DrdStagePipeline *self, const DrdEncodedGfxFrame *frame)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(frame != NULL);
+
+    const gint64 capture_time = drd_encoded_gfx_frame_get_capture_time(frame);
+    const guint64 sequence = drd_encoded_gfx_frame_get_sequence(frame);
+    if (capture_time <= 0)
+    {
+        return;
+    }
+
+    g_mutex_lock(&self->stats_lock);
+    const gboolean replayed = sequence <= self->last_sent_sequence;
+    self->last_sent_sequence = MAX(self->last_sent_sequence, sequence);
+    g_mutex_unlock(&self->stats_lock);
+    if (!replayed)
+    {
+        drd_stage_pipeline_record(self, &self->stats.latency, g_get_monotonic_time() - capture_time);
+    }
+}
+
+/*
+ * 功能：读取各阶段耗时统计。
+ * 逻辑：持锁拷贝统计并补上交接槽合并次数；reset_max 为 TRUE 时清零各阶段窗口最大值与窗口 CPU 时间。
+ * 参数：self 流水线；reset_max 是否开启新统计窗口；out_stats 输出。
+ * 外部接口：drd_handoff_slot_get_replaced。
+ */
+void drd_stage_pipeline_get_stats(DrdStagePipeline *self, gboolean reset_max, DrdStagePipelineStats *out_stats)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&self->stats_lock);
+    *out_stats = self->stats;
+    if (reset_max)
+    {
+        self->stats.analysis.max_us = 0;
+        self->stats.encode.max_us = 0;
+        self->stats.transmit.max_us = 0;
+        self->stats.latency.max_us = 0;
+        self->stats.sched_wait.max_us = 0;
+        self->stats.cpu_us = 0;
+    }
+    g_mutex_unlock(&self->stats_lock);
+    out_stats->analysis_merged = drd_handoff_slot_get_replaced(self->analyzed);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glib.h>
+
+#include <freerdp/freerdp.h>
+
+#include "core/drd_server_runtime.h"
+#include "encoding/drd_encoding_manager.h"
+#include "session/drd_encode_scheduler.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Rdpgfx 分阶段流水线：分析线程（等待捕获帧 + tile 差分）与编码线程各自独立运行，
+ * 发送阶段由会话渲染线程承担。分析→编码之间为“最新者胜出”交接槽（被覆盖的脏块并入新结果），
+ * 编码→发送之间为深度 1 的阻塞交接槽（编码帧存在参考链，不可丢弃）。
+ * 流水线使用调用方（编码组）提供的编码器，运行期间订阅共享捕获的帧邮箱，多条流水线共用同一路捕获；
+ * 捕获处于按需模式：发送阶段确认 Rdpgfx 有容量后才授予抓帧额度。
+ * 分析与编码两步计算前向进程级编码调度器申请核心配额，多个编码组按加权公平份额分享 CPU。
+ */
+typedef struct _DrdStagePipeline DrdStagePipeline;
+
+typedef struct
+{
+    guint64 frames; /* 本阶段完成的帧数 */
+    gint64 last_us; /* 最近一次耗时 */
+    gint64 avg_us;  /* 平滑耗时（EWMA 1/8） */
+    gint64 max_us;  /* 本统计窗口最大耗时 */
+} DrdStageTiming;
+
+typedef struct
+{
+    DrdStageTiming analysis;
+    DrdStageTiming encode;
+    DrdStageTiming transmit;
+    DrdStageTiming latency;    /* 捕获→发送完成的端到端时延（缓存帧刷新不计） */
+    DrdStageTiming sched_wait; /* 分析/编码任务等待核心配额的时长 */
+    guint64 cpu_us;            /* 本统计窗口内分析与编码占用的线程 CPU 时间 */
+    guint64 analysis_merged;   /* 编码阶段来不及消费、被新分析结果合并覆盖的次数 */
+    guint64 stale_skipped;     /* 超过陈旧期限、让位于更新捕获的帧数 */
+    guint64 encode_errors;     /* 编码失败次数（不含无新数据） */
+    guint64 refresh_cached;    /* 刷新请求直接由关键帧缓存满足、免于重编的次数 */
+} DrdStagePipelineStats;
+
+DrdStagePipeline *drd_stage_pipeline_new(DrdServerRuntime *runtime, DrdEncodingManager *encoder,
+                                         DrdEncodeSchedulerClient *scheduler, rdpSettings *settings);
+void drd_stage_pipeline_free(DrdStagePipeline *self);
+
+gboolean drd_stage_pipeline_start(DrdStagePipeline *self, GError **error);
+void drd_stage_pipeline_stop(DrdStagePipeline *self);
+
+void drd_stage_pipeline_request_refresh(DrdStagePipeline *self);
+gboolean drd_stage_pipeline_wait_encoded(DrdStagePipeline *self, gint64 timeout_us, DrdEncodedGfxFrame **out_frame);
+void drd_stage_pipeline_record_transmit(DrdStagePipeline *self, gint64 duration_us);
+void drd_stage_pipeline_record_sent(DrdStagePipeline *self, const DrdEncodedGfxFrame *frame);
+void drd_stage_pipeline_get_stats(DrdStagePipeline *self, gboolean reset_max, DrdStagePipelineStats *out_stats);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdStagePipeline, drd_stage_pipeline_free)
+
+G_END_DECLS
@@ -166,10 +166,11 @@ static void drd_system_daemon_unqueue_client(DrdSystemDaemon *self, DrdRemoteCli
 
 static gboolean drd_system_daemon_register_client(DrdSystemDaemon * self,
                                                   GSocketConnection * connection,
-                                                  DrdRoutingTokenInfo * info);
+                                                  const DrdRoutingTokenInfo * info);
 
 static gboolean drd_system_daemon_delegate(DrdRdpListener *listener,
                                            GSocketConnection *connection,
+                                           const DrdRoutingTokenInfo *routing,
                                            gpointer user_data,
                                            GError **error);
 
@@ -421,7 +422,7 @@ drd_system_daemon_remove_client(DrdSystemDaemon *self, DrdRemoteClient *client)
 static gboolean
 drd_system_daemon_register_client(DrdSystemDaemon *self,
                                   GSocketConnection *connection,
-                                  DrdRoutingTokenInfo *info)
+                                  const DrdRoutingTokenInfo *info)
 {
     g_return_val_if_fail(DRD_IS_SYSTEM_DAEMON(self), FALSE);
     g_return_val_if_fail(G_IS_SOCKET_CONNECTION(connection), FALSE);
@@ -539,37 +540,30 @@ drd_system_daemon_register_client(DrdSystemDaemon *self,
 // return FALSE 时，需要继续处理这个connection;return TRUE时，代表已经处理过，需要让handover进程来处理；
 /*
  * 功能：监听器委派回调，用于在 system 模式下注册/续接 handover 客户端。
- * 逻辑：peek 路由 token；若 token 已存在且未绑定 session，则更新连接并触发 TakeClientReady；否则注册为新客户端并决定是否继续交由默认监听器处理。
- * 参数：listener RDP 监听器；connection 新连接；user_data system 守护实例；error 错误输出。
- * 外部接口：drd_routing_token_peek 读取 token；GIO g_socket_connection_factory_create_connection/g_object_set_data；drd_system_daemon_register_client；GDBus 信号 drd_dbus_remote_desktop_rdp_handover_emit_take_client_ready。
+ * 逻辑：路由 token 已由监听器接入线程窥探；若 token 已存在且未绑定 session，则更新连接并触发 TakeClientReady；否则注册为新客户端并决定是否继续交由默认监听器处理。
+ * 参数：listener RDP 监听器；connection 新连接；routing 窥探到的路由 token 信息；user_data system 守护实例；error 错误输出。
+ * 外部接口：GIO g_object_set_data；drd_system_daemon_register_client；GDBus 信号 drd_dbus_remote_desktop_rdp_handover_emit_take_client_ready。
  */
 static gboolean
 drd_system_daemon_delegate(DrdRdpListener *listener,
                            GSocketConnection *connection,
+                           const DrdRoutingTokenInfo *routing,
                            gpointer user_data,
                            GError **error)
 {
     (void) listener;
+    (void) error;
     DrdSystemDaemon *self = DRD_SYSTEM_DAEMON(user_data);
     g_return_val_if_fail(DRD_IS_SYSTEM_DAEMON(self), TRUE);
+    g_return_val_if_fail(routing != NULL, TRUE);
 
-    g_autoptr(DrdRoutingTokenInfo)
-    info = drd_routing_token_info_new();
     g_object_ref(connection);
-    DRD_LOG_MESSAGE("drd_routing_token_peek run");
-    g_autoptr(GCancellable)
-    cancellable = g_cancellable_new();
-    if (!drd_routing_token_peek(connection, cancellable, info, error))
-    {
-        g_object_unref(connection);
-        return TRUE;
-    }
 
-    if (info->routing_token != NULL)
+    if (routing->routing_token != NULL)
     {
         // 第二次进
         DrdRemoteClient *existing =
-                drd_system_daemon_find_client_by_token(self, info->routing_token);
+                drd_system_daemon_find_client_by_token(self, routing->routing_token);
         if (existing != NULL && existing->session == NULL)
         {
             g_clear_object(&existing->connection);
@@ -586,9 +580,8 @@ drd_system_daemon_delegate(DrdRdpListener *listener,
         }
     }
 
-    if (!drd_system_daemon_register_client(self, connection, info))
+    if (!drd_system_daemon_register_client(self, connection, routing))
     {
-        g_clear_pointer(&info, drd_routing_token_info_free);
         g_object_unref(connection);
         return TRUE;
     }
@@ -1077,6 +1070,12 @@ drd_system_daemon_start_listener(DrdSystemDaemon *self, GError **error)
         return FALSE;
     }
 
+    drd_rdp_listener_set_accept_limits(self->listener,
+                                       drd_config_get_accept_workers(self->config),
+                                       drd_config_get_accept_queue_max(self->config),
+                                       drd_config_get_accept_queue_timeout_ms(self->config),
+                                       drd_config_get_routing_peek_timeout_ms(self->config));
+
     if (!drd_rdp_listener_start(self->listener, error))
     {
         g_clear_object(&self->listener);
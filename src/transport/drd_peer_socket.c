@@ -0,0 +1,125 @@
+#include "transport/drd_peer_socket.h"
+
+#include <errno.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+/*
+ * 功能：为 peer TCP 连接启用低延迟发送参数。
+ * 逻辑：开启 TCP_NODELAY 关闭 Nagle 合并；设置 TCP_NOTSENT_LOWAT，使内核仅在未发送字节低于阈值时报告可写，
+ *       让 poll/epoll 直接反映链路排空情况。编译环境不支持 NOTSENT_LOWAT 时 NODELAY 仍生效，但返回
+ *       G_IO_ERROR_NOT_SUPPORTED，调用方不应再以 POLLOUT 等待排空。
+ * 参数：fd socket 描述符；notsent_lowat 未发送字节阈值；error 错误输出。
+ * 外部接口：POSIX setsockopt；错误通过 g_set_error 以 G_IO_ERROR 返回。
+ */
+gboolean
+drd_peer_socket_configure_low_latency(gint fd, guint notsent_lowat, GError **error)
+{
+    if (fd < 0)
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid peer socket");
+        return FALSE;
+    }
+
+    const int nodelay = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) != 0)
+    {
+        const int saved_errno = errno;
+        g_set_error(error,
+                    G_IO_ERROR,
+                    g_io_error_from_errno(saved_errno),
+                    "Failed to enable TCP_NODELAY: %s",
+                    g_strerror(saved_errno));
+        return FALSE;
+    }
+
+#ifdef TCP_NOTSENT_LOWAT
+    const int lowat = (int) notsent_lowat;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat)) != 0)
+    {
+        const int saved_errno = errno;
+        g_set_error(error,
+                    G_IO_ERROR,
+                    g_io_error_from_errno(saved_errno),
+                    "Failed to set TCP_NOTSENT_LOWAT: %s",
+                    g_strerror(saved_errno));
+        return FALSE;
+    }
+#else
+    (void) notsent_lowat;
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "TCP_NOTSENT_LOWAT is not supported");
+    return FALSE;
+#endif
+
+    return TRUE;
+}
+
+/*
+ * 功能：读取 socket 中尚未发送到网络的字节数。
+ * 逻辑：优先使用 SIOCOUTQNSD（仅统计未发送数据），不支持时退回 SIOCOUTQ（含已发送未确认数据）。
+ * 参数：fd socket 描述符；out_bytes 输出字节数。
+ * 外部接口：Linux ioctl SIOCOUTQNSD/SIOCOUTQ。
+ */
+gboolean
+drd_peer_socket_get_unsent_bytes(gint fd, gsize *out_bytes)
+{
+    g_return_val_if_fail(out_bytes != NULL, FALSE);
+
+    int pending = 0;
+#ifdef SIOCOUTQNSD
+    if (ioctl(fd, SIOCOUTQNSD, &pending) == 0)
+    {
+        *out_bytes = pending > 0 ? (gsize) pending : 0;
+        return TRUE;
+    }
+#endif
+    if (ioctl(fd, SIOCOUTQ, &pending) == 0)
+    {
+        *out_bytes = pending > 0 ? (gsize) pending : 0;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * 功能：等待 socket 发送队列排空到阈值以下。
+ * 逻辑：未发送字节不超过 limit 时立即返回 TRUE；否则以 POLLOUT 等待（配合 TCP_NOTSENT_LOWAT 在排空时唤醒），
+ *       超时后重新读取队列长度判定。读取失败时不阻塞调用方。
+ * 参数：fd socket 描述符；limit 允许的未发送字节上限；timeout_us 最长等待时间。
+ * 外部接口：POSIX poll；drd_peer_socket_get_unsent_bytes。
+ */
+gboolean
+drd_peer_socket_wait_drain(gint fd, gsize limit, gint64 timeout_us)
+{
+    gsize unsent = 0;
+    if (fd < 0 || !drd_peer_socket_get_unsent_bytes(fd, &unsent))
+    {
+        return TRUE;
+    }
+    if (unsent <= limit)
+    {
+        return TRUE;
+    }
+
+    struct pollfd pfd;
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    const int timeout_ms = (int) MAX((timeout_us + 999) / 1000, (gint64) 1);
+    if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR)
+    {
+        return TRUE;
+    }
+
+    if (!drd_peer_socket_get_unsent_bytes(fd, &unsent))
+    {
+        return TRUE;
+    }
+    return unsent <= limit;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* 内核中未发送字节低于该值时 socket 才报告可写，避免编码帧在 socket 缓冲中堆积 */
+#define DRD_PEER_SOCKET_NOTSENT_LOWAT (128 * 1024)
+
+gboolean drd_peer_socket_configure_low_latency(gint fd, guint notsent_lowat, GError **error);
+gboolean drd_peer_socket_get_unsent_bytes(gint fd, gsize *out_bytes);
+gboolean drd_peer_socket_wait_drain(gint fd, gsize limit, gint64 timeout_us);
+
+G_END_DECLS
@@ -20,12 +20,16 @@
 #include "core/drd_server_runtime.h"
 #include "input/drd_input_dispatcher.h"
 #include "session/drd_rdp_session.h"
+#include "session/drd_session_reactor.h"
+#include "security/drd_auth_pool.h"
 #include "security/drd_tls_credentials.h"
-#include "security/drd_local_session.h"
 #include "security/drd_nla_sam.h"
 #include "utils/drd_log.h"
 #include "utils/drd_system_info.h"
 
+/* 监听器统计摘要的输出周期，期间没有新的认证/接入时不输出 */
+#define DRD_RDP_LISTENER_STATS_INTERVAL_SEC 60
+
 typedef struct
 {
     rdpContext context;
@@ -52,7 +56,8 @@ static BOOL drd_rdp_peer_pointer_event_x11(rdpInput *input, UINT16 flags, UINT16
 
 static BOOL drd_peer_capabilities(freerdp_peer *client);
 
-static gboolean drd_rdp_listener_has_active_session(DrdRdpListener *self);
+static gboolean drd_rdp_listener_reserve_session(DrdRdpListener *self);
+static void drd_rdp_listener_release_session(DrdRdpListener *self);
 
 static gboolean drd_rdp_listener_session_closed(DrdRdpListener *self, DrdRdpSession *session);
 
@@ -68,9 +73,42 @@ static gboolean drd_rdp_listener_connection_keep_open(GSocketConnection *connect
 
 static void drd_rdp_listener_close_connection(GSocketConnection *connection, gboolean keep_open);
 
-static void drd_rdp_listener_cleanup_peer(freerdp_peer *peer,
-                                          GSocketConnection *connection,
-                                          gboolean keep_open);
+typedef enum
+{
+    DRD_RDP_ACCEPT_STAGE_PEEK,     /* 工作线程：窥探路由令牌（system 模式） */
+    DRD_RDP_ACCEPT_STAGE_DELEGATE, /* 主循环：交给 delegate 决定归属 */
+    DRD_RDP_ACCEPT_STAGE_SETUP,    /* 工作线程：创建 peer、配置并启动会话 */
+    DRD_RDP_ACCEPT_STAGE_READY,    /* 主循环：通知会话回调 */
+    DRD_RDP_ACCEPT_STAGE_DONE      /* 主循环：结算统计并回收 */
+} DrdRdpAcceptStage;
+
+typedef enum
+{
+    DRD_RDP_ACCEPT_OUTCOME_ACCEPTED,
+    DRD_RDP_ACCEPT_OUTCOME_DELEGATED,
+    DRD_RDP_ACCEPT_OUTCOME_TIMED_OUT,
+    DRD_RDP_ACCEPT_OUTCOME_FAILED
+} DrdRdpAcceptOutcome;
+
+/* 一个待接入连接，在工作线程与主循环之间按阶段交接，同一时刻只有一方持有 */
+typedef struct
+{
+    DrdRdpListener *listener;
+    GSocketConnection *connection;
+    GCancellable *cancellable;   /* 停止监听或窥探超时时取消 */
+    DrdRoutingTokenInfo *routing;
+    DrdRdpSession *session;      /* 建立成功的会话 */
+    gchar *peer_name;
+    gboolean keep_open;
+    DrdRdpAcceptStage stage;
+    DrdRdpAcceptOutcome outcome;
+    GError *error;
+    gint64 enqueued_us;          /* 受理时刻 */
+    gint64 staged_us;            /* 进入当前阶段的时刻 */
+    gint64 queue_us;             /* 累计等待工作线程的时长 */
+    gint64 peek_us;
+    gint64 setup_us;
+} DrdRdpAcceptJob;
 
 struct _DrdRdpListener
 {
@@ -78,11 +116,15 @@ struct _DrdRdpListener
 
     gchar *bind_address;
     guint16 port;
+    GMutex sessions_lock;       /* 保护 sessions 与 reserved_sessions，会话在工作线程建立、在事件线程关闭 */
     GPtrArray *sessions;
+    guint reserved_sessions;    /* 已占位、仍在建立中的会话数 */
     DrdServerRuntime *runtime;
     gchar *nla_username;
     gchar *nla_password;
     gchar *nla_hash;
+    GMutex nla_lock;            /* 保护 nla_password/nla_hash/nla_sam 的惰性初始化，peer 设置在接入工作线程上并发执行 */
+    DrdNlaSamFile *nla_sam;     /* 所有连接共用的内存 SAM 数据库 */
     gboolean nla_enabled;
     gchar *pam_service;
     DrdRuntimeMode runtime_mode;
@@ -93,6 +135,20 @@ struct _DrdRdpListener
     gpointer delegate_data;
     DrdRdpListenerSessionFunc session_cb;
     gpointer session_cb_data;
+    GMainContext *main_context; /* incoming 所在的主循环，接入流水线的主循环阶段派发到这里 */
+    GThreadPool *accept_pool;
+    GMutex accept_lock;         /* 保护 accept_jobs 与统计 */
+    GPtrArray *accept_jobs;     /* 已受理未结束的连接，停止时逐个取消 */
+    guint accept_workers;       /* 接入工作线程数：窥探与 peer 建立都是短任务，少量线程即可吸收连接突发 */
+    guint accept_queue_max;     /* 已受理未结束的连接上限，超出后新连接直接关闭 */
+    gint64 accept_queue_timeout_us; /* 单个工作阶段排队等待线程的上限，超时的客户端多半已放弃 */
+    guint peek_timeout_ms;      /* 路由令牌窥探的上限，客户端迟迟不发 X.224 连接请求时放弃 */
+    DrdRdpListenerAcceptStats accept_stats;
+    gint64 accept_total_us;
+    GSource *stats_source;      /* 周期统计摘要，挂在 main_context 上 */
+    guint64 stats_auth_seen;    /* 上次摘要时已结束的认证请求数 */
+    guint64 stats_accept_seen;  /* 上次摘要时已结束的接入连接数 */
+    guint64 stats_reactor_seen; /* 上次摘要时会话反应器的累计回调次数 */
 };
 
 G_DEFINE_TYPE(DrdRdpListener, drd_rdp_listener, G_TYPE_SOCKET_SERVICE)
@@ -111,7 +167,8 @@ drd_rdp_listener_is_system_mode(DrdRdpListener *self)
 
 /*
  * 功能：在 system 模式下根据客户端分辨率更新编码配置。
- * 逻辑：以配置中的编码选项为基准，若客户端提供分辨率则覆盖，并写入 runtime。
+ * 逻辑：以配置中的编码选项为基准，若客户端提供分辨率则覆盖，并写入 runtime；
+ *       已有其他会话在观看时沿用当前分辨率，后加入的观看者经 DesktopResize 适配。
  * 参数：self 监听器；client_width/client_height 客户端分辨率。
  * 外部接口：drd_server_runtime_set_encoding_options 更新运行时参数。
  */
@@ -130,6 +187,14 @@ drd_rdp_listener_update_system_encoding(DrdRdpListener *self,
         return;
     }
 
+    g_mutex_lock(&self->sessions_lock);
+    const guint n_sessions = self->sessions->len;
+    g_mutex_unlock(&self->sessions_lock);
+    if (n_sessions > 1)
+    {
+        return;
+    }
+
     DrdEncodingOptions updated = self->encoding_options;
     if (client_width > 0 && client_height > 0)
     {
@@ -155,46 +220,51 @@ drd_rdp_listener_is_handover_mode(DrdRdpListener *self)
 static void drd_rdp_listener_stop_internal(DrdRdpListener *self);
 
 /*
- * 功能：确保 NLA 使用的 NT hash 已就绪。
- * 逻辑：若未启用 NLA 或已有 hash 直接返回；否则用存储的密码生成 hash，清零原始密码存储。
+ * 功能：获取所有连接共用的 NLA SAM 数据库。
+ * 逻辑：持 nla_lock 惰性初始化：首次调用时用存储的密码派生 NT hash 并清零原始密码，再创建内存 SAM；
+ *       之后各连接只增加引用，连接建立期间不再有文件写入。
  * 参数：self 监听器；error 输出错误。
- * 外部接口：调用 drd_nla_sam_hash_password 派生 NTLM hash；GLib g_set_error。
+ * 外部接口：调用 drd_nla_sam_hash_password 派生 NTLM hash，drd_nla_sam_file_new 创建 SAM；GLib g_set_error。
+ * 返回：SAM 引用，调用方负责 unref；失败返回 NULL。
  */
-static gboolean
-drd_rdp_listener_ensure_nla_hash(DrdRdpListener *self, GError **error)
+static DrdNlaSamFile *
+drd_rdp_listener_ensure_nla_sam(DrdRdpListener *self, GError **error)
 {
-    if (!self->nla_enabled)
+    g_mutex_lock(&self->nla_lock);
+    if (self->nla_sam == NULL && self->nla_hash == NULL)
     {
-        return TRUE;
-    }
+        if (self->nla_password == NULL)
+        {
+            g_mutex_unlock(&self->nla_lock);
+            g_set_error_literal(error,
+                                G_IO_ERROR,
+                                G_IO_ERROR_FAILED,
+                                "NLA password is not available");
+            return NULL;
+        }
 
-    if (self->nla_hash != NULL)
-    {
-        return TRUE;
-    }
+        self->nla_hash = drd_nla_sam_hash_password(self->nla_password);
+        if (self->nla_hash == NULL)
+        {
+            g_mutex_unlock(&self->nla_lock);
+            g_set_error_literal(error,
+                                G_IO_ERROR,
+                                G_IO_ERROR_FAILED,
+                                "Failed to derive NT hash for NLA user");
+            return NULL;
+        }
 
-    if (self->nla_password == NULL)
-    {
-        g_set_error_literal(error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_FAILED,
-                            "NLA password is not available");
-        return FALSE;
+        memset(self->nla_password, 0, strlen(self->nla_password));
+        g_clear_pointer(&self->nla_password, g_free);
     }
 
-    self->nla_hash = drd_nla_sam_hash_password(self->nla_password);
-    if (self->nla_hash == NULL)
+    if (self->nla_sam == NULL)
     {
-        g_set_error_literal(error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_FAILED,
-                            "Failed to derive NT hash for NLA user");
-        return FALSE;
+        self->nla_sam = drd_nla_sam_file_new(self->nla_username, self->nla_hash, error);
     }
-
-    memset(self->nla_password, 0, strlen(self->nla_password));
-    g_clear_pointer(&self->nla_password, g_free);
-    return TRUE;
+    DrdNlaSamFile *sam = self->nla_sam != NULL ? drd_nla_sam_file_ref(self->nla_sam) : NULL;
+    g_mutex_unlock(&self->nla_lock);
+    return sam;
 }
 
 /*
@@ -214,7 +284,7 @@ drd_rdp_listener_dispose(GObject *object)
 
 /*
  * 功能：释放监听器中分配的字符串、数组与敏感信息。
- * 逻辑：清理地址、session 数组、NLA 用户名/密码/hash 等，并交由父类 finalize。
+ * 逻辑：清理地址、session 数组、接入任务列表与锁、NLA 用户名/密码/hash 与共用 SAM 等，并交由父类 finalize。
  * 参数：object GObject 指针。
  * 外部接口：GLib g_clear_pointer/g_free；对密码/hash 做 memset 清零。
  */
@@ -224,6 +294,12 @@ drd_rdp_listener_finalize(GObject *object)
     DrdRdpListener *self = DRD_RDP_LISTENER(object);
     g_clear_pointer(&self->bind_address, g_free);
     g_clear_pointer(&self->sessions, g_ptr_array_unref);
+    g_clear_pointer(&self->accept_jobs, g_ptr_array_unref);
+    g_clear_pointer(&self->main_context, g_main_context_unref);
+    g_mutex_clear(&self->sessions_lock);
+    g_mutex_clear(&self->accept_lock);
+    g_clear_pointer(&self->nla_sam, drd_nla_sam_file_unref);
+    g_mutex_clear(&self->nla_lock);
     g_clear_pointer(&self->nla_username, g_free);
     if (self->nla_password != NULL)
     {
@@ -258,14 +334,22 @@ drd_rdp_listener_class_init(DrdRdpListenerClass *klass)
 
 /*
  * 功能：初始化监听器实例的集合与默认标志。
- * 逻辑：创建 session 数组并清零绑定/回调相关状态。
+ * 逻辑：创建 session 数组与接入任务列表、初始化锁，并清零绑定/回调相关状态。
  * 参数：self 监听器。
- * 外部接口：GLib g_ptr_array_new_with_free_func。
+ * 外部接口：GLib g_ptr_array_new_with_free_func/g_mutex_init。
  */
 static void
 drd_rdp_listener_init(DrdRdpListener *self)
 {
+    g_mutex_init(&self->sessions_lock);
+    g_mutex_init(&self->accept_lock);
+    g_mutex_init(&self->nla_lock);
     self->sessions = g_ptr_array_new_with_free_func(g_object_unref);
+    self->accept_jobs = g_ptr_array_new();
+    self->accept_workers = DRD_ACCEPT_DEFAULT_WORKERS;
+    self->accept_queue_max = DRD_ACCEPT_DEFAULT_QUEUE_MAX;
+    self->accept_queue_timeout_us = (gint64) DRD_ACCEPT_DEFAULT_QUEUE_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+    self->peek_timeout_ms = DRD_ACCEPT_DEFAULT_PEEK_TIMEOUT_MS;
     self->is_bound = FALSE;
     self->cancellable = NULL;
     self->delegate_func = NULL;
@@ -275,25 +359,46 @@ drd_rdp_listener_init(DrdRdpListener *self)
 }
 
 /*
- * 功能：检查是否存在活跃会话。
- * 逻辑：若 sessions 数组为空或未初始化返回 FALSE，否则根据长度判断。
+ * 功能：为即将建立的会话占一个观看者名额。
+ * 逻辑：上限取编码配置 gfx_max_viewers（未配置按 1 处理），多个会话共享同一路捕获与编码；
+ *       已建立与建立中的会话一起计数，多个工作线程并发接入时不会超出上限。
  * 参数：self 监听器。
- * 外部接口：无。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ * 返回：占位成功返回 TRUE，之后须以加入会话列表或 release_session 结束占位。
  */
 static gboolean
-drd_rdp_listener_has_active_session(DrdRdpListener *self)
+drd_rdp_listener_reserve_session(DrdRdpListener *self)
 {
-    if (self == NULL || self->sessions == NULL)
+    const guint max_viewers = MAX(self->encoding_options.gfx_max_viewers, 1u);
+
+    g_mutex_lock(&self->sessions_lock);
+    const gboolean reserved = self->sessions->len + self->reserved_sessions < max_viewers;
+    if (reserved)
     {
-        return FALSE;
+        self->reserved_sessions++;
     }
+    g_mutex_unlock(&self->sessions_lock);
+    return reserved;
+}
 
-    return self->sessions->len > 0;
+/*
+ * 功能：归还未能建立会话的观看者名额。
+ * 逻辑：持锁递减占位计数。
+ * 参数：self 监听器。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+static void
+drd_rdp_listener_release_session(DrdRdpListener *self)
+{
+    g_mutex_lock(&self->sessions_lock);
+    g_warn_if_fail(self->reserved_sessions > 0);
+    self->reserved_sessions--;
+    g_mutex_unlock(&self->sessions_lock);
 }
 
 /*
  * 功能：从会话列表中移除关闭的会话并在空闲时停止 runtime。
- * 逻辑：从 sessions 数组移除匹配会话并记录日志；若列表为空则调用 runtime 停止。
+ * 逻辑：持锁从 sessions 数组移除匹配会话（会话引用在锁外释放）并记录日志；若列表为空则调用 runtime 停止。
  * 参数：self 监听器；session 已关闭的会话。
  * 外部接口：drd_server_runtime_stop 停止流。
  */
@@ -305,16 +410,24 @@ drd_rdp_listener_session_closed(DrdRdpListener *self, DrdRdpSession *session)
         return FALSE;
     }
 
-    if (!g_ptr_array_remove_fast(self->sessions, session))
+    g_mutex_lock(&self->sessions_lock);
+    guint index = 0;
+    const gboolean found = g_ptr_array_find(self->sessions, session, &index);
+    DrdRdpSession *removed = found ? g_ptr_array_steal_index_fast(self->sessions, index) : NULL;
+    const guint remaining = self->sessions->len;
+    g_mutex_unlock(&self->sessions_lock);
+
+    if (!found)
     {
         return FALSE;
     }
 
     DRD_LOG_MESSAGE("Detached session %p, %u session(s) remaining",
                     (void *)session,
-                    self->sessions->len);
+                    remaining);
+    g_object_unref(removed);
 
-    if (self->sessions->len == 0 && self->runtime != NULL)
+    if (remaining == 0 && self->runtime != NULL)
     {
         drd_server_runtime_stop(self->runtime);
     }
@@ -529,9 +642,9 @@ drd_peer_context_new(freerdp_peer *client, rdpContext *context)
 
 /*
  * 功能：释放 peer 上下文中的资源。
- * 逻辑：在 listener 中移除 session，释放 session/runtime 引用，释放 NLA SAM 文件，关闭 VCM。
+ * 逻辑：在 listener 中移除 session，释放 session/runtime 引用，释放 NLA SAM 引用，关闭 VCM。
  * 参数：client peer（未使用）；context 上下文。
- * 外部接口：WTSCloseServer 关闭虚拟通道管理器，drd_nla_sam_file_free 释放 SAM。
+ * 外部接口：WTSCloseServer 关闭虚拟通道管理器，drd_nla_sam_file_unref 释放 SAM 引用。
  */
 static void
 drd_peer_context_free(freerdp_peer *client G_GNUC_UNUSED, rdpContext *context)
@@ -553,7 +666,7 @@ drd_peer_context_free(freerdp_peer *client G_GNUC_UNUSED, rdpContext *context)
         ctx->runtime = NULL;
     }
 
-    g_clear_pointer(&ctx->nla_sam, drd_nla_sam_file_free);
+    g_clear_pointer(&ctx->nla_sam, drd_nla_sam_file_unref);
     if (ctx->vcm != NULL && ctx->vcm != INVALID_HANDLE_VALUE)
     {
         WTSCloseServer(ctx->vcm);
@@ -564,7 +677,8 @@ drd_peer_context_free(freerdp_peer *client G_GNUC_UNUSED, rdpContext *context)
 
 /*
  * 功能：处理 FreeRDP PostConnect 回调。
- * 逻辑：调用会话 post_connect，释放 NLA SAM 文件；在非 NLA 模式下执行 TLS/PAM 登录校验。
+ * 逻辑：调用会话 post_connect，释放 NLA SAM 引用；在非 NLA 模式下把 TLS/PAM 登录校验提交到认证线程池，
+ *       结果由会话事件处理方异步收取。
  * 参数：client peer。
  * 外部接口：FreeRDP 回调机制；drd_rdp_listener_authenticate_tls_login 验证凭据。
  */
@@ -577,7 +691,7 @@ drd_peer_post_connect(freerdp_peer *client)
         return FALSE;
     }
     BOOL result = drd_rdp_session_post_connect(ctx->session);
-    g_clear_pointer(&ctx->nla_sam, drd_nla_sam_file_free);
+    g_clear_pointer(&ctx->nla_sam, drd_nla_sam_file_unref);
     if (!result)
     {
         return FALSE;
@@ -1019,11 +1133,11 @@ drd_rdp_peer_extended_pointer_event(rdpInput *input, UINT16 flags, UINT16 x, UIN
 
 /*
  * 功能：根据运行时配置初始化 FreeRDP peer 设置（TLS/NLA/编码模式等）。
- * 逻辑：应用 TLS 证书，配置 NLA SAM 文件或 TLS-only 安全模式，设置桌面尺寸/色深/管线能力，
+ * 逻辑：应用 TLS 证书，引用共用的内存 NLA SAM 或配置 TLS-only 安全模式，设置桌面尺寸/色深/管线能力，
  *       禁用不需要的功能，按照 handover 模式打开 RDSTLS。
  * 参数：self 监听器；client peer；error 错误输出。
- * 外部接口：大量使用 freerdp_settings_set_* API，drd_tls_credentials_apply 应用证书，
- *           drd_nla_sam_file_new 配置 SAM。
+ * 外部接口：大量使用 freerdp_settings_set_* API，drd_tls_credentials_apply 写入预解析证书的副本，
+ *           drd_rdp_listener_ensure_nla_sam 获取 SAM。
  */
 static BOOL
 drd_configure_peer_settings(DrdRdpListener *self, freerdp_peer *client, GError **error)
@@ -1062,8 +1176,7 @@ drd_configure_peer_settings(DrdRdpListener *self, freerdp_peer *client, GError *
 
     if (self->nla_enabled)
     {
-        if (self->nla_username == NULL ||
-            !drd_rdp_listener_ensure_nla_hash(self, error))
+        if (self->nla_username == NULL)
         {
             g_set_error_literal(error,
                                 G_IO_ERROR,
@@ -1072,8 +1185,8 @@ drd_configure_peer_settings(DrdRdpListener *self, freerdp_peer *client, GError *
             return FALSE;
         }
 
-        g_clear_pointer(&ctx->nla_sam, drd_nla_sam_file_free);
-        ctx->nla_sam = drd_nla_sam_file_new(self->nla_username, self->nla_hash, error);
+        g_clear_pointer(&ctx->nla_sam, drd_nla_sam_file_unref);
+        ctx->nla_sam = drd_rdp_listener_ensure_nla_sam(self, error);
         if (ctx->nla_sam == NULL)
         {
             return FALSE;
@@ -1092,7 +1205,7 @@ drd_configure_peer_settings(DrdRdpListener *self, freerdp_peer *client, GError *
     }
     else
     {
-        g_clear_pointer(&ctx->nla_sam, drd_nla_sam_file_free);
+        g_clear_pointer(&ctx->nla_sam, drd_nla_sam_file_unref);
         if (!freerdp_settings_set_string(settings, FreeRDP_NtlmSamFile, NULL))
         {
             g_set_error_literal(error,
@@ -1226,22 +1339,19 @@ drd_configure_peer_settings(DrdRdpListener *self, freerdp_peer *client, GError *
 }
 
 /*
- * 功能：接受新的 FreeRDP peer，配置上下文与输入回调。
- * 逻辑：为 peer 分配自定义 context，确保无其他会话占用；配置 peer settings、回调与 VCM，
- *       启动会话事件线程并将会话加入列表，设置输入回调（非 system 模式）。
- * 参数：self 监听器；peer FreeRDP peer；peer_name 日志用对端描述。
+ * 功能：为已占位的 peer 配置上下文与输入回调并启动会话。
+ * 逻辑：为 peer 分配自定义 context；配置 peer settings、回调与 VCM，
+ *       启动会话事件线程并将会话加入列表（同时结束占位），设置输入回调（非 system 模式）。
+ * 参数：self 监听器；peer FreeRDP peer；peer_name 日志用对端描述；out_session 输出会话引用。
  * 外部接口：freerdp_peer_context_new/Initialize、WTSOpenServerA 打开 VCM，
  *           会话相关 drd_rdp_session_* 调用。
  */
 static gboolean
-drd_rdp_listener_accept_peer(DrdRdpListener *self,
-                             freerdp_peer *peer,
-                             const gchar *peer_name)
+drd_rdp_listener_setup_peer(DrdRdpListener *self,
+                            freerdp_peer *peer,
+                            const gchar *peer_name,
+                            DrdRdpSession **out_session)
 {
-    DRD_LOG_MESSAGE("listener accept peer");
-    g_return_val_if_fail(DRD_IS_RDP_LISTENER(self), FALSE);
-    g_return_val_if_fail(peer != NULL, FALSE);
-
     peer->ContextSize = sizeof(DrdRdpPeerContext);
     peer->ContextNew = drd_peer_context_new;
     peer->ContextFree = drd_peer_context_free;
@@ -1252,12 +1362,6 @@ drd_rdp_listener_accept_peer(DrdRdpListener *self,
         return FALSE;
     }
 
-    if (drd_rdp_listener_has_active_session(self))
-    {
-        DRD_LOG_WARNING("Rejecting connection from %s: session already active", peer_name);
-        return FALSE;
-    }
-
     g_autoptr(GError) settings_error = NULL;
     if (!drd_configure_peer_settings(self, peer, &settings_error))
     {
@@ -1293,6 +1397,8 @@ drd_rdp_listener_accept_peer(DrdRdpListener *self,
     }
 
     drd_rdp_session_set_peer_address(ctx->session, peer_name);
+    /* 事件线程启动后 peer 随时可能因断线被释放，先持有会话引用 */
+    g_autoptr(DrdRdpSession) session = g_object_ref(ctx->session);
 
     ctx->vcm = WTSOpenServerA((LPSTR) peer->context);
     if (ctx->vcm == NULL || ctx->vcm == INVALID_HANDLE_VALUE)
@@ -1315,7 +1421,10 @@ drd_rdp_listener_accept_peer(DrdRdpListener *self,
 
     ctx->listener = self;
     drd_rdp_session_set_peer_state(ctx->session, "initialized");
+    g_mutex_lock(&self->sessions_lock);
+    self->reserved_sessions--;
     g_ptr_array_add(self->sessions, g_object_ref(ctx->session));
+    g_mutex_unlock(&self->sessions_lock);
     drd_rdp_session_set_closed_callback(ctx->session,
                                         drd_rdp_listener_on_session_closed,
                                         self);
@@ -1334,6 +1443,39 @@ drd_rdp_listener_accept_peer(DrdRdpListener *self,
     }
 
     DRD_LOG_MESSAGE("Accepted connection from %s", peer_name);
+    *out_session = g_steal_pointer(&session);
+    return TRUE;
+}
+
+/*
+ * 功能：接受新的 FreeRDP peer。
+ * 逻辑：先占一个观看者名额，名额已满直接拒绝；随后配置并启动会话，失败时归还名额。
+ *       可在接入工作线程上调用。
+ * 参数：self 监听器；peer FreeRDP peer；peer_name 日志用对端描述；out_session 输出会话引用。
+ * 外部接口：内部 drd_rdp_listener_reserve_session/setup_peer/release_session。
+ */
+static gboolean
+drd_rdp_listener_accept_peer(DrdRdpListener *self,
+                             freerdp_peer *peer,
+                             const gchar *peer_name,
+                             DrdRdpSession **out_session)
+{
+    DRD_LOG_MESSAGE("listener accept peer");
+    g_return_val_if_fail(DRD_IS_RDP_LISTENER(self), FALSE);
+    g_return_val_if_fail(peer != NULL, FALSE);
+
+    if (!drd_rdp_listener_reserve_session(self))
+    {
+        DRD_LOG_WARNING("Rejecting connection from %s: viewer limit %u reached", peer_name,
+                        MAX(self->encoding_options.gfx_max_viewers, 1u));
+        return FALSE;
+    }
+
+    if (!drd_rdp_listener_setup_peer(self, peer, peer_name, out_session))
+    {
+        drd_rdp_listener_release_session(self);
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -1359,29 +1501,42 @@ drd_rdp_listener_close_connection(GSocketConnection *connection, gboolean keep_o
 }
 
 /*
- * 功能：统一回收 peer 与关联连接的失败分支。
- * 逻辑：释放 peer 后复用连接关闭逻辑，减少重复代码。
- * 参数：peer FreeRDP peer；connection 套接字连接；keep_open 是否保持连接打开。
- * 外部接口：freerdp_peer_free。
+ * 功能：由套接字连接建立 peer 并启动会话。
+ * 逻辑：由连接 fd 创建 FreeRDP peer 后交由 accept_peer 配置；失败时释放 peer，连接留给调用方关闭。
+ *       不触碰主循环状态，可在接入工作线程上调用。
+ * 参数：self 监听器；connection 套接字连接；peer_name 日志用对端描述；error 错误输出。
+ * 外部接口：drd_rdp_listener_peer_from_connection 创建 peer，FreeRDP freerdp_peer_free 释放失败的 peer。
+ * 返回：新会话（调用方持有引用），失败返回 NULL。
  */
-static void
-drd_rdp_listener_cleanup_peer(freerdp_peer *peer,
-                              GSocketConnection *connection,
-                              gboolean keep_open)
+static DrdRdpSession *
+drd_rdp_listener_prepare_session(DrdRdpListener *self,
+                                 GSocketConnection *connection,
+                                 const gchar *peer_name,
+                                 GError **error)
 {
-    if (peer != NULL)
+    freerdp_peer *peer = drd_rdp_listener_peer_from_connection(connection, error);
+    if (peer == NULL)
+    {
+        return NULL;
+    }
+
+    DrdRdpSession *session = NULL;
+    if (!drd_rdp_listener_accept_peer(self, peer, peer_name, &session))
     {
         freerdp_peer_free(peer);
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to accept peer %s", peer_name);
+        return NULL;
     }
-    drd_rdp_listener_close_connection(connection, keep_open);
+
+    return session;
 }
 
 /*
- * 功能：处理新的 socket 连接，构造 peer 并交由 accept_peer。
- * 逻辑：生成对端描述，按需求保持连接打开，创建 FreeRDP peer；若接受成功可调用 session 回调；
+ * 功能：同步处理新的 socket 连接（handover 接管路径）。
+ * 逻辑：生成对端描述，按需求保持连接打开，建立 peer 与会话；若接受成功可调用 session 回调；
  *       根据 keep_open 决定是否立即关闭 GLib 连接。
  * 参数：self 监听器；connection 套接字连接；error 错误输出。
- * 外部接口：drd_rdp_listener_peer_from_connection 创建 peer，drd_rdp_listener_accept_peer 完成配置。
+ * 外部接口：drd_rdp_listener_prepare_session 完成 peer 创建与配置。
  */
 static gboolean
 drd_rdp_listener_handle_connection(DrdRdpListener *self,
@@ -1394,37 +1549,290 @@ drd_rdp_listener_handle_connection(DrdRdpListener *self,
 
     g_autofree gchar *peer_name = drd_rdp_listener_describe_connection(connection);
     const gboolean keep_open = drd_rdp_listener_connection_keep_open(connection);
-    freerdp_peer *peer = drd_rdp_listener_peer_from_connection(connection, error);
-    if (peer == NULL)
+    g_autoptr(DrdRdpSession) session =
+            drd_rdp_listener_prepare_session(self, connection, peer_name, error);
+    if (session == NULL)
     {
-        drd_rdp_listener_close_connection(connection, FALSE);
+        drd_rdp_listener_close_connection(connection, keep_open);
         return FALSE;
     }
 
-    if (!drd_rdp_listener_accept_peer(self, peer, peer_name))
+    if (self->session_cb != NULL)
     {
-        drd_rdp_listener_cleanup_peer(peer, connection, keep_open);
+        self->session_cb(self, session, connection, self->session_cb_data);
+    }
+
+    drd_rdp_listener_close_connection(connection, keep_open);
+
+    return TRUE;
+}
+
+static const gchar *
+drd_rdp_listener_accept_outcome_name(DrdRdpAcceptOutcome outcome)
+{
+    switch (outcome)
+    {
+        case DRD_RDP_ACCEPT_OUTCOME_ACCEPTED:
+            return "accepted";
+        case DRD_RDP_ACCEPT_OUTCOME_DELEGATED:
+            return "delegated";
+        case DRD_RDP_ACCEPT_OUTCOME_TIMED_OUT:
+            return "timed out";
+        default:
+            return "failed";
+    }
+}
+
+/*
+ * 功能：释放接入任务。
+ * 逻辑：释放会话、取消源、路由信息与错误，最后释放监听器引用；连接由 accept_job_finish 处理。
+ * 参数：job 接入任务。
+ * 外部接口：GLib g_clear_object/g_clear_error；drd_routing_token_info_free。
+ */
+static void
+drd_rdp_listener_accept_job_free(DrdRdpAcceptJob *job)
+{
+    g_clear_object(&job->session);
+    g_clear_object(&job->cancellable);
+    g_clear_pointer(&job->routing, drd_routing_token_info_free);
+    g_clear_pointer(&job->peer_name, g_free);
+    g_clear_error(&job->error);
+    g_object_unref(job->listener);
+    g_free(job);
+}
+
+/*
+ * 功能：结束接入任务并结算统计。
+ * 逻辑：在主循环调用；移出在途列表，更新队列深度与结果计数，成功的连接计入受理到结束的时延；
+ *       delegate 接管的连接只释放引用，其余按 keep_open 关闭；输出一行各阶段耗时与队列状态。
+ * 参数：job 接入任务，调用后失效。
+ * 外部接口：GLib g_get_monotonic_time；日志 DRD_LOG_MESSAGE/DRD_LOG_WARNING。
+ */
+static void
+drd_rdp_listener_accept_job_finish(DrdRdpAcceptJob *job)
+{
+    DrdRdpListener *self = job->listener;
+    const gint64 latency_us = g_get_monotonic_time() - job->enqueued_us;
+    const gboolean succeeded = job->outcome == DRD_RDP_ACCEPT_OUTCOME_ACCEPTED ||
+                               job->outcome == DRD_RDP_ACCEPT_OUTCOME_DELEGATED;
+
+    g_mutex_lock(&self->accept_lock);
+    DrdRdpListenerAcceptStats *stats = &self->accept_stats;
+    g_ptr_array_remove_fast(self->accept_jobs, job);
+    stats->queue_depth = self->accept_jobs->len;
+    switch (job->outcome)
+    {
+        case DRD_RDP_ACCEPT_OUTCOME_ACCEPTED:
+            stats->accepted++;
+            break;
+        case DRD_RDP_ACCEPT_OUTCOME_DELEGATED:
+            stats->delegated++;
+            break;
+        case DRD_RDP_ACCEPT_OUTCOME_TIMED_OUT:
+            stats->timed_out++;
+            break;
+        default:
+            stats->failed++;
+            break;
+    }
+    if (succeeded)
+    {
+        self->accept_total_us += latency_us;
+        stats->avg_accept_us = self->accept_total_us / (gint64) (stats->accepted + stats->delegated);
+        stats->max_accept_us = MAX(stats->max_accept_us, latency_us);
+    }
+    const DrdRdpListenerAcceptStats snapshot = *stats;
+    g_mutex_unlock(&self->accept_lock);
+
+    if (job->error != NULL)
+    {
+        DRD_LOG_WARNING("Accept pipeline for %s: %s", job->peer_name, job->error->message);
+    }
+    DRD_LOG_MESSAGE("Accept pipeline for %s %s in %.1f ms (queue %.1f ms, peek %.1f ms, setup %.1f ms), "
+                    "depth=%u max_depth=%u avg=%.1f ms max=%.1f ms rejected=%" G_GUINT64_FORMAT
+                    " timeouts=%" G_GUINT64_FORMAT,
+                    job->peer_name,
+                    drd_rdp_listener_accept_outcome_name(job->outcome),
+                    latency_us / 1000.0,
+                    job->queue_us / 1000.0,
+                    job->peek_us / 1000.0,
+                    job->setup_us / 1000.0,
+                    snapshot.queue_depth,
+                    snapshot.max_queue_depth,
+                    snapshot.avg_accept_us / 1000.0,
+                    snapshot.max_accept_us / 1000.0,
+                    snapshot.rejected,
+                    snapshot.timed_out);
+
+    if (job->outcome == DRD_RDP_ACCEPT_OUTCOME_DELEGATED)
+    {
+        g_object_unref(job->connection);
+    }
+    else
+    {
+        drd_rdp_listener_close_connection(job->connection, job->keep_open);
+    }
+    drd_rdp_listener_accept_job_free(job);
+}
+
+/*
+ * 功能：把接入任务投递给工作线程执行下一阶段。
+ * 逻辑：在主循环调用；监听器已停止（线程池已释放）时返回 FALSE 由调用方结束任务。
+ *       线程池仅在无法新建线程时报错，此时任务仍在队列中，等待已有线程处理。
+ * 参数：self 监听器；job 接入任务；stage 工作线程阶段（PEEK 或 SETUP）。
+ * 外部接口：GLib g_thread_pool_push。
+ */
+static gboolean
+drd_rdp_listener_accept_push(DrdRdpListener *self, DrdRdpAcceptJob *job, DrdRdpAcceptStage stage)
+{
+    if (self->accept_pool == NULL)
+    {
+        g_set_error_literal(&job->error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Listener stopped");
+        job->outcome = DRD_RDP_ACCEPT_OUTCOME_FAILED;
         return FALSE;
     }
 
-    if (self->session_cb != NULL && peer->context != NULL)
+    job->stage = stage;
+    job->staged_us = g_get_monotonic_time();
+
+    g_autoptr(GError) error = NULL;
+    if (!g_thread_pool_push(self->accept_pool, job, &error))
     {
-        DrdRdpPeerContext *ctx = (DrdRdpPeerContext *) peer->context;
-        if (ctx != NULL && ctx->session != NULL)
+        DRD_LOG_WARNING("Accept worker unavailable, %s stays queued: %s", job->peer_name, error->message);
+    }
+    return TRUE;
+}
+
+/*
+ * 功能：在主循环执行接入任务的主循环阶段。
+ * 逻辑：DELEGATE 阶段把窥探结果交给 delegate，未被接管且无错误时回投工作线程建立会话；READY 阶段通知会话回调；
+ *       监听器已停止时跳过回调；其余情况结算回收。
+ * 参数：user_data 接入任务。
+ * 外部接口：调用方注册的 delegate 与 session 回调。
+ */
+static gboolean
+drd_rdp_listener_accept_dispatch(gpointer user_data)
+{
+    DrdRdpAcceptJob *job = user_data;
+    DrdRdpListener *self = job->listener;
+    const gboolean stopped = self->accept_pool == NULL;
+
+    if (job->stage == DRD_RDP_ACCEPT_STAGE_DELEGATE)
+    {
+        job->stage = DRD_RDP_ACCEPT_STAGE_DONE;
+        job->outcome = DRD_RDP_ACCEPT_OUTCOME_FAILED;
+        if (stopped)
+        {
+            g_set_error_literal(&job->error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Listener stopped");
+        }
+        else if (self->delegate_func(self, job->connection, job->routing, self->delegate_data, &job->error))
         {
-            self->session_cb(self, ctx->session, connection, self->session_cb_data);
+            /* 已被 delegate 接管：即便报告了错误，连接也归 delegate 处理 */
+            job->outcome = DRD_RDP_ACCEPT_OUTCOME_DELEGATED;
+        }
+        else if (job->error == NULL &&
+                 drd_rdp_listener_accept_push(self, job, DRD_RDP_ACCEPT_STAGE_SETUP))
+        {
+            return G_SOURCE_REMOVE;
+        }
+    }
+    else if (job->stage == DRD_RDP_ACCEPT_STAGE_READY)
+    {
+        job->stage = DRD_RDP_ACCEPT_STAGE_DONE;
+        job->outcome = DRD_RDP_ACCEPT_OUTCOME_ACCEPTED;
+        if (self->session_cb != NULL && !stopped)
+        {
+            self->session_cb(self, job->session, job->connection, self->session_cb_data);
         }
     }
 
-    drd_rdp_listener_close_connection(connection, keep_open);
+    drd_rdp_listener_accept_job_finish(job);
+    return G_SOURCE_REMOVE;
+}
 
-    return TRUE;
+/*
+ * 功能：在工作线程窥探路由令牌，带截止时间。
+ * 逻辑：截止时间交给窥探本身，每次 poll 只等待剩余时限；任务的 cancellable 仅在监听器停止时取消。
+ *       超时错误计为 TIMED_OUT，其余失败计为 FAILED；成功时进入 DELEGATE 阶段。
+ * 参数：job 接入任务。
+ * 外部接口：drd_routing_token_peek。
+ */
+static void
+drd_rdp_listener_accept_peek(DrdRdpAcceptJob *job)
+{
+    job->routing = drd_routing_token_info_new();
+    const gboolean peeked = drd_routing_token_peek(job->connection,
+                                                   job->listener->peek_timeout_ms,
+                                                   job->cancellable,
+                                                   job->routing,
+                                                   &job->error);
+    if (peeked)
+    {
+        job->stage = DRD_RDP_ACCEPT_STAGE_DELEGATE;
+        return;
+    }
+
+    job->stage = DRD_RDP_ACCEPT_STAGE_DONE;
+    job->outcome = g_error_matches(job->error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT)
+                       ? DRD_RDP_ACCEPT_OUTCOME_TIMED_OUT
+                       : DRD_RDP_ACCEPT_OUTCOME_FAILED;
 }
 
 /*
- * 功能：GSocketService incoming 回调，处理系统模式委托或直接接受连接。
- * 逻辑：若 system 模式且有 delegate 则先交给 delegate 处理；否则调用 handle_connection，
- *       并在失败时记录日志。
+ * 功能：接入工作线程入口，执行窥探或会话建立阶段。
+ * 逻辑：先检查监听器是否停止、排队是否超时；PEEK 阶段窥探路由令牌，SETUP 阶段建立 peer 与会话；
+ *       完成后把任务派回主循环，释放与回调都在主循环进行。
+ * 参数：data 接入任务；user_data 未使用。
+ * 外部接口：GLib g_idle_source_new/g_source_attach；内部 drd_rdp_listener_accept_peek/prepare_session。
+ */
+static void
+drd_rdp_listener_accept_worker(gpointer data, gpointer user_data G_GNUC_UNUSED)
+{
+    DrdRdpAcceptJob *job = data;
+    const gint64 start = g_get_monotonic_time();
+    const gint64 waited = start - job->staged_us;
+    job->queue_us += waited;
+
+    if (g_cancellable_set_error_if_cancelled(job->cancellable, &job->error))
+    {
+        job->stage = DRD_RDP_ACCEPT_STAGE_DONE;
+        job->outcome = DRD_RDP_ACCEPT_OUTCOME_FAILED;
+    }
+    else if (waited > job->listener->accept_queue_timeout_us)
+    {
+        g_set_error(&job->error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                    "Waited %.1f s for an accept worker", waited / (gdouble) G_USEC_PER_SEC);
+        job->stage = DRD_RDP_ACCEPT_STAGE_DONE;
+        job->outcome = DRD_RDP_ACCEPT_OUTCOME_TIMED_OUT;
+    }
+    else if (job->stage == DRD_RDP_ACCEPT_STAGE_PEEK)
+    {
+        drd_rdp_listener_accept_peek(job);
+        job->peek_us = g_get_monotonic_time() - start;
+    }
+    else
+    {
+        job->keep_open = drd_rdp_listener_connection_keep_open(job->connection);
+        job->session = drd_rdp_listener_prepare_session(job->listener,
+                                                        job->connection,
+                                                        job->peer_name,
+                                                        &job->error);
+        job->setup_us = g_get_monotonic_time() - start;
+        job->stage = job->session != NULL ? DRD_RDP_ACCEPT_STAGE_READY : DRD_RDP_ACCEPT_STAGE_DONE;
+        job->outcome = DRD_RDP_ACCEPT_OUTCOME_FAILED;
+    }
+
+    /* 不用 g_main_context_invoke：主循环未运行时它会在本线程直接执行回调 */
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, drd_rdp_listener_accept_dispatch, job, NULL);
+    g_source_attach(source, job->listener->main_context);
+    g_source_unref(source);
+}
+
+/*
+ * 功能：GSocketService incoming 回调，只做受理与派发。
+ * 逻辑：在途连接达到上限时直接关闭并计入拒绝数；否则登记接入任务，system 模式且有 delegate 时
+ *       先投递窥探阶段，其余直接投递会话建立阶段；窥探、peer 创建与配置都在工作线程完成，主循环不阻塞。
  * 参数：service 套接字服务（监听器自身）；connection 新连接；source_object 未使用。
  * 外部接口：GLib GSocketService 回调机制；日志 DRD_LOG_*。
  */
@@ -1434,43 +1842,46 @@ drd_rdp_listener_incoming(GSocketService *service,
                           GObject *source_object G_GNUC_UNUSED)
 {
     DrdRdpListener *self = DRD_RDP_LISTENER(service);
-    g_autoptr(GError) accept_error = NULL;
-    DRD_LOG_MESSAGE("drd_rdp_listener_incoming");
 
-    if (drd_rdp_listener_is_system_mode(self) && self->delegate_func != NULL)
+    DrdRdpAcceptJob *job = g_new0(DrdRdpAcceptJob, 1);
+    job->listener = g_object_ref(self);
+    job->connection = g_object_ref(connection);
+    job->cancellable = g_cancellable_new();
+    job->peer_name = drd_rdp_listener_describe_connection(connection);
+    job->enqueued_us = g_get_monotonic_time();
+    DRD_LOG_MESSAGE("drd_rdp_listener_incoming from %s", job->peer_name);
+
+    g_mutex_lock(&self->accept_lock);
+    const gboolean admitted = self->accept_jobs->len < self->accept_queue_max;
+    if (admitted)
     {
-        const gboolean handled =
-                self->delegate_func(self, connection, self->delegate_data, &accept_error);
+        g_ptr_array_add(self->accept_jobs, job);
+        self->accept_stats.queue_depth = self->accept_jobs->len;
+        self->accept_stats.max_queue_depth =
+                MAX(self->accept_stats.max_queue_depth, self->accept_stats.queue_depth);
+    }
+    else
+    {
+        self->accept_stats.rejected++;
+    }
+    g_mutex_unlock(&self->accept_lock);
 
-        if (handled)
-        {
-            // 第二次进这里
-            DRD_LOG_MESSAGE("delegate_func run handled");
-            if (accept_error != NULL)
-            {
-                DRD_LOG_WARNING("Delegate reported error while handling connection: %s",
-                                accept_error->message);
-            }
-            return TRUE;
-        }
-        if (accept_error != NULL)
-        {
-            DRD_LOG_WARNING("Delegate failed to process connection: %s", accept_error->message);
-            return TRUE;
-        }
+    if (!admitted)
+    {
+        DRD_LOG_WARNING("Rejecting connection from %s: %u connection(s) already being accepted",
+                        job->peer_name,
+                        self->accept_queue_max);
+        drd_rdp_listener_close_connection(job->connection, FALSE);
+        drd_rdp_listener_accept_job_free(job);
+        return TRUE;
     }
 
-    // 第一次进这里
-    if (!drd_rdp_listener_handle_connection(self, g_object_ref(connection), &accept_error))
+    const DrdRdpAcceptStage stage = drd_rdp_listener_is_system_mode(self) && self->delegate_func != NULL
+                                        ? DRD_RDP_ACCEPT_STAGE_PEEK
+                                        : DRD_RDP_ACCEPT_STAGE_SETUP;
+    if (!drd_rdp_listener_accept_push(self, job, stage))
     {
-        if (accept_error != NULL)
-        {
-            DRD_LOG_WARNING("Failed to handle incoming RDP connection: %s", accept_error->message);
-        }
-        else
-        {
-            DRD_LOG_WARNING("Failed to handle incoming RDP connection");
-        }
+        drd_rdp_listener_accept_job_finish(job);
     }
 
     return TRUE;
@@ -1542,9 +1953,10 @@ drd_rdp_listener_bind(DrdRdpListener *self, GError **error)
 
 /*
  * 功能：内部停止监听器并清理资源。
- * 逻辑：停止 socket service、关闭 listener、清空 session 列表、停止 runtime、取消 cancellable。
+ * 逻辑：停止 socket service、关闭 listener，移除周期统计摘要；取消在途接入任务并等待工作线程退出（已派回主循环的任务随后结算）；
+ *       清空 session 列表（会话引用在锁外释放）、停止 runtime、取消 cancellable。
  * 参数：self 监听器。
- * 外部接口：GLib g_socket_service_stop/g_socket_listener_close，drd_server_runtime_stop 停止流。
+ * 外部接口：GLib g_socket_service_stop/g_socket_listener_close/g_thread_pool_free，drd_server_runtime_stop 停止流。
  */
 static void
 drd_rdp_listener_stop_internal(DrdRdpListener *self)
@@ -1556,7 +1968,29 @@ drd_rdp_listener_stop_internal(DrdRdpListener *self)
         self->is_bound = FALSE;
     }
 
-    g_ptr_array_set_size(self->sessions, 0);
+    if (self->stats_source != NULL)
+    {
+        g_source_destroy(self->stats_source);
+        g_clear_pointer(&self->stats_source, g_source_unref);
+    }
+
+    if (self->accept_pool != NULL)
+    {
+        g_mutex_lock(&self->accept_lock);
+        for (guint i = 0; i < self->accept_jobs->len; ++i)
+        {
+            DrdRdpAcceptJob *job = g_ptr_array_index(self->accept_jobs, i);
+            g_cancellable_cancel(job->cancellable);
+        }
+        g_mutex_unlock(&self->accept_lock);
+        g_thread_pool_free(g_steal_pointer(&self->accept_pool), FALSE, TRUE);
+    }
+
+    g_mutex_lock(&self->sessions_lock);
+    GPtrArray *sessions = g_steal_pointer(&self->sessions);
+    self->sessions = g_ptr_array_new_with_free_func(g_object_unref);
+    g_mutex_unlock(&self->sessions_lock);
+    g_ptr_array_unref(sessions);
 
     if (self->runtime != NULL)
     {
@@ -1570,11 +2004,137 @@ drd_rdp_listener_stop_internal(DrdRdpListener *self)
     }
 }
 
+/*
+ * 功能：把 PAM 耗时直方图的某一分位格式化为所在桶的范围。
+ * 逻辑：按桶累加到不少于 percent% 的样本即取该桶，输出“<上界ms”；落在无上界的最后一桶时输出“>=上一上界ms”，
+ *       尚无样本时输出“n/a”。
+ * 参数：stats 认证线程池统计；percent 分位（1~100）；buf/buf_len 输出缓冲。
+ * 外部接口：drd_auth_pool_latency_bucket_bound_ms。
+ */
+static void
+drd_rdp_listener_format_auth_percentile(const DrdAuthPoolStats *stats, guint percent, gchar *buf, gsize buf_len)
+{
+    guint64 total = 0;
+    for (guint i = 0; i < DRD_AUTH_POOL_LATENCY_BUCKETS; ++i)
+    {
+        total += stats->latency_buckets[i];
+    }
+
+    guint64 seen = 0;
+    for (guint i = 0; i < DRD_AUTH_POOL_LATENCY_BUCKETS && total > 0; ++i)
+    {
+        seen += stats->latency_buckets[i];
+        if (seen * 100 < total * percent)
+        {
+            continue;
+        }
+        if (i + 1 < DRD_AUTH_POOL_LATENCY_BUCKETS)
+        {
+            g_snprintf(buf, buf_len, "<%ums", drd_auth_pool_latency_bucket_bound_ms(i));
+        }
+        else
+        {
+            g_snprintf(buf, buf_len, ">=%ums", drd_auth_pool_latency_bucket_bound_ms(i - 1));
+        }
+        return;
+    }
+    g_strlcpy(buf, "n/a", buf_len);
+}
+
+/*
+ * 功能：周期输出监听器侧的统计摘要。
+ * 逻辑：在主循环定时调用；自上次摘要以来有接入连接结束时输出接入流水线的队列深度、各结果计数与受理耗时；
+ *       有新的认证结束时再输出认证线程池的并发/排队、各结果计数以及 p50/p95 所在桶的上界与最大耗时；
+ *       会话反应器有新的回调时输出线程数、事件源数、本周期回调次数与单次回调最长耗时。
+ * 参数：user_data 监听器。
+ * 外部接口：drd_rdp_listener_get_accept_stats、drd_auth_pool_get_stats、drd_session_reactor_get_stats；日志 DRD_LOG_MESSAGE。
+ * 返回：G_SOURCE_CONTINUE，随监听器停止销毁。
+ */
+static gboolean
+drd_rdp_listener_log_stats(gpointer user_data)
+{
+    DrdRdpListener *self = user_data;
+
+    DrdRdpListenerAcceptStats accept;
+    drd_rdp_listener_get_accept_stats(self, &accept);
+    const guint64 accept_done =
+            accept.accepted + accept.delegated + accept.rejected + accept.timed_out + accept.failed;
+    if (accept_done != self->stats_accept_seen)
+    {
+        self->stats_accept_seen = accept_done;
+        DRD_LOG_MESSAGE("Accept pipeline summary: workers=%u depth=%u/%u peak=%u accepted=%" G_GUINT64_FORMAT
+                        " delegated=%" G_GUINT64_FORMAT " rejected=%" G_GUINT64_FORMAT " timed_out=%" G_GUINT64_FORMAT
+                        " failed=%" G_GUINT64_FORMAT " avg=%.1f ms max=%.1f ms",
+                        self->accept_workers,
+                        accept.queue_depth,
+                        self->accept_queue_max,
+                        accept.max_queue_depth,
+                        accept.accepted,
+                        accept.delegated,
+                        accept.rejected,
+                        accept.timed_out,
+                        accept.failed,
+                        accept.avg_accept_us / 1000.0,
+                        accept.max_accept_us / 1000.0);
+    }
+
+    if (self->runtime == NULL)
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    DrdAuthPoolStats auth;
+    drd_auth_pool_get_stats(drd_server_runtime_get_auth_pool(self->runtime), &auth);
+    const guint64 auth_done = auth.succeeded + auth.failed + auth.rejected + auth.timed_out + auth.abandoned;
+    if (auth_done != self->stats_auth_seen)
+    {
+        self->stats_auth_seen = auth_done;
+        gchar p50[16];
+        gchar p95[16];
+        drd_rdp_listener_format_auth_percentile(&auth, 50, p50, sizeof(p50));
+        drd_rdp_listener_format_auth_percentile(&auth, 95, p95, sizeof(p95));
+        DRD_LOG_MESSAGE("Auth pool summary: workers=%u running=%u queued=%u succeeded=%" G_GUINT64_FORMAT
+                        " failed=%" G_GUINT64_FORMAT " rejected=%" G_GUINT64_FORMAT " timed_out=%" G_GUINT64_FORMAT
+                        " abandoned=%" G_GUINT64_FORMAT " p50%s p95%s max=%.1f ms",
+                        auth.workers,
+                        auth.running,
+                        auth.queued,
+                        auth.succeeded,
+                        auth.failed,
+                        auth.rejected,
+                        auth.timed_out,
+                        auth.abandoned,
+                        p50,
+                        p95,
+                        auth.max_latency_us / 1000.0);
+    }
+
+    DrdSessionReactor *reactor = drd_server_runtime_get_session_reactor(self->runtime);
+    if (reactor != NULL)
+    {
+        DrdSessionReactorStats events;
+        drd_session_reactor_get_stats(reactor, &events);
+        if (events.dispatches != self->stats_reactor_seen)
+        {
+            DRD_LOG_MESSAGE("Session reactor summary: threads=%u sources=%u dispatches=%" G_GUINT64_FORMAT
+                            " (+%" G_GUINT64_FORMAT ") max_dispatch=%.1f ms",
+                            events.threads,
+                            events.sources,
+                            events.dispatches,
+                            events.dispatches - self->stats_reactor_seen,
+                            events.max_dispatch_us / 1000.0);
+            self->stats_reactor_seen = events.dispatches;
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
 /*
  * 功能：启动监听器，绑定端口并激活 socket service。
- * 逻辑：调用 bind，必要时创建 cancellable（system 模式），最后启动服务并记录日志。
+ * 逻辑：记录当前主循环并创建接入线程池，调用 bind，必要时创建 cancellable（system 模式），最后启动服务、
+ *       在主循环挂上周期统计摘要并记录日志。
  * 参数：self 监听器；error 输出错误。
- * 外部接口：GLib g_socket_service_start。
+ * 外部接口：GLib g_main_context_ref_thread_default/g_thread_pool_new/g_socket_service_start/g_timeout_source_new_seconds。
  */
 gboolean
 drd_rdp_listener_start(DrdRdpListener *self, GError **error)
@@ -1585,6 +2145,24 @@ drd_rdp_listener_start(DrdRdpListener *self, GError **error)
                     self->bind_address != NULL ? self->bind_address : "0.0.0.0",
                     self->port);
 
+    if (self->main_context == NULL)
+    {
+        self->main_context = g_main_context_ref_thread_default();
+    }
+
+    if (self->accept_pool == NULL)
+    {
+        self->accept_pool = g_thread_pool_new(drd_rdp_listener_accept_worker,
+                                              NULL,
+                                              (gint) self->accept_workers,
+                                              FALSE,
+                                              error);
+        if (self->accept_pool == NULL)
+        {
+            return FALSE;
+        }
+    }
+
     if (!drd_rdp_listener_bind(self, error))
     {
         DRD_LOG_CRITICAL("Failed to bind RDP listener on %s:%u - %s",
@@ -1601,6 +2179,12 @@ drd_rdp_listener_start(DrdRdpListener *self, GError **error)
     }
 
     g_socket_service_start(G_SOCKET_SERVICE(self));
+    if (self->stats_source == NULL)
+    {
+        self->stats_source = g_timeout_source_new_seconds(DRD_RDP_LISTENER_STATS_INTERVAL_SEC);
+        g_source_set_callback(self->stats_source, drd_rdp_listener_log_stats, self, NULL);
+        g_source_attach(self->stats_source, self->main_context);
+    }
     DRD_LOG_MESSAGE("Socket service successfully started on %s:%u",
                     self->bind_address != NULL ? self->bind_address : "0.0.0.0",
                     self->port);
@@ -1608,6 +2192,58 @@ drd_rdp_listener_start(DrdRdpListener *self, GError **error)
     return TRUE;
 }
 
+/*
+ * 功能：设置接入流水线的线程数、在途上限与各阶段超时。
+ * 逻辑：须在 start 之前调用（线程池在 start 时按 workers 创建）；各值为 0 时保留默认值。
+ * 参数：self 监听器；workers 工作线程数；queue_max 在途连接上限；queue_timeout_ms 排队等待上限；
+ *       peek_timeout_ms 路由令牌窥探上限。
+ * 外部接口：无。
+ */
+void
+drd_rdp_listener_set_accept_limits(DrdRdpListener *self,
+                                   guint workers,
+                                   guint queue_max,
+                                   guint queue_timeout_ms,
+                                   guint peek_timeout_ms)
+{
+    g_return_if_fail(DRD_IS_RDP_LISTENER(self));
+    g_return_if_fail(self->accept_pool == NULL);
+
+    if (workers > 0)
+    {
+        self->accept_workers = workers;
+    }
+    if (queue_max > 0)
+    {
+        self->accept_queue_max = queue_max;
+    }
+    if (queue_timeout_ms > 0)
+    {
+        self->accept_queue_timeout_us = (gint64) queue_timeout_ms * G_TIME_SPAN_MILLISECOND;
+    }
+    if (peek_timeout_ms > 0)
+    {
+        self->peek_timeout_ms = peek_timeout_ms;
+    }
+}
+
+/*
+ * 功能：读取接入流水线统计。
+ * 逻辑：持锁复制当前快照。
+ * 参数：self 监听器；out_stats 输出统计。
+ * 外部接口：GLib g_mutex_lock/unlock。
+ */
+void
+drd_rdp_listener_get_accept_stats(DrdRdpListener *self, DrdRdpListenerAcceptStats *out_stats)
+{
+    g_return_if_fail(DRD_IS_RDP_LISTENER(self));
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&self->accept_lock);
+    *out_stats = self->accept_stats;
+    g_mutex_unlock(&self->accept_lock);
+}
+
 /*
  * 功能：停止监听器（公开接口）。
  * 逻辑：调用内部 stop 清理绑定与 runtime。
@@ -1671,16 +2307,17 @@ drd_rdp_listener_adopt_connection(DrdRdpListener *self,
 }
 
 /*
- * 功能：在 TLS-only 模式下使用 PAM 验证客户端凭据并生成本地会话。
- * 逻辑：读取 FreeRDP settings 中的用户名/密码/域，调用 drd_local_session_new 进行 PAM 认证，
- *       成功后附加到会话并清空密码；失败时记录警告。
+ * 功能：在 TLS-only 模式下发起 PAM 凭据校验。
+ * 逻辑：读取 FreeRDP settings 中的用户名/密码/域，交给会话提交到运行时的认证线程池后清空密码；
+ *       PAM 不在事件处理方上执行，结果由会话收取并附加本地会话。排队已满时记录警告并拒绝。
  * 参数：ctx peer 上下文；client FreeRDP peer。
- * 外部接口：drd_local_session_new 进行 PAM/NSS 登录；freerdp_settings_get_string 读取凭据。
+ * 外部接口：drd_rdp_session_begin_authentication、drd_server_runtime_get_auth_pool；freerdp_settings_get_string 读取凭据。
+ * 返回：认证已排队返回 TRUE。
  */
 static gboolean
 drd_rdp_listener_authenticate_tls_login(DrdRdpPeerContext *ctx, freerdp_peer *client)
 {
-    if (ctx == NULL || ctx->session == NULL || ctx->listener == NULL || client == NULL ||
+    if (ctx == NULL || ctx->session == NULL || ctx->listener == NULL || ctx->runtime == NULL || client == NULL ||
         client->context == NULL || client->context->settings == NULL)
     {
         return FALSE;
@@ -1697,37 +2334,38 @@ drd_rdp_listener_authenticate_tls_login(DrdRdpPeerContext *ctx, freerdp_peer *cl
     }
 
     g_autoptr(GError) auth_error = NULL;
-    DrdLocalSession *local_session =
-            drd_local_session_new(ctx->listener->pam_service,
-                                  username,
-                                  domain,
-                                  password,
-                                  client->hostname,
-                                  &auth_error);
+    const gboolean queued =
+            drd_rdp_session_begin_authentication(ctx->session,
+                                                 drd_server_runtime_get_auth_pool(ctx->runtime),
+                                                 ctx->listener->pam_service,
+                                                 username,
+                                                 domain,
+                                                 password,
+                                                 client->hostname,
+                                                 &auth_error);
 
     if (password != NULL)
     {
         freerdp_settings_set_string(settings, FreeRDP_Password, "");
     }
 
-    if (local_session == NULL)
+    if (!queued)
     {
         if (auth_error != NULL)
         {
-            DRD_LOG_WARNING("Peer %s TLS/PAM single sign-on failure for %s: %s",
+            DRD_LOG_WARNING("Peer %s TLS/PAM single sign-on rejected for %s: %s",
                             client->hostname,
                             username,
                             auth_error->message);
         }
         else
         {
-            DRD_LOG_WARNING("Peer %s TLS/PAM single sign-on failure for %s", client->hostname, username);
+            DRD_LOG_WARNING("Peer %s TLS/PAM single sign-on rejected for %s", client->hostname, username);
         }
         return FALSE;
     }
 
-    drd_rdp_session_attach_local_session(ctx->session, local_session);
-    DRD_LOG_MESSAGE("Peer %s TLS/PAM single sign-on accepted for %s", client->hostname, username);
+    DRD_LOG_MESSAGE("Peer %s TLS/PAM single sign-on queued for %s", client->hostname, username);
     return TRUE;
 }
 
@@ -3,6 +3,7 @@
 #include <gio/gio.h>
 
 #include "core/drd_config.h"
+#include "transport/drd_rdp_routing_token.h"
 
 typedef struct _DrdServerRuntime DrdServerRuntime;
 
@@ -13,8 +14,10 @@ G_DECLARE_FINAL_TYPE(DrdRdpListener, drd_rdp_listener, DRD, RDP_LISTENER, GSocke
 
 typedef struct _DrdRdpSession DrdRdpSession;
 
+/* 在主循环调用；routing 为接入工作线程已窥探到的路由令牌信息，回调可复制其内容但不持有 */
 typedef gboolean (*DrdRdpListenerDelegateFunc)(DrdRdpListener *listener,
                                                GSocketConnection *connection,
+                                               const DrdRoutingTokenInfo *routing,
                                                gpointer user_data,
                                                GError **error);
 typedef void (*DrdRdpListenerSessionFunc)(DrdRdpListener *listener,
@@ -22,6 +25,20 @@ typedef void (*DrdRdpListenerSessionFunc)(DrdRdpListener *listener,
                                           GSocketConnection *connection,
                                           gpointer user_data);
 
+/* 接入流水线统计，时长单位为微秒 */
+typedef struct
+{
+    guint queue_depth;      /* 已受理、尚未结束的连接数 */
+    guint max_queue_depth;  /* 队列深度峰值 */
+    guint64 accepted;       /* 建立会话的连接数 */
+    guint64 delegated;      /* 交由 delegate 接管的连接数 */
+    guint64 rejected;       /* 队列已满被拒绝的连接数 */
+    guint64 timed_out;      /* 排队或窥探超时的连接数 */
+    guint64 failed;         /* 其余失败的连接数 */
+    gint64 avg_accept_us;   /* 受理到结束的平均时长（成功的连接） */
+    gint64 max_accept_us;   /* 受理到结束的最长时长（成功的连接） */
+} DrdRdpListenerAcceptStats;
+
 DrdRdpListener *drd_rdp_listener_new(const gchar *bind_address,
                                      guint16 port,
                                      DrdServerRuntime *runtime,
@@ -31,6 +48,11 @@ DrdRdpListener *drd_rdp_listener_new(const gchar *bind_address,
                                      const gchar *nla_password,
                                      const gchar *pam_service,
                                      DrdRuntimeMode runtime_mode);
+void drd_rdp_listener_set_accept_limits(DrdRdpListener *self,
+                                        guint workers,
+                                        guint queue_max,
+                                        guint queue_timeout_ms,
+                                        guint peek_timeout_ms);
 gboolean drd_rdp_listener_start(DrdRdpListener *self, GError **error);
 void drd_rdp_listener_stop(DrdRdpListener *self);
 DrdServerRuntime *drd_rdp_listener_get_runtime(DrdRdpListener *self);
@@ -45,5 +67,6 @@ void drd_rdp_listener_set_session_callback(DrdRdpListener *self,
                                            gpointer user_data);
 
 gboolean drd_rdp_listener_is_handover_mode(DrdRdpListener *self);
+void drd_rdp_listener_get_accept_stats(DrdRdpListener *self, DrdRdpListenerAcceptStats *out_stats);
 
 G_END_DECLS
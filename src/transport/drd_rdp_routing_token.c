@@ -15,7 +15,6 @@
 #endif
 
 #define DRD_ROUTING_TOKEN_PREFIX "Cookie: msts="
-#define DRD_ROUTING_TOKEN_PEEK_TIMEOUT_MS (2 * 1000)
 
 struct _DrdRoutingTokenInfo
 {
@@ -59,99 +58,99 @@ typedef struct
     GCancellable *cancellable;
 } DrdRoutingTokenPeekContext;
 
-static void
-wstream_free_full(wStream * s);
+/* TPKT 头长度，足以读出整个 x224Crq PDU 的长度 */
+#define DRD_ROUTING_TOKEN_TPKT_HEADER_LENGTH 4
+/* 可读通知后窥探不到新数据（虚假唤醒、水位未生效）时的退避，避免等待循环空转 */
+#define DRD_ROUTING_TOKEN_SHORT_PEEK_BACKOFF_MS 10
 
-G_DEFINE_AUTOPTR_CLEANUP_FUNC(wStream, wstream_free_full)
+typedef enum
+{
+    DRD_ROUTING_TOKEN_PARSE_NEED_MORE,
+    DRD_ROUTING_TOKEN_PARSE_DONE,
+    DRD_ROUTING_TOKEN_PARSE_ERROR
+} DrdRoutingTokenParseResult;
 
 /*
- * 功能：释放 WinPR wStream 并释放底层缓冲。
- * 逻辑：调用 Stream_Free，传 TRUE 表示释放内部分配的缓冲。
- * 参数：s 待释放的 wStream。
- * 外部接口：WinPR Stream_Free。
+ * 功能：设置 socket 的可读水位。
+ * 逻辑：SO_RCVLOWAT 设为 bytes 后，poll 只在接收缓冲达到该字节数（或对端关闭/出错）时报告可读。
+ * 参数：fd 套接字；bytes 水位字节数。
+ * 外部接口：POSIX setsockopt。
+ * 返回：设置成功返回 TRUE。
  */
-static void
-wstream_free_full(wStream *s)
+static gboolean
+drd_routing_token_set_rcvlowat(int fd, int bytes)
 {
-    Stream_Free(s, TRUE);
+    return setsockopt(fd, SOL_SOCKET, SO_RCVLOWAT, &bytes, sizeof(bytes)) == 0;
 }
 
-#define MAX_PEEK_TIME_MS 2000
+/*
+ * 功能：计算距截止时间的剩余毫秒数。
+ * 逻辑：deadline 为 0 表示不限，返回 -1；否则向上取整到毫秒，已到期时设置超时错误。
+ * 参数：deadline 单调时钟截止时间（微秒）；timeout_ms 总时限，仅用于错误信息；out_remaining_ms 输出剩余毫秒；error 错误输出。
+ * 外部接口：GLib g_get_monotonic_time。
+ * 返回：未到期返回 TRUE。
+ */
+static gboolean
+drd_routing_token_remaining_ms(gint64 deadline, guint timeout_ms, gint *out_remaining_ms, GError **error)
+{
+    if (deadline == 0)
+    {
+        *out_remaining_ms = -1;
+        return TRUE;
+    }
+
+    const gint64 remaining = deadline - g_get_monotonic_time();
+    if (remaining <= 0)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                    "No routing token within %u ms", timeout_ms);
+        return FALSE;
+    }
+    *out_remaining_ms = (gint) MIN((remaining + 999) / 1000, G_MAXINT);
+    return TRUE;
+}
 
 /*
- * 功能：在不消费 socket 数据的情况下读取指定字节数（MSG_PEEK）。
- * 逻辑：使用 g_poll 等待可读或取消事件，随后调用 recv(MSG_PEEK) 获取数据，支持 EINTR/EAGAIN 重试。
- * 参数：fd 套接字；buffer 目标缓存；length 读取长度；cancellable 取消源；error 错误输出。
- * 外部接口：POSIX poll/recv，GLib g_cancellable_* 管理取消。
+ * 功能：等待 socket 可读或取消事件。
+ * 逻辑：同时 poll 套接字与 cancellable 的 fd，至多等待 timeout_ms；fd 传 -1 时 poll 忽略该项，仅按 timeout_ms 退避。
+ * 参数：fd 套接字或 -1；timeout_ms poll 超时，-1 表示不限；cancellable 取消源；error 错误输出。
+ * 外部接口：GLib g_poll/g_cancellable_make_pollfd/g_cancellable_set_error_if_cancelled。
  */
 static gboolean
-peek_bytes(int fd,
-           uint8_t *buffer,
-           int length,
-           GCancellable *cancellable,
-           GError **error)
+drd_routing_token_wait(int fd,
+                       gint timeout_ms,
+                       GCancellable *cancellable,
+                       GError **error)
 {
     GPollFD poll_fds[2] = {};
-    int n_fds = 0;
     int ret;
 
-    poll_fds[n_fds].fd = fd;
-    poll_fds[n_fds].events = G_IO_IN;
-    n_fds++;
+    poll_fds[0].fd = fd;
+    poll_fds[0].events = G_IO_IN;
 
-    if (!g_cancellable_make_pollfd(cancellable, &poll_fds[n_fds]))
+    if (!g_cancellable_make_pollfd(cancellable, &poll_fds[1]))
     {
         g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
                     "Failure preparing the cancellable for pollfd");
         return FALSE;
     }
 
-    n_fds++;
-
     do
-    {
-        do
-            ret = g_poll(poll_fds, n_fds, MAX_PEEK_TIME_MS);
-        while (ret == -1 && errno == EINTR);
-
-        if (ret == -1)
-        {
-            g_set_error(error, G_IO_ERROR,
-                        g_io_error_from_errno(errno),
-                        "On poll command: %s", strerror(errno));
-            g_cancellable_release_fd(cancellable);
-            return FALSE;
-        }
-
-        if (g_cancellable_is_cancelled(cancellable))
-        {
-            g_set_error(error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
-                        "Cancelled");
-            g_cancellable_release_fd(cancellable);
-            return FALSE;
-        }
-
-        do
-            ret = recv(fd, (void *) buffer, (size_t) length, MSG_PEEK);
-        while (ret == -1 && errno == EINTR);
+        ret = g_poll(poll_fds, G_N_ELEMENTS(poll_fds), timeout_ms);
+    while (ret == -1 && errno == EINTR);
 
-        if (ret == -1)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-                continue;
+    const int saved_errno = errno;
+    g_cancellable_release_fd(cancellable);
 
-            g_set_error(error, G_IO_ERROR,
-                        g_io_error_from_errno(errno),
-                        "On recv command: %s", strerror(errno));
-            g_cancellable_release_fd(cancellable);
-            return FALSE;
-        }
+    if (ret == -1)
+    {
+        g_set_error(error, G_IO_ERROR,
+                    g_io_error_from_errno(saved_errno),
+                    "On poll command: %s", strerror(saved_errno));
+        return FALSE;
     }
-    while (ret < length);
 
-    g_cancellable_release_fd(cancellable);
-
-    return TRUE;
+    return !g_cancellable_set_error_if_cancelled(cancellable, error);
 }
 
 /*
@@ -212,41 +211,23 @@ get_routing_token_without_prefix(char *buffer,
 
 
 /*
- * 功能：窥探 RDP TPKT/X224 握手头，提取路由令牌及 RDSTLS 请求信息。
- * 逻辑：MSG_PEEK 首 4 字节解析 TPKT 长度；再 peek 全部 PDU 验证 x224 CRQ 与 rdpNegReq，
+ * 功能：按已窥探到的字节增量解析 TPKT/X224 连接请求，提取路由令牌及 RDSTLS 请求信息。
+ * 逻辑：先由 4 字节 TPKT 头得出 PDU 总长度，数据不足时输出所需字节数；数据齐全后验证 x224 CRQ 与 rdpNegReq，
  *       解析前缀为 Cookie: msts= 的 routing token，并检查是否请求 RDSTLS 协议。
- * 参数：connection GLib socket 连接；cancellable 可取消对象；info 输出路由令牌信息；error 错误输出。
- * 外部接口：WinPR Stream_* 操作缓冲，FreeRDP 常量 PROTOCOL_RDSTLS；GLib g_socket_get_fd 获取 fd。
+ * 参数：data 已窥探的数据（至少 TPKT 头长度）；length 数据长度；info 输出路由令牌信息；
+ *       needed 输出所需的总字节数；error 错误输出。
+ * 外部接口：WinPR Stream_* 操作缓冲，FreeRDP 常量 PROTOCOL_RDSTLS。
  */
-gboolean
-drd_routing_token_peek(GSocketConnection *connection,
-                       GCancellable *cancellable,
-                       DrdRoutingTokenInfo *info,
-                       GError **error)
+static DrdRoutingTokenParseResult
+drd_routing_token_parse(const uint8_t *data,
+                        gsize length,
+                        DrdRoutingTokenInfo *info,
+                        gsize *needed,
+                        GError **error)
 {
-    g_return_val_if_fail(G_IS_SOCKET_CONNECTION(connection), FALSE);
-    g_return_val_if_fail(info != NULL, FALSE);
-
-    GSocket *socket = g_socket_connection_get_socket(connection);
-    if (!G_IS_SOCKET(socket))
-    {
-        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Socket unavailable for routing token peek");
-        return FALSE;
-    }
-
-
     // copy form grd
-    g_autoptr(wStream)
-    stream = Stream_New(NULL, 4);
-    if (stream == NULL)
-    {
-        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to allocate stream");
-        return FALSE;
-    }
-
-    int fd = g_socket_get_fd(socket);
-    if (!peek_bytes(fd, Stream_Buffer(stream), 4, cancellable, error))
-        return FALSE;
+    wStream static_stream;
+    wStream *stream = Stream_StaticConstInit(&static_stream, data, length);
 
     /* TPKT values */
     uint8_t version;
@@ -259,24 +240,20 @@ drd_routing_token_peek(GSocketConnection *connection,
     {
         g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
                     "The TPKT Header doesn't have version 3");
-        return FALSE;
+        return DRD_ROUTING_TOKEN_PARSE_ERROR;
     }
     if (tpkt_length < 4 + 7)
     {
         g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
                     "The x224Crq TPDU length is too short");
-        return FALSE;
+        return DRD_ROUTING_TOKEN_PARSE_ERROR;
     }
-    /* Peek full PDU */
-    Stream_Free(stream, TRUE);
-    stream = Stream_New(NULL, tpkt_length);
-    g_assert(stream);
-
-    if (!peek_bytes(fd, Stream_Buffer(stream), tpkt_length, cancellable, error))
-        return FALSE;
-
-    Stream_Seek(stream, 4);
-
+    if (length < tpkt_length)
+    {
+        *needed = tpkt_length;
+        return DRD_ROUTING_TOKEN_PARSE_NEED_MORE;
+    }
+    Stream_SetLength(stream, tpkt_length);
 
     /* Check x224Crq */
     uint8_t length_indicator;
@@ -295,7 +272,7 @@ drd_routing_token_peek(GSocketConnection *connection,
     {
         g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
                     "Wrong info on x224Crq");
-        return FALSE;
+        return DRD_ROUTING_TOKEN_PARSE_ERROR;
     }
 
     int routing_token_length;
@@ -304,12 +281,12 @@ drd_routing_token_peek(GSocketConnection *connection,
                                                            Stream_GetRemainingLength(stream),
                                                            &routing_token_length);
     if (!info->routing_token)
-        return TRUE;
+        return DRD_ROUTING_TOKEN_PARSE_DONE;
 
     /* Check rdpNegReq */
     Stream_Seek(stream, routing_token_length + 2);
     if (Stream_GetRemainingLength(stream) < 8)
-        return TRUE;
+        return DRD_ROUTING_TOKEN_PARSE_DONE;
 
     /* rdpNegReq values */
     uint8_t rdp_neg_type;
@@ -323,13 +300,116 @@ drd_routing_token_peek(GSocketConnection *connection,
     {
         g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
                     "Wrong info on rdpNegReq");
-        return FALSE;
+        return DRD_ROUTING_TOKEN_PARSE_ERROR;
     }
 
     info->requested_rdstls = !!(requested_protocols & PROTOCOL_RDSTLS);
 
     // end grd copy
 
+    return DRD_ROUTING_TOKEN_PARSE_DONE;
+}
 
-    return TRUE;
+/*
+ * 功能：窥探 RDP TPKT/X224 握手头，提取路由令牌及 RDSTLS 请求信息。
+ * 逻辑：以 MSG_PEEK 读取、不消费数据，FreeRDP 随后仍从头读取完整握手。每轮把 SO_RCVLOWAT 设为当前所需字节数
+ *       （先是 TPKT 头，再是整个 PDU），poll 只在数据凑齐时唤醒，慢速发送方不占 CPU；
+ *       凑齐后一次窥探交给增量解析器，最多两轮。每次 poll 只等待剩余时限；窥探到的数据不足但比上次多时，
+ *       直接回到 poll 按剩余时限等待 POLLIN；只有 EAGAIN 或字节数没有增长（虚假唤醒、水位未生效）时才退避一小段
+ *       再重新 poll，不会在 recv 上空转。结束后恢复默认水位。
+ * 参数：connection GLib socket 连接；timeout_ms 总时限，0 表示不限（仅靠取消 cancellable 结束）；cancellable 可取消对象；
+ *       info 输出路由令牌信息；error 错误输出，到期为 G_IO_ERROR_TIMED_OUT。
+ * 外部接口：POSIX recv(MSG_PEEK)/setsockopt；GLib g_socket_get_fd/g_get_monotonic_time；内部 drd_routing_token_parse。
+ */
+gboolean
+drd_routing_token_peek(GSocketConnection *connection,
+                       guint timeout_ms,
+                       GCancellable *cancellable,
+                       DrdRoutingTokenInfo *info,
+                       GError **error)
+{
+    g_return_val_if_fail(G_IS_SOCKET_CONNECTION(connection), FALSE);
+    g_return_val_if_fail(info != NULL, FALSE);
+
+    GSocket *socket = g_socket_connection_get_socket(connection);
+    if (!G_IS_SOCKET(socket))
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "Socket unavailable for routing token peek");
+        return FALSE;
+    }
+
+    const int fd = g_socket_get_fd(socket);
+    const gint64 deadline = timeout_ms > 0 ? g_get_monotonic_time() + (gint64) timeout_ms * G_TIME_SPAN_MILLISECOND : 0;
+    gsize needed = DRD_ROUTING_TOKEN_TPKT_HEADER_LENGTH;
+    gint remaining_ms = -1;
+    g_autofree uint8_t *buffer = NULL;
+    gsize capacity = 0;
+    gsize peeked = 0;
+    gboolean parsed = FALSE;
+
+    for (;;)
+    {
+        if (capacity < needed)
+        {
+            buffer = g_realloc(buffer, needed);
+            capacity = needed;
+        }
+
+        drd_routing_token_set_rcvlowat(fd, (int) needed);
+        if (!drd_routing_token_remaining_ms(deadline, timeout_ms, &remaining_ms, error) ||
+            !drd_routing_token_wait(fd, remaining_ms, cancellable, error))
+        {
+            break;
+        }
+
+        ssize_t ret;
+        do
+            ret = recv(fd, (void *) buffer, needed, MSG_PEEK | MSG_DONTWAIT);
+        while (ret == -1 && errno == EINTR);
+
+        if (ret == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            g_set_error(error, G_IO_ERROR,
+                        g_io_error_from_errno(errno),
+                        "On recv command: %s", strerror(errno));
+            break;
+        }
+        if (ret == 0)
+        {
+            g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED,
+                                "Connection closed before the x224 connection request");
+            break;
+        }
+        if (ret > 0 && (gsize) ret < needed && (gsize) ret > peeked)
+        {
+            /* 数据仍在到达：回到循环开头按剩余时限等待 POLLIN，不额外退避 */
+            peeked = (gsize) ret;
+            continue;
+        }
+        if (ret == -1 || (gsize) ret < needed)
+        {
+            /* poll 已超时、虚假唤醒或水位未生效，没有新数据：退避后回到循环开头按剩余时限重新 poll */
+            if (!drd_routing_token_remaining_ms(deadline, timeout_ms, &remaining_ms, error) ||
+                !drd_routing_token_wait(-1,
+                                        remaining_ms < 0 ? DRD_ROUTING_TOKEN_SHORT_PEEK_BACKOFF_MS
+                                                         : MIN(remaining_ms, DRD_ROUTING_TOKEN_SHORT_PEEK_BACKOFF_MS),
+                                        cancellable,
+                                        error))
+            {
+                break;
+            }
+            continue;
+        }
+
+        const DrdRoutingTokenParseResult result =
+                drd_routing_token_parse(buffer, needed, info, &needed, error);
+        if (result != DRD_ROUTING_TOKEN_PARSE_NEED_MORE)
+        {
+            parsed = result == DRD_ROUTING_TOKEN_PARSE_DONE;
+            break;
+        }
+    }
+
+    drd_routing_token_set_rcvlowat(fd, 1);
+    return parsed;
 }
@@ -16,6 +16,7 @@ DrdRoutingTokenInfo *drd_routing_token_info_new(void);
 void drd_routing_token_info_free(DrdRoutingTokenInfo *info);
 
 gboolean drd_routing_token_peek(GSocketConnection *connection,
+                                guint timeout_ms,
                                 GCancellable *cancellable,
                                 DrdRoutingTokenInfo *info,
                                 GError **error);
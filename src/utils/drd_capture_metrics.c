@@ -6,6 +6,8 @@ static gsize metrics_init_once = 0;
 static guint cached_target_fps = 60;
 static gint64 cached_target_interval_us = G_USEC_PER_SEC / 60;
 static gint64 cached_stats_interval_us = (gint64) 5 * G_USEC_PER_SEC;
+static gboolean cached_adaptive_fps = TRUE;
+static guint cached_min_fps = 5;
 
 /*
  * 功能：将配置层提供的帧率与统计窗口写入缓存，带上边界保护。
@@ -88,3 +90,45 @@ drd_capture_metrics_get_stats_interval_us(void)
      */
     return cached_stats_interval_us;
 }
+
+/*
+ * 功能：写入会话自适应帧率配置。
+ * 逻辑：min_fps 为 0 时回落默认 5，并限制不超过当前 target_fps。
+ * 参数：adaptive_fps 是否启用会话帧率调节；min_fps 允许下调到的最低帧率。
+ * 外部接口：无，供配置初始化阶段在 drd_capture_metrics_apply_config 之后调用。
+ */
+void
+drd_capture_metrics_apply_adaptive_config(gboolean adaptive_fps, guint min_fps)
+{
+    if (min_fps == 0)
+    {
+        min_fps = 5;
+    }
+
+    cached_adaptive_fps = adaptive_fps;
+    cached_min_fps = MIN(min_fps, cached_target_fps);
+}
+
+gboolean
+drd_capture_metrics_get_adaptive_fps(void)
+{
+    /*
+     * 功能：查询是否启用会话自适应帧率。
+     * 逻辑：返回配置缓存，默认启用。
+     * 参数：无。
+     * 外部接口：无。
+     */
+    return cached_adaptive_fps;
+}
+
+guint
+drd_capture_metrics_get_min_fps(void)
+{
+    /*
+     * 功能：获取自适应帧率下限。
+     * 逻辑：返回配置缓存，默认 5。
+     * 参数：无。
+     * 外部接口：无。
+     */
+    return cached_min_fps;
+}
@@ -7,7 +7,10 @@
  * 目标帧率/统计窗口从 config 读取，省去环境变量依赖，便于统一配置管理。
  */
 void drd_capture_metrics_apply_config(guint target_fps, guint stats_interval_sec);
+void drd_capture_metrics_apply_adaptive_config(gboolean adaptive_fps, guint min_fps);
 
 guint drd_capture_metrics_get_target_fps(void);
 gint64 drd_capture_metrics_get_target_interval_us(void);
 gint64 drd_capture_metrics_get_stats_interval_us(void);
+gboolean drd_capture_metrics_get_adaptive_fps(void);
+guint drd_capture_metrics_get_min_fps(void);
@@ -0,0 +1,273 @@
+#include "utils/drd_dirty_map.h"
+
+#include <string.h>
+
+#define DRD_DIRTY_MAP_WORD_BITS 64u
+
+struct _DrdDirtyMap
+{
+    guint tiles_x;
+    guint tiles_y;
+    guint words_per_row;
+    gsize capacity; /* words 已分配的字数，几何缩小时保留 */
+    guint64 *words;
+};
+
+/*
+ * 功能：创建空的脏块位图。
+ * 逻辑：几何为 0，首次 drd_dirty_map_reset 时分配位存储。
+ * 参数：无。
+ * 外部接口：GLib g_new0。
+ */
+DrdDirtyMap *
+drd_dirty_map_new(void)
+{
+    return g_new0(DrdDirtyMap, 1);
+}
+
+/*
+ * 功能：释放脏块位图。
+ * 逻辑：释放位存储与结构体。
+ * 参数：self 位图，可为 NULL。
+ * 外部接口：GLib g_free。
+ */
+void
+drd_dirty_map_free(DrdDirtyMap *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    g_free(self->words);
+    g_free(self);
+}
+
+/*
+ * 功能：按 tile 网格重置位图并清空全部标记。
+ * 逻辑：每行按 64 位对齐；容量不足时扩容，足够时只清零，几何不变的稳态帧不分配内存。
+ * 参数：self 位图；tiles_x/tiles_y tile 列数与行数。
+ * 外部接口：GLib g_free/g_new0。
+ * 返回：本次是否重新分配了位存储，供调用方计入分配统计。
+ */
+gboolean
+drd_dirty_map_reset(DrdDirtyMap *self, guint tiles_x, guint tiles_y)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+    g_return_val_if_fail(tiles_x <= G_MAXUINT16 && tiles_y <= G_MAXUINT16, FALSE);
+
+    const guint words_per_row = (tiles_x + DRD_DIRTY_MAP_WORD_BITS - 1) / DRD_DIRTY_MAP_WORD_BITS;
+    const gsize words = (gsize) words_per_row * tiles_y;
+    gboolean grown = FALSE;
+
+    if (words > self->capacity)
+    {
+        g_free(self->words);
+        self->words = g_new0(guint64, words);
+        self->capacity = words;
+        grown = TRUE;
+    }
+
+    self->tiles_x = tiles_x;
+    self->tiles_y = tiles_y;
+    self->words_per_row = words_per_row;
+    drd_dirty_map_clear(self);
+    return grown;
+}
+
+/*
+ * 功能：清空全部脏块标记，几何保持不变。
+ * 逻辑：对当前几何覆盖的字清零。
+ * 参数：self 位图。
+ * 外部接口：C 标准库 memset。
+ */
+void
+drd_dirty_map_clear(DrdDirtyMap *self)
+{
+    g_return_if_fail(self != NULL);
+
+    if (self->words != NULL)
+    {
+        memset(self->words, 0, (gsize) self->words_per_row * self->tiles_y * sizeof(guint64));
+    }
+}
+
+guint
+drd_dirty_map_get_tiles_x(const DrdDirtyMap *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+
+    return self->tiles_x;
+}
+
+guint
+drd_dirty_map_get_tiles_y(const DrdDirtyMap *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+
+    return self->tiles_y;
+}
+
+/*
+ * 功能：标记一个 tile 为脏。
+ * 逻辑：定位所在行的字与位后置位。
+ * 参数：self 位图；x/y tile 坐标。
+ * 外部接口：无。
+ */
+void
+drd_dirty_map_set(DrdDirtyMap *self, guint x, guint y)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(x < self->tiles_x && y < self->tiles_y);
+
+    guint64 *row = self->words + (gsize) y * self->words_per_row;
+    row[x / DRD_DIRTY_MAP_WORD_BITS] |= G_GUINT64_CONSTANT(1) << (x % DRD_DIRTY_MAP_WORD_BITS);
+}
+
+/*
+ * 功能：查询一个 tile 是否为脏。
+ * 逻辑：越界坐标视为干净，便于合并时探测边界。
+ * 参数：self 位图；x/y tile 坐标。
+ * 外部接口：无。
+ */
+gboolean
+drd_dirty_map_test(const DrdDirtyMap *self, guint x, guint y)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+
+    if (x >= self->tiles_x || y >= self->tiles_y)
+    {
+        return FALSE;
+    }
+
+    const guint64 *row = self->words + (gsize) y * self->words_per_row;
+    return (row[x / DRD_DIRTY_MAP_WORD_BITS] >> (x % DRD_DIRTY_MAP_WORD_BITS)) & 1u;
+}
+
+/*
+ * 功能：统计脏 tile 数。
+ * 逻辑：逐字 popcount；行尾填充位从不置位，无需掩码。
+ * 参数：self 位图。
+ * 外部接口：编译器内建 __builtin_popcountll。
+ */
+guint
+drd_dirty_map_count(const DrdDirtyMap *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+
+    const gsize words = (gsize) self->words_per_row * self->tiles_y;
+    guint count = 0;
+    for (gsize i = 0; i < words; ++i)
+    {
+        count += (guint) __builtin_popcountll(self->words[i]);
+    }
+    return count;
+}
+
+/*
+ * 功能：把另一张同几何位图的脏块并入本位图。
+ * 逻辑：逐字按位或并顺带统计合并后的脏块数；几何不一致时不做修改。
+ * 参数：self 目标位图；other 来源位图。
+ * 外部接口：编译器内建 __builtin_popcountll。
+ * 返回：合并后的脏 tile 数。
+ */
+guint
+drd_dirty_map_merge(DrdDirtyMap *self, const DrdDirtyMap *other)
+{
+    g_return_val_if_fail(self != NULL, 0);
+    g_return_val_if_fail(other != NULL, 0);
+    g_return_val_if_fail(self->tiles_x == other->tiles_x && self->tiles_y == other->tiles_y,
+                         drd_dirty_map_count(self));
+
+    const gsize words = (gsize) self->words_per_row * self->tiles_y;
+    guint count = 0;
+    for (gsize i = 0; i < words; ++i)
+    {
+        self->words[i] |= other->words[i];
+        count += (guint) __builtin_popcountll(self->words[i]);
+    }
+    return count;
+}
+
+/*
+ * 功能：在一行内查找从 from 起第一个取值为 value 的 tile。
+ * 逻辑：按字扫描，整字全 0/全 1 时直接跳过，否则用 ctz 定位首个目标位。
+ * 参数：self 位图；y 行号；from 起始列；value 查找脏(TRUE)或干净(FALSE)。
+ * 外部接口：编译器内建 __builtin_ctzll。
+ * 返回：列号，未找到时返回 tiles_x。
+ */
+static guint
+drd_dirty_map_find_in_row(const DrdDirtyMap *self, guint y, guint from, gboolean value)
+{
+    const guint64 *row = self->words + (gsize) y * self->words_per_row;
+
+    for (guint x = from; x < self->tiles_x;)
+    {
+        const guint word_index = x / DRD_DIRTY_MAP_WORD_BITS;
+        const guint bit = x % DRD_DIRTY_MAP_WORD_BITS;
+        guint64 word = value ? row[word_index] : ~row[word_index];
+        word &= ~G_GUINT64_CONSTANT(0) << bit;
+        if (word != 0)
+        {
+            const guint found = word_index * DRD_DIRTY_MAP_WORD_BITS + (guint) __builtin_ctzll(word);
+            return MIN(found, self->tiles_x);
+        }
+        x = (word_index + 1) * DRD_DIRTY_MAP_WORD_BITS;
+    }
+    return self->tiles_x;
+}
+
+/*
+ * 功能：判断某行在 [x0, x1) 上是否恰好是一段完整的脏块连续段。
+ * 逻辑：段内全脏且左右相邻 tile 均干净（或到达边界）。
+ * 参数：self 位图；y 行号；x0/x1 段的起止列。
+ * 外部接口：无。
+ */
+static gboolean
+drd_dirty_map_row_has_run(const DrdDirtyMap *self, guint y, guint x0, guint x1)
+{
+    if (x0 > 0 && drd_dirty_map_test(self, x0 - 1, y))
+    {
+        return FALSE;
+    }
+    return drd_dirty_map_test(self, x0, y) && drd_dirty_map_find_in_row(self, y, x0, FALSE) == x1;
+}
+
+/*
+ * 功能：把脏块合并为矩形列表。
+ * 逻辑：逐行提取水平连续段；若上一行存在完全相同的段则该段已被上方矩形吸收，否则向下延伸，
+ *       直到某行不再出现相同的段，得到一个最大纵向堆叠矩形。输出按左上角行优先排列。
+ * 参数：self 位图；rects 输出数组（元素为 DrdDirtyRect，追加写入，调用方负责清空）。
+ * 外部接口：GLib g_array_append_val。
+ * 返回：追加的矩形数。
+ */
+guint
+drd_dirty_map_coalesce(const DrdDirtyMap *self, GArray *rects)
+{
+    g_return_val_if_fail(self != NULL, 0);
+    g_return_val_if_fail(rects != NULL, 0);
+
+    guint appended = 0;
+    for (guint y = 0; y < self->tiles_y; ++y)
+    {
+        guint x0 = drd_dirty_map_find_in_row(self, y, 0, TRUE);
+        while (x0 < self->tiles_x)
+        {
+            const guint x1 = drd_dirty_map_find_in_row(self, y, x0, FALSE);
+            if (y == 0 || !drd_dirty_map_row_has_run(self, y - 1, x0, x1))
+            {
+                guint y1 = y + 1;
+                while (y1 < self->tiles_y && drd_dirty_map_row_has_run(self, y1, x0, x1))
+                {
+                    y1++;
+                }
+
+                DrdDirtyRect rect = {(guint16) x0, (guint16) y, (guint16) (x1 - x0), (guint16) (y1 - y)};
+                g_array_append_val(rects, rect);
+                appended++;
+            }
+            x0 = x1 < self->tiles_x ? drd_dirty_map_find_in_row(self, y, x1, TRUE) : self->tiles_x;
+        }
+    }
+    return appended;
+}
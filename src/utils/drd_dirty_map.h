@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * tile 脏块位图：每个 tile 占 1 位，按行对齐到 64 位字，行内可逐字跳过干净区域。
+ * 坐标均以 tile 为单位，像素换算由调用方按 tile 尺寸完成。
+ */
+typedef struct _DrdDirtyMap DrdDirtyMap;
+
+/* 合并后的脏矩形（tile 单位） */
+typedef struct
+{
+    guint16 x;
+    guint16 y;
+    guint16 width;
+    guint16 height;
+} DrdDirtyRect;
+
+DrdDirtyMap *drd_dirty_map_new(void);
+void drd_dirty_map_free(DrdDirtyMap *self);
+
+gboolean drd_dirty_map_reset(DrdDirtyMap *self, guint tiles_x, guint tiles_y);
+void drd_dirty_map_clear(DrdDirtyMap *self);
+guint drd_dirty_map_get_tiles_x(const DrdDirtyMap *self);
+guint drd_dirty_map_get_tiles_y(const DrdDirtyMap *self);
+
+void drd_dirty_map_set(DrdDirtyMap *self, guint x, guint y);
+gboolean drd_dirty_map_test(const DrdDirtyMap *self, guint x, guint y);
+guint drd_dirty_map_count(const DrdDirtyMap *self);
+guint drd_dirty_map_merge(DrdDirtyMap *self, const DrdDirtyMap *other);
+
+guint drd_dirty_map_coalesce(const DrdDirtyMap *self, GArray *rects);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdDirtyMap, drd_dirty_map_free)
+
+G_END_DECLS
@@ -1,55 +1,187 @@
 #include "utils/drd_frame_queue.h"
 
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "utils/drd_log.h"
+
+/* 槽位数取 2 的幂，索引回绕时与掩码保持连续；深度仍受 DRD_FRAME_QUEUE_MAX_FRAMES 限制 */
+#define DRD_FRAME_QUEUE_SLOTS 4
+#define DRD_FRAME_QUEUE_SLOT(index) ((index) & (DRD_FRAME_QUEUE_SLOTS - 1))
+
+G_STATIC_ASSERT(DRD_FRAME_QUEUE_MAX_FRAMES <= DRD_FRAME_QUEUE_SLOTS);
+
 struct _DrdFrameQueue
 {
     GObject parent_instance;
 
-    GMutex mutex;
-    GCond cond;
-    DrdFrame *frames[DRD_FRAME_QUEUE_MAX_FRAMES];
-    guint head;
-    guint tail;
-    guint size;
-    gboolean running;
-    guint64 dropped_frames;
+    gpointer slots[DRD_FRAME_QUEUE_SLOTS]; /* DrdFrame*，仅通过 g_atomic_pointer_* 访问 */
+    guint depth;
+    gint head;    /* 仅消费者推进 */
+    gint tail;    /* 仅生产者推进 */
+    gint running;
+    int wakeup_fd;
+
+    guint64 dropped_frames; /* 丢帧计数，仅通过 __atomic 内建访问（64 位不回绕），拥塞时的覆盖路径同样不持锁 */
+    /* 阻塞等待统计只在消费者真正睡眠后更新，不影响无锁的数据通路 */
+    GMutex stats_lock;
+    DrdFrameQueueStats stats;
 };
 
 G_DEFINE_TYPE(DrdFrameQueue, drd_frame_queue, G_TYPE_OBJECT)
 
+/*
+ * 功能：原子摘下槽位中的帧指针。
+ * 逻辑：CAS 循环把槽位置空并返回旧值；g_atomic_pointer_exchange 需 GLib 2.74，此处保持 2.64 兼容。
+ * 参数：slot 槽位地址。
+ * 外部接口：GLib g_atomic_pointer_get/g_atomic_pointer_compare_and_exchange。
+ */
+static DrdFrame *
+drd_frame_queue_steal_slot(gpointer *slot)
+{
+    DrdFrame *frame = NULL;
+    do
+    {
+        frame = g_atomic_pointer_get(slot);
+    } while (frame != NULL && !g_atomic_pointer_compare_and_exchange(slot, frame, NULL));
+    return frame;
+}
+
+/*
+ * 功能：释放所有槽位中的帧引用。
+ * 逻辑：逐个原子摘下槽位指针并释放，头尾索引归零；调用方需保证生产者与消费者均未在访问队列。
+ * 参数：self 队列实例。
+ * 外部接口：drd_frame_queue_steal_slot；GLib g_object_unref。
+ */
+static void
+drd_frame_queue_clear_slots(DrdFrameQueue *self)
+{
+    for (guint i = 0; i < DRD_FRAME_QUEUE_SLOTS; ++i)
+    {
+        DrdFrame *frame = drd_frame_queue_steal_slot(&self->slots[i]);
+        if (frame != NULL)
+        {
+            g_object_unref(frame);
+        }
+    }
+    g_atomic_int_set(&self->head, 0);
+    g_atomic_int_set(&self->tail, 0);
+}
+
+/*
+ * 功能：写 eventfd 唤醒消费者。
+ * 逻辑：计数器加 1；EAGAIN 表示计数已饱和，消费者必然可读，忽略即可。
+ * 参数：self 队列实例。
+ * 外部接口：POSIX write。
+ */
+static void
+drd_frame_queue_signal(DrdFrameQueue *self)
+{
+    if (self->wakeup_fd < 0)
+    {
+        return;
+    }
+
+    const guint64 one = 1;
+    if (write(self->wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        DRD_LOG_WARNING("Frame queue failed to signal wakeup fd: %s", g_strerror(errno));
+    }
+}
+
+/*
+ * 功能：清空 eventfd 计数。
+ * 逻辑：非阻塞读取一次即可把计数归零。
+ * 参数：self 队列实例。
+ * 外部接口：POSIX read。
+ */
+static void
+drd_frame_queue_drain_signal(DrdFrameQueue *self)
+{
+    if (self->wakeup_fd < 0)
+    {
+        return;
+    }
+
+    guint64 value = 0;
+    if (read(self->wakeup_fd, &value, sizeof(value)) < 0)
+    {
+        (void) value;
+    }
+}
+
+/*
+ * 功能：消费者无等待地取出队头帧。
+ * 逻辑：读取生产者发布的 tail 判断是否为空；非空时原子摘下队头槽位，再推进 head 把槽位归还生产者。
+ *       槽位在 head 推进前始终非空（生产者覆盖使用 CAS），因此取到的帧必然有效。
+ * 参数：self 队列实例；out_frame 输出帧（所有权转移给调用方）。
+ * 外部接口：GLib g_atomic_int_get/g_atomic_int_set；drd_frame_queue_steal_slot。
+ */
+static gboolean
+drd_frame_queue_try_take(DrdFrameQueue *self, DrdFrame **out_frame)
+{
+    const guint head = (guint) g_atomic_int_get(&self->head);
+    const guint tail = (guint) g_atomic_int_get(&self->tail);
+    if (head == tail)
+    {
+        return FALSE;
+    }
+
+    DrdFrame *frame = drd_frame_queue_steal_slot(&self->slots[DRD_FRAME_QUEUE_SLOT(head)]);
+    g_atomic_int_set(&self->head, (gint) (head + 1));
+    *out_frame = frame;
+    return frame != NULL;
+}
+
+/*
+ * 功能：生产者发布新帧后按需唤醒消费者。
+ * 逻辑：发布 tail 之后再读取 head，若消费者已取空此前所有帧（head 等于旧 tail）则写 eventfd；
+ *       消费者在阻塞前会先排空 eventfd 再复查队列，二者顺序保证不会丢失唤醒。
+ * 参数：self 队列实例；published_index 本次写入槽位对应的序号（旧 tail）。
+ * 外部接口：GLib g_atomic_int_get。
+ */
+static void
+drd_frame_queue_notify_published(DrdFrameQueue *self, guint published_index)
+{
+    if ((guint) g_atomic_int_get(&self->head) == published_index)
+    {
+        drd_frame_queue_signal(self);
+    }
+}
+
 /*
  * 功能：释放帧队列中的帧对象。
- * 逻辑：持锁清理环形缓冲的帧引用并重置计数，随后交由父类 dispose。
+ * 逻辑：清理所有槽位后交由父类 dispose。
  * 参数：object 基类指针，期望为 DrdFrameQueue。
- * 外部接口：GLib g_clear_object；互斥锁保护。
+ * 外部接口：drd_frame_queue_clear_slots。
  */
 static void
 drd_frame_queue_dispose(GObject *object)
 {
     DrdFrameQueue *self = DRD_FRAME_QUEUE(object);
 
-    g_mutex_lock(&self->mutex);
-    for (guint i = 0; i < DRD_FRAME_QUEUE_MAX_FRAMES; ++i)
-    {
-        g_clear_object(&self->frames[i]);
-    }
-    self->size = 0;
-    g_mutex_unlock(&self->mutex);
+    drd_frame_queue_clear_slots(self);
 
     G_OBJECT_CLASS(drd_frame_queue_parent_class)->dispose(object);
 }
 
 /*
- * 功能：释放互斥量与条件变量。
- * 逻辑：清理锁与条件后交由父类 finalize。
+ * 功能：释放 eventfd 与统计锁。
+ * 逻辑：关闭唤醒 fd、清理统计锁后交由父类 finalize。
  * 参数：object 基类指针。
- * 外部接口：GLib g_mutex_clear/g_cond_clear。
+ * 外部接口：POSIX close；GLib g_mutex_clear。
  */
 static void
 drd_frame_queue_finalize(GObject *object)
 {
     DrdFrameQueue *self = DRD_FRAME_QUEUE(object);
-    g_mutex_clear(&self->mutex);
-    g_cond_clear(&self->cond);
+    if (self->wakeup_fd >= 0)
+    {
+        close(self->wakeup_fd);
+        self->wakeup_fd = -1;
+    }
+    g_mutex_clear(&self->stats_lock);
     G_OBJECT_CLASS(drd_frame_queue_parent_class)->finalize(object);
 }
 
@@ -68,29 +200,34 @@ drd_frame_queue_class_init(DrdFrameQueueClass *klass)
 }
 
 /*
- * 功能：初始化帧队列的锁、条件和缓冲。
- * 逻辑：初始化互斥锁/条件变量，清空环形缓冲并设置运行标志与计数。
+ * 功能：初始化帧邮箱的槽位、eventfd 与统计。
+ * 逻辑：清空槽位并设为默认深度；创建非阻塞 eventfd，失败时退化为短间隔轮询。
  * 参数：self 队列实例。
- * 外部接口：GLib g_mutex_init/g_cond_init。
+ * 外部接口：Linux eventfd；GLib g_mutex_init。
  */
 static void
 drd_frame_queue_init(DrdFrameQueue *self)
 {
-    g_mutex_init(&self->mutex);
-    g_cond_init(&self->cond);
-    for (guint i = 0; i < DRD_FRAME_QUEUE_MAX_FRAMES; ++i)
+    for (guint i = 0; i < DRD_FRAME_QUEUE_SLOTS; ++i)
     {
-        self->frames[i] = NULL;
+        self->slots[i] = NULL;
     }
+    self->depth = DRD_FRAME_QUEUE_DEFAULT_DEPTH;
     self->head = 0;
     self->tail = 0;
-    self->size = 0;
-    self->running = TRUE;
+    self->running = 1;
+    self->wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (self->wakeup_fd < 0)
+    {
+        DRD_LOG_WARNING("Frame queue failed to create eventfd, falling back to polling: %s", g_strerror(errno));
+    }
     self->dropped_frames = 0;
+    g_mutex_init(&self->stats_lock);
+    self->stats = (DrdFrameQueueStats){0};
 }
 
 /*
- * 功能：创建帧队列对象。
+ * 功能：创建默认深度（最新帧胜出）的帧邮箱。
  * 逻辑：调用 g_object_new 分配实例。
  * 参数：无。
  * 外部接口：GLib g_object_new。
@@ -101,37 +238,48 @@ drd_frame_queue_new(void)
     return g_object_new(DRD_TYPE_FRAME_QUEUE, NULL);
 }
 
+/*
+ * 功能：创建指定 FIFO 深度的帧邮箱。
+ * 逻辑：深度夹紧到 [1, DRD_FRAME_QUEUE_MAX_FRAMES]，须在队列被多线程使用前设定。
+ * 参数：depth 最多缓存的帧数。
+ * 外部接口：drd_frame_queue_new。
+ */
+DrdFrameQueue *
+drd_frame_queue_new_with_depth(guint depth)
+{
+    DrdFrameQueue *self = drd_frame_queue_new();
+    self->depth = CLAMP(depth, 1, DRD_FRAME_QUEUE_MAX_FRAMES);
+    return self;
+}
+
 /*
  * 功能：重置队列状态并清空缓冲。
- * 逻辑：持锁恢复 running，清理所有帧引用，重置头尾指针与统计，并广播条件唤醒等待线程。
+ * 逻辑：恢复运行态，释放所有帧、归零索引与统计并排空 eventfd；须在生产者启动前、消费者未等待时调用。
  * 参数：self 队列实例。
- * 外部接口：GLib g_clear_object；互斥锁保护。
+ * 外部接口：drd_frame_queue_clear_slots；GLib g_atomic_int_set。
  */
 void
 drd_frame_queue_reset(DrdFrameQueue *self)
 {
     g_return_if_fail(DRD_IS_FRAME_QUEUE(self));
 
-    g_mutex_lock(&self->mutex);
-    self->running = TRUE;
-    for (guint i = 0; i < DRD_FRAME_QUEUE_MAX_FRAMES; ++i)
-    {
-        g_clear_object(&self->frames[i]);
-        self->frames[i] = NULL;
-    }
-    self->head = 0;
-    self->tail = 0;
-    self->size = 0;
-    self->dropped_frames = 0;
-    g_cond_broadcast(&self->cond);
-    g_mutex_unlock(&self->mutex);
+    drd_frame_queue_clear_slots(self);
+    drd_frame_queue_drain_signal(self);
+
+    __atomic_store_n(&self->dropped_frames, 0, __ATOMIC_RELAXED);
+    g_mutex_lock(&self->stats_lock);
+    self->stats = (DrdFrameQueueStats){0};
+    g_mutex_unlock(&self->stats_lock);
+
+    g_atomic_int_set(&self->running, 1);
 }
 
 /*
- * 功能：向队列推入一帧，满容量时丢弃最旧帧。
- * 逻辑：持锁检查运行状态；满队列时移除头部帧并累加丢弃计数；将新帧写入尾部并广播条件。
+ * 功能：生产者推入一帧，满容量时覆盖最新一格。
+ * 逻辑：有空位时写入 tail 槽位后发布 tail；已满时用 CAS 把最新一格替换为新帧并原子递增丢帧数。
+ *       CAS 失败说明消费者正在取走该格，让出 CPU 后重试即可拿到空位。
  * 参数：self 队列实例；frame 待推入帧。
- * 外部接口：GLib g_clear_object/g_cond_broadcast；互斥锁保护。
+ * 外部接口：GLib g_atomic_pointer_compare_and_exchange/g_atomic_int_set/g_thread_yield；GCC __atomic_fetch_add。
  */
 void
 drd_frame_queue_push(DrdFrameQueue *self, DrdFrame *frame)
@@ -139,34 +287,44 @@ drd_frame_queue_push(DrdFrameQueue *self, DrdFrame *frame)
     g_return_if_fail(DRD_IS_FRAME_QUEUE(self));
     g_return_if_fail(DRD_IS_FRAME(frame));
 
-    g_mutex_lock(&self->mutex);
-    if (!self->running)
+    if (!g_atomic_int_get(&self->running))
     {
-        g_mutex_unlock(&self->mutex);
         return;
     }
 
-    if (self->size == DRD_FRAME_QUEUE_MAX_FRAMES)
+    DrdFrame *ref = g_object_ref(frame);
+    while (TRUE)
     {
-        g_clear_object(&self->frames[self->head]);
-        self->frames[self->head] = NULL;
-        self->head = (self->head + 1) % DRD_FRAME_QUEUE_MAX_FRAMES;
-        self->size--;
-        self->dropped_frames++;
-    }
+        const guint tail = (guint) g_atomic_int_get(&self->tail);
+        const guint head = (guint) g_atomic_int_get(&self->head);
+
+        if (tail - head < self->depth)
+        {
+            g_atomic_pointer_set(&self->slots[DRD_FRAME_QUEUE_SLOT(tail)], ref);
+            g_atomic_int_set(&self->tail, (gint) (tail + 1));
+            drd_frame_queue_notify_published(self, tail);
+            return;
+        }
+
+        gpointer *newest = &self->slots[DRD_FRAME_QUEUE_SLOT(tail - 1)];
+        DrdFrame *old = g_atomic_pointer_get(newest);
+        if (old != NULL && g_atomic_pointer_compare_and_exchange(newest, old, ref))
+        {
+            g_object_unref(old);
+            __atomic_fetch_add(&self->dropped_frames, 1, __ATOMIC_RELAXED);
+            return;
+        }
 
-    self->frames[self->tail] = g_object_ref(frame);
-    self->tail = (self->tail + 1) % DRD_FRAME_QUEUE_MAX_FRAMES;
-    self->size++;
-    g_cond_broadcast(&self->cond);
-    g_mutex_unlock(&self->mutex);
+        g_thread_yield();
+    }
 }
 
 /*
- * 功能：阻塞等待一帧输出，可选超时。
- * 逻辑：持锁检查运行状态；根据超时策略等待条件；取出头部帧返回并缩减大小。
+ * 功能：消费者等待一帧输出，可选超时。
+ * 逻辑：先无等待取帧；队列为空时排空 eventfd 再复查一次，仍为空才在 eventfd 上 g_poll，
+ *       被唤醒后重试直至取到帧、超时或停止；实际发生阻塞时记录等待次数与耗时。
  * 参数：self 队列实例；timeout_us 超时时间（微秒，0 为立即返回，<0 为无限等待）；out_frame 输出帧。
- * 外部接口：GLib g_cond_wait/g_cond_wait_until/g_get_monotonic_time；互斥锁保护。
+ * 外部接口：GLib g_poll/g_get_monotonic_time；Linux eventfd。
  */
 gboolean
 drd_frame_queue_wait(DrdFrameQueue *self, gint64 timeout_us, DrdFrame **out_frame)
@@ -174,94 +332,123 @@ drd_frame_queue_wait(DrdFrameQueue *self, gint64 timeout_us, DrdFrame **out_fram
     g_return_val_if_fail(DRD_IS_FRAME_QUEUE(self), FALSE);
     g_return_val_if_fail(out_frame != NULL, FALSE);
 
+    const gint64 start = g_get_monotonic_time();
+    const gint64 deadline = timeout_us > 0 ? start + timeout_us : 0;
+    gboolean blocked = FALSE;
     gboolean result = FALSE;
 
-    g_mutex_lock(&self->mutex);
-    if (!self->running)
+    while (g_atomic_int_get(&self->running))
     {
-        g_mutex_unlock(&self->mutex);
-        return FALSE;
-    }
-
-    gint64 deadline = 0;
-    if (timeout_us > 0)
-    {
-        deadline = g_get_monotonic_time() + timeout_us;
-    }
+        if (drd_frame_queue_try_take(self, out_frame))
+        {
+            result = TRUE;
+            break;
+        }
 
-    while (self->running && self->size == 0)
-    {
+        drd_frame_queue_drain_signal(self);
+        if (drd_frame_queue_try_take(self, out_frame))
+        {
+            result = TRUE;
+            break;
+        }
         if (timeout_us == 0)
         {
-            g_mutex_unlock(&self->mutex);
-            return FALSE;
+            break;
         }
 
+        gint timeout_ms = -1;
         if (timeout_us > 0)
         {
-            if (!g_cond_wait_until(&self->cond, &self->mutex, deadline))
+            const gint64 remaining = deadline - g_get_monotonic_time();
+            if (remaining <= 0)
             {
                 break;
             }
+            timeout_ms = (gint) ((remaining + 999) / 1000);
         }
-        else
-        {
-            g_cond_wait(&self->cond, &self->mutex);
-        }
-    }
 
-    if (self->running && self->size > 0)
-    {
-        DrdFrame *frame = self->frames[self->head];
-        self->frames[self->head] = NULL;
-        self->head = (self->head + 1) % DRD_FRAME_QUEUE_MAX_FRAMES;
-        self->size--;
-        if (frame != NULL)
+        blocked = TRUE;
+        if (self->wakeup_fd >= 0)
         {
-            *out_frame = g_object_ref(frame);
-            g_clear_object(&frame);
+            GPollFD pfd = {.fd = self->wakeup_fd, .events = G_IO_IN, .revents = 0};
+            g_poll(&pfd, 1, timeout_ms);
         }
         else
         {
-            *out_frame = NULL;
+            g_usleep(1000);
         }
-        result = TRUE;
     }
 
-    g_mutex_unlock(&self->mutex);
+    if (blocked)
+    {
+        const gint64 waited = g_get_monotonic_time() - start;
+        g_mutex_lock(&self->stats_lock);
+        self->stats.waits++;
+        self->stats.wait_us_total += (guint64) waited;
+        self->stats.wait_us_max = MAX(self->stats.wait_us_max, waited);
+        g_mutex_unlock(&self->stats_lock);
+    }
+
     return result;
 }
 
 /*
- * 功能：停止队列，唤醒所有等待者。
- * 逻辑：持锁将 running 置 FALSE 并广播条件。
+ * 功能：停止队列，唤醒等待者。
+ * 逻辑：清除运行标志后写 eventfd，让阻塞在 g_poll 上的消费者立即返回。
  * 参数：self 队列实例。
- * 外部接口：GLib g_cond_broadcast；互斥锁保护。
+ * 外部接口：GLib g_atomic_int_set。
  */
 void
 drd_frame_queue_stop(DrdFrameQueue *self)
 {
     g_return_if_fail(DRD_IS_FRAME_QUEUE(self));
 
-    g_mutex_lock(&self->mutex);
-    self->running = FALSE;
-    g_cond_broadcast(&self->cond);
-    g_mutex_unlock(&self->mutex);
+    g_atomic_int_set(&self->running, 0);
+    drd_frame_queue_signal(self);
+}
+
+/*
+ * 功能：返回可加入外部 poll 集合的唤醒 fd。
+ * 逻辑：队列由空变非空时可读；可读后反复 drd_frame_queue_wait(…, 0, …) 直至返回 FALSE（此时 fd 已被排空）。
+ * 参数：self 队列实例。
+ * 外部接口：无，eventfd 创建失败时返回 -1。
+ */
+gint
+drd_frame_queue_get_wakeup_fd(DrdFrameQueue *self)
+{
+    g_return_val_if_fail(DRD_IS_FRAME_QUEUE(self), -1);
+
+    return self->wakeup_fd;
 }
 
 /*
  * 功能：获取队列累计丢帧数。
- * 逻辑：持锁读取 dropped_frames 并返回。
+ * 逻辑：原子读取 64 位 dropped_frames。
  * 参数：self 队列实例。
- * 外部接口：互斥锁保护。
+ * 外部接口：GCC __atomic_load_n。
  */
 guint64
 drd_frame_queue_get_dropped_frames(DrdFrameQueue *self)
 {
     g_return_val_if_fail(DRD_IS_FRAME_QUEUE(self), 0);
 
-    g_mutex_lock(&self->mutex);
-    guint64 dropped = self->dropped_frames;
-    g_mutex_unlock(&self->mutex);
-    return dropped;
+    return __atomic_load_n(&self->dropped_frames, __ATOMIC_RELAXED);
+}
+
+/*
+ * 功能：获取丢帧与阻塞等待统计。
+ * 逻辑：持统计锁拷贝等待统计，丢帧数原子读取后填入。
+ * 参数：self 队列实例；out_stats 输出。
+ * 外部接口：互斥锁保护；GCC __atomic_load_n。
+ */
+void
+drd_frame_queue_get_stats(DrdFrameQueue *self, DrdFrameQueueStats *out_stats)
+{
+    g_return_if_fail(DRD_IS_FRAME_QUEUE(self));
+    g_return_if_fail(out_stats != NULL);
+
+    g_mutex_lock(&self->stats_lock);
+    *out_stats = self->stats;
+    g_mutex_unlock(&self->stats_lock);
+    out_stats->dropped_frames = __atomic_load_n(&self->dropped_frames, __ATOMIC_RELAXED);
 }
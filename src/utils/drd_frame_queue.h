@@ -4,14 +4,31 @@
 
 #include "utils/drd_frame.h"
 
+/* 环形槽位上限；实际深度由 drd_frame_queue_new_with_depth 指定 */
 #define DRD_FRAME_QUEUE_MAX_FRAMES 3
+/* 默认深度 1：纯“最新帧胜出”邮箱 */
+#define DRD_FRAME_QUEUE_DEFAULT_DEPTH 1
 
 G_BEGIN_DECLS
 
+/*
+ * 单生产者/单消费者帧邮箱：槽位与头尾索引均为原子操作，不持锁；
+ * 满时新帧覆盖最新一格（最新者胜出），其余帧保持 FIFO 顺序。
+ * 队列由空变非空时写 eventfd 唤醒消费者，该 fd 也可加入外部 poll 集合。
+ */
 #define DRD_TYPE_FRAME_QUEUE (drd_frame_queue_get_type())
 G_DECLARE_FINAL_TYPE(DrdFrameQueue, drd_frame_queue, DRD, FRAME_QUEUE, GObject)
 
+typedef struct
+{
+    guint64 dropped_frames; /* 被新帧覆盖的帧数 */
+    guint64 waits;          /* 消费者因队列为空而阻塞的次数 */
+    guint64 wait_us_total;  /* 阻塞等待累计耗时 */
+    gint64 wait_us_max;     /* 单次阻塞等待最大耗时 */
+} DrdFrameQueueStats;
+
 DrdFrameQueue *drd_frame_queue_new(void);
+DrdFrameQueue *drd_frame_queue_new_with_depth(guint depth);
 
 void drd_frame_queue_reset(DrdFrameQueue *self);
 void drd_frame_queue_push(DrdFrameQueue *self, DrdFrame *frame);
@@ -19,6 +36,8 @@ gboolean drd_frame_queue_wait(DrdFrameQueue *self,
                                gint64 timeout_us,
                                DrdFrame **out_frame);
 void drd_frame_queue_stop(DrdFrameQueue *self);
+gint drd_frame_queue_get_wakeup_fd(DrdFrameQueue *self);
 guint64 drd_frame_queue_get_dropped_frames(DrdFrameQueue *self);
+void drd_frame_queue_get_stats(DrdFrameQueue *self, DrdFrameQueueStats *out_stats);
 
 G_END_DECLS
@@ -0,0 +1,230 @@
+#include "utils/drd_handoff_slot.h"
+
+struct _DrdHandoffSlot
+{
+    GMutex mutex;
+    GCond cond;
+    gpointer item;
+    gboolean running;
+    GDestroyNotify free_func;
+    DrdHandoffMergeFunc merge_func;
+    guint64 replaced;
+};
+
+/*
+ * 功能：释放单个槽位元素。
+ * 逻辑：元素非空且设置了释放回调时调用回调。
+ * 参数：self 交接槽；item 待释放元素。
+ * 外部接口：调用方提供的 GDestroyNotify。
+ */
+static void drd_handoff_slot_release_item(DrdHandoffSlot *self, gpointer item)
+{
+    if (item != NULL && self->free_func != NULL)
+    {
+        self->free_func(item);
+    }
+}
+
+/*
+ * 功能：创建交接槽。
+ * 逻辑：初始化锁/条件变量，记录元素释放与合并回调，槽位初始为空且处于运行态。
+ * 参数：free_func 元素释放回调；merge_func 覆盖时的合并回调，可为 NULL。
+ * 外部接口：GLib g_new0/g_mutex_init/g_cond_init。
+ */
+DrdHandoffSlot *drd_handoff_slot_new(GDestroyNotify free_func, DrdHandoffMergeFunc merge_func)
+{
+    DrdHandoffSlot *self = g_new0(DrdHandoffSlot, 1);
+    g_mutex_init(&self->mutex);
+    g_cond_init(&self->cond);
+    self->item = NULL;
+    self->running = TRUE;
+    self->free_func = free_func;
+    self->merge_func = merge_func;
+    self->replaced = 0;
+    return self;
+}
+
+/*
+ * 功能：释放交接槽及其中未被取走的元素。
+ * 逻辑：释放残留元素后清理锁与条件变量。
+ * 参数：self 交接槽，可为 NULL。
+ * 外部接口：GLib g_mutex_clear/g_cond_clear/g_free。
+ */
+void drd_handoff_slot_free(DrdHandoffSlot *self)
+{
+    if (self == NULL)
+    {
+        return;
+    }
+
+    drd_handoff_slot_release_item(self, self->item);
+    g_mutex_clear(&self->mutex);
+    g_cond_clear(&self->cond);
+    g_free(self);
+}
+
+/*
+ * 功能：以“最新者胜出”语义放入元素。
+ * 逻辑：持锁检查运行态；槽位已有未取走的旧项时先调用合并回调把旧项信息并入新项，再释放旧项并计数，
+ *       最后放入新项并唤醒消费者。已停止时直接释放新项。
+ * 参数：self 交接槽；item 新元素（所有权转移给槽位）。
+ * 外部接口：GLib g_cond_broadcast；互斥锁保护。
+ */
+gboolean drd_handoff_slot_replace(DrdHandoffSlot *self, gpointer item)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+    g_return_val_if_fail(item != NULL, FALSE);
+
+    gpointer dropped = NULL;
+
+    g_mutex_lock(&self->mutex);
+    if (!self->running)
+    {
+        g_mutex_unlock(&self->mutex);
+        drd_handoff_slot_release_item(self, item);
+        return FALSE;
+    }
+
+    if (self->item != NULL)
+    {
+        if (self->merge_func != NULL)
+        {
+            self->merge_func(item, self->item);
+        }
+        dropped = self->item;
+        self->replaced++;
+    }
+    self->item = item;
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->mutex);
+
+    drd_handoff_slot_release_item(self, dropped);
+    return TRUE;
+}
+
+/*
+ * 功能：以阻塞语义放入元素，用于不可丢弃的下游数据。
+ * 逻辑：持锁等待槽位空出或交接槽停止；停止时释放元素并返回 FALSE。
+ * 参数：self 交接槽；item 新元素（所有权转移给槽位）。
+ * 外部接口：GLib g_cond_wait/g_cond_broadcast；互斥锁保护。
+ */
+gboolean drd_handoff_slot_put(DrdHandoffSlot *self, gpointer item)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+    g_return_val_if_fail(item != NULL, FALSE);
+
+    g_mutex_lock(&self->mutex);
+    while (self->running && self->item != NULL)
+    {
+        g_cond_wait(&self->cond, &self->mutex);
+    }
+
+    if (!self->running)
+    {
+        g_mutex_unlock(&self->mutex);
+        drd_handoff_slot_release_item(self, item);
+        return FALSE;
+    }
+
+    self->item = item;
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->mutex);
+    return TRUE;
+}
+
+/*
+ * 功能：取出槽位中的元素，可选超时。
+ * 逻辑：持锁等待元素出现（0 立即返回，<0 无限等待）；取到后清空槽位并唤醒阻塞的生产者。
+ * 参数：self 交接槽；timeout_us 超时（微秒）；out_item 输出元素（所有权转移给调用方）。
+ * 外部接口：GLib g_cond_wait/g_cond_wait_until/g_get_monotonic_time；互斥锁保护。
+ */
+gboolean drd_handoff_slot_take(DrdHandoffSlot *self, gint64 timeout_us, gpointer *out_item)
+{
+    g_return_val_if_fail(self != NULL, FALSE);
+    g_return_val_if_fail(out_item != NULL, FALSE);
+
+    const gint64 deadline = timeout_us > 0 ? g_get_monotonic_time() + timeout_us : 0;
+
+    g_mutex_lock(&self->mutex);
+    while (self->running && self->item == NULL)
+    {
+        if (timeout_us == 0)
+        {
+            break;
+        }
+        if (timeout_us > 0)
+        {
+            if (!g_cond_wait_until(&self->cond, &self->mutex, deadline))
+            {
+                break;
+            }
+        }
+        else
+        {
+            g_cond_wait(&self->cond, &self->mutex);
+        }
+    }
+
+    if (!self->running || self->item == NULL)
+    {
+        g_mutex_unlock(&self->mutex);
+        return FALSE;
+    }
+
+    *out_item = self->item;
+    self->item = NULL;
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->mutex);
+    return TRUE;
+}
+
+/*
+ * 功能：丢弃槽位中尚未被取走的元素。
+ * 逻辑：持锁摘下元素并唤醒阻塞的生产者，锁外释放元素。
+ * 参数：self 交接槽。
+ * 外部接口：GLib g_cond_broadcast；互斥锁保护。
+ */
+void drd_handoff_slot_clear(DrdHandoffSlot *self)
+{
+    g_return_if_fail(self != NULL);
+
+    g_mutex_lock(&self->mutex);
+    gpointer item = self->item;
+    self->item = NULL;
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->mutex);
+
+    drd_handoff_slot_release_item(self, item);
+}
+
+/*
+ * 功能：停止交接槽，唤醒所有等待者。
+ * 逻辑：持锁将 running 置 FALSE 并广播，之后的 put/replace/take 均立即失败。
+ * 参数：self 交接槽。
+ * 外部接口：GLib g_cond_broadcast；互斥锁保护。
+ */
+void drd_handoff_slot_stop(DrdHandoffSlot *self)
+{
+    g_return_if_fail(self != NULL);
+
+    g_mutex_lock(&self->mutex);
+    self->running = FALSE;
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->mutex);
+}
+
+/*
+ * 功能：读取被新项覆盖的累计次数。
+ * 逻辑：持锁读取 replaced。
+ * 参数：self 交接槽。
+ * 外部接口：互斥锁保护。
+ */
+guint64 drd_handoff_slot_get_replaced(DrdHandoffSlot *self)
+{
+    g_return_val_if_fail(self != NULL, 0);
+
+    g_mutex_lock(&self->mutex);
+    const guint64 replaced = self->replaced;
+    g_mutex_unlock(&self->mutex);
+    return replaced;
+}
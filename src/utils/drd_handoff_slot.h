@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * 流水线阶段之间的单槽交接点：生产者 replace 时新项覆盖未被取走的旧项（可选合并回调），
+ * put 时阻塞到槽位空出；消费者 take 可带超时等待。内部自带互斥锁，可跨线程使用。
+ */
+typedef struct _DrdHandoffSlot DrdHandoffSlot;
+
+/* 旧项被覆盖前调用，把 older 中仍需保留的信息并入 newer；旧项随后由 free_func 释放 */
+typedef void (*DrdHandoffMergeFunc)(gpointer newer, gpointer older);
+
+DrdHandoffSlot *drd_handoff_slot_new(GDestroyNotify free_func, DrdHandoffMergeFunc merge_func);
+void drd_handoff_slot_free(DrdHandoffSlot *self);
+
+gboolean drd_handoff_slot_replace(DrdHandoffSlot *self, gpointer item);
+gboolean drd_handoff_slot_put(DrdHandoffSlot *self, gpointer item);
+gboolean drd_handoff_slot_take(DrdHandoffSlot *self, gint64 timeout_us, gpointer *out_item);
+void drd_handoff_slot_clear(DrdHandoffSlot *self);
+void drd_handoff_slot_stop(DrdHandoffSlot *self);
+guint64 drd_handoff_slot_get_replaced(DrdHandoffSlot *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdHandoffSlot, drd_handoff_slot_free)
+
+G_END_DECLS
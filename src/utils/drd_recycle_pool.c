@@ -0,0 +1,120 @@
+#include "utils/drd_recycle_pool.h"
+
+struct _DrdRecyclePool
+{
+    gint ref_count;
+    GMutex mutex;
+    GDestroyNotify free_func;
+    guint capacity;
+    guint count;
+    gpointer *items; /* 创建时按容量一次分配，取还只移动指针 */
+};
+
+/*
+ * 功能：创建回收池。
+ * 逻辑：按容量一次性分配指针数组，初始引用计数为 1。
+ * 参数：capacity 最多缓存的对象数；free_func 池满或池销毁时释放对象的回调。
+ * 外部接口：GLib g_new0/g_mutex_init。
+ */
+DrdRecyclePool *
+drd_recycle_pool_new(guint capacity, GDestroyNotify free_func)
+{
+    g_return_val_if_fail(capacity > 0, NULL);
+    g_return_val_if_fail(free_func != NULL, NULL);
+
+    DrdRecyclePool *self = g_new0(DrdRecyclePool, 1);
+    self->ref_count = 1;
+    g_mutex_init(&self->mutex);
+    self->free_func = free_func;
+    self->capacity = capacity;
+    self->count = 0;
+    self->items = g_new0(gpointer, capacity);
+    return self;
+}
+
+/*
+ * 功能：增加回收池引用。
+ * 逻辑：原子递增引用计数。
+ * 参数：self 回收池。
+ * 外部接口：GLib g_atomic_int_inc。
+ */
+DrdRecyclePool *
+drd_recycle_pool_ref(DrdRecyclePool *self)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+
+    g_atomic_int_inc(&self->ref_count);
+    return self;
+}
+
+/*
+ * 功能：释放回收池引用。
+ * 逻辑：引用归零时销毁池内缓存的对象并释放池本身。
+ * 参数：self 回收池，可为 NULL。
+ * 外部接口：GLib g_atomic_int_dec_and_test/g_mutex_clear/g_free。
+ */
+void
+drd_recycle_pool_unref(DrdRecyclePool *self)
+{
+    if (self == NULL || !g_atomic_int_dec_and_test(&self->ref_count))
+    {
+        return;
+    }
+
+    for (guint i = 0; i < self->count; ++i)
+    {
+        self->free_func(self->items[i]);
+    }
+    g_free(self->items);
+    g_mutex_clear(&self->mutex);
+    g_free(self);
+}
+
+/*
+ * 功能：取出一个可复用对象。
+ * 逻辑：持锁弹出最近归还的对象（缓存更热）；池空时返回 NULL，由调用方新建并计入分配统计。
+ * 参数：self 回收池。
+ * 外部接口：互斥锁保护。
+ */
+gpointer
+drd_recycle_pool_acquire(DrdRecyclePool *self)
+{
+    g_return_val_if_fail(self != NULL, NULL);
+
+    gpointer item = NULL;
+    g_mutex_lock(&self->mutex);
+    if (self->count > 0)
+    {
+        item = self->items[--self->count];
+        self->items[self->count] = NULL;
+    }
+    g_mutex_unlock(&self->mutex);
+    return item;
+}
+
+/*
+ * 功能：归还对象。
+ * 逻辑：持锁压入；池已满时在锁外用 free_func 释放。
+ * 参数：self 回收池；item 已重置、可供下次复用的对象。
+ * 外部接口：互斥锁保护。
+ */
+void
+drd_recycle_pool_release(DrdRecyclePool *self, gpointer item)
+{
+    g_return_if_fail(self != NULL);
+    g_return_if_fail(item != NULL);
+
+    gboolean stored = FALSE;
+    g_mutex_lock(&self->mutex);
+    if (self->count < self->capacity)
+    {
+        self->items[self->count++] = item;
+        stored = TRUE;
+    }
+    g_mutex_unlock(&self->mutex);
+
+    if (!stored)
+    {
+        self->free_func(item);
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * 定长回收池：缓存若干个已分配的对象供下一帧复用，稳态下取还均不分配内存。
+ * 对象在池外流转期间应持有池引用，池在最后一个引用释放时用 free_func 销毁仍在池内的对象。
+ */
+typedef struct _DrdRecyclePool DrdRecyclePool;
+
+DrdRecyclePool *drd_recycle_pool_new(guint capacity, GDestroyNotify free_func);
+DrdRecyclePool *drd_recycle_pool_ref(DrdRecyclePool *self);
+void drd_recycle_pool_unref(DrdRecyclePool *self);
+
+gpointer drd_recycle_pool_acquire(DrdRecyclePool *self);
+void drd_recycle_pool_release(DrdRecyclePool *self, gpointer item);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(DrdRecyclePool, drd_recycle_pool_unref)
+
+G_END_DECLS
@@ -0,0 +1,75 @@
+#include "utils/drd_timestamp.h"
+
+/* 墙钟偏移重算周期：足以跟随 NTP 步进与夏令时切换，又不必每帧查询时区 */
+#define DRD_TIMESTAMP_RESYNC_INTERVAL_US ((gint64) 60 * G_USEC_PER_SEC)
+#define DRD_TIMESTAMP_US_PER_DAY ((gint64) 24 * 3600 * G_USEC_PER_SEC)
+
+static GMutex timestamp_lock;
+static gint64 cached_offset_us = 0;   /* 本地墙钟（含时区偏移）减单调时钟 */
+static gint64 cached_synced_at_us = 0; /* 上次重算时的单调时刻，0 表示尚未初始化 */
+
+/*
+ * 功能：重新计算本地墙钟与单调时钟之间的偏移。
+ * 逻辑：读取 UTC 墙钟与单调时钟，加上当前时区 UTC 偏移；只在重算周期到达时执行一次时区查询。
+ * 参数：now_monotonic 当前单调时刻。
+ * 外部接口：GLib g_get_real_time/g_date_time_new_now_local/g_date_time_get_utc_offset；调用方持锁。
+ */
+static void
+drd_timestamp_resync_locked(gint64 now_monotonic)
+{
+    gint64 utc_offset_us = 0;
+    GDateTime *now_local = g_date_time_new_now_local();
+    if (now_local != NULL)
+    {
+        utc_offset_us = g_date_time_get_utc_offset(now_local);
+        g_date_time_unref(now_local);
+    }
+
+    cached_offset_us = g_get_real_time() + utc_offset_us - now_monotonic;
+    cached_synced_at_us = now_monotonic;
+}
+
+/*
+ * 功能：把单调时钟时刻换算为本地墙钟（自 Epoch 起、已含时区偏移的微秒数）。
+ * 逻辑：持锁检查缓存偏移是否过期，过期则重算，随后直接相加；锁内仅做整数运算。
+ * 参数：monotonic_us g_get_monotonic_time() 取得的时刻，例如帧捕获时间戳。
+ * 外部接口：GLib g_get_monotonic_time；互斥锁保护缓存。
+ */
+gint64
+drd_timestamp_monotonic_to_local_us(gint64 monotonic_us)
+{
+    const gint64 now_monotonic = g_get_monotonic_time();
+
+    g_mutex_lock(&timestamp_lock);
+    if (cached_synced_at_us == 0 || now_monotonic - cached_synced_at_us >= DRD_TIMESTAMP_RESYNC_INTERVAL_US)
+    {
+        drd_timestamp_resync_locked(now_monotonic);
+    }
+    const gint64 offset_us = cached_offset_us;
+    g_mutex_unlock(&timestamp_lock);
+
+    return monotonic_us + offset_us;
+}
+
+/*
+ * 功能：生成 Rdpgfx StartFrame 使用的 32 位时间戳。
+ * 逻辑：把单调时刻换算为本地时间后取当日偏移，按 [MS-RDPEGFX] 编码为 小时<<22 | 分钟<<16 | 秒<<10 | 毫秒。
+ * 参数：monotonic_us 帧捕获时刻（单调时钟）。
+ * 外部接口：drd_timestamp_monotonic_to_local_us。
+ */
+guint32
+drd_timestamp_rdpgfx_from_monotonic(gint64 monotonic_us)
+{
+    gint64 day_us = drd_timestamp_monotonic_to_local_us(monotonic_us) % DRD_TIMESTAMP_US_PER_DAY;
+    if (day_us < 0)
+    {
+        day_us += DRD_TIMESTAMP_US_PER_DAY;
+    }
+
+    const guint32 hour = (guint32) (day_us / ((gint64) 3600 * G_USEC_PER_SEC));
+    const guint32 minute = (guint32) ((day_us / ((gint64) 60 * G_USEC_PER_SEC)) % 60);
+    const guint32 second = (guint32) ((day_us / G_USEC_PER_SEC) % 60);
+    const guint32 millisecond = (guint32) ((day_us / 1000) % 1000);
+
+    return (hour << 22) | (minute << 16) | (second << 10) | millisecond;
+}
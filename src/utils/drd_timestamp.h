@@ -0,0 +1,10 @@
+#pragma once
+
+#include <glib.h>
+
+/*
+ * 时间戳服务：以缓存的“本地墙钟 - 单调时钟”偏移把帧捕获时刻换算成本地时间，
+ * 偏移定期重算以跟随 NTP 校时与时区/夏令时变化，单帧换算不分配内存、不查询时区。
+ */
+gint64 drd_timestamp_monotonic_to_local_us(gint64 monotonic_us);
+guint32 drd_timestamp_rdpgfx_from_monotonic(gint64 monotonic_us);
@@ -0,0 +1,403 @@
+#include <glib.h>
+
+#include "utils/drd_frame.h"
+#include "utils/drd_frame_queue.h"
+
+/*
+ * 帧邮箱 push/pop 微基准：
+ *   1. 单线程 push 后立即 wait(0) 取出，测无竞争数据通路；
+ *   2. 队列已满、无消费者时连续 push，测拥塞覆盖（丢帧）路径；
+ *   3. 生产者/消费者各一条线程，测跨线程交接吞吐、丢帧与消费端阻塞次数。
+ * 每个场景分别跑无锁邮箱（lockfree）与改造前的互斥锁 + GCond 队列（locked，基准内置副本）作对照。
+ * 用法：drd-frame-queue-bench [迭代次数]，默认 1000000。
+ */
+
+#define DRD_FRAME_QUEUE_BENCH_DEFAULT_ITERATIONS 1000000
+
+/*
+ * 改造前的帧队列：一把互斥锁保护环形缓冲，push 每次广播条件变量，满时丢弃最旧帧。
+ * 仅作对照，只保留基准用到的操作。
+ */
+typedef struct
+{
+    GMutex mutex;
+    GCond cond;
+    DrdFrame *frames[DRD_FRAME_QUEUE_MAX_FRAMES];
+    guint depth;
+    guint head;
+    guint size;
+    gboolean running;
+    DrdFrameQueueStats stats;
+} DrdLockedFrameQueue;
+
+/* 两种队列的统一操作表，场景函数按表调用 */
+typedef struct
+{
+    const gchar *name;
+    gpointer (*create)(guint depth);
+    void (*destroy)(gpointer queue);
+    void (*push)(gpointer queue, DrdFrame *frame);
+    gboolean (*wait)(gpointer queue, gint64 timeout_us, DrdFrame **out_frame);
+    void (*stop)(gpointer queue);
+    void (*get_stats)(gpointer queue, DrdFrameQueueStats *out_stats);
+} DrdFrameQueueBenchImpl;
+
+typedef struct
+{
+    const DrdFrameQueueBenchImpl *impl;
+    gpointer queue;
+    DrdFrame *frame;
+    guint iterations;
+} DrdFrameQueueBenchProducer;
+
+/*
+ * 功能：创建对照队列。
+ * 逻辑：初始化锁与条件变量，深度夹紧到 [1, DRD_FRAME_QUEUE_MAX_FRAMES]。
+ * 参数：depth 队列深度。
+ * 外部接口：GLib g_new0/g_mutex_init/g_cond_init。
+ */
+static gpointer
+drd_locked_frame_queue_new(guint depth)
+{
+    DrdLockedFrameQueue *self = g_new0(DrdLockedFrameQueue, 1);
+    g_mutex_init(&self->mutex);
+    g_cond_init(&self->cond);
+    self->depth = CLAMP(depth, 1, DRD_FRAME_QUEUE_MAX_FRAMES);
+    self->running = TRUE;
+    return self;
+}
+
+/*
+ * 功能：释放对照队列及残留帧。
+ * 逻辑：释放环形缓冲中的帧引用后清理锁与条件变量。
+ * 参数：queue 对照队列。
+ * 外部接口：GLib g_clear_object/g_mutex_clear/g_cond_clear。
+ */
+static void
+drd_locked_frame_queue_free(gpointer queue)
+{
+    DrdLockedFrameQueue *self = queue;
+    for (guint i = 0; i < DRD_FRAME_QUEUE_MAX_FRAMES; ++i)
+    {
+        g_clear_object(&self->frames[i]);
+    }
+    g_mutex_clear(&self->mutex);
+    g_cond_clear(&self->cond);
+    g_free(self);
+}
+
+/*
+ * 功能：对照队列推入一帧。
+ * 逻辑：持锁写入尾部，满时先丢弃头部最旧帧并计数，最后广播条件变量。
+ * 参数：queue 对照队列；frame 待推入帧。
+ * 外部接口：GLib g_mutex_lock/g_cond_broadcast。
+ */
+static void
+drd_locked_frame_queue_push(gpointer queue, DrdFrame *frame)
+{
+    DrdLockedFrameQueue *self = queue;
+
+    g_mutex_lock(&self->mutex);
+    if (!self->running)
+    {
+        g_mutex_unlock(&self->mutex);
+        return;
+    }
+    if (self->size == self->depth)
+    {
+        g_clear_object(&self->frames[self->head]);
+        self->head = (self->head + 1) % self->depth;
+        self->size--;
+        self->stats.dropped_frames++;
+    }
+    self->frames[(self->head + self->size) % self->depth] = g_object_ref(frame);
+    self->size++;
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->mutex);
+}
+
+/*
+ * 功能：对照队列等待一帧。
+ * 逻辑：持锁在条件变量上等待（0 立即返回，<0 无限等待），取出头部帧；实际阻塞时记录等待次数与耗时。
+ * 参数：queue 对照队列；timeout_us 超时；out_frame 输出帧。
+ * 外部接口：GLib g_cond_wait/g_cond_wait_until/g_get_monotonic_time。
+ */
+static gboolean
+drd_locked_frame_queue_wait(gpointer queue, gint64 timeout_us, DrdFrame **out_frame)
+{
+    DrdLockedFrameQueue *self = queue;
+    const gint64 start = g_get_monotonic_time();
+    const gint64 deadline = start + timeout_us;
+    gboolean blocked = FALSE;
+    gboolean result = FALSE;
+
+    g_mutex_lock(&self->mutex);
+    while (self->running && self->size == 0 && timeout_us != 0)
+    {
+        blocked = TRUE;
+        if (timeout_us < 0)
+        {
+            g_cond_wait(&self->cond, &self->mutex);
+        }
+        else if (!g_cond_wait_until(&self->cond, &self->mutex, deadline))
+        {
+            break;
+        }
+    }
+    if (self->running && self->size > 0)
+    {
+        *out_frame = g_steal_pointer(&self->frames[self->head]);
+        self->head = (self->head + 1) % self->depth;
+        self->size--;
+        result = TRUE;
+    }
+    if (blocked)
+    {
+        const gint64 waited = g_get_monotonic_time() - start;
+        self->stats.waits++;
+        self->stats.wait_us_total += (guint64) waited;
+        self->stats.wait_us_max = MAX(self->stats.wait_us_max, waited);
+    }
+    g_mutex_unlock(&self->mutex);
+    return result;
+}
+
+/*
+ * 功能：停止对照队列并唤醒等待者。
+ * 逻辑：持锁清除运行标志并广播条件变量。
+ * 参数：queue 对照队列。
+ * 外部接口：GLib g_cond_broadcast。
+ */
+static void
+drd_locked_frame_queue_stop(gpointer queue)
+{
+    DrdLockedFrameQueue *self = queue;
+
+    g_mutex_lock(&self->mutex);
+    self->running = FALSE;
+    g_cond_broadcast(&self->cond);
+    g_mutex_unlock(&self->mutex);
+}
+
+static void
+drd_locked_frame_queue_get_stats(gpointer queue, DrdFrameQueueStats *out_stats)
+{
+    DrdLockedFrameQueue *self = queue;
+
+    g_mutex_lock(&self->mutex);
+    *out_stats = self->stats;
+    g_mutex_unlock(&self->mutex);
+}
+
+/* 无锁邮箱适配到统一操作表 */
+static gpointer
+drd_frame_queue_bench_lockfree_new(guint depth)
+{
+    return drd_frame_queue_new_with_depth(depth);
+}
+
+static void
+drd_frame_queue_bench_lockfree_free(gpointer queue)
+{
+    g_object_unref(queue);
+}
+
+static void
+drd_frame_queue_bench_lockfree_push(gpointer queue, DrdFrame *frame)
+{
+    drd_frame_queue_push(queue, frame);
+}
+
+static gboolean
+drd_frame_queue_bench_lockfree_wait(gpointer queue, gint64 timeout_us, DrdFrame **out_frame)
+{
+    return drd_frame_queue_wait(queue, timeout_us, out_frame);
+}
+
+static void
+drd_frame_queue_bench_lockfree_stop(gpointer queue)
+{
+    drd_frame_queue_stop(queue);
+}
+
+static void
+drd_frame_queue_bench_lockfree_get_stats(gpointer queue, DrdFrameQueueStats *out_stats)
+{
+    drd_frame_queue_get_stats(queue, out_stats);
+}
+
+static const DrdFrameQueueBenchImpl drd_frame_queue_bench_impls[] = {
+        {
+                "lockfree",
+                drd_frame_queue_bench_lockfree_new,
+                drd_frame_queue_bench_lockfree_free,
+                drd_frame_queue_bench_lockfree_push,
+                drd_frame_queue_bench_lockfree_wait,
+                drd_frame_queue_bench_lockfree_stop,
+                drd_frame_queue_bench_lockfree_get_stats,
+        },
+        {
+                "locked",
+                drd_locked_frame_queue_new,
+                drd_locked_frame_queue_free,
+                drd_locked_frame_queue_push,
+                drd_locked_frame_queue_wait,
+                drd_locked_frame_queue_stop,
+                drd_locked_frame_queue_get_stats,
+        },
+};
+
+/*
+ * 功能：输出单项基准结果。
+ * 逻辑：按总耗时折算每次操作的纳秒数与每秒操作数。
+ * 参数：impl 队列实现；name 场景名；depth 队列深度；iterations 操作次数；elapsed_us 总耗时。
+ * 外部接口：GLib g_print。
+ */
+static void
+drd_frame_queue_bench_report(const DrdFrameQueueBenchImpl *impl,
+                             const gchar *name,
+                             guint depth,
+                             guint iterations,
+                             gint64 elapsed_us)
+{
+    const gdouble ns_per_op = elapsed_us * 1000.0 / MAX(iterations, 1u);
+    const gdouble ops_per_sec = elapsed_us > 0 ? iterations * (gdouble) G_USEC_PER_SEC / elapsed_us : 0.0;
+    g_print("%-8s %-10s depth=%u  %8.1f ns/op  %12.0f ops/s\n", impl->name, name, depth, ns_per_op, ops_per_sec);
+}
+
+/*
+ * 功能：单线程 push 后立即取出。
+ * 逻辑：队列始终在空与一帧之间切换；无锁邮箱每轮走 eventfd 写入与排空，对照队列每轮加锁并广播。
+ * 参数：impl 队列实现；depth 队列深度；frame 复用的帧；iterations 轮数。
+ * 外部接口：操作表 push/wait。
+ */
+static void
+drd_frame_queue_bench_roundtrip(const DrdFrameQueueBenchImpl *impl, guint depth, DrdFrame *frame, guint iterations)
+{
+    gpointer queue = impl->create(depth);
+    const gint64 start = g_get_monotonic_time();
+    for (guint i = 0; i < iterations; ++i)
+    {
+        DrdFrame *out = NULL;
+        impl->push(queue, frame);
+        if (impl->wait(queue, 0, &out))
+        {
+            g_object_unref(out);
+        }
+    }
+    drd_frame_queue_bench_report(impl, "roundtrip", depth, iterations, g_get_monotonic_time() - start);
+    impl->destroy(queue);
+}
+
+/*
+ * 功能：队列已满时连续 push。
+ * 逻辑：先填满队列，此后每次 push 都丢弃一帧（无锁邮箱覆盖最新一格，对照队列丢最旧帧）；结束时核对丢帧数。
+ * 参数：impl 队列实现；depth 队列深度；frame 复用的帧；iterations 轮数。
+ * 外部接口：操作表 push/get_stats。
+ */
+static void
+drd_frame_queue_bench_congested(const DrdFrameQueueBenchImpl *impl, guint depth, DrdFrame *frame, guint iterations)
+{
+    gpointer queue = impl->create(depth);
+    for (guint i = 0; i < depth; ++i)
+    {
+        impl->push(queue, frame);
+    }
+
+    const gint64 start = g_get_monotonic_time();
+    for (guint i = 0; i < iterations; ++i)
+    {
+        impl->push(queue, frame);
+    }
+    drd_frame_queue_bench_report(impl, "congested", depth, iterations, g_get_monotonic_time() - start);
+
+    DrdFrameQueueStats stats;
+    impl->get_stats(queue, &stats);
+    g_print("                    dropped=%" G_GUINT64_FORMAT "\n", stats.dropped_frames);
+    impl->destroy(queue);
+}
+
+/*
+ * 功能：生产者线程入口。
+ * 逻辑：连续推入指定数量的帧后停止队列，唤醒阻塞中的消费者。
+ * 参数：data 生产者参数。
+ * 外部接口：操作表 push/stop。
+ */
+static gpointer
+drd_frame_queue_bench_produce(gpointer data)
+{
+    DrdFrameQueueBenchProducer *producer = data;
+    for (guint i = 0; i < producer->iterations; ++i)
+    {
+        producer->impl->push(producer->queue, producer->frame);
+    }
+    producer->impl->stop(producer->queue);
+    return NULL;
+}
+
+/*
+ * 功能：一条生产者线程与一条消费者线程并发交接。
+ * 逻辑：当前线程作为消费者无限期等待，直至生产者停止队列；统计取到的帧数、丢帧与阻塞等待。
+ * 参数：impl 队列实现；depth 队列深度；frame 复用的帧；iterations 推入帧数。
+ * 外部接口：GLib g_thread_new/g_thread_join；操作表 wait/get_stats。
+ */
+static void
+drd_frame_queue_bench_spsc(const DrdFrameQueueBenchImpl *impl, guint depth, DrdFrame *frame, guint iterations)
+{
+    gpointer queue = impl->create(depth);
+    DrdFrameQueueBenchProducer producer = {.impl = impl, .queue = queue, .frame = frame, .iterations = iterations};
+    guint64 consumed = 0;
+
+    const gint64 start = g_get_monotonic_time();
+    GThread *thread = g_thread_new("drd-bench-producer", drd_frame_queue_bench_produce, &producer);
+    DrdFrame *out = NULL;
+    while (impl->wait(queue, -1, &out))
+    {
+        g_object_unref(out);
+        consumed++;
+    }
+    g_thread_join(thread);
+    drd_frame_queue_bench_report(impl, "spsc", depth, iterations, g_get_monotonic_time() - start);
+
+    DrdFrameQueueStats stats;
+    impl->get_stats(queue, &stats);
+    g_print("                    consumed=%" G_GUINT64_FORMAT " dropped=%" G_GUINT64_FORMAT " waits=%" G_GUINT64_FORMAT
+            " max_wait=%" G_GINT64_FORMAT " us\n",
+            consumed,
+            stats.dropped_frames,
+            stats.waits,
+            stats.wait_us_max);
+    impl->destroy(queue);
+}
+
+int
+main(int argc, char **argv)
+{
+    guint iterations = DRD_FRAME_QUEUE_BENCH_DEFAULT_ITERATIONS;
+    if (argc > 1)
+    {
+        guint64 parsed = g_ascii_strtoull(argv[1], NULL, 10);
+        if (parsed == 0 || parsed > G_MAXUINT)
+        {
+            g_printerr("usage: %s [iterations]\n", argv[0]);
+            return 1;
+        }
+        iterations = (guint) parsed;
+    }
+
+    g_autoptr(DrdFrame) frame = drd_frame_new();
+    drd_frame_configure(frame, 64, 64, 64 * 4, 0);
+
+    const guint depths[] = {DRD_FRAME_QUEUE_DEFAULT_DEPTH, DRD_FRAME_QUEUE_MAX_FRAMES};
+    for (guint i = 0; i < G_N_ELEMENTS(depths); ++i)
+    {
+        for (guint j = 0; j < G_N_ELEMENTS(drd_frame_queue_bench_impls); ++j)
+        {
+            const DrdFrameQueueBenchImpl *impl = &drd_frame_queue_bench_impls[j];
+            drd_frame_queue_bench_roundtrip(impl, depths[i], frame, iterations);
+            drd_frame_queue_bench_congested(impl, depths[i], frame, iterations);
+            drd_frame_queue_bench_spsc(impl, depths[i], frame, iterations);
+        }
+    }
+    return 0;
+}
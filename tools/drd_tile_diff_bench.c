@@ -0,0 +1,190 @@
+#include <glib.h>
+#include <string.h>
+
+#include "encoding/drd_encoding_manager.h"
+#include "utils/drd_frame.h"
+
+/*
+ * Rdpgfx 分析阶段（tile 变化检测）基准：在 1080p 与 4K 下对比单层 tile 与 super tile 两级检测，
+ * 场景分别为画面静止、小块区域变化（约一个光标/输入框大小）与整帧变化。
+ * 每轮交替分析两帧，耗时含基线帧拷贝，与会话分析线程的实际工作一致。
+ * 用法：drd-tile-diff-bench [每个场景的帧数]，默认 200。
+ */
+
+#define DRD_TILE_DIFF_BENCH_DEFAULT_FRAMES 200
+#define DRD_TILE_DIFF_BENCH_BPP 4
+/* 小块变化区域，模拟光标移动或文本输入 */
+#define DRD_TILE_DIFF_BENCH_SMALL_WIDTH 200
+#define DRD_TILE_DIFF_BENCH_SMALL_HEIGHT 100
+
+typedef enum
+{
+    DRD_TILE_DIFF_BENCH_STATIC = 0,
+    DRD_TILE_DIFF_BENCH_SMALL,
+    DRD_TILE_DIFF_BENCH_FULL
+} DrdTileDiffBenchScene;
+
+typedef struct
+{
+    guint width;
+    guint height;
+} DrdTileDiffBenchResolution;
+
+typedef struct
+{
+    guint tile_size;
+    guint super_tile_factor;
+} DrdTileDiffBenchLayout;
+
+/*
+ * 功能：创建填充了测试图案的捕获帧。
+ * 逻辑：按行写入与坐标相关的渐变作为底图；variant 非 0 时按场景改写像素：小块场景只改左上角附近的矩形，
+ *       整帧场景逐像素异或，使所有 tile 都发生变化。
+ * 参数：width/height 分辨率；scene 场景；variant 0 为底图，1 为变化后的帧。
+ * 外部接口：drd_frame_new/drd_frame_configure/drd_frame_ensure_capacity。
+ */
+static DrdFrame *
+drd_tile_diff_bench_frame_new(guint width, guint height, DrdTileDiffBenchScene scene, guint variant)
+{
+    const guint stride = width * DRD_TILE_DIFF_BENCH_BPP;
+    DrdFrame *frame = drd_frame_new();
+    drd_frame_configure(frame, width, height, stride, 0);
+    guint8 *data = drd_frame_ensure_capacity(frame, (gsize) stride * height);
+
+    for (guint y = 0; y < height; ++y)
+    {
+        guint8 *row = data + (gsize) y * stride;
+        for (guint x = 0; x < width; ++x)
+        {
+            guint8 *pixel = row + (gsize) x * DRD_TILE_DIFF_BENCH_BPP;
+            pixel[0] = (guint8) x;
+            pixel[1] = (guint8) y;
+            pixel[2] = (guint8) (x ^ y);
+            pixel[3] = 0xff;
+
+            if (variant == 0)
+            {
+                continue;
+            }
+            if (scene == DRD_TILE_DIFF_BENCH_FULL ||
+                (scene == DRD_TILE_DIFF_BENCH_SMALL && x >= 100 && x < 100 + DRD_TILE_DIFF_BENCH_SMALL_WIDTH &&
+                 y >= 100 && y < 100 + DRD_TILE_DIFF_BENCH_SMALL_HEIGHT))
+            {
+                pixel[0] ^= 0x5a;
+            }
+        }
+    }
+    return frame;
+}
+
+/*
+ * 功能：测量一种分辨率、tile 布局与场景下的分析耗时。
+ * 逻辑：按布局准备编码管理器，先分析一帧建立基线（几何变化帧不计时），随后交替分析两帧并计时，
+ *       输出每帧平均耗时与平均脏 tile 数。
+ * 参数：resolution 分辨率；layout tile 边长与 super tile 系数；scene 场景；frames 计时帧数。
+ * 外部接口：drd_encoding_manager_prepare/drd_encoding_manager_analyze_gfx_frame；GLib g_get_monotonic_time。
+ */
+static gboolean
+drd_tile_diff_bench_run(const DrdTileDiffBenchResolution *resolution,
+                        const DrdTileDiffBenchLayout *layout,
+                        DrdTileDiffBenchScene scene,
+                        guint frames)
+{
+    static const gchar *scene_names[] = {"static", "small", "full"};
+
+    DrdEncodingOptions options;
+    memset(&options, 0, sizeof(options));
+    options.width = resolution->width;
+    options.height = resolution->height;
+    options.mode = DRD_ENCODING_MODE_RFX;
+    options.enable_frame_diff = TRUE;
+    options.gfx_tile_size = layout->tile_size;
+    options.gfx_super_tile_factor = layout->super_tile_factor;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(DrdEncodingManager) manager = drd_encoding_manager_new();
+    if (!drd_encoding_manager_prepare(manager, &options, &error))
+    {
+        g_printerr("prepare failed: %s\n", error->message);
+        return FALSE;
+    }
+
+    g_autoptr(DrdFrame) base = drd_tile_diff_bench_frame_new(resolution->width, resolution->height, scene, 0);
+    g_autoptr(DrdFrame) changed = drd_tile_diff_bench_frame_new(resolution->width, resolution->height, scene, 1);
+    DrdFrame *inputs[] = {changed, base};
+
+    DrdGfxAnalysis *analysis = NULL;
+    if (!drd_encoding_manager_analyze_gfx_frame(manager, base, &analysis, &error))
+    {
+        g_printerr("analysis failed: %s\n", error->message);
+        return FALSE;
+    }
+    drd_gfx_analysis_free(analysis);
+
+    guint64 changed_tiles = 0;
+    guint total_tiles = 0;
+    const gint64 start = g_get_monotonic_time();
+    for (guint i = 0; i < frames; ++i)
+    {
+        if (!drd_encoding_manager_analyze_gfx_frame(manager, inputs[i % G_N_ELEMENTS(inputs)], &analysis, &error))
+        {
+            g_printerr("analysis failed: %s\n", error->message);
+            return FALSE;
+        }
+        changed_tiles += analysis->changed_tiles;
+        total_tiles = analysis->tiles_x * analysis->tiles_y;
+        drd_gfx_analysis_free(analysis);
+    }
+    const gint64 elapsed = g_get_monotonic_time() - start;
+
+    g_print("%4ux%-4u tile=%-3u super=x%-2u %-6s %8.3f ms/frame  dirty=%6.1f/%u\n",
+            resolution->width,
+            resolution->height,
+            layout->tile_size,
+            layout->super_tile_factor,
+            scene_names[scene],
+            elapsed / 1000.0 / MAX(frames, 1u),
+            changed_tiles / (gdouble) MAX(frames, 1u),
+            total_tiles);
+    return TRUE;
+}
+
+int
+main(int argc, char **argv)
+{
+    guint frames = DRD_TILE_DIFF_BENCH_DEFAULT_FRAMES;
+    if (argc > 1)
+    {
+        guint64 parsed = g_ascii_strtoull(argv[1], NULL, 10);
+        if (parsed == 0 || parsed > G_MAXUINT)
+        {
+            g_printerr("usage: %s [frames]\n", argv[0]);
+            return 1;
+        }
+        frames = (guint) parsed;
+    }
+
+    /* 第一项是变更前的固定 64×64 单层布局，作为对照 */
+    static const DrdTileDiffBenchResolution resolutions[] = {{1920, 1080}, {3840, 2160}};
+    static const DrdTileDiffBenchLayout layouts[] = {
+        {64, 1},
+        {DRD_GFX_DEFAULT_TILE_SIZE, DRD_GFX_DEFAULT_SUPER_TILE_FACTOR},
+        {32, 8},
+        {16, 16},
+    };
+
+    for (guint r = 0; r < G_N_ELEMENTS(resolutions); ++r)
+    {
+        for (guint l = 0; l < G_N_ELEMENTS(layouts); ++l)
+        {
+            for (guint s = DRD_TILE_DIFF_BENCH_STATIC; s <= DRD_TILE_DIFF_BENCH_FULL; ++s)
+            {
+                if (!drd_tile_diff_bench_run(&resolutions[r], &layouts[l], (DrdTileDiffBenchScene) s, frames))
+                {
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}